@@ -17,6 +17,28 @@ out/$(BUILD_MODE)/examples_provider.a : $(examples_provider_obj_files)
 	rm -f $@
 	$(AR) crsT $@ $^
 
+examples_provider_unittest_obj_files := $(EXAMPLES_PROVIDER_UNITTEST_SRC_FILES:%.cc=out/$(BUILD_MODE)/%.o)
+
+$(examples_provider_unittest_obj_files) : $(LIBEVHTP_HEADERS)
+$(examples_provider_unittest_obj_files) : INCLUDES += $(LIBEVHTP_INCLUDES)
+$(examples_provider_unittest_obj_files) : out/$(BUILD_MODE)/%.o : %.cc
+	mkdir -p $(dir $@)
+	$(CXX) $(DEFS_TEST) $(INCLUDES) $(CFLAGS) $(CFLAGS_$(BUILD_MODE)) $(CFLAGS_CC) -c -o $@ $<
+
+# Links only the providers under test, without the avahi and libevhtp libraries.
+out/$(BUILD_MODE)/examples_provider_testrunner : \
+	$(examples_provider_unittest_obj_files) \
+	out/$(BUILD_MODE)/examples/provider/curl_http_client.o \
+	out/$(BUILD_MODE)/examples/provider/event_task_runner.o \
+	out/$(BUILD_MODE)/libweave_common.a \
+	out/$(BUILD_MODE)/src/test/weave_testrunner.o \
+	$(third_party_gtest_lib) \
+	$(third_party_gmock_lib)
+	$(CXX) -o $@ $^ $(CFLAGS) -levent -lcurl -lcrypto -lexpat -lpthread -lrt
+
+examples-test : out/$(BUILD_MODE)/examples_provider_testrunner
+	$(TEST_ENV) $< $(TEST_FLAGS)
+
 EXAMPLES_DAEMON_SRC_FILES := \
 	examples/daemon/ledflasher/ledflasher.cc \
 	examples/daemon/light/light.cc \
@@ -63,7 +85,7 @@ out/$(BUILD_MODE)/weave_daemon_lock : out/$(BUILD_MODE)/examples/daemon/lock/loc
 out/$(BUILD_MODE)/weave_daemon_sample : out/$(BUILD_MODE)/examples/daemon/sample/sample.o $(example_daemon_deps)
 	$(CXX) -o $@ $^ $(CFLAGS) $(example_daemon_common_flags)
 
-all-examples : out/$(BUILD_MODE)/weave_daemon_ledflasher out/$(BUILD_MODE)/weave_daemon_light out/$(BUILD_MODE)/weave_daemon_lock out/$(BUILD_MODE)/weave_daemon_sample
+all-examples : out/$(BUILD_MODE)/weave_daemon_ledflasher out/$(BUILD_MODE)/weave_daemon_light out/$(BUILD_MODE)/weave_daemon_lock out/$(BUILD_MODE)/weave_daemon_sample out/$(BUILD_MODE)/examples_provider_testrunner
 
-.PHONY : all-examples
+.PHONY : all-examples examples-test
 
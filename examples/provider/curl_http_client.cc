@@ -5,14 +5,13 @@
 #include "examples/provider/curl_http_client.h"
 
 #include <algorithm>
-#include <future>
-#include <thread>
+#include <cstring>
 
 #include <base/bind.h>
 #include <base/logging.h>
-#include <curl/curl.h>
 #include <weave/enum_to_string.h>
-#include <weave/provider/task_runner.h>
+
+#include "examples/provider/event_task_runner.h"
 
 namespace weave {
 namespace examples {
@@ -35,144 +34,242 @@ size_t WriteFunction(void* contents, size_t size, size_t nmemb, void* userp) {
   return size * nmemb;
 }
 
-size_t HeaderFunction(void* contents, size_t size, size_t nmemb, void* userp) {
-  std::string header(static_cast<const char*>(contents), size * nmemb);
-  auto pos = header.find(':');
-  if (pos != std::string::npos) {
-    std::pair<std::string, std::string> header_pair;
-
-    static const char kSpaces[] = " \t\r\n";
-    header_pair.first = header.substr(0, pos);
-    pos = header.find_first_not_of(kSpaces, pos + 1);
-    if (pos != std::string::npos) {
-      auto last_non_space = header.find_last_not_of(kSpaces);
-      if (last_non_space >= pos)
-        header_pair.second = header.substr(pos, last_non_space - pos + 1);
-    }
+// Position of libcurl in the chunks of the request body.
+struct ReadState {
+  const CurlHttpClient::Chunks* chunks{nullptr};
+  size_t chunk{0};
+  size_t offset{0};
+};
 
-    static_cast<provider::HttpClient::Headers*>(userp)->emplace_back(
-        std::move(header_pair));
+size_t ReadFunction(char* buffer, size_t size, size_t nmemb, void* userp) {
+  ReadState* state = static_cast<ReadState*>(userp);
+  size_t written = 0;
+  while (written < size * nmemb && state->chunk < state->chunks->size()) {
+    const std::string& chunk = *(*state->chunks)[state->chunk];
+    size_t count =
+        std::min(size * nmemb - written, chunk.size() - state->offset);
+    memcpy(buffer + written, chunk.data() + state->offset, count);
+    written += count;
+    state->offset += count;
+    if (state->offset == chunk.size()) {
+      ++state->chunk;
+      state->offset = 0;
+    }
   }
-  return size * nmemb;
+  return written;
 }
 
-std::pair<std::unique_ptr<CurlHttpClient::Response>, ErrorPtr>
-SendRequestBlocking(CurlHttpClient::Method method,
-                    const std::string& url,
-                    const CurlHttpClient::Headers& headers,
-                    const std::string& data) {
+}  // namespace
+
+// State of a request in progress. libcurl reads the body from |data| and
+// writes the reply into |response|.
+struct CurlHttpClient::Request {
   std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl{curl_easy_init(),
                                                            &curl_easy_cleanup};
+  std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)> headers{
+      nullptr, &curl_slist_free_all};
+  Chunks data;
+  ReadState read_state;
+  std::unique_ptr<ResponseImpl> response{new ResponseImpl};
+  SendRequestCallback callback;
+};
+
+CurlHttpClient::CurlHttpClient(EventTaskRunner* task_runner)
+    : task_runner_{task_runner} {
+  CHECK(multi_);
+  timeout_event_.reset(
+      evtimer_new(task_runner_->GetEventBase(), &OnTimeout, this));
+
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_SOCKETFUNCTION,
+                                       &SocketFunction));
+  CHECK_EQ(CURLM_OK,
+           curl_multi_setopt(multi_.get(), CURLMOPT_SOCKETDATA, this));
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_TIMERFUNCTION,
+                                       &TimerFunction));
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_TIMERDATA, this));
+#if LIBCURL_VERSION_NUM >= 0x072B00
+  CHECK_EQ(CURLM_OK, curl_multi_setopt(multi_.get(), CURLMOPT_PIPELINING,
+                                       CURLPIPE_MULTIPLEX));
+#endif
+}
+
+CurlHttpClient::~CurlHttpClient() {
+  for (const auto& pair : requests_)
+    curl_multi_remove_handle(multi_.get(), pair.first);
+  // Closing the cached connections calls SocketFunction(), so the multi
+  // handle goes before the socket events.
+  multi_.reset();
+}
+
+void CurlHttpClient::SendRequest(Method method,
+                                 const std::string& url,
+                                 const Headers& headers,
+                                 const std::string& data,
+                                 const SendRequestCallback& callback) {
+  SendRequestWithChunks(method, url, headers,
+                        {std::make_shared<const std::string>(data)}, callback);
+}
+
+void CurlHttpClient::SendRequestWithChunks(
+    Method method,
+    const std::string& url,
+    const Headers& headers,
+    const Chunks& data,
+    const SendRequestCallback& callback) {
+  std::unique_ptr<Request> request{new Request};
+  request->data = data;
+  request->read_state.chunks = &request->data;
+  request->callback = callback;
+  CURL* curl = request->curl.get();
   CHECK(curl);
 
   switch (method) {
-    case CurlHttpClient::Method::kGet:
-      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HTTPGET, 1L));
+    case Method::kGet:
+      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L));
       break;
-    case CurlHttpClient::Method::kPost:
-      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HTTPPOST, 1L));
+    case Method::kPost:
+      // CURLOPT_POST is set below, together with the body.
       break;
-    case CurlHttpClient::Method::kPatch:
-    case CurlHttpClient::Method::kPut:
-      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_CUSTOMREQUEST,
+    case Method::kPatch:
+    case Method::kPut:
+      CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST,
                                           weave::EnumToString(method).c_str()));
       break;
   }
 
-  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str()));
-
-  curl_slist* chunk = nullptr;
-  for (const auto& h : headers)
-    chunk = curl_slist_append(chunk, (h.first + ": " + h.second).c_str());
-
-  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, chunk));
-
-  if (!data.empty() || method == CurlHttpClient::Method::kPost) {
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_URL, url.c_str()));
+#if LIBCURL_VERSION_NUM >= 0x072F00
+  // Uses HTTP/2 for https:// URLs if the server supports it.
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_HTTP_VERSION,
+                                      CURL_HTTP_VERSION_2TLS));
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072B00
+  // Waits for a connection being set up to the same host to multiplex over
+  // it, instead of opening another one.
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L));
+#endif
+
+  for (const auto& h : headers) {
+    request->headers.reset(curl_slist_append(
+        request->headers.release(), (h.first + ": " + h.second).c_str()));
+  }
+  CHECK_EQ(CURLE_OK,
+           curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request->headers.get()));
+
+  // The body is read from the chunks as libcurl sends it, without joining
+  // them into a single buffer.
+  curl_off_t data_size = 0;
+  for (const auto& chunk : request->data)
+    data_size += chunk->size();
+  if (data_size > 0 || method == Method::kPost) {
+    CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_POST, 1L));
+    CHECK_EQ(CURLE_OK,
+             curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, data_size));
+    CHECK_EQ(CURLE_OK,
+             curl_easy_setopt(curl, CURLOPT_READFUNCTION, &ReadFunction));
     CHECK_EQ(CURLE_OK,
-             curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, data.c_str()));
+             curl_easy_setopt(curl, CURLOPT_READDATA, &request->read_state));
   }
 
-  std::unique_ptr<ResponseImpl> response{new ResponseImpl};
-  CHECK_EQ(CURLE_OK,
-           curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, &WriteFunction));
-  CHECK_EQ(CURLE_OK,
-           curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &response->data));
-  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION,
-                                      &HeaderFunction));
-  provider::HttpClient::Headers response_headers;
   CHECK_EQ(CURLE_OK,
-           curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &response_headers));
+           curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &WriteFunction));
+  CHECK_EQ(CURLE_OK, curl_easy_setopt(curl, CURLOPT_WRITEDATA,
+                                      &request->response->data));
 
-  CURLcode res = curl_easy_perform(curl.get());
-  if (chunk)
-    curl_slist_free_all(chunk);
-
-  ErrorPtr error;
-  if (res != CURLE_OK) {
-    Error::AddTo(&error, FROM_HERE, "curl_easy_perform_error",
-                 curl_easy_strerror(res));
-    return {nullptr, std::move(error)};
-  }
+  requests_.emplace(curl, std::move(request));
+  // libcurl schedules the first action of the request with TimerFunction().
+  CHECK_EQ(CURLM_OK, curl_multi_add_handle(multi_.get(), curl));
+}
 
-  for (const auto& header : response_headers) {
-    if (header.first == "Content-Type")
-      response->content_type = header.second;
+int CurlHttpClient::SocketFunction(CURL* easy,
+                                   curl_socket_t socket,
+                                   int what,
+                                   void* userp,
+                                   void* socketp) {
+  CurlHttpClient* self = static_cast<CurlHttpClient*>(userp);
+  if (what == CURL_POLL_REMOVE) {
+    self->socket_events_.erase(socket);
+    return 0;
   }
 
-  CHECK_EQ(CURLE_OK, curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE,
-                                       &response->status));
-
-  return {std::move(response), nullptr};
+  // Level triggered, as libcurl does not necessarily drain the socket.
+  int16_t flags = EV_PERSIST;
+  flags |= (what & CURL_POLL_IN) ? EV_READ : 0;
+  flags |= (what & CURL_POLL_OUT) ? EV_WRITE : 0;
+  EventPtr<event>& socket_event = self->socket_events_[socket];
+  socket_event.reset(event_new(self->task_runner_->GetEventBase(), socket,
+                               flags, &OnSocketEvent, self));
+  event_add(socket_event.get(), nullptr);
+  return 0;
 }
 
-}  // namespace
+int CurlHttpClient::TimerFunction(CURLM* multi, long timeout_ms, void* userp) {
+  CurlHttpClient* self = static_cast<CurlHttpClient*>(userp);
+  if (timeout_ms < 0) {
+    evtimer_del(self->timeout_event_.get());
+    return 0;
+  }
+  timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+  evtimer_add(self->timeout_event_.get(), &tv);
+  return 0;
+}
 
-CurlHttpClient::CurlHttpClient(provider::TaskRunner* task_runner)
-    : task_runner_{task_runner} {}
+void CurlHttpClient::OnSocketEvent(int fd, int16_t what, void* userp) {
+  int events = 0;
+  events |= (what & EV_READ) ? CURL_CSELECT_IN : 0;
+  events |= (what & EV_WRITE) ? CURL_CSELECT_OUT : 0;
+  static_cast<CurlHttpClient*>(userp)->SocketAction(fd, events);
+}
 
-void CurlHttpClient::SendRequest(Method method,
-                                 const std::string& url,
-                                 const Headers& headers,
-                                 const std::string& data,
-                                 const SendRequestCallback& callback) {
-  pending_tasks_.emplace_back(
-      std::async(std::launch::async, SendRequestBlocking, method, url, headers,
-                 data),
-      callback);
-  if (pending_tasks_.size() == 1)  // More means check is scheduled.
-    CheckTasks();
+void CurlHttpClient::OnTimeout(int fd, int16_t what, void* userp) {
+  static_cast<CurlHttpClient*>(userp)->SocketAction(CURL_SOCKET_TIMEOUT, 0);
 }
 
-void CurlHttpClient::CheckTasks() {
-  VLOG(4) << "CurlHttpClient::CheckTasks, size=" << pending_tasks_.size();
-  auto ready_begin =
-      std::partition(pending_tasks_.begin(), pending_tasks_.end(),
-                     [](const decltype(pending_tasks_)::value_type& value) {
-                       return value.first.wait_for(std::chrono::seconds(0)) !=
-                              std::future_status::ready;
-                     });
-
-  for (auto it = ready_begin; it != pending_tasks_.end(); ++it) {
-    CHECK(it->first.valid());
-    auto result = it->first.get();
-    VLOG(2) << "CurlHttpClient::CheckTasks done";
+void CurlHttpClient::SocketAction(curl_socket_t socket, int events) {
+  int running_handles = 0;
+  CURLMcode code =
+      curl_multi_socket_action(multi_.get(), socket, events, &running_handles);
+  LOG_IF(WARNING, code != CURLM_OK) << "curl_multi_socket_action failed: "
+                                    << curl_multi_strerror(code);
+
+  CURLMsg* message = nullptr;
+  int messages_left = 0;
+  while ((message = curl_multi_info_read(multi_.get(), &messages_left))) {
+    if (message->msg != CURLMSG_DONE)
+      continue;
+    CURL* curl = message->easy_handle;
+    CURLcode res = message->data.result;
+    CHECK_EQ(CURLM_OK, curl_multi_remove_handle(multi_.get(), curl));
+    auto it = requests_.find(curl);
+    CHECK(it != requests_.end());
+    std::unique_ptr<Request> request = std::move(it->second);
+    requests_.erase(it);
+
+    std::unique_ptr<Response> response;
+    ErrorPtr error;
+    if (res == CURLE_OK) {
+      // Header names are case-insensitive, and always lowercase with HTTP/2,
+      // so libcurl looks the header up.
+      const char* content_type = nullptr;
+      CHECK_EQ(CURLE_OK, curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE,
+                                           &content_type));
+      if (content_type)
+        request->response->content_type = content_type;
+      CHECK_EQ(CURLE_OK, curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE,
+                                           &request->response->status));
+      response = std::move(request->response);
+    } else {
+      Error::AddTo(&error, FROM_HERE, "curl_easy_perform_error",
+                   curl_easy_strerror(res));
+    }
+    VLOG(2) << "CurlHttpClient request done";
+    // The callback may send new requests, so it does not run from within
+    // libcurl callbacks.
     task_runner_->PostDelayedTask(
-        FROM_HERE, base::Bind(it->second, base::Passed(&result.first),
-                              base::Passed(&result.second)),
+        FROM_HERE, base::Bind(request->callback, base::Passed(&response),
+                              base::Passed(&error)),
         {});
   }
-
-  pending_tasks_.erase(ready_begin, pending_tasks_.end());
-
-  if (pending_tasks_.empty()) {
-    VLOG(2) << "No more CurlHttpClient tasks";
-    return;
-  }
-
-  task_runner_->PostDelayedTask(
-      FROM_HERE,
-      base::Bind(&CurlHttpClient::CheckTasks, weak_ptr_factory_.GetWeakPtr()),
-      base::TimeDelta::FromMilliseconds(100));
 }
 
 }  // namespace examples
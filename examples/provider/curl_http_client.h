@@ -5,43 +5,69 @@
 #ifndef LIBWEAVE_EXAMPLES_PROVIDER_CURL_HTTP_CLIENT_H_
 #define LIBWEAVE_EXAMPLES_PROVIDER_CURL_HTTP_CLIENT_H_
 
-#include <future>
+#include <map>
+#include <memory>
 #include <string>
-#include <utility>
 
-#include <base/memory/weak_ptr.h>
+#include <base/macros.h>
+#include <curl/curl.h>
 #include <weave/provider/http_client.h>
 
-namespace weave {
-
-namespace provider {
-class TaskRunner;
-}
+#include "examples/provider/event_deleter.h"
 
+namespace weave {
 namespace examples {
 
-// Basic implementation of weave::HttpClient using libcurl. Should be used in
-// production code as it's blocking and does not validate server certificates.
+class EventTaskRunner;
+
+// Basic implementation of weave::HttpClient using libcurl. Should not be used
+// in production code as it does not validate server certificates.
+// Requests run concurrently on a single libcurl multi handle driven by the
+// libevent loop of |task_runner|. The multi handle keeps the connections
+// alive between requests and multiplexes requests to the same host over one
+// HTTP/2 connection when libcurl supports it.
 class CurlHttpClient : public provider::HttpClient {
  public:
-  explicit CurlHttpClient(provider::TaskRunner* task_runner);
+  explicit CurlHttpClient(EventTaskRunner* task_runner);
+  ~CurlHttpClient() override;
 
   void SendRequest(Method method,
                    const std::string& url,
                    const Headers& headers,
                    const std::string& data,
                    const SendRequestCallback& callback) override;
+  void SendRequestWithChunks(Method method,
+                             const std::string& url,
+                             const Headers& headers,
+                             const Chunks& data,
+                             const SendRequestCallback& callback) override;
 
  private:
-  void CheckTasks();
+  struct Request;
+
+  // Callbacks of the libcurl multi socket interface.
+  static int SocketFunction(CURL* easy,
+                            curl_socket_t socket,
+                            int what,
+                            void* userp,
+                            void* socketp);
+  static int TimerFunction(CURLM* multi, long timeout_ms, void* userp);
+
+  // libevent callbacks for the sockets and the timeout of libcurl.
+  static void OnSocketEvent(int fd, int16_t what, void* userp);
+  static void OnTimeout(int fd, int16_t what, void* userp);
+
+  // Lets libcurl process |socket|, then completes the finished requests.
+  void SocketAction(curl_socket_t socket, int events);
 
-  std::vector<
-      std::pair<std::future<std::pair<std::unique_ptr<Response>, ErrorPtr>>,
-                SendRequestCallback>>
-      pending_tasks_;
-  provider::TaskRunner* task_runner_{nullptr};
+  EventTaskRunner* task_runner_{nullptr};
+  std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)> multi_{
+      curl_multi_init(), &curl_multi_cleanup};
+  EventPtr<event> timeout_event_;
+  std::map<curl_socket_t, EventPtr<event>> socket_events_;
+  std::map<CURL*, std::unique_ptr<Request>> requests_;
 
-  base::WeakPtrFactory<CurlHttpClient> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(CurlHttpClient);
 };
 
 }  // namespace examples
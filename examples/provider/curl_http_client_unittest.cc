@@ -0,0 +1,92 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "examples/provider/curl_http_client.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <base/bind.h>
+#include <event2/buffer.h>
+#include <event2/http.h>
+#include <gtest/gtest.h>
+
+#include "examples/provider/event_task_runner.h"
+#include "src/bind_lambda.h"
+
+namespace weave {
+namespace examples {
+
+namespace {
+
+// Replies to every request with |content_type_header| set to
+// "application/json".
+void ReplyWithJson(evhttp_request* request, void* content_type_header) {
+  evhttp_add_header(evhttp_request_get_output_headers(request),
+                    static_cast<const char*>(content_type_header),
+                    "application/json; charset=utf-8");
+  EventPtr<evbuffer> body{evbuffer_new()};
+  evbuffer_add_printf(body.get(), "{}");
+  evhttp_send_reply(request, 200, "OK", body.get());
+}
+
+}  // namespace
+
+class CurlHttpClientTest : public ::testing::Test {
+ protected:
+  // Starts a local server, which names the content type header
+  // |content_type_header|, and returns its URL.
+  std::string StartServer(const char* content_type_header) {
+    server_.reset(evhttp_new(task_runner_.GetEventBase()));
+    evhttp_set_gencb(server_.get(), &ReplyWithJson,
+                     const_cast<char*>(content_type_header));
+    evhttp_bound_socket* socket =
+        evhttp_bind_socket_with_handle(server_.get(), "127.0.0.1", 0);
+    CHECK(socket);
+    sockaddr_in address = {};
+    socklen_t size = sizeof(address);
+    CHECK_EQ(0, getsockname(evhttp_bound_socket_get_fd(socket),
+                            reinterpret_cast<sockaddr*>(&address), &size));
+    return "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) + "/";
+  }
+
+  // Sends a GET request to |url| and returns the content type of the reply.
+  std::string GetContentType(const std::string& url) {
+    std::string content_type;
+    client_.SendRequest(
+        provider::HttpClient::Method::kGet, url, {}, {},
+        base::Bind(
+            [](EventTaskRunner* task_runner, std::string* content_type,
+               std::unique_ptr<provider::HttpClient::Response> response,
+               ErrorPtr error) {
+              EXPECT_FALSE(error);
+              if (response)
+                *content_type = response->GetContentType();
+              event_base_loopexit(task_runner->GetEventBase(), nullptr);
+            },
+            &task_runner_, &content_type));
+    task_runner_.Run();
+    return content_type;
+  }
+
+  EventTaskRunner task_runner_;
+  std::unique_ptr<evhttp, decltype(&evhttp_free)> server_{nullptr,
+                                                           &evhttp_free};
+  CurlHttpClient client_{&task_runner_};
+};
+
+TEST_F(CurlHttpClientTest, ContentType) {
+  EXPECT_EQ("application/json; charset=utf-8",
+            GetContentType(StartServer("Content-Type")));
+}
+
+TEST_F(CurlHttpClientTest, LowercaseContentType) {
+  // HTTP/2 replies have only lowercase header names.
+  EXPECT_EQ("application/json; charset=utf-8",
+            GetContentType(StartServer("content-type")));
+}
+
+}  // namespace examples
+}  // namespace weave
@@ -4,6 +4,7 @@
 
 #include "examples/provider/event_http_server.h"
 
+#include <memory>
 #include <vector>
 
 #include <base/bind.h>
@@ -25,6 +26,10 @@ std::string GetSslError() {
   return error;
 }
 
+void ReleaseChunk(const void* data, size_t length, void* chunk) {
+  delete static_cast<std::shared_ptr<const std::string>*>(chunk);
+}
+
 }  // namespace
 
 class HttpServerImpl::RequestImpl : public Request {
@@ -51,8 +56,49 @@ class HttpServerImpl::RequestImpl : public Request {
   void SendReply(int status_code,
                  const std::string& data,
                  const std::string& mime_type) override {
+    SendReplyWithHeaders(status_code, data, mime_type, {});
+  }
+
+  void SendReplyWithHeaders(
+      int status_code,
+      const std::string& data,
+      const std::string& mime_type,
+      const std::vector<std::pair<std::string, std::string>>& headers)
+      override {
     EventPtr<evbuffer> buf{evbuffer_new()};
     evbuffer_add(buf.get(), data.data(), data.size());
+    SendReplyWithBuffer(status_code, std::move(buf), mime_type, headers);
+  }
+
+  void SendReplyWithChunks(
+      int status_code,
+      const Chunks& chunks,
+      const std::string& mime_type,
+      const std::vector<std::pair<std::string, std::string>>& headers)
+      override {
+    // The buffer references the chunks instead of copying them. Each
+    // reference keeps its chunk alive until libevent has sent it.
+    EventPtr<evbuffer> buf{evbuffer_new()};
+    for (const auto& chunk : chunks) {
+      if (chunk->empty())
+        continue;
+      evbuffer_add_reference(buf.get(), chunk->data(), chunk->size(),
+                             &ReleaseChunk,
+                             new std::shared_ptr<const std::string>{chunk});
+    }
+    SendReplyWithBuffer(status_code, std::move(buf), mime_type, headers);
+  }
+
+ private:
+  void SendReplyWithBuffer(
+      int status_code,
+      EventPtr<evbuffer> buf,
+      const std::string& mime_type,
+      const std::vector<std::pair<std::string, std::string>>& headers) {
+    for (const auto& header : headers) {
+      evhtp_header_key_add(req_->headers_out, header.first.c_str(), 1);
+      evhtp_header_val_add(req_->headers_out, header.second.c_str(), 1);
+    }
     evhtp_header_key_add(req_->headers_out, "Content-Type", 0);
     evhtp_header_val_add(req_->headers_out, mime_type.c_str(), 1);
     evhtp_header_key_add(req_->headers_out, "Content-Length", 0);
@@ -63,7 +109,6 @@ class HttpServerImpl::RequestImpl : public Request {
     evhtp_send_reply_end(req_.get());
   }
 
- private:
   EventPtr<evhtp_request_t> req_;
   std::string data_;
 };
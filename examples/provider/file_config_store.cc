@@ -4,15 +4,17 @@
 
 #include "examples/provider/file_config_store.h"
 
+#include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 
 #include <fstream>
-#include <map>
 #include <string>
-#include <vector>
 
 #include <base/bind.h>
+#include <base/posix/eintr_wrapper.h>
 
 namespace weave {
 namespace examples {
@@ -79,11 +81,62 @@ void FileConfigStore::SaveSettings(const std::string& name,
                                    const std::string& settings,
                                    const DoneCallback& callback) {
   CHECK(mkdir(kSettingsDir, S_IRWXU) == 0 || errno == EEXIST);
-  LOG(INFO) << "Saving settings to " << GetPath(name);
-  std::ofstream str(GetPath(name));
-  str << settings;
-  if (!callback.is_null())
-    task_runner_->PostDelayedTask(FROM_HERE, base::Bind(callback, nullptr), {});
+  // Write a new file and replace the old one with it, so a crash leaves
+  // either the old or the new settings.
+  std::string path = GetPath(name);
+  std::string temp_path = path + ".tmp";
+  LOG(INFO) << "Saving settings to " << path;
+  int error = WriteFile(temp_path, settings);
+  if (!error && rename(temp_path.c_str(), path.c_str()) != 0)
+    error = errno;
+  if (error) {
+    unlink(temp_path.c_str());
+  } else {
+    // Make the rename durable.
+    int dir = HANDLE_EINTR(open(kSettingsDir, O_RDONLY | O_DIRECTORY));
+    if (dir >= 0) {
+      fsync(dir);
+      close(dir);
+    }
+  }
+
+  ErrorPtr save_error;
+  if (error) {
+    Error::AddToPrintf(&save_error, FROM_HERE, "file_write_error",
+                       "Failed to save %s: %s", path.c_str(), strerror(error));
+  }
+  if (callback.is_null()) {
+    // Nobody else would see the error.
+    if (save_error)
+      LOG(ERROR) << save_error->GetMessage();
+    return;
+  }
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(callback, base::Passed(&save_error)), {});
+}
+
+int FileConfigStore::WriteFile(const std::string& path,
+                               const std::string& data) {
+  int fd = HANDLE_EINTR(open(path.c_str(),
+                             O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                             S_IRUSR | S_IWUSR));
+  if (fd < 0)
+    return errno;
+  int error = 0;
+  for (size_t written = 0; written < data.size();) {
+    ssize_t size =
+        HANDLE_EINTR(write(fd, data.data() + written, data.size() - written));
+    if (size < 0) {
+      error = errno;
+      break;
+    }
+    written += size;
+  }
+  if (!error && fsync(fd) != 0)
+    error = errno;
+  if (close(fd) != 0 && !error)
+    error = errno;
+  return error;
 }
 
 }  // namespace examples
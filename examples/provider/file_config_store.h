@@ -5,9 +5,7 @@
 #ifndef LIBWEAVE_EXAMPLES_PROVIDER_FILE_CONFIG_STORE_H_
 #define LIBWEAVE_EXAMPLES_PROVIDER_FILE_CONFIG_STORE_H_
 
-#include <map>
 #include <string>
-#include <vector>
 
 #include <weave/provider/config_store.h>
 #include <weave/provider/task_runner.h>
@@ -15,6 +13,8 @@
 namespace weave {
 namespace examples {
 
+// Saves the settings into files, each file is replaced atomically. Saves are
+// written right away, libweave coalesces its changes before saving them.
 class FileConfigStore : public provider::ConfigStore {
  public:
   FileConfigStore(const std::string& model_id,
@@ -30,6 +30,10 @@ class FileConfigStore : public provider::ConfigStore {
 
  private:
   std::string GetPath(const std::string& name) const;
+  // Writes |data| to a new file at |path| and flushes it to the disk. Returns
+  // 0 or the errno of the failed call.
+  static int WriteFile(const std::string& path, const std::string& data);
+
   const std::string model_id_;
   provider::TaskRunner* task_runner_{nullptr};
 };
@@ -7,18 +7,25 @@ WEAVE_SRC_FILES := \
 	src/access_revocation_manager_impl.cc \
 	src/backoff_entry.cc \
 	src/base_api_handler.cc \
+	src/cbor.cc \
+	src/cloud_request_scheduler.cc \
 	src/commands/cloud_command_proxy.cc \
 	src/commands/command_instance.cc \
 	src/commands/command_queue.cc \
+	src/commands/command_update_batcher.cc \
 	src/commands/schema_constants.cc \
 	src/component_manager_impl.cc \
+	src/component_tree.cc \
 	src/config.cc \
 	src/data_encoding.cc \
+	src/debounced_closure.cc \
 	src/device_manager.cc \
 	src/device_registration_info.cc \
 	src/error.cc \
 	src/http_constants.cc \
 	src/json_error_codes.cc \
+	src/json_reader.cc \
+	src/json_writer.cc \
 	src/notification/notification_parser.cc \
 	src/notification/pull_channel.cc \
 	src/notification/xml_node.cc \
@@ -39,6 +46,7 @@ WEAVE_SRC_FILES := \
 	src/privet/wifi_bootstrap_manager.cc \
 	src/privet/wifi_ssid_generator.cc \
 	src/registration_status.cc \
+	src/schema_validator.cc \
 	src/states/state_change_queue.cc \
 	src/streams.cc \
 	src/string_utils.cc \
@@ -54,14 +62,21 @@ WEAVE_UNITTEST_SRC_FILES := \
 	src/access_revocation_manager_impl_unittest.cc \
 	src/backoff_entry_unittest.cc \
 	src/base_api_handler_unittest.cc \
+	src/cbor_unittest.cc \
+	src/cloud_request_scheduler_unittest.cc \
 	src/commands/cloud_command_proxy_unittest.cc \
 	src/commands/command_instance_unittest.cc \
 	src/commands/command_queue_unittest.cc \
+	src/commands/command_update_batcher_unittest.cc \
 	src/component_manager_unittest.cc \
+	src/component_tree_unittest.cc \
 	src/config_unittest.cc \
 	src/data_encoding_unittest.cc \
+	src/debounced_closure_unittest.cc \
 	src/device_registration_info_unittest.cc \
 	src/error_unittest.cc \
+	src/json_reader_unittest.cc \
+	src/json_writer_unittest.cc \
 	src/notification/notification_parser_unittest.cc \
 	src/notification/xml_node_unittest.cc \
 	src/notification/xmpp_channel_unittest.cc \
@@ -71,6 +86,7 @@ WEAVE_UNITTEST_SRC_FILES := \
 	src/privet/privet_handler_unittest.cc \
 	src/privet/security_manager_unittest.cc \
 	src/privet/wifi_ssid_generator_unittest.cc \
+	src/schema_validator_unittest.cc \
 	src/states/state_change_queue_unittest.cc \
 	src/streams_unittest.cc \
 	src/string_utils_unittest.cc \
@@ -79,6 +95,20 @@ WEAVE_UNITTEST_SRC_FILES := \
 WEAVE_EXPORTS_UNITTEST_SRC_FILES := \
 	src/weave_unittest.cc
 
+WEAVE_BENCHMARK_SRC_FILES := \
+	src/access_revocation_manager_impl_benchmark.cc \
+	src/cbor_benchmark.cc \
+	src/component_manager_benchmark.cc \
+	src/data_encoding_benchmark.cc \
+	src/json_reader_benchmark.cc \
+	src/json_writer_benchmark.cc \
+	src/notification/xmpp_stream_parser_benchmark.cc \
+	src/privet/auth_manager_benchmark.cc \
+	src/privet/privet_handler_benchmark.cc \
+	src/states/state_change_queue_benchmark.cc \
+	src/test/benchmark.cc \
+	src/values_benchmark.cc
+
 EXAMPLES_PROVIDER_SRC_FILES := \
 	examples/provider/avahi_client.cc \
 	examples/provider/bluez_client.cc \
@@ -90,6 +120,9 @@ EXAMPLES_PROVIDER_SRC_FILES := \
 	examples/provider/ssl_stream.cc \
 	examples/provider/wifi_manager.cc
 
+EXAMPLES_PROVIDER_UNITTEST_SRC_FILES := \
+	examples/provider/curl_http_client_unittest.cc
+
 THIRD_PARTY_CHROMIUM_BASE_SRC_FILES := \
 	third_party/chromium/base/bind_helpers.cc \
 	third_party/chromium/base/callback_internal.cc \
@@ -123,6 +156,7 @@ THIRD_PARTY_CHROMIUM_BASE_UNITTEST_SRC_FILES := \
 	third_party/chromium/base/bind_unittest.cc \
 	third_party/chromium/base/callback_list_unittest.cc \
 	third_party/chromium/base/callback_unittest.cc \
+	third_party/chromium/base/containers/flat_map_unittest.cc \
 	third_party/chromium/base/guid_unittest.cc \
 	third_party/chromium/base/json/json_parser_unittest.cc \
 	third_party/chromium/base/json/json_reader_unittest.cc \
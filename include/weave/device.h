@@ -75,6 +75,23 @@ inline bool operator!=(const RegistrationData& l, const RegistrationData& r) {
   return !(l == r);
 }
 
+// Handle of a component, obtained from Device::GetComponentHandle(). The
+// contents are private to libweave. A handle keeps referring to the same
+// component (even if its index in a component array changes) and becomes
+// invalid when the component is removed.
+struct ComponentHandle {
+  uint32_t slot{0};
+  uint32_t generation{0};
+};
+
+// Handle of a state property name, obtained from
+// Device::GetStatePropertyHandle(). The contents are private to libweave.
+struct StatePropertyHandle {
+  explicit StatePropertyHandle(uint32_t id = 0) : id{id} {}
+
+  uint32_t id;
+};
+
 class Device {
  public:
   virtual ~Device() {}
@@ -144,6 +161,29 @@ class Device {
                                 const base::Value& value,
                                 ErrorPtr* error) = 0;
 
+  // Resolves the |component| path into a handle, so that frequent state
+  // updates can be made without parsing the path each time.
+  // Returns a handle with zero |generation| if the component does not exist.
+  virtual ComponentHandle GetComponentHandle(const std::string& component,
+                                             ErrorPtr* error) const = 0;
+
+  // Resolves the full property name |name| (e.g. "base.network") into a
+  // handle. Returns a handle with zero |id| if the name is malformed or
+  // refers to a nested property (e.g. "trait.a.b").
+  virtual StatePropertyHandle GetStatePropertyHandle(const std::string& name,
+                                                     ErrorPtr* error) = 0;
+
+  // Same as SetStateProperties() and SetStateProperty() but take handles
+  // instead of a component path and a property name. Fail if |component| has
+  // been removed.
+  virtual bool SetStatePropertiesByHandle(ComponentHandle component,
+                                          const base::DictionaryValue& dict,
+                                          ErrorPtr* error) = 0;
+  virtual bool SetStatePropertyByHandle(ComponentHandle component,
+                                        StatePropertyHandle property,
+                                        const base::Value& value,
+                                        ErrorPtr* error) = 0;
+
   // Callback type for AddCommandHandler.
   using CommandHandlerCallback =
       base::Callback<void(const std::weak_ptr<Command>& command)>;
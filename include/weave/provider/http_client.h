@@ -5,6 +5,7 @@
 #ifndef LIBWEAVE_INCLUDE_WEAVE_PROVIDER_HTTP_CLIENT_H_
 #define LIBWEAVE_INCLUDE_WEAVE_PROVIDER_HTTP_CLIENT_H_
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -43,6 +44,13 @@ namespace provider {
 //   callback - standard callback to notify libweave when request is complete
 //     and provide results and response data.
 //
+// Implementation of the SendRequestWithChunks(...) method should do the same
+// as SendRequest(...) with the request body made of |chunks|, a chain of
+// buffers. libweave uses it to send large requests without joining them into
+// a single string. The buffers are immutable and the implementation may keep
+// references to them until the request is complete. The default
+// implementation joins the buffers and calls SendRequest(...).
+//
 // Implementation of the SendRequest(...) should be non-blocking, meaning it
 // should schedule network request and return right away. Later (after the
 // request is complete), callback should be invokes on the same thread.
@@ -91,6 +99,19 @@ class HttpClient {
                            const std::string& data,
                            const SendRequestCallback& callback) = 0;
 
+  using Chunks = std::vector<std::shared_ptr<const std::string>>;
+
+  virtual void SendRequestWithChunks(Method method,
+                                     const std::string& url,
+                                     const Headers& headers,
+                                     const Chunks& chunks,
+                                     const SendRequestCallback& callback) {
+    std::string data;
+    for (const auto& chunk : chunks)
+      data += *chunk;
+    SendRequest(method, url, headers, data, callback);
+  }
+
  protected:
   virtual ~HttpClient() {}
 };
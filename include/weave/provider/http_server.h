@@ -5,7 +5,9 @@
 #ifndef LIBWEAVE_INCLUDE_WEAVE_PROVIDER_HTTP_SERVER_H_
 #define LIBWEAVE_INCLUDE_WEAVE_PROVIDER_HTTP_SERVER_H_
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <base/callback.h>
@@ -89,6 +91,20 @@ namespace provider {
 // HTTP headers, like "Content-Length" or "Transfer-Encoding" depending on
 // capabilities of the server and client which made this request.
 //
+// Implementation of the SendReplyWithHeaders(...) method should do the same
+// as SendReply(...), and in addition send the given response headers, for
+// example "ETag". The default implementation drops the headers and calls
+// SendReply(...), which is sufficient for servers that can not set custom
+// headers.
+//
+// Implementation of the SendReplyWithChunks(...) method should do the same
+// as SendReplyWithHeaders(...) with the response body made of |chunks|, a
+// chain of buffers. libweave uses it to send large responses without joining
+// them into a single string. The buffers are immutable and the server may
+// keep references to them until the response is sent, e.g. with
+// evbuffer_add_reference(). The default implementation joins the buffers and
+// calls SendReplyWithHeaders(...).
+//
 // In case a device has multiple networking interfaces, the device developer
 // needs to make a decision where local APIs (Privet) are necessary and where
 // they are not needed. For example, it may not make sense to expose local
@@ -118,6 +134,27 @@ class HttpServer {
     virtual void SendReply(int status_code,
                            const std::string& data,
                            const std::string& mime_type) = 0;
+
+    virtual void SendReplyWithHeaders(
+        int status_code,
+        const std::string& data,
+        const std::string& mime_type,
+        const std::vector<std::pair<std::string, std::string>>& headers) {
+      SendReply(status_code, data, mime_type);
+    }
+
+    using Chunks = std::vector<std::shared_ptr<const std::string>>;
+
+    virtual void SendReplyWithChunks(
+        int status_code,
+        const Chunks& chunks,
+        const std::string& mime_type,
+        const std::vector<std::pair<std::string, std::string>>& headers) {
+      std::string data;
+      for (const auto& chunk : chunks)
+        data += *chunk;
+      SendReplyWithHeaders(status_code, data, mime_type, headers);
+    }
   };
 
   // Callback type for AddRequestHandler.
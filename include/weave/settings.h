@@ -73,6 +73,27 @@ struct Settings {
   bool allow_endpoints_override{false};
   bool wifi_auto_setup_enabled{true};
   std::string test_privet_ssid;
+
+  // State changes are published to the cloud once there were no further
+  // changes for |state_publish_window|, but no later than
+  // |state_publish_max_delay| after the first unpublished change. A zero
+  // window publishes every change as soon as possible. Changes that command
+  // updates wait for are published right away.
+  base::TimeDelta state_publish_window{base::TimeDelta::FromSeconds(1)};
+  base::TimeDelta state_publish_max_delay{base::TimeDelta::FromSeconds(5)};
+  // Maximum number of component patches sent in a single request.
+  size_t state_publish_max_batch_size{50};
+
+  // Sends the command updates made at the same time as one request to
+  // commands/batchUpdate instead of a PATCH per command. The server must
+  // support the batch endpoint.
+  bool batch_command_updates{false};
+
+  // Rejects state changes that do not match the "state" schemas of their
+  // traits, including properties the traits do not declare. Off by default,
+  // as existing devices may report state their trait definitions do not
+  // describe.
+  bool validate_state{false};
 };
 
 }  // namespace weave
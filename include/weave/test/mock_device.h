@@ -51,6 +51,20 @@ class MockDevice : public Device {
                     const std::string& name,
                     const base::Value& value,
                     ErrorPtr* error));
+  MOCK_CONST_METHOD2(GetComponentHandle,
+                     ComponentHandle(const std::string& component,
+                                     ErrorPtr* error));
+  MOCK_METHOD2(GetStatePropertyHandle,
+               StatePropertyHandle(const std::string& name, ErrorPtr* error));
+  MOCK_METHOD3(SetStatePropertiesByHandle,
+               bool(ComponentHandle component,
+                    const base::DictionaryValue& dict,
+                    ErrorPtr* error));
+  MOCK_METHOD4(SetStatePropertyByHandle,
+               bool(ComponentHandle component,
+                    StatePropertyHandle property,
+                    const base::Value& value,
+                    ErrorPtr* error));
   MOCK_METHOD3(AddCommandHandler,
                void(const std::string& component,
                     const std::string& command_name,
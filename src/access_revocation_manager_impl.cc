@@ -4,10 +4,13 @@
 
 #include "src/access_revocation_manager_impl.h"
 
+#include <algorithm>
 #include <memory>
 
+#include <base/bind.h>
 #include <base/json/json_reader.h>
 #include <base/json/json_writer.h>
+#include <base/logging.h>
 #include <base/memory/ptr_util.h>
 #include <base/values.h>
 
@@ -24,43 +27,91 @@ const char kUser[] = "user";
 const char kApp[] = "app";
 const char kExpiration[] = "expiration";
 const char kRevocation[] = "revocation";
+
+using Entry = AccessRevocationManager::Entry;
+
+// Returns the number of entries in the saved |json| list, including the ones
+// which fail to parse.
+size_t ParseEntries(const std::string& json, std::vector<Entry>* entries) {
+  auto list = base::ListValue::From(base::JSONReader::Read(json));
+  if (!list)
+    return 0;
+  for (const auto& value : *list) {
+    const base::DictionaryValue* entry{nullptr};
+    std::string user;
+    std::string app;
+    Entry e;
+    int revocation = 0;
+    int expiration = 0;
+    if (value->GetAsDictionary(&entry) && entry->GetString(kUser, &user) &&
+        Base64Decode(user, &e.user_id) && entry->GetString(kApp, &app) &&
+        Base64Decode(app, &e.app_id) &&
+        entry->GetInteger(kRevocation, &revocation) &&
+        entry->GetInteger(kExpiration, &expiration)) {
+      e.revocation = FromJ2000Time(revocation);
+      e.expiration = FromJ2000Time(expiration);
+      entries->push_back(std::move(e));
+    }
+  }
+  return list->GetSize();
 }
 
+// 64-bit FNV-1a digest of the ids of an entry.
+uint64_t HashIds(const std::vector<uint8_t>& user_id,
+                 const std::vector<uint8_t>& app_id) {
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](uint8_t byte) { hash = (hash ^ byte) * 1099511628211ull; };
+  for (uint8_t byte : user_id)
+    add(byte);
+  // Separates the ids, so moving bytes between them changes the digest.
+  add(static_cast<uint8_t>(user_id.size()));
+  for (uint8_t byte : app_id)
+    add(byte);
+  return hash;
+}
+
+void RunSaveCallbacks(const std::vector<DoneCallback>& callbacks,
+                      ErrorPtr error) {
+  for (const auto& callback : callbacks) {
+    if (!callback.is_null())
+      callback.Run(error ? error->Clone() : nullptr);
+  }
+}
+
+}  // namespace
+
 AccessRevocationManagerImpl::AccessRevocationManagerImpl(
     provider::ConfigStore* store,
+    provider::TaskRunner* task_runner,
     size_t capacity,
     base::Clock* clock)
-    : capacity_{capacity}, clock_{clock}, store_{store} {
+    : capacity_{capacity},
+      clock_{clock ? clock : &default_clock_},
+      store_{store},
+      task_runner_{task_runner} {
   Load();
 }
 
+AccessRevocationManagerImpl::~AccessRevocationManagerImpl() {
+  // Write the pending changes and report them to the Block() callers.
+  if (save_scheduled_)
+    SaveNow();
+}
+
 void AccessRevocationManagerImpl::Load() {
   if (!store_)
     return;
-  if (auto list = base::ListValue::From(
-          base::JSONReader::Read(store_->LoadSettings(kConfigFileName)))) {
-    for (const auto& value : *list) {
-      const base::DictionaryValue* entry{nullptr};
-      std::string user;
-      std::string app;
-      Entry e;
-      int revocation = 0;
-      int expiration = 0;
-      if (value->GetAsDictionary(&entry) && entry->GetString(kUser, &user) &&
-          Base64Decode(user, &e.user_id) && entry->GetString(kApp, &app) &&
-          Base64Decode(app, &e.app_id) &&
-          entry->GetInteger(kRevocation, &revocation) &&
-          entry->GetInteger(kExpiration, &expiration)) {
-        e.revocation = FromJ2000Time(revocation);
-        e.expiration = FromJ2000Time(expiration);
-        if (e.expiration > clock_->Now())
-          entries_.insert(e);
-      }
-    }
-    if (entries_.size() < list->GetSize()) {
-      // Save some storage space by saving without expired entries.
-      Save({});
-    }
+  std::vector<Entry> entries;
+  size_t count =
+      ParseEntries(store_->LoadSettings(kConfigFileName), &entries);
+  base::Time now = clock_->Now();
+  for (const auto& e : entries) {
+    if (e.expiration > now)
+      Insert(e);
+  }
+  if (entries_.size() < count) {
+    // Save some storage space by saving without expired entries.
+    Save({});
   }
 }
 
@@ -71,6 +122,23 @@ void AccessRevocationManagerImpl::Save(const DoneCallback& callback) {
     return;
   }
 
+  save_callbacks_.push_back(callback);
+  if (!task_runner_)
+    return SaveNow();
+  if (save_scheduled_)
+    return;
+  save_scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&AccessRevocationManagerImpl::SaveNow,
+                            weak_ptr_factory_.GetWeakPtr()),
+      {});
+}
+
+void AccessRevocationManagerImpl::SaveNow() {
+  save_scheduled_ = false;
+  std::vector<DoneCallback> callbacks;
+  callbacks.swap(save_callbacks_);
+
   base::ListValue list;
   for (const auto& e : entries_) {
     std::unique_ptr<base::DictionaryValue> entry =
@@ -84,41 +152,97 @@ void AccessRevocationManagerImpl::Save(const DoneCallback& callback) {
 
   std::string json;
   base::JSONWriter::Write(list, &json);
-  store_->SaveSettings(kConfigFileName, json, callback);
+  store_->SaveSettings(kConfigFileName, json,
+                       base::Bind(&RunSaveCallbacks, callbacks));
 }
 
 void AccessRevocationManagerImpl::Shrink() {
-  base::Time oldest[2] = {base::Time::Max(), base::Time::Max()};
-  for (auto i = begin(entries_); i != end(entries_);) {
-    if (i->expiration <= clock_->Now())
-      i = entries_.erase(i);
-    else {
-      // Non-strict comparison to ensure counting same timestamps as different.
-      if (i->revocation <= oldest[0]) {
-        oldest[1] = oldest[0];
-        oldest[0] = i->revocation;
+  base::Time now = clock_->Now();
+  if (now >= next_expiration_) {
+    next_expiration_ = base::Time::Max();
+    for (auto i = begin(entries_); i != end(entries_);) {
+      if (i->expiration <= now) {
+        i = EraseEntry(i);
       } else {
-        oldest[1] = std::min(oldest[1], i->revocation);
+        next_expiration_ = std::min(next_expiration_, i->expiration);
+        ++i;
       }
-      ++i;
     }
   }
   CHECK_GT(capacity_, 1u);
-  if (entries_.size() >= capacity_) {
-    // List is full so we are going to remove oldest entries from the list.
-    for (auto i = begin(entries_); i != end(entries_);) {
-      if (i->revocation <= oldest[1])
-        i = entries_.erase(i);
-      else {
-        ++i;
-      }
+  if (entries_.size() < capacity_)
+    return;
+
+  // List is full so we are going to replace the oldest entries with a single
+  // rule. Removing |count| entries and adding one leaves room for one more.
+  size_t count = entries_.size() + 2 - capacity_;
+  std::vector<base::Time> revocations;
+  revocations.reserve(entries_.size());
+  for (const auto& e : entries_)
+    revocations.push_back(e.revocation);
+  auto nth = revocations.begin() + count - 1;
+  std::nth_element(revocations.begin(), nth, revocations.end());
+  base::Time oldest = *nth;
+
+  for (auto i = begin(entries_); i != end(entries_);) {
+    if (i->revocation <= oldest)
+      i = EraseEntry(i);
+    else {
+      ++i;
+    }
+  }
+  // And replace with a single rule to block everything older.
+  Entry all_blocking_entry;
+  all_blocking_entry.expiration = base::Time::Max();
+  all_blocking_entry.revocation = oldest;
+  AddEntry(all_blocking_entry);
+}
+
+void AccessRevocationManagerImpl::Insert(const Entry& entry) {
+  // The merged entry expires no earlier, so |next_expiration_| stays a lower
+  // bound.
+  next_expiration_ = std::min(next_expiration_, entry.expiration);
+  auto existing = entries_.find(entry);
+  if (existing != entries_.end()) {
+    Entry new_entry = entry;
+    new_entry.expiration = std::max(entry.expiration, existing->expiration);
+    new_entry.revocation = std::max(entry.revocation, existing->revocation);
+    EraseEntry(existing);
+    AddEntry(new_entry);
+  } else {
+    AddEntry(entry);
+  }
+}
+
+void AccessRevocationManagerImpl::AddEntry(const Entry& entry) {
+  auto result = entries_.insert(entry);
+  if (result.second) {
+    index_.emplace(HashIds(entry.user_id, entry.app_id),
+                   &*result.first);
+  }
+}
+
+AccessRevocationManagerImpl::EntrySet::iterator
+AccessRevocationManagerImpl::EraseEntry(EntrySet::iterator entry) {
+  auto range = index_.equal_range(HashIds(entry->user_id, entry->app_id));
+  for (auto i = range.first; i != range.second; ++i) {
+    if (i->second == &*entry) {
+      index_.erase(i);
+      break;
     }
-    // And replace with a single rule to block everything older.
-    Entry all_blocking_entry;
-    all_blocking_entry.expiration = base::Time::Max();
-    all_blocking_entry.revocation = oldest[1];
-    entries_.insert(all_blocking_entry);
   }
+  return entries_.erase(entry);
+}
+
+const AccessRevocationManager::Entry* AccessRevocationManagerImpl::FindEntry(
+    const std::vector<uint8_t>& user_id,
+    const std::vector<uint8_t>& app_id) const {
+  auto range = index_.equal_range(HashIds(user_id, app_id));
+  for (auto i = range.first; i != range.second; ++i) {
+    if (i->second->user_id == user_id && i->second->app_id == app_id)
+      return i->second;
+  }
+  return nullptr;
 }
 
 void AccessRevocationManagerImpl::AddEntryAddedCallback(
@@ -137,21 +261,9 @@ void AccessRevocationManagerImpl::Block(const Entry& entry,
     }
     return;
   }
-
-  // Iterating is OK as Save below is more expensive.
   Shrink();
-  CHECK_LT(entries_.size(), capacity_);
-
-  auto existing = entries_.find(entry);
-  if (existing != entries_.end()) {
-    Entry new_entry = entry;
-    new_entry.expiration = std::max(entry.expiration, existing->expiration);
-    new_entry.revocation = std::max(entry.revocation, existing->revocation);
-    entries_.erase(existing);
-    entries_.insert(new_entry);
-  } else {
-    entries_.insert(entry);
-  }
+  Insert(entry);
+  CHECK_LE(entries_.size(), capacity_);
 
   for (const auto& cb : on_entry_added_callbacks_)
     cb.Run();
@@ -162,18 +274,20 @@ void AccessRevocationManagerImpl::Block(const Entry& entry,
 bool AccessRevocationManagerImpl::IsBlocked(const std::vector<uint8_t>& user_id,
                                             const std::vector<uint8_t>& app_id,
                                             base::Time timestamp) const {
-  Entry entry_to_find;
-  const std::vector<uint8_t> no_id;
-  for (const auto& user : {no_id, user_id}) {
-    for (const auto& app : {no_id, app_id}) {
-      entry_to_find.user_id = user;
-      entry_to_find.app_id = app;
-      auto match = entries_.find(entry_to_find);
-      if (match != end(entries_) && match->expiration > clock_->Now() &&
-          match->revocation >= timestamp) {
-        return true;
-      }
-    }
+  const Entry* matches[] = {
+      FindEntry(no_id_, no_id_), FindEntry(no_id_, app_id),
+      FindEntry(user_id, no_id_), FindEntry(user_id, app_id),
+  };
+  base::Time now;
+  for (const Entry* match : matches) {
+    if (!match || match->revocation < timestamp)
+      continue;
+    // Entries are only dropped once they expire, so check the expiration.
+    // The clock is only read when needed, most requests match no entry.
+    if (now.is_null())
+      now = clock_->Now();
+    if (match->expiration > now)
+      return true;
   }
   return false;
 }
@@ -6,22 +6,32 @@
 #define LIBWEAVE_SRC_ACCESS_REVOCATION_MANAGER_IMPL_H_
 
 #include <set>
+#include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include <base/memory/weak_ptr.h>
 #include <base/time/default_clock.h>
 #include <base/time/time.h>
 #include <weave/error.h>
 #include <weave/provider/config_store.h>
+#include <weave/provider/task_runner.h>
 
 #include "src/access_revocation_manager.h"
 
 namespace weave {
 
+// Keeps the revocation list in memory and saves it to |store| as a JSON list.
+// If |task_runner| is set, the changes made during one task are saved
+// together, otherwise every change is saved immediately.
 class AccessRevocationManagerImpl : public AccessRevocationManager {
  public:
-  explicit AccessRevocationManagerImpl(provider::ConfigStore* store,
-                                       size_t capacity = 1024,
-                                       base::Clock* clock = nullptr);
+  AccessRevocationManagerImpl(provider::ConfigStore* store,
+                              provider::TaskRunner* task_runner,
+                              size_t capacity = 1024,
+                              base::Clock* clock = nullptr);
+  ~AccessRevocationManagerImpl() override;
 
   // AccessRevocationManager implementation.
   void AddEntryAddedCallback(const base::Closure& callback) override;
@@ -35,8 +45,15 @@ class AccessRevocationManagerImpl : public AccessRevocationManager {
 
  private:
   void Load();
+  // Saves the list now, or with the other changes of the current task if
+  // there is |task_runner_|.
   void Save(const DoneCallback& callback);
+  void SaveNow();
+  // Drops expired entries and, if the list is full, replaces the oldest ones
+  // with a single all-blocking entry.
   void Shrink();
+  // Adds |entry| or merges it into the existing entry with the same ids.
+  void Insert(const Entry& entry);
 
   struct EntryIdsLess {
     bool operator()(const Entry& l, const Entry& r) const {
@@ -47,14 +64,37 @@ class AccessRevocationManagerImpl : public AccessRevocationManager {
     }
   };
 
+  using EntrySet = std::set<Entry, EntryIdsLess>;
+
+  // Add and remove entries of |entries_| and keep |index_| in sync.
+  void AddEntry(const Entry& entry);
+  EntrySet::iterator EraseEntry(EntrySet::iterator entry);
+  // Returns the entry with exactly these ids or nullptr.
+  const Entry* FindEntry(const std::vector<uint8_t>& user_id,
+                         const std::vector<uint8_t>& app_id) const;
+
   const size_t capacity_{0};
   base::DefaultClock default_clock_;
   base::Clock* clock_{&default_clock_};
 
   provider::ConfigStore* store_{nullptr};
-  std::set<Entry, EntryIdsLess> entries_;
+  provider::TaskRunner* task_runner_{nullptr};
+  EntrySet entries_;
+  // Entries of |entries_| by the digest of their ids. Lookups only hash and
+  // compare the ids, without building a key.
+  std::unordered_multimap<uint64_t, const Entry*> index_;
+  // Empty id to look up the wildcard entries.
+  const std::vector<uint8_t> no_id_;
+  // Earliest expiration of |entries_|, expired entries are only looked for
+  // once it has passed.
+  base::Time next_expiration_{base::Time::Max()};
   std::vector<base::Closure> on_entry_added_callbacks_;
 
+  // Set while a task to save the changes is posted.
+  bool save_scheduled_{false};
+  std::vector<DoneCallback> save_callbacks_;
+
+  base::WeakPtrFactory<AccessRevocationManagerImpl> weak_ptr_factory_{this};
   DISALLOW_COPY_AND_ASSIGN(AccessRevocationManagerImpl);
 };
 
@@ -0,0 +1,32 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/access_revocation_manager_impl.h"
+
+#include <base/time/default_clock.h>
+
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+// Checks an access token which none of the size() revocation entries
+// matches, as most privet requests do.
+WEAVE_BENCHMARK(AccessRevocationManagerIsBlocked) {
+  base::DefaultClock clock;
+  AccessRevocationManagerImpl manager{nullptr, nullptr, state->size() + 2,
+                                      &clock};
+  base::Time expiration = clock.Now() + base::TimeDelta::FromDays(1);
+  for (size_t i = 0; i < state->size(); ++i) {
+    std::vector<uint8_t> id{static_cast<uint8_t>(i),
+                            static_cast<uint8_t>(i >> 8)};
+    manager.Block({id, id, clock.Now(), expiration}, {});
+  }
+
+  const std::vector<uint8_t> user_id{1, 2, 3, 4, 5, 6, 7, 8};
+  const std::vector<uint8_t> app_id{8, 7, 6, 5, 4, 3, 2, 1};
+  while (state->KeepRunning())
+    CHECK(!manager.IsBlocked(user_id, app_id, {}));
+}
+
+}  // namespace weave
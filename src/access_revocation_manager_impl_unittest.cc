@@ -6,6 +6,7 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
 #include <weave/provider/test/mock_config_store.h>
 #include <weave/test/unittest_utils.h>
 
@@ -36,28 +37,39 @@ class AccessRevocationManagerImplTest : public testing::Test {
     EXPECT_CALL(config_store_, LoadSettings("black_list"))
         .WillOnce(Return(to_load));
 
+    // The list is saved without the expired entry.
+    ExpectSave();
+
+    EXPECT_CALL(clock_, Now())
+        .WillRepeatedly(Return(base::Time::FromTimeT(1412121212)));
+    manager_.reset(
+        new AccessRevocationManagerImpl{&config_store_, nullptr, 10, &clock_});
+  }
+
+  // Expects a single save of the list, into |saved_|.
+  void ExpectSave() {
     EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
         .WillOnce(testing::WithArgs<1, 2>(testing::Invoke(
-            [](const std::string& json, const DoneCallback& callback) {
-              std::string to_save = R"([{
-                "user": "AQID",
-                "app": "AwQF",
-                "expiration": 473315199,
-                "revocation": 473313199
-              }])";
-              EXPECT_JSON_EQ(to_save, *test::CreateValue(json));
+            [this](const std::string& data, const DoneCallback& callback) {
+              saved_ = data;
               if (!callback.is_null())
                 callback.Run(nullptr);
-            })));
+            })))
+        .RetiresOnSaturation();
+  }
 
-    EXPECT_CALL(clock_, Now())
-        .WillRepeatedly(Return(base::Time::FromTimeT(1412121212)));
-    manager_.reset(
-        new AccessRevocationManagerImpl{&config_store_, 10, &clock_});
+  // Returns the entries loaded from the saved list |data|.
+  std::vector<AccessRevocationManager::Entry> Reload(const std::string& data) {
+    StrictMock<provider::test::MockConfigStore> store{false};
+    EXPECT_CALL(store, LoadSettings("black_list")).WillOnce(Return(data));
+    return AccessRevocationManagerImpl{&store, nullptr, 10, &clock_}
+        .GetEntries();
   }
+
   StrictMock<test::MockClock> clock_;
   StrictMock<provider::test::MockConfigStore> config_store_{false};
   std::unique_ptr<AccessRevocationManagerImpl> manager_;
+  std::string saved_;
 };
 
 TEST_F(AccessRevocationManagerImplTest, Init) {
@@ -70,6 +82,12 @@ TEST_F(AccessRevocationManagerImplTest, Init) {
                 base::Time::FromTimeT(1419999999),
             }}),
             manager_->GetEntries());
+  // The list is saved as minified JSON, which all versions can read.
+  EXPECT_EQ(
+      R"([{"app":"AwQF","expiration":473315199,"revocation":473313199,)"
+      R"("user":"AQID"}])",
+      saved_);
+  EXPECT_EQ(manager_->GetEntries(), Reload(saved_));
 }
 
 TEST_F(AccessRevocationManagerImplTest, Block) {
@@ -77,30 +95,91 @@ TEST_F(AccessRevocationManagerImplTest, Block) {
   manager_->AddEntryAddedCallback(
       base::Bind([](bool* callback_called) { *callback_called = true; },
                  base::Unretained(&callback_called)));
-  EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
-      .WillOnce(testing::WithArgs<1, 2>(testing::Invoke(
-          [](const std::string& json, const DoneCallback& callback) {
-            std::string to_save = R"([{
-                "user": "AQID",
-                "app": "AwQF",
-                "expiration": 473315199,
-                "revocation": 473313199
-              }, {
-                "app": "CAgI",
-                "user": "BwcH",
-                "expiration": 473305200,
-                "revocation": 473295200
-              }])";
-            EXPECT_JSON_EQ(to_save, *test::CreateValue(json));
-            if (!callback.is_null())
-              callback.Run(nullptr);
-          })));
+  ExpectSave();
   manager_->Block({{7, 7, 7},
                    {8, 8, 8},
                    base::Time::FromTimeT(1419980000),
                    base::Time::FromTimeT(1419990000)},
                   {});
   EXPECT_TRUE(callback_called);
+  std::string to_save = R"([{
+      "user": "AQID",
+      "app": "AwQF",
+      "expiration": 473315199,
+      "revocation": 473313199
+    }, {
+      "app": "CAgI",
+      "user": "BwcH",
+      "expiration": 473305200,
+      "revocation": 473295200
+    }])";
+  EXPECT_JSON_EQ(to_save, *test::CreateValue(saved_));
+  EXPECT_EQ((std::vector<AccessRevocationManagerImpl::Entry>{
+                {{1, 2, 3},
+                 {3, 4, 5},
+                 base::Time::FromTimeT(1419997999),
+                 base::Time::FromTimeT(1419999999)},
+                {{7, 7, 7},
+                 {8, 8, 8},
+                 base::Time::FromTimeT(1419980000),
+                 base::Time::FromTimeT(1419990000)},
+            }),
+            Reload(saved_));
+}
+
+TEST_F(AccessRevocationManagerImplTest, BlockSavesOnce) {
+  provider::test::FakeTaskRunner task_runner;
+  EXPECT_CALL(config_store_, LoadSettings("black_list"))
+      .WillOnce(Return(saved_));
+  manager_.reset(new AccessRevocationManagerImpl{&config_store_, &task_runner,
+                                                 10, &clock_});
+
+  size_t done_count = 0;
+  auto done = base::Bind(
+      [](size_t* done_count, ErrorPtr error) {
+        EXPECT_FALSE(error);
+        ++*done_count;
+      },
+      base::Unretained(&done_count));
+  const base::Time revocation = base::Time::FromTimeT(1419980000);
+  const base::Time expiration = base::Time::FromTimeT(1419990000);
+  manager_->Block({{7}, {8}, revocation, expiration}, done);
+  manager_->Block({{7}, {9}, revocation, expiration}, done);
+  manager_->Block({{}, {11}, revocation, expiration}, done);
+  // The entries are blocked right away but saved together later.
+  EXPECT_EQ(4u, manager_->GetSize());
+  EXPECT_TRUE(manager_->IsBlocked({1}, {11}, revocation));
+  EXPECT_EQ(0u, done_count);
+
+  ExpectSave();
+  task_runner.RunOnce();
+  EXPECT_EQ(3u, done_count);
+  EXPECT_EQ(manager_->GetEntries(), Reload(saved_));
+}
+
+TEST_F(AccessRevocationManagerImplTest, DestroySavesPendingChanges) {
+  provider::test::FakeTaskRunner task_runner;
+  EXPECT_CALL(config_store_, LoadSettings("black_list"))
+      .WillOnce(Return(saved_));
+  manager_.reset(new AccessRevocationManagerImpl{&config_store_, &task_runner,
+                                                 10, &clock_});
+
+  bool done = false;
+  manager_->Block({{7}, {8}, base::Time::FromTimeT(1419980000),
+                   base::Time::FromTimeT(1419990000)},
+                  base::Bind(
+                      [](bool* done, ErrorPtr error) {
+                        EXPECT_FALSE(error);
+                        *done = true;
+                      },
+                      base::Unretained(&done)));
+  EXPECT_FALSE(done);
+
+  ExpectSave();
+  auto entries = manager_->GetEntries();
+  manager_.reset();
+  EXPECT_TRUE(done);
+  EXPECT_EQ(entries, Reload(saved_));
 }
 
 TEST_F(AccessRevocationManagerImplTest, BlockExpired) {
@@ -115,7 +194,8 @@ TEST_F(AccessRevocationManagerImplTest, BlockExpired) {
 
 TEST_F(AccessRevocationManagerImplTest, BlockListOverflow) {
   EXPECT_CALL(config_store_, LoadSettings("black_list")).WillOnce(Return(""));
-  manager_.reset(new AccessRevocationManagerImpl{&config_store_, 10, &clock_});
+  manager_.reset(
+      new AccessRevocationManagerImpl{&config_store_, nullptr, 10, &clock_});
 
   EXPECT_CALL(config_store_, SaveSettings("black_list", _, _))
       .WillRepeatedly(testing::WithArgs<1, 2>(testing::Invoke(
@@ -159,6 +239,14 @@ TEST_F(AccessRevocationManagerImplTest, IsBlockedIdsNotMacth) {
   EXPECT_FALSE(manager_->IsBlocked({7, 7, 7}, {8, 8, 8}, {}));
 }
 
+TEST_F(AccessRevocationManagerImplTest, IsBlockedIdsSplitDifferently) {
+  ExpectSave();
+  manager_->Block({{7, 7}, {8}, {}, base::Time::FromTimeT(1419990000)}, {});
+  EXPECT_TRUE(manager_->IsBlocked({7, 7}, {8}, {}));
+  EXPECT_FALSE(manager_->IsBlocked({7}, {7, 8}, {}));
+  EXPECT_FALSE(manager_->IsBlocked({7, 7, 8}, {}, {}));
+}
+
 TEST_F(AccessRevocationManagerImplTest, IsBlockedRevocationIsOld) {
   // Ids match but delegation time is newer than revocation time.
   EXPECT_FALSE(manager_->IsBlocked({1, 2, 3}, {3, 4, 5},
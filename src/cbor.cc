@@ -0,0 +1,446 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/cbor.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <base/logging.h>
+#include <base/strings/string_util.h>
+
+namespace weave {
+
+namespace errors {
+namespace cbor {
+const char kParseError[] = "cbor_parse_error";
+}  // namespace cbor
+}  // namespace errors
+
+namespace {
+
+// Major types.
+const uint8_t kUnsigned = 0;
+const uint8_t kNegative = 1;
+const uint8_t kByteString = 2;
+const uint8_t kTextString = 3;
+const uint8_t kArray = 4;
+const uint8_t kMap = 5;
+const uint8_t kTag = 6;
+const uint8_t kSimple = 7;
+
+// Additional information of the initial byte.
+const uint8_t kOneByte = 24;
+const uint8_t kTwoBytes = 25;
+const uint8_t kFourBytes = 26;
+const uint8_t kEightBytes = 27;
+const uint8_t kIndefinite = 31;
+
+// Simple values and floats of major type 7.
+const uint8_t kFalse = 20;
+const uint8_t kTrue = 21;
+const uint8_t kNull = 22;
+const uint8_t kUndefined = 23;
+const uint8_t kHalfFloat = kTwoBytes;
+const uint8_t kSingleFloat = kFourBytes;
+const uint8_t kDoubleFloat = kEightBytes;
+const uint8_t kBreak = 0xff;
+
+// Same limit as base::JSONReader.
+const int kMaxDepth = 100;
+
+void WriteBigEndian(uint64_t value, size_t size, std::string* output) {
+  for (size_t i = size; i > 0; --i)
+    output->push_back(static_cast<char>(value >> ((i - 1) * 8)));
+}
+
+// Writes the initial byte of a data item with the shortest encoding of
+// |argument|.
+void WriteHead(uint8_t major_type, uint64_t argument, std::string* output) {
+  uint8_t head = major_type << 5;
+  if (argument < kOneByte) {
+    output->push_back(static_cast<char>(head | argument));
+  } else if (argument <= std::numeric_limits<uint8_t>::max()) {
+    output->push_back(static_cast<char>(head | kOneByte));
+    WriteBigEndian(argument, 1, output);
+  } else if (argument <= std::numeric_limits<uint16_t>::max()) {
+    output->push_back(static_cast<char>(head | kTwoBytes));
+    WriteBigEndian(argument, 2, output);
+  } else if (argument <= std::numeric_limits<uint32_t>::max()) {
+    output->push_back(static_cast<char>(head | kFourBytes));
+    WriteBigEndian(argument, 4, output);
+  } else {
+    output->push_back(static_cast<char>(head | kEightBytes));
+    WriteBigEndian(argument, 8, output);
+  }
+}
+
+void WriteString(uint8_t major_type,
+                 const char* data,
+                 size_t size,
+                 std::string* output) {
+  WriteHead(major_type, size, output);
+  output->append(data, size);
+}
+
+void WriteValue(const base::Value& value, std::string* output) {
+  switch (value.GetType()) {
+    case base::Value::TYPE_NULL:
+      WriteHead(kSimple, kNull, output);
+      break;
+    case base::Value::TYPE_BOOLEAN: {
+      bool bool_value = false;
+      CHECK(value.GetAsBoolean(&bool_value));
+      WriteHead(kSimple, bool_value ? kTrue : kFalse, output);
+      break;
+    }
+    case base::Value::TYPE_INTEGER: {
+      int int_value = 0;
+      CHECK(value.GetAsInteger(&int_value));
+      if (int_value >= 0) {
+        WriteHead(kUnsigned, int_value, output);
+      } else {
+        // -1 - int_value does not overflow for negative values.
+        WriteHead(kNegative, static_cast<uint64_t>(-1 - int_value), output);
+      }
+      break;
+    }
+    case base::Value::TYPE_DOUBLE: {
+      double double_value = 0;
+      CHECK(value.GetAsDouble(&double_value));
+      float float_value = static_cast<float>(double_value);
+      if (float_value == double_value || std::isnan(double_value)) {
+        uint32_t bits = 0;
+        memcpy(&bits, &float_value, sizeof(bits));
+        output->push_back(static_cast<char>(kSimple << 5 | kSingleFloat));
+        WriteBigEndian(bits, sizeof(bits), output);
+      } else {
+        uint64_t bits = 0;
+        memcpy(&bits, &double_value, sizeof(bits));
+        output->push_back(static_cast<char>(kSimple << 5 | kDoubleFloat));
+        WriteBigEndian(bits, sizeof(bits), output);
+      }
+      break;
+    }
+    case base::Value::TYPE_STRING: {
+      std::string string_value;
+      CHECK(value.GetAsString(&string_value));
+      WriteString(kTextString, string_value.data(), string_value.size(),
+                  output);
+      break;
+    }
+    case base::Value::TYPE_BINARY: {
+      const base::BinaryValue* binary_value =
+          static_cast<const base::BinaryValue*>(&value);
+      WriteString(kByteString, binary_value->GetBuffer(),
+                  binary_value->GetSize(), output);
+      break;
+    }
+    case base::Value::TYPE_DICTIONARY: {
+      const base::DictionaryValue* dict_value = nullptr;
+      CHECK(value.GetAsDictionary(&dict_value));
+      WriteHead(kMap, dict_value->size(), output);
+      for (base::DictionaryValue::Iterator it(*dict_value); !it.IsAtEnd();
+           it.Advance()) {
+        WriteString(kTextString, it.key().data(), it.key().size(), output);
+        WriteValue(it.value(), output);
+      }
+      break;
+    }
+    case base::Value::TYPE_LIST: {
+      const base::ListValue* list_value = nullptr;
+      CHECK(value.GetAsList(&list_value));
+      WriteHead(kArray, list_value->GetSize(), output);
+      for (const auto& item : *list_value)
+        WriteValue(*item, output);
+      break;
+    }
+  }
+}
+
+double DecodeHalfFloat(uint16_t half) {
+  // Same as the decoder in RFC 7049, Appendix D.
+  int exponent = (half >> 10) & 0x1f;
+  int mantissa = half & 0x3ff;
+  double value = 0;
+  if (exponent == 0)
+    value = std::ldexp(mantissa, -24);
+  else if (exponent != 31)
+    value = std::ldexp(mantissa + 1024, exponent - 25);
+  else
+    value = mantissa == 0 ? std::numeric_limits<double>::infinity()
+                          : std::numeric_limits<double>::quiet_NaN();
+  return half & 0x8000 ? -value : value;
+}
+
+class Decoder final {
+ public:
+  Decoder(const std::string& data, ErrorPtr* error)
+      : data_{data}, error_{error} {}
+
+  std::unique_ptr<base::Value> Decode() {
+    std::unique_ptr<base::Value> value = ReadValue(0);
+    if (value && pos_ != data_.size()) {
+      value.reset();
+      SetError("Unexpected data after the data item");
+    }
+    return value;
+  }
+
+ private:
+  // Data item head: the major type, the additional information and the
+  // argument it encodes.
+  struct Head {
+    uint8_t major_type;
+    uint8_t info;
+    uint64_t argument;
+  };
+
+  bool SetError(const char* message) {
+    Error::AddToPrintf(error_, FROM_HERE, errors::cbor::kParseError,
+                       "%s at offset %zu", message, pos_);
+    return false;
+  }
+
+  bool ReadBigEndian(size_t size, uint64_t* value) {
+    if (data_.size() - pos_ < size)
+      return SetError("Unexpected end of data");
+    *value = 0;
+    for (size_t i = 0; i < size; ++i)
+      *value = *value << 8 | static_cast<uint8_t>(data_[pos_++]);
+    return true;
+  }
+
+  bool ReadHead(Head* head) {
+    uint64_t initial_byte = 0;
+    if (!ReadBigEndian(1, &initial_byte))
+      return false;
+    head->major_type = initial_byte >> 5;
+    head->info = initial_byte & 0x1f;
+    head->argument = 0;
+    if (head->info < kOneByte) {
+      head->argument = head->info;
+      return true;
+    }
+    switch (head->info) {
+      case kOneByte:
+        return ReadBigEndian(1, &head->argument);
+      case kTwoBytes:
+        return ReadBigEndian(2, &head->argument);
+      case kFourBytes:
+        return ReadBigEndian(4, &head->argument);
+      case kEightBytes:
+        return ReadBigEndian(8, &head->argument);
+      case kIndefinite:
+        if (head->major_type >= kByteString && head->major_type <= kMap)
+          return true;
+        if (head->major_type == kSimple)
+          return SetError("Unexpected break");
+        return SetError("Invalid indefinite length");
+      default:
+        return SetError("Invalid additional information");
+    }
+  }
+
+  // Returns true and skips the break byte if it is next.
+  bool ReadBreak() {
+    if (pos_ < data_.size() && static_cast<uint8_t>(data_[pos_]) == kBreak) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  // Reads the content of a byte or text string. Chunks of indefinite-length
+  // strings are concatenated.
+  bool ReadString(const Head& head, std::string* output) {
+    if (head.info != kIndefinite) {
+      if (data_.size() - pos_ < head.argument)
+        return SetError("Unexpected end of data");
+      output->append(data_, pos_, head.argument);
+      pos_ += head.argument;
+      return true;
+    }
+    while (!ReadBreak()) {
+      Head chunk;
+      if (!ReadHead(&chunk))
+        return false;
+      if (chunk.major_type != head.major_type || chunk.info == kIndefinite)
+        return SetError("Invalid string chunk");
+      if (!ReadString(chunk, output))
+        return false;
+    }
+    return true;
+  }
+
+  bool ReadTextString(const Head& head, std::string* output) {
+    if (!ReadString(head, output))
+      return false;
+    if (!base::IsStringUTF8(*output))
+      return SetError("Invalid UTF-8 string");
+    return true;
+  }
+
+  // Returns true if there are more items in an array or a map with |count|
+  // items, or until the break byte if |indefinite|.
+  bool HasMoreItems(bool indefinite, uint64_t* count) {
+    if (indefinite)
+      return !ReadBreak();
+    if (*count == 0)
+      return false;
+    --*count;
+    return true;
+  }
+
+  std::unique_ptr<base::Value> ReadValue(int depth) {
+    if (depth > kMaxDepth) {
+      SetError("Data items are nested too deep");
+      return nullptr;
+    }
+    Head head;
+    if (!ReadHead(&head))
+      return nullptr;
+    switch (head.major_type) {
+      case kUnsigned:
+        return CreateInteger(static_cast<double>(head.argument),
+                             head.argument <= std::numeric_limits<int>::max());
+      case kNegative:
+        return CreateInteger(
+            -1 - static_cast<double>(head.argument),
+            head.argument <=
+                static_cast<uint64_t>(-1 - std::numeric_limits<int>::min()));
+      case kByteString: {
+        std::string value;
+        if (!ReadString(head, &value))
+          return nullptr;
+        return base::BinaryValue::CreateWithCopiedBuffer(value.data(),
+                                                         value.size());
+      }
+      case kTextString: {
+        std::string value;
+        if (!ReadTextString(head, &value))
+          return nullptr;
+        return std::unique_ptr<base::Value>{new base::StringValue{value}};
+      }
+      case kArray: {
+        std::unique_ptr<base::ListValue> list{new base::ListValue};
+        bool indefinite = head.info == kIndefinite;
+        while (HasMoreItems(indefinite, &head.argument)) {
+          std::unique_ptr<base::Value> item = ReadValue(depth + 1);
+          if (!item)
+            return nullptr;
+          list->Append(std::move(item));
+        }
+        return std::move(list);
+      }
+      case kMap: {
+        std::unique_ptr<base::DictionaryValue> dict{new base::DictionaryValue};
+        bool indefinite = head.info == kIndefinite;
+        while (HasMoreItems(indefinite, &head.argument)) {
+          Head key_head;
+          std::string key;
+          if (!ReadHead(&key_head))
+            return nullptr;
+          if (key_head.major_type != kTextString) {
+            SetError("Map key is not a text string");
+            return nullptr;
+          }
+          if (!ReadTextString(key_head, &key))
+            return nullptr;
+          std::unique_ptr<base::Value> item = ReadValue(depth + 1);
+          if (!item)
+            return nullptr;
+          dict->SetWithoutPathExpansion(key, std::move(item));
+        }
+        return std::move(dict);
+      }
+      case kTag:
+        return ReadValue(depth + 1);
+      case kSimple:
+        return ReadSimpleValue(head);
+    }
+    NOTREACHED();
+    return nullptr;
+  }
+
+  std::unique_ptr<base::Value> CreateInteger(double value, bool is_int) {
+    if (is_int) {
+      return std::unique_ptr<base::Value>{
+          new base::FundamentalValue{static_cast<int>(value)}};
+    }
+    return std::unique_ptr<base::Value>{new base::FundamentalValue{value}};
+  }
+
+  std::unique_ptr<base::Value> ReadSimpleValue(const Head& head) {
+    double value = 0;
+    switch (head.info) {
+      case kFalse:
+        return std::unique_ptr<base::Value>{new base::FundamentalValue{false}};
+      case kTrue:
+        return std::unique_ptr<base::Value>{new base::FundamentalValue{true}};
+      case kNull:
+      case kUndefined:
+        return base::Value::CreateNullValue();
+      case kHalfFloat:
+        value = DecodeHalfFloat(static_cast<uint16_t>(head.argument));
+        break;
+      case kSingleFloat: {
+        uint32_t bits = static_cast<uint32_t>(head.argument);
+        float float_value = 0;
+        memcpy(&float_value, &bits, sizeof(bits));
+        value = float_value;
+        break;
+      }
+      case kDoubleFloat:
+        memcpy(&value, &head.argument, sizeof(value));
+        break;
+      default:
+        SetError("Unsupported simple value");
+        return nullptr;
+    }
+    return std::unique_ptr<base::Value>{new base::FundamentalValue{value}};
+  }
+
+  const std::string& data_;
+  ErrorPtr* error_{nullptr};
+  size_t pos_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(Decoder);
+};
+
+}  // namespace
+
+std::string CborEncode(const base::Value& value) {
+  std::string output;
+  WriteValue(value, &output);
+  return output;
+}
+
+void CborEncode(const base::Value& value, std::string* output) {
+  WriteValue(value, output);
+}
+
+void CborEncodeMapStart(std::string* output) {
+  output->push_back(static_cast<char>(kMap << 5 | kIndefinite));
+}
+
+void CborEncodeArrayStart(std::string* output) {
+  output->push_back(static_cast<char>(kArray << 5 | kIndefinite));
+}
+
+void CborEncodeBreak(std::string* output) {
+  output->push_back(static_cast<char>(kBreak));
+}
+
+void CborEncodeString(const std::string& value, std::string* output) {
+  WriteString(kTextString, value.data(), value.size(), output);
+}
+
+std::unique_ptr<base::Value> CborDecode(const std::string& data,
+                                        ErrorPtr* error) {
+  return Decoder{data, error}.Decode();
+}
+
+}  // namespace weave
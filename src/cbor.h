@@ -0,0 +1,46 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_CBOR_H_
+#define LIBWEAVE_SRC_CBOR_H_
+
+#include <memory>
+#include <string>
+
+#include <base/values.h>
+#include <weave/error.h>
+
+namespace weave {
+
+namespace errors {
+namespace cbor {
+extern const char kParseError[];
+}  // namespace cbor
+}  // namespace errors
+
+// Encodes |value| as a CBOR (RFC 7049) data item. Dictionaries are encoded as
+// maps with text string keys, binary values as byte strings. Doubles are
+// encoded as single-precision floats if this does not lose precision.
+std::string CborEncode(const base::Value& value);
+// Appends the encoding of |value| to |output|.
+void CborEncode(const base::Value& value, std::string* output);
+
+// Encode a data item piece by piece, e.g. while walking a live data structure
+// (see JsonWriter). Maps and arrays are started with indefinite length and
+// ended by CborEncodeBreak().
+void CborEncodeMapStart(std::string* output);
+void CborEncodeArrayStart(std::string* output);
+void CborEncodeBreak(std::string* output);
+void CborEncodeString(const std::string& value, std::string* output);
+
+// Decodes a single CBOR data item from |data|. Integers which do not fit into
+// int are decoded as doubles, undefined as null, and tags are ignored.
+// Returns nullptr if |data| is malformed, has trailing bytes or contains maps
+// with keys which are not text strings.
+std::unique_ptr<base::Value> CborDecode(const std::string& data,
+                                        ErrorPtr* error);
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_CBOR_H_
@@ -0,0 +1,73 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/cbor.h"
+
+#include <base/json/json_reader.h>
+#include <base/json/json_writer.h>
+
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kTraitCount = 10;
+const size_t kPropertyCount = 10;
+
+// Returns the component tree of |size| components, as privet /components
+// replies with it.
+std::unique_ptr<base::DictionaryValue> CreateComponents(size_t size) {
+  std::unique_ptr<base::DictionaryValue> reply{new base::DictionaryValue};
+  reply->Set("components", benchmark::CreateComponentTree(size, kTraitCount,
+                                                          kPropertyCount));
+  reply->SetString("fingerprint", "1");
+  return reply;
+}
+
+}  // namespace
+
+// Encodes the reply in the formerly used pretty-printed JSON for reference.
+WEAVE_BENCHMARK(EncodeComponentsPrettyJson) {
+  auto components = CreateComponents(state->size());
+  std::string json;
+  while (state->KeepRunning()) {
+    base::JSONWriter::WriteWithOptions(
+        *components, base::JSONWriter::OPTIONS_PRETTY_PRINT, &json);
+  }
+  state->set_bytes(json.size());
+}
+
+WEAVE_BENCHMARK(EncodeComponentsJson) {
+  auto components = CreateComponents(state->size());
+  std::string json;
+  while (state->KeepRunning())
+    base::JSONWriter::Write(*components, &json);
+  state->set_bytes(json.size());
+}
+
+WEAVE_BENCHMARK(EncodeComponentsCbor) {
+  auto components = CreateComponents(state->size());
+  std::string cbor;
+  while (state->KeepRunning())
+    cbor = CborEncode(*components);
+  state->set_bytes(cbor.size());
+}
+
+WEAVE_BENCHMARK(DecodeComponentsJson) {
+  std::string json;
+  base::JSONWriter::Write(*CreateComponents(state->size()), &json);
+  while (state->KeepRunning())
+    CHECK(base::JSONReader::Read(json));
+  state->set_bytes(json.size());
+}
+
+WEAVE_BENCHMARK(DecodeComponentsCbor) {
+  std::string cbor = CborEncode(*CreateComponents(state->size()));
+  while (state->KeepRunning())
+    CHECK(CborDecode(cbor, nullptr));
+  state->set_bytes(cbor.size());
+}
+
+}  // namespace weave
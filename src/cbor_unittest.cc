@@ -0,0 +1,174 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/cbor.h"
+
+#include <base/strings/string_number_conversions.h>
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+namespace weave {
+
+namespace {
+
+using test::CreateValue;
+
+std::string FromHex(const std::string& hex) {
+  std::vector<uint8_t> bytes;
+  EXPECT_TRUE(hex.empty() || base::HexStringToBytes(hex, &bytes)) << hex;
+  return std::string{bytes.begin(), bytes.end()};
+}
+
+std::string EncodeToHex(const std::string& json) {
+  std::string cbor = CborEncode(*CreateValue(json));
+  return base::HexEncode(cbor.data(), cbor.size());
+}
+
+std::unique_ptr<base::Value> DecodeHex(const std::string& hex) {
+  ErrorPtr error;
+  auto value = CborDecode(FromHex(hex), &error);
+  EXPECT_TRUE(value) << hex << ": " << error->GetMessage();
+  return value;
+}
+
+std::string DecodeHexError(const std::string& hex) {
+  ErrorPtr error;
+  EXPECT_FALSE(CborDecode(FromHex(hex), &error)) << hex;
+  return error ? error->GetCode() : std::string{};
+}
+
+}  // namespace
+
+// Examples from RFC 7049, Appendix A.
+TEST(Cbor, EncodeScalars) {
+  EXPECT_EQ("00", EncodeToHex("0"));
+  EXPECT_EQ("17", EncodeToHex("23"));
+  EXPECT_EQ("1818", EncodeToHex("24"));
+  EXPECT_EQ("1864", EncodeToHex("100"));
+  EXPECT_EQ("1903E8", EncodeToHex("1000"));
+  EXPECT_EQ("1A000F4240", EncodeToHex("1000000"));
+  EXPECT_EQ("20", EncodeToHex("-1"));
+  EXPECT_EQ("3863", EncodeToHex("-100"));
+  EXPECT_EQ("3903E7", EncodeToHex("-1000"));
+  EXPECT_EQ("3A7FFFFFFF", EncodeToHex("-2147483648"));
+  EXPECT_EQ("FA3FC00000", EncodeToHex("1.5"));
+  EXPECT_EQ("FB3FF199999999999A", EncodeToHex("1.1"));
+  EXPECT_EQ("F4", EncodeToHex("false"));
+  EXPECT_EQ("F5", EncodeToHex("true"));
+  EXPECT_EQ("F6", EncodeToHex("null"));
+  EXPECT_EQ("60", EncodeToHex("\"\""));
+  EXPECT_EQ("6449455446", EncodeToHex("\"IETF\""));
+  EXPECT_EQ("62C3BC", EncodeToHex("\"\\u00fc\""));
+}
+
+TEST(Cbor, EncodeContainers) {
+  EXPECT_EQ("80", EncodeToHex("[]"));
+  EXPECT_EQ("83010203", EncodeToHex("[1, 2, 3]"));
+  EXPECT_EQ("A0", EncodeToHex("{}"));
+  EXPECT_EQ("A26161016162820203", EncodeToHex("{'a': 1, 'b': [2, 3]}"));
+}
+
+TEST(Cbor, EncodeBinary) {
+  auto value = base::BinaryValue::CreateWithCopiedBuffer("\x01\x02\x03", 3);
+  EXPECT_EQ(FromHex("43010203"), CborEncode(*value));
+}
+
+TEST(Cbor, RoundTrip) {
+  const char kJson[] = R"({
+    'bool': true,
+    'double': -0.1,
+    'int': -2147483648,
+    'list': [null, 'string', {}, [1000000]],
+    'nested': {'a': {'b': {'c': 2147483647}}}
+  })";
+  auto value = CreateValue(kJson);
+  auto decoded = CborDecode(CborEncode(*value), nullptr);
+  ASSERT_TRUE(decoded);
+  EXPECT_JSON_EQ(kJson, *decoded);
+}
+
+TEST(Cbor, DecodeScalars) {
+  EXPECT_JSON_EQ("0", *DecodeHex("00"));
+  EXPECT_JSON_EQ("1000000", *DecodeHex("1A000F4240"));
+  EXPECT_JSON_EQ("1000000", *DecodeHex("1B00000000000F4240"));
+  EXPECT_JSON_EQ("-1000", *DecodeHex("3903E7"));
+  EXPECT_JSON_EQ("false", *DecodeHex("F4"));
+  EXPECT_JSON_EQ("true", *DecodeHex("F5"));
+  EXPECT_JSON_EQ("null", *DecodeHex("F6"));
+  EXPECT_JSON_EQ("null", *DecodeHex("F7"));
+  EXPECT_JSON_EQ("\"IETF\"", *DecodeHex("6449455446"));
+  EXPECT_JSON_EQ("\"\\u00fc\"", *DecodeHex("62C3BC"));
+  // Tags are ignored.
+  EXPECT_JSON_EQ("1363896240", *DecodeHex("C11A514B67B0"));
+}
+
+TEST(Cbor, DecodeLargeIntegers) {
+  EXPECT_JSON_EQ("2147483647", *DecodeHex("1A7FFFFFFF"));
+  EXPECT_JSON_EQ("2147483648.0", *DecodeHex("1A80000000"));
+  EXPECT_JSON_EQ("-2147483648", *DecodeHex("3A7FFFFFFF"));
+  EXPECT_JSON_EQ("-2147483649.0", *DecodeHex("3A80000000"));
+  EXPECT_JSON_EQ("1000000000000.0", *DecodeHex("1B000000E8D4A51000"));
+}
+
+TEST(Cbor, DecodeFloats) {
+  EXPECT_JSON_EQ("0.0", *DecodeHex("F90000"));
+  EXPECT_JSON_EQ("1.0", *DecodeHex("F93C00"));
+  EXPECT_JSON_EQ("-4.0", *DecodeHex("F9C400"));
+  EXPECT_JSON_EQ("65504.0", *DecodeHex("F97BFF"));
+  EXPECT_JSON_EQ("5.960464477539063e-8", *DecodeHex("F90001"));
+  EXPECT_JSON_EQ("100000.0", *DecodeHex("FA47C35000"));
+  EXPECT_JSON_EQ("1.1", *DecodeHex("FB3FF199999999999A"));
+}
+
+TEST(Cbor, DecodeContainers) {
+  EXPECT_JSON_EQ("[1, [2, 3], [4, 5]]", *DecodeHex("8301820203820405"));
+  EXPECT_JSON_EQ("{'a': 1, 'b': [2, 3]}", *DecodeHex("A26161016162820203"));
+  EXPECT_JSON_EQ("['a', {'b': 'c'}]", *DecodeHex("826161A161626163"));
+}
+
+TEST(Cbor, DecodeIndefiniteLength) {
+  EXPECT_JSON_EQ("\"streaming\"", *DecodeHex("7F657374726561646D696E67FF"));
+  EXPECT_JSON_EQ("[]", *DecodeHex("9FFF"));
+  EXPECT_JSON_EQ("[1, [2, 3], [4, 5]]", *DecodeHex("9F018202039F0405FFFF"));
+  EXPECT_JSON_EQ("{'a': 1, 'b': [2, 3]}", *DecodeHex("BF61610161629F0203FFFF"));
+
+  auto value = DecodeHex("5F42010243030405FF");
+  const base::BinaryValue* binary = nullptr;
+  ASSERT_TRUE(value->GetAsBinary(&binary));
+  EXPECT_EQ(FromHex("0102030405"),
+            std::string(binary->GetBuffer(), binary->GetSize()));
+}
+
+TEST(Cbor, DecodeErrors) {
+  const char kParseError[] = "cbor_parse_error";
+  // Empty, truncated and trailing data.
+  EXPECT_EQ(kParseError, DecodeHexError(""));
+  EXPECT_EQ(kParseError, DecodeHexError("1901"));
+  EXPECT_EQ(kParseError, DecodeHexError("6449455446FF"));
+  EXPECT_EQ(kParseError, DecodeHexError("0000"));
+  EXPECT_EQ(kParseError, DecodeHexError("83010203FF"));
+  EXPECT_EQ(kParseError, DecodeHexError("830102"));
+  EXPECT_EQ(kParseError, DecodeHexError("9F0102"));
+  // Unexpected break and invalid indefinite lengths.
+  EXPECT_EQ(kParseError, DecodeHexError("FF"));
+  EXPECT_EQ(kParseError, DecodeHexError("1F"));
+  EXPECT_EQ(kParseError, DecodeHexError("7F01FF"));
+  EXPECT_EQ(kParseError, DecodeHexError("1C"));
+  // Map keys which are not text strings.
+  EXPECT_EQ(kParseError, DecodeHexError("A10102"));
+  // Invalid UTF-8.
+  EXPECT_EQ(kParseError, DecodeHexError("61FF"));
+  // Unsupported simple value.
+  EXPECT_EQ(kParseError, DecodeHexError("F820"));
+}
+
+TEST(Cbor, DecodeMaxDepth) {
+  std::string data(100, '\x81');
+  data += '\x00';
+  EXPECT_TRUE(CborDecode(data, nullptr));
+  data.insert(0, 1, '\x81');
+  EXPECT_FALSE(CborDecode(data, nullptr));
+}
+
+}  // namespace weave
@@ -0,0 +1,114 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/cloud_request_scheduler.h"
+
+#include <algorithm>
+
+#include <base/bind.h>
+#include <base/logging.h>
+
+namespace weave {
+
+CloudRequestScheduler::CloudRequestScheduler(size_t max_in_flight,
+                                             base::Clock* clock)
+    : max_in_flight_{max_in_flight},
+      clock_{clock ? clock : &default_clock_} {
+  CHECK_GT(max_in_flight_, 0u);
+}
+
+void CloudRequestScheduler::Schedule(Priority priority,
+                                     const std::string& key,
+                                     const Request& request) {
+  if (!key.empty() && !queued_keys_.insert(key).second) {
+    VLOG(2) << "Cloud request '" << key << "' is already queued";
+    ++metrics_.coalesced;
+    return;
+  }
+  queues_[static_cast<size_t>(priority)].push_back(
+      Entry{key, request, {}, clock_->Now()});
+  StartRequests();
+}
+
+void CloudRequestScheduler::Suspend() {
+  CHECK_GT(in_flight_, 0u);
+  --in_flight_;
+  StartRequests();
+}
+
+void CloudRequestScheduler::Resume(Priority priority,
+                                   const base::Closure& resume) {
+  // The key of the request stays in flight while it is suspended, so the
+  // entry has none.
+  queues_[static_cast<size_t>(priority)].push_back(
+      Entry{{}, {}, resume, clock_->Now()});
+  StartRequests();
+}
+
+size_t CloudRequestScheduler::GetQueueSize(Priority priority) const {
+  return queues_[static_cast<size_t>(priority)].size();
+}
+
+void CloudRequestScheduler::StartRequests() {
+  if (starting_)
+    return;
+  starting_ = true;
+  Entry entry;
+  while (in_flight_ < max_in_flight_ && TakeStartableRequest(&entry)) {
+    if (!entry.key.empty())
+      in_flight_keys_.insert(entry.key);
+    ++in_flight_;
+
+    base::Time now = clock_->Now();
+    base::TimeDelta queue_time = now - entry.queue_time;
+    metrics_.total_queue_time += queue_time;
+    metrics_.max_queue_time = std::max(metrics_.max_queue_time, queue_time);
+
+    if (!entry.resume.is_null()) {
+      entry.resume.Run();
+      continue;
+    }
+    // |done| may be copied by the request, the flag is shared by the copies.
+    entry.request.Run(base::Bind(&CloudRequestScheduler::OnRequestDone,
+                                 weak_ptr_factory_.GetWeakPtr(),
+                                 base::Owned(new bool{false}), entry.key, now));
+  }
+  starting_ = false;
+}
+
+bool CloudRequestScheduler::TakeStartableRequest(Entry* entry) {
+  for (auto& queue : queues_) {
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+      if (!it->key.empty() && in_flight_keys_.count(it->key))
+        continue;
+      *entry = std::move(*it);
+      queue.erase(it);
+      queued_keys_.erase(entry->key);
+      return true;
+    }
+  }
+  return false;
+}
+
+void CloudRequestScheduler::OnRequestDone(bool* done,
+                                          const std::string& key,
+                                          base::Time start_time) {
+  CHECK(!*done) << "Cloud request '" << key << "' completed twice";
+  *done = true;
+  if (!key.empty())
+    in_flight_keys_.erase(key);
+  --in_flight_;
+
+  ++metrics_.completed;
+  base::TimeDelta request_time = clock_->Now() - start_time;
+  metrics_.total_request_time += request_time;
+  VLOG(2) << "Cloud request '" << key << "' done in " << request_time
+          << ", in flight: " << in_flight_ << ", queued: "
+          << GetQueueSize(Priority::kCommand) << "/"
+          << GetQueueSize(Priority::kState) << "/"
+          << GetQueueSize(Priority::kDeviceResource);
+  StartRequests();
+}
+
+}  // namespace weave
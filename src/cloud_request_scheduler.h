@@ -0,0 +1,109 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_CLOUD_REQUEST_SCHEDULER_H_
+#define LIBWEAVE_SRC_CLOUD_REQUEST_SCHEDULER_H_
+
+#include <deque>
+#include <set>
+#include <string>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <base/time/default_clock.h>
+#include <base/time/time.h>
+
+namespace weave {
+
+// Orders the requests to the cloud server by priority and bounds the number
+// of requests in flight. Requests sharing a key, e.g. the state patches of the
+// device, run one at a time and are coalesced while queued.
+class CloudRequestScheduler final {
+ public:
+  // Request priorities, from the highest to the lowest.
+  enum class Priority {
+    kCommand,         // Command updates and command queue fetches.
+    kState,           // Device state patches.
+    kDeviceResource,  // Device resource updates and other requests.
+  };
+
+  // Starts a request. The request must run |done| once it has completed.
+  using Request = base::Callback<void(const base::Closure& done)>;
+
+  struct Metrics {
+    // Number of completed requests.
+    size_t completed{0};
+    // Number of requests dropped in favor of a queued one with the same key.
+    size_t coalesced{0};
+    // Total and maximum time the started requests waited in the queue.
+    base::TimeDelta total_queue_time;
+    base::TimeDelta max_queue_time;
+    // Total time from the start of the completed requests to their
+    // completion.
+    base::TimeDelta total_request_time;
+  };
+
+  explicit CloudRequestScheduler(size_t max_in_flight,
+                                 base::Clock* clock = nullptr);
+
+  // Queues |request| and starts it if the limits allow. If |key| is not
+  // empty, the request does not start while another request with the same
+  // key is in flight, and it is dropped if a request with the same key is
+  // queued already. Such requests are expected to send the latest data at the
+  // time they start, so the queued one covers the dropped one.
+  void Schedule(Priority priority,
+                const std::string& key,
+                const Request& request);
+
+  // Releases the in-flight slot of a started request while it waits, e.g. for
+  // the backoff before a retry, so that it does not hold up other requests.
+  // The request keeps its key, and calls Resume() before it continues.
+  void Suspend();
+  // Queues |resume| to continue a suspended request once the limits allow.
+  // The request still runs its |done| once it has completed.
+  void Resume(Priority priority, const base::Closure& resume);
+
+  size_t GetQueueSize(Priority priority) const;
+  size_t GetInFlightCount() const { return in_flight_; }
+  const Metrics& GetMetrics() const { return metrics_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    Request request;
+    // Set instead of |request| for a suspended request.
+    base::Closure resume;
+    base::Time queue_time;
+  };
+
+  static const size_t kPriorityCount = 3;
+
+  // Starts queued requests while the limits allow.
+  void StartRequests();
+  // Removes the first request which may start from the queues.
+  bool TakeStartableRequest(Entry* entry);
+  void OnRequestDone(bool* done,
+                     const std::string& key,
+                     base::Time start_time);
+
+  const size_t max_in_flight_;
+  base::DefaultClock default_clock_;
+  base::Clock* clock_{&default_clock_};
+
+  std::deque<Entry> queues_[kPriorityCount];
+  std::set<std::string> queued_keys_;
+  std::set<std::string> in_flight_keys_;
+  size_t in_flight_{0};
+  // Set while StartRequests() runs, as requests may complete synchronously.
+  bool starting_{false};
+  Metrics metrics_;
+
+  base::WeakPtrFactory<CloudRequestScheduler> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(CloudRequestScheduler);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_CLOUD_REQUEST_SCHEDULER_H_
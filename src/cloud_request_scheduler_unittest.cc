@@ -0,0 +1,163 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/cloud_request_scheduler.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+
+#include "src/test/mock_clock.h"
+
+namespace weave {
+
+using testing::ReturnPointee;
+using Priority = CloudRequestScheduler::Priority;
+
+class CloudRequestSchedulerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    EXPECT_CALL(clock_, Now()).WillRepeatedly(ReturnPointee(&now_));
+  }
+
+  // Schedules a request named |name| which completes on Complete(|name|).
+  void Schedule(Priority priority,
+                const std::string& key,
+                const std::string& name) {
+    scheduler_.Schedule(priority, key,
+                        base::Bind(&CloudRequestSchedulerTest::Start,
+                                   base::Unretained(this), name));
+  }
+
+  void Start(const std::string& name, const base::Closure& done) {
+    started_.push_back(name);
+    done_[name] = done;
+  }
+
+  // Resumes a suspended request named |name|.
+  void Resume(Priority priority, const std::string& name) {
+    scheduler_.Resume(priority, base::Bind(&CloudRequestSchedulerTest::OnResume,
+                                           base::Unretained(this), name));
+  }
+
+  void OnResume(const std::string& name) { resumed_.push_back(name); }
+
+  void Complete(const std::string& name) {
+    auto done = done_[name];
+    done_.erase(name);
+    done.Run();
+  }
+
+  base::Time now_{base::Time::FromTimeT(1450000000)};
+  testing::StrictMock<test::MockClock> clock_;
+  CloudRequestScheduler scheduler_{2, &clock_};
+  std::vector<std::string> started_;
+  std::vector<std::string> resumed_;
+  std::map<std::string, base::Closure> done_;
+};
+
+TEST_F(CloudRequestSchedulerTest, Priorities) {
+  Schedule(Priority::kDeviceResource, {}, "resource1");
+  Schedule(Priority::kDeviceResource, {}, "resource2");
+  Schedule(Priority::kDeviceResource, {}, "resource3");
+  Schedule(Priority::kState, {}, "state");
+  Schedule(Priority::kCommand, {}, "command");
+  EXPECT_EQ((std::vector<std::string>{"resource1", "resource2"}), started_);
+  EXPECT_EQ(2u, scheduler_.GetInFlightCount());
+  EXPECT_EQ(1u, scheduler_.GetQueueSize(Priority::kCommand));
+  EXPECT_EQ(1u, scheduler_.GetQueueSize(Priority::kState));
+  EXPECT_EQ(1u, scheduler_.GetQueueSize(Priority::kDeviceResource));
+
+  Complete("resource2");
+  Complete("resource1");
+  EXPECT_EQ((std::vector<std::string>{"resource1", "resource2", "command",
+                                      "state"}),
+            started_);
+  Complete("command");
+  EXPECT_EQ("resource3", started_.back());
+  EXPECT_EQ(0u, scheduler_.GetQueueSize(Priority::kDeviceResource));
+}
+
+TEST_F(CloudRequestSchedulerTest, Keys) {
+  Schedule(Priority::kState, "state", "state1");
+  Schedule(Priority::kState, "state", "state2");
+  Schedule(Priority::kState, "state", "state3");
+  Schedule(Priority::kDeviceResource, {}, "resource");
+  // The queued state request does not block the other requests.
+  EXPECT_EQ((std::vector<std::string>{"state1", "resource"}), started_);
+  EXPECT_EQ(1u, scheduler_.GetQueueSize(Priority::kState));
+  EXPECT_EQ(1u, scheduler_.GetMetrics().coalesced);
+
+  Complete("resource");
+  EXPECT_EQ(2u, started_.size());
+  Complete("state1");
+  EXPECT_EQ("state2", started_.back());
+  Schedule(Priority::kState, "state", "state4");
+  Complete("state2");
+  EXPECT_EQ("state4", started_.back());
+}
+
+TEST_F(CloudRequestSchedulerTest, SuspendedRequestsDoNotBlock) {
+  Schedule(Priority::kDeviceResource, "resource", "resource1");
+  Schedule(Priority::kDeviceResource, {}, "resource2");
+  Schedule(Priority::kCommand, {}, "command");
+  EXPECT_EQ(1u, scheduler_.GetQueueSize(Priority::kCommand));
+
+  // Both requests failed and wait for a retry, the command starts meanwhile.
+  scheduler_.Suspend();
+  scheduler_.Suspend();
+  EXPECT_EQ("command", started_.back());
+  EXPECT_EQ(1u, scheduler_.GetInFlightCount());
+
+  // A suspended request keeps its key.
+  Schedule(Priority::kDeviceResource, "resource", "resource3");
+  EXPECT_EQ("command", started_.back());
+
+  Resume(Priority::kDeviceResource, "resource1");
+  Resume(Priority::kDeviceResource, "resource2");
+  EXPECT_EQ((std::vector<std::string>{"resource1"}), resumed_);
+  EXPECT_EQ(2u, scheduler_.GetInFlightCount());
+
+  Complete("resource1");
+  EXPECT_EQ("resource3", started_.back());
+  Complete("command");
+  EXPECT_EQ((std::vector<std::string>{"resource1", "resource2"}), resumed_);
+  Complete("resource2");
+  Complete("resource3");
+  EXPECT_EQ(0u, scheduler_.GetInFlightCount());
+  EXPECT_EQ(4u, scheduler_.GetMetrics().completed);
+}
+
+TEST_F(CloudRequestSchedulerTest, SynchronousCompletion) {
+  for (size_t i = 0; i < 5; ++i) {
+    scheduler_.Schedule(
+        Priority::kCommand, {},
+        base::Bind([](const base::Closure& done) { done.Run(); }));
+  }
+  EXPECT_EQ(0u, scheduler_.GetInFlightCount());
+  EXPECT_EQ(0u, scheduler_.GetQueueSize(Priority::kCommand));
+  EXPECT_EQ(5u, scheduler_.GetMetrics().completed);
+}
+
+TEST_F(CloudRequestSchedulerTest, Metrics) {
+  Schedule(Priority::kCommand, {}, "command1");
+  Schedule(Priority::kCommand, {}, "command2");
+  Schedule(Priority::kCommand, {}, "command3");
+  now_ += base::TimeDelta::FromSeconds(1);
+  Complete("command1");
+  now_ += base::TimeDelta::FromSeconds(2);
+  Complete("command2");
+  Complete("command3");
+
+  const auto& metrics = scheduler_.GetMetrics();
+  EXPECT_EQ(3u, metrics.completed);
+  EXPECT_EQ(base::TimeDelta::FromSeconds(1), metrics.total_queue_time);
+  EXPECT_EQ(base::TimeDelta::FromSeconds(1), metrics.max_queue_time);
+  EXPECT_EQ(base::TimeDelta::FromSeconds(6), metrics.total_request_time);
+}
+
+}  // namespace weave
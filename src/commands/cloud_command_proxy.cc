@@ -105,8 +105,10 @@ void CloudCommandProxy::SendCommandUpdate() {
   // command update was queued haven't been acknowledged by the server, we
   // will hold the corresponding command updates until the related device state
   // has been successfully updated on the server.
-  if (update_queue_.front().first > last_state_update_id_)
+  if (update_queue_.front().first > last_state_update_id_) {
+    cloud_command_updater_->FlushStateUpdates();
     return;
+  }
 
   backoff_weak_ptr_factory_.InvalidateWeakPtrs();
   if (cloud_backoff_entry_->ShouldRejectRequest()) {
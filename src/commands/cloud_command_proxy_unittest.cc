@@ -43,6 +43,7 @@ class MockCloudCommandUpdateInterface : public CloudCommandUpdateInterface {
                void(const std::string&,
                     const base::DictionaryValue&,
                     const DoneCallback&));
+  MOCK_METHOD0(FlushStateUpdates, void());
 };
 
 // Test back-off entry that uses the test clock.
@@ -95,6 +96,7 @@ class CloudCommandProxyTest : public ::testing::Test {
         .WillRepeatedly(Invoke(callback));
     EXPECT_CALL(component_manager_, GetLastStateChangeId())
         .WillRepeatedly(testing::ReturnPointee(&current_state_update_id_));
+    EXPECT_CALL(cloud_updater_, FlushStateUpdates()).Times(AnyNumber());
 
     CreateCommandInstance();
   }
@@ -175,6 +177,14 @@ TEST_F(CloudCommandProxyTest, DelayedUpdate) {
   callbacks_.Notify(20);
 }
 
+TEST_F(CloudCommandProxyTest, FlushStateForDelayedUpdate) {
+  current_state_update_id_ = 20;
+  command_instance_->Complete({}, nullptr);
+  // The update waits for state #20, so it is published without delay.
+  EXPECT_CALL(cloud_updater_, FlushStateUpdates()).Times(1);
+  task_runner_.RunOnce();
+}
+
 TEST_F(CloudCommandProxyTest, InFlightRequest) {
   // SetProgress causes two consecutive updates:
   //    state=inProgress
@@ -20,6 +20,11 @@ class CloudCommandUpdateInterface {
                              const base::DictionaryValue& command_patch,
                              const DoneCallback& callback) = 0;
 
+  // Sends the recorded state changes to the server without waiting for
+  // further changes to coalesce with. Called while command updates wait for
+  // the state at the time they were made to reach the server.
+  virtual void FlushStateUpdates() = 0;
+
  protected:
   virtual ~CloudCommandUpdateInterface() {}
 };
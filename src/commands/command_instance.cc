@@ -137,29 +137,23 @@ bool CommandInstance::SetError(const Error* command_error, ErrorPtr* error) {
 
 namespace {
 
-// Helper method to retrieve command parameters from the command definition
-// object passed in as |json|.
-// On success, returns |true| and the validated parameters and values through
-// |parameters|. Otherwise returns |false| and additional error information in
-// |error|.
+// Helper method to retrieve command parameters from the "parameters" property
+// |params_value| of a command definition, null if the property is missing.
+// On success, returns the parameters. Otherwise returns null and additional
+// error information in |error|.
 std::unique_ptr<base::DictionaryValue> GetCommandParameters(
-    const base::DictionaryValue* json,
+    std::unique_ptr<base::Value> params_value,
     ErrorPtr* error) {
-  // Get the command parameters from 'parameters' property.
-  std::unique_ptr<base::DictionaryValue> params;
-  const base::Value* params_value = nullptr;
-  if (json->Get(commands::attributes::kCommand_Parameters, &params_value)) {
-    // Make sure the "parameters" property is actually an object.
-    const base::DictionaryValue* params_dict = nullptr;
-    if (!params_value->GetAsDictionary(&params_dict)) {
-      return Error::AddToPrintf(error, FROM_HERE, errors::json::kObjectExpected,
-                                "Property '%s' must be a JSON object",
-                                commands::attributes::kCommand_Parameters);
-    }
-    params = params_dict->CreateDeepCopy();
-  } else {
+  if (!params_value) {
     // "parameters" are not specified. Assume empty param list.
-    params.reset(new base::DictionaryValue);
+    return std::unique_ptr<base::DictionaryValue>{new base::DictionaryValue};
+  }
+  // Make sure the "parameters" property is actually an object.
+  auto params = base::DictionaryValue::From(std::move(params_value));
+  if (!params) {
+    return Error::AddToPrintf(error, FROM_HERE, errors::json::kObjectExpected,
+                              "Property '%s' must be a JSON object",
+                              commands::attributes::kCommand_Parameters);
   }
   return params;
 }
@@ -171,7 +165,6 @@ std::unique_ptr<CommandInstance> CommandInstance::FromJson(
     Command::Origin origin,
     std::string* command_id,
     ErrorPtr* error) {
-  std::unique_ptr<CommandInstance> instance;
   std::string command_id_buffer;  // used if |command_id| was nullptr.
   if (!command_id)
     command_id = &command_id_buffer;
@@ -188,33 +181,118 @@ std::unique_ptr<CommandInstance> CommandInstance::FromJson(
   if (!json->GetString(commands::attributes::kCommand_Id, command_id))
     command_id->clear();
 
+  const base::Value* name = nullptr;
+  json->Get(commands::attributes::kCommand_Name, &name);
+  const base::Value* parameters = nullptr;
+  json->Get(commands::attributes::kCommand_Parameters, &parameters);
+  const base::Value* component = nullptr;
+  json->Get(commands::attributes::kCommand_Component, &component);
+  return FromJsonMembers(
+      *command_id, name,
+      parameters ? parameters->CreateDeepCopy() : nullptr, component, origin,
+      error);
+}
+
+std::unique_ptr<CommandInstance> CommandInstance::FromJsonMembers(
+    const std::string& command_id,
+    const base::Value* name,
+    std::unique_ptr<base::Value> parameters,
+    const base::Value* component,
+    Command::Origin origin,
+    ErrorPtr* error) {
   // Get the command name from 'name' property.
   std::string command_name;
-  if (!json->GetString(commands::attributes::kCommand_Name, &command_name)) {
+  if (!name || !name->GetAsString(&command_name)) {
     return Error::AddTo(error, FROM_HERE, errors::commands::kPropertyMissing,
                         "Command name is missing");
   }
 
-  auto parameters = GetCommandParameters(json, error);
-  if (!parameters) {
+  auto params = GetCommandParameters(std::move(parameters), error);
+  if (!params) {
     return Error::AddToPrintf(
         error, FROM_HERE, errors::commands::kCommandFailed,
         "Failed to validate command '%s'", command_name.c_str());
   }
 
-  instance.reset(new CommandInstance{command_name, origin, *parameters});
+  std::unique_ptr<CommandInstance> instance{
+      new CommandInstance{command_name, origin, base::DictionaryValue{}}};
+  instance->parameters_.Swap(params.get());
 
-  if (!command_id->empty())
-    instance->SetID(*command_id);
+  if (!command_id.empty())
+    instance->SetID(command_id);
 
   // Get the component name this command is for.
-  std::string component;
-  if (json->GetString(commands::attributes::kCommand_Component, &component))
-    instance->SetComponent(component);
+  std::string component_path;
+  if (component && component->GetAsString(&component_path))
+    instance->SetComponent(component_path);
 
   return instance;
 }
 
+CommandInstance::ListReader::ListReader(const std::string& list_key,
+                                        Command::Origin origin)
+    : list_key_{list_key}, origin_{origin} {}
+
+CommandInstance::ListReader::~ListReader() {}
+
+void CommandInstance::ListReader::OnObjectBegin() {
+  // Commands are the objects in the list, which is at depth 2.
+  if (++depth_ == 3 && in_list_) {
+    id_value_.reset();
+    name_.reset();
+    parameters_.reset();
+    component_.reset();
+  }
+}
+
+JsonHandler::Member CommandInstance::ListReader::OnMemberKey(
+    base::StringPiece key) {
+  if (depth_ == 1)
+    return key == list_key_ ? Member::kVisit : Member::kSkip;
+  if (depth_ != 3 || !in_list_)
+    return Member::kSkip;
+
+  // Build only the members used by FromJsonMembers().
+  if (key == commands::attributes::kCommand_Id)
+    member_ = &id_value_;
+  else if (key == commands::attributes::kCommand_Name)
+    member_ = &name_;
+  else if (key == commands::attributes::kCommand_Parameters)
+    member_ = &parameters_;
+  else if (key == commands::attributes::kCommand_Component)
+    member_ = &component_;
+  else
+    return Member::kSkip;
+  return Member::kBuild;
+}
+
+void CommandInstance::ListReader::OnObjectEnd() {
+  if (depth_-- != 3 || !in_list_)
+    return;
+
+  Entry entry;
+  if (!id_value_ || !id_value_->GetAsString(&entry.id))
+    entry.id.clear();
+  entry.command =
+      FromJsonMembers(entry.id, name_.get(), std::move(parameters_),
+                      component_.get(), origin_, &entry.error);
+  entries_.push_back(std::move(entry));
+}
+
+void CommandInstance::ListReader::OnListBegin() {
+  if (++depth_ == 2)
+    in_list_ = true;
+}
+
+void CommandInstance::ListReader::OnListEnd() {
+  if (depth_-- == 2)
+    in_list_ = false;
+}
+
+void CommandInstance::ListReader::OnValue(std::unique_ptr<base::Value> value) {
+  *member_ = std::move(value);
+}
+
 std::unique_ptr<base::DictionaryValue> CommandInstance::ToJson() const {
   std::unique_ptr<base::DictionaryValue> json{new base::DictionaryValue};
 
@@ -15,6 +15,8 @@
 #include <weave/command.h>
 #include <weave/error.h>
 
+#include "src/json_reader.h"
+
 namespace base {
 class Value;
 }  // namespace base
@@ -77,6 +79,51 @@ class CommandInstance final : public Command {
                                                    std::string* command_id,
                                                    ErrorPtr* error);
 
+  // Reads command instances from the list member |list_key| of a JSON object
+  // as ReadJsonEvents() parses it, e.g. from a commands/queue response. The
+  // command members used by FromJson() are built, and "parameters" is moved
+  // into the command without a copy. The other members are skipped.
+  class ListReader final : public JsonHandler {
+   public:
+    // A command read from the list. |command| is null and |error| is set if
+    // the command is not valid. |id| is set if the command has one.
+    struct Entry {
+      std::string id;
+      std::unique_ptr<CommandInstance> command;
+      ErrorPtr error;
+    };
+
+    ListReader(const std::string& list_key, Command::Origin origin);
+    ~ListReader() override;
+
+    std::vector<Entry>& entries() { return entries_; }
+
+    // JsonHandler overrides.
+    void OnObjectBegin() override;
+    Member OnMemberKey(base::StringPiece key) override;
+    void OnObjectEnd() override;
+    void OnListBegin() override;
+    void OnListEnd() override;
+    void OnValue(std::unique_ptr<base::Value> value) override;
+
+   private:
+    const std::string list_key_;
+    const Command::Origin origin_;
+    // Number of objects and lists the parser is in.
+    int depth_{0};
+    bool in_list_{false};
+    // Members of the command being read, null if missing.
+    std::unique_ptr<base::Value> id_value_;
+    std::unique_ptr<base::Value> name_;
+    std::unique_ptr<base::Value> parameters_;
+    std::unique_ptr<base::Value> component_;
+    // The member being built.
+    std::unique_ptr<base::Value>* member_{nullptr};
+    std::vector<Entry> entries_;
+
+    DISALLOW_COPY_AND_ASSIGN(ListReader);
+  };
+
   std::unique_ptr<base::DictionaryValue> ToJson() const;
 
   // Sets the command ID (normally done by CommandQueue when the command
@@ -92,6 +139,16 @@ class CommandInstance final : public Command {
   void DetachFromQueue() { queue_ = nullptr; }
 
  private:
+  // Creates a command from the members of its JSON object, see FromJson().
+  // |name|, |parameters| and |component| are null if they are missing.
+  static std::unique_ptr<CommandInstance> FromJsonMembers(
+      const std::string& command_id,
+      const base::Value* name,
+      std::unique_ptr<base::Value> parameters,
+      const base::Value* component,
+      Command::Origin origin,
+      ErrorPtr* error);
+
   // Helper function to update the command status.
   // Used by Abort(), Cancel(), Done() methods.
   bool SetStatus(Command::State status, ErrorPtr* error);
@@ -101,6 +101,47 @@ TEST(CommandInstanceTest, FromJson_ParamsNotObject) {
   EXPECT_EQ("command_failed", error->GetCode());
 }
 
+TEST(CommandInstanceTest, ListReader) {
+  const char kJson[] = R"({
+    "kind": "weave#commandsListResponse",
+    "commands": [
+      {"kind": "weave#command", "id": "1", "name": "robot.jump",
+       "component": "comp", "parameters": {"height": 53},
+       "progress": {}, "results": {}, "state": "queued"},
+      {"id": "2", "parameters": {"height": 1}},
+      {"id": "3", "name": "robot.speak", "parameters": "hello"},
+      {"name": "base.reboot"},
+      "not a command"
+    ],
+    "next": {"commands": [{"name": "robot.skipped"}]}
+  })";
+  CommandInstance::ListReader reader{"commands", Command::Origin::kCloud};
+  ASSERT_TRUE(ReadJsonEvents(kJson, &reader, nullptr));
+  auto& entries = reader.entries();
+  ASSERT_EQ(4u, entries.size());
+
+  EXPECT_EQ("1", entries[0].id);
+  ASSERT_NE(nullptr, entries[0].command.get());
+  EXPECT_EQ("1", entries[0].command->GetID());
+  EXPECT_EQ("robot.jump", entries[0].command->GetName());
+  EXPECT_EQ("comp", entries[0].command->GetComponent());
+  EXPECT_EQ(Command::Origin::kCloud, entries[0].command->GetOrigin());
+  EXPECT_JSON_EQ("{'height': 53}", entries[0].command->GetParameters());
+
+  EXPECT_EQ("2", entries[1].id);
+  EXPECT_EQ(nullptr, entries[1].command.get());
+  EXPECT_EQ("parameter_missing", entries[1].error->GetCode());
+
+  EXPECT_EQ("3", entries[2].id);
+  EXPECT_EQ(nullptr, entries[2].command.get());
+  EXPECT_EQ("command_failed", entries[2].error->GetCode());
+
+  EXPECT_EQ("", entries[3].id);
+  ASSERT_NE(nullptr, entries[3].command.get());
+  EXPECT_EQ("base.reboot", entries[3].command->GetName());
+  EXPECT_JSON_EQ("{}", entries[3].command->GetParameters());
+}
+
 TEST(CommandInstanceTest, ToJson) {
   auto json = CreateDictionaryValue(R"({
     'component': 'testComponent',
@@ -0,0 +1,85 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/commands/command_update_batcher.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <base/bind.h>
+#include <base/logging.h>
+#include <weave/provider/task_runner.h>
+
+#include "src/commands/schema_constants.h"
+
+namespace weave {
+
+namespace {
+
+const char kCommands[] = "commands";
+
+}  // namespace
+
+CommandUpdateBatcher::CommandUpdateBatcher(
+    provider::TaskRunner* task_runner,
+    size_t max_batch_size,
+    const SendCallback& send_callback,
+    const base::Closure& flush_state_callback)
+    : task_runner_{task_runner},
+      max_batch_size_{max_batch_size},
+      send_callback_{send_callback},
+      flush_state_callback_{flush_state_callback} {
+  CHECK_GT(max_batch_size_, 0u);
+}
+
+CommandUpdateBatcher::~CommandUpdateBatcher() {}
+
+void CommandUpdateBatcher::UpdateCommand(
+    const std::string& command_id,
+    const base::DictionaryValue& command_patch,
+    const DoneCallback& callback) {
+  if (updates_.empty()) {
+    task_runner_->PostDelayedTask(
+        FROM_HERE, base::Bind(&CommandUpdateBatcher::SendUpdates,
+                              weak_ptr_factory_.GetWeakPtr()),
+        {});
+  }
+  std::unique_ptr<base::DictionaryValue> command{
+      command_patch.CreateDeepCopy()};
+  command->SetString(commands::attributes::kCommand_Id, command_id);
+  updates_.push_back(Update{std::move(command), callback});
+}
+
+void CommandUpdateBatcher::FlushStateUpdates() {
+  flush_state_callback_.Run();
+}
+
+void CommandUpdateBatcher::SendUpdates() {
+  std::vector<Update> updates;
+  updates.swap(updates_);
+  VLOG(1) << "Sending " << updates.size() << " command updates";
+  for (size_t begin = 0; begin < updates.size(); begin += max_batch_size_) {
+    size_t end = std::min(updates.size(), begin + max_batch_size_);
+    std::unique_ptr<base::ListValue> commands{new base::ListValue};
+    std::vector<DoneCallback> callbacks;
+    callbacks.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      commands->Append(std::move(updates[i].command));
+      callbacks.push_back(updates[i].callback);
+    }
+    base::DictionaryValue body;
+    body.Set(kCommands, std::move(commands));
+    send_callback_.Run(body, base::Bind(&CommandUpdateBatcher::OnBatchDone,
+                                        std::move(callbacks)));
+  }
+}
+
+void CommandUpdateBatcher::OnBatchDone(
+    const std::vector<DoneCallback>& callbacks,
+    ErrorPtr error) {
+  for (const auto& callback : callbacks)
+    callback.Run(error ? error->Clone() : nullptr);
+}
+
+}  // namespace weave
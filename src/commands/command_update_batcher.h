@@ -0,0 +1,79 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_COMMANDS_COMMAND_UPDATE_BATCHER_H_
+#define LIBWEAVE_SRC_COMMANDS_COMMAND_UPDATE_BATCHER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <base/values.h>
+#include <weave/error.h>
+
+#include "src/commands/cloud_command_update_interface.h"
+
+namespace weave {
+
+namespace provider {
+class TaskRunner;
+}
+
+// Collects the command updates made during one task and sends them to the
+// cloud together, as a single request with the body:
+//   {"commands": [{"id": <command id>, <command patch>...}, ...]}
+// Updates are only delayed until the current task completes, so the order in
+// which CloudCommandProxy sends them relative to the state updates is kept.
+class CommandUpdateBatcher final : public CloudCommandUpdateInterface {
+ public:
+  // Sends a batch request with |body| and runs |callback| with its result.
+  using SendCallback =
+      base::Callback<void(const base::DictionaryValue& body,
+                          const DoneCallback& callback)>;
+
+  // |flush_state_callback| implements FlushStateUpdates().
+  CommandUpdateBatcher(provider::TaskRunner* task_runner,
+                       size_t max_batch_size,
+                       const SendCallback& send_callback,
+                       const base::Closure& flush_state_callback);
+  ~CommandUpdateBatcher() override;
+
+  // CloudCommandUpdateInterface overrides.
+  void UpdateCommand(const std::string& command_id,
+                     const base::DictionaryValue& command_patch,
+                     const DoneCallback& callback) override;
+  void FlushStateUpdates() override;
+
+  size_t GetPendingUpdateCount() const { return updates_.size(); }
+
+ private:
+  struct Update {
+    std::unique_ptr<base::DictionaryValue> command;
+    DoneCallback callback;
+  };
+
+  // Sends the pending updates, |max_batch_size_| per request.
+  void SendUpdates();
+  // Runs the callbacks of the updates of a batch with its result.
+  static void OnBatchDone(const std::vector<DoneCallback>& callbacks,
+                          ErrorPtr error);
+
+  provider::TaskRunner* task_runner_{nullptr};
+  const size_t max_batch_size_;
+  SendCallback send_callback_;
+  base::Closure flush_state_callback_;
+
+  // Updates waiting for SendUpdates(), in the order they were made.
+  std::vector<Update> updates_;
+
+  base::WeakPtrFactory<CommandUpdateBatcher> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(CommandUpdateBatcher);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_COMMANDS_COMMAND_UPDATE_BATCHER_H_
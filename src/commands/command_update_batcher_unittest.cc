@@ -0,0 +1,91 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/commands/command_update_batcher.h"
+
+#include <vector>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
+#include <weave/test/unittest_utils.h>
+
+namespace weave {
+
+using test::CreateDictionaryValue;
+
+class CommandUpdateBatcherTest : public testing::Test {
+ protected:
+  void Send(const base::DictionaryValue& body, const DoneCallback& callback) {
+    bodies_.emplace_back(body.CreateDeepCopy());
+    callbacks_.push_back(callback);
+  }
+
+  void FlushStateUpdates() { ++flush_count_; }
+
+  void OnUpdateDone(const std::string& id, ErrorPtr error) {
+    done_.push_back(id + (error ? ":" + error->GetCode() : ""));
+  }
+
+  void Update(const std::string& id, const std::string& patch) {
+    batcher_.UpdateCommand(id, *CreateDictionaryValue(patch),
+                           base::Bind(&CommandUpdateBatcherTest::OnUpdateDone,
+                                      base::Unretained(this), id));
+  }
+
+  provider::test::FakeTaskRunner task_runner_;
+  CommandUpdateBatcher batcher_{
+      &task_runner_, 2,
+      base::Bind(&CommandUpdateBatcherTest::Send, base::Unretained(this)),
+      base::Bind(&CommandUpdateBatcherTest::FlushStateUpdates,
+                 base::Unretained(this))};
+  std::vector<std::unique_ptr<base::DictionaryValue>> bodies_;
+  std::vector<DoneCallback> callbacks_;
+  std::vector<std::string> done_;
+  int flush_count_{0};
+};
+
+TEST_F(CommandUpdateBatcherTest, BatchesUpdatesOfOneTask) {
+  Update("1", "{'state': 'done'}");
+  Update("2", "{'progress': {'percent': 50}}");
+  Update("3", "{'state': 'error'}");
+  EXPECT_TRUE(bodies_.empty());
+  EXPECT_EQ(3u, batcher_.GetPendingUpdateCount());
+
+  task_runner_.RunOnce();
+  EXPECT_EQ(0u, batcher_.GetPendingUpdateCount());
+  ASSERT_EQ(2u, bodies_.size());
+  EXPECT_JSON_EQ(
+      (R"({"commands": [{"id": "1", "state": "done"},
+                        {"id": "2", "progress": {"percent": 50}}]})"),
+      *bodies_[0]);
+  EXPECT_JSON_EQ(R"({"commands": [{"id": "3", "state": "error"}]})",
+                 *bodies_[1]);
+
+  ErrorPtr error;
+  Error::AddTo(&error, FROM_HERE, "test_error", "Test error");
+  callbacks_[1].Run(std::move(error));
+  callbacks_[0].Run(nullptr);
+  EXPECT_EQ((std::vector<std::string>{"3:test_error", "1", "2"}), done_);
+}
+
+TEST_F(CommandUpdateBatcherTest, NextTask) {
+  Update("1", "{'state': 'inProgress'}");
+  task_runner_.RunOnce();
+  Update("1", "{'state': 'done'}");
+  EXPECT_EQ(1u, bodies_.size());
+  task_runner_.RunOnce();
+  ASSERT_EQ(2u, bodies_.size());
+  EXPECT_JSON_EQ(R"({"commands": [{"id": "1", "state": "done"}]})",
+                 *bodies_[1]);
+  EXPECT_EQ(0u, task_runner_.GetTaskQueueSize());
+}
+
+TEST_F(CommandUpdateBatcherTest, FlushStateUpdates) {
+  batcher_.FlushStateUpdates();
+  EXPECT_EQ(1, flush_count_);
+  EXPECT_EQ(0u, task_runner_.GetTaskQueueSize());
+}
+
+}  // namespace weave
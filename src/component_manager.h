@@ -122,6 +122,13 @@ class ComponentManager {
       std::string* id,
       ErrorPtr* error) = 0;
 
+  // Same as ParseCommandInstance(), but for a command already built from its
+  // JSON definition, e.g. by CommandInstance::ListReader. Routes the command
+  // to a component and assigns it a new ID if it has none.
+  virtual bool ValidateCommandInstance(CommandInstance* command_instance,
+                                       UserRole role,
+                                       ErrorPtr* error) = 0;
+
   // Find a command instance with the given ID in the command queue.
   virtual CommandInstance* FindCommand(const std::string& id) = 0;
 
@@ -174,6 +181,10 @@ class ComponentManager {
   virtual std::unique_ptr<base::DictionaryValue> GetComponentsForUserRole(
       UserRole role) const = 0;
 
+  // Enables checking state changes against the "state" schemas of their
+  // traits. Off by default.
+  virtual void SetStateValidationEnabled(bool enabled) = 0;
+
   // Component state manipulation methods.
   virtual bool SetStateProperties(const std::string& component_path,
                                   const base::DictionaryValue& dict,
@@ -189,11 +200,33 @@ class ComponentManager {
                                 const base::Value& value,
                                 ErrorPtr* error) = 0;
 
+  // Resolves a component path or a state property name into a handle, which
+  // can be used to update the state without parsing strings on every call.
+  // Component handles are invalidated when the component is removed.
+  virtual ComponentHandle GetComponentHandle(const std::string& component_path,
+                                             ErrorPtr* error) const = 0;
+  virtual StatePropertyHandle GetStatePropertyHandle(const std::string& name,
+                                                     ErrorPtr* error) = 0;
+  virtual bool SetStatePropertiesByHandle(ComponentHandle component,
+                                          const base::DictionaryValue& dict,
+                                          ErrorPtr* error) = 0;
+  virtual bool SetStatePropertyByHandle(ComponentHandle component,
+                                        StatePropertyHandle property,
+                                        const base::Value& value,
+                                        ErrorPtr* error) = 0;
+
   virtual void AddStateChangedCallback(const base::Closure& callback) = 0;
 
   // Returns the recorded state changes since last time this method was called.
   virtual StateSnapshot GetAndClearRecordedStateChanges() = 0;
 
+  // Sets the maximum number of state change records kept for the component
+  // until they are sent to the server. Older records are merged together
+  // when the limit is reached.
+  virtual bool SetStateChangeQueueSize(const std::string& component_path,
+                                       size_t max_queue_size,
+                                       ErrorPtr* error) = 0;
+
   // Called to notify that the state patch with |id| has been successfully sent
   // to the server and processed.
   virtual void NotifyStateUpdatedOnServer(UpdateID id) = 0;
@@ -202,6 +235,16 @@ class ComponentManager {
   // invocation increments this value by 1.
   virtual UpdateID GetLastStateChangeId() const = 0;
 
+  // Returns the state changes made after the state change update |id|: one
+  // change per component, in order of the first change, with the current
+  // values of the properties changed since. Unlike
+  // GetAndClearRecordedStateChanges(), this does not consume the changes.
+  // Only a limited number of recent changes is kept; returns false if the
+  // changes after |id| are no longer available.
+  virtual bool GetStateChangesSince(
+      UpdateID id,
+      std::vector<ComponentStateChange>* changes) const = 0;
+
   // Subscribes for device state update notifications from cloud server.
   // The |callback| will be called every time a state patch with given ID is
   // successfully received and processed by Weave server.
@@ -0,0 +1,84 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <base/strings/stringprintf.h>
+#include <base/values.h>
+#include <weave/provider/test/fake_task_runner.h>
+
+#include "src/commands/command_instance.h"
+#include "src/component_manager_impl.h"
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kTraitCount = 4;
+const size_t kPropertyCount = 4;
+
+}  // namespace
+
+// Updates a property of the last of |size| components.
+WEAVE_BENCHMARK(ComponentManagerSetStateProperties) {
+  provider::test::FakeTaskRunner task_runner;
+  ComponentManagerImpl manager{&task_runner};
+  benchmark::AddComponents(&manager, state->size(), kTraitCount,
+                           kPropertyCount);
+  manager.SetStateValidationEnabled(true);
+  std::string path = base::StringPrintf("comp%zu", state->size() - 1);
+  base::DictionaryValue properties;
+  int value = 0;
+  while (state->KeepRunning()) {
+    properties.SetInteger("trait0.prop0", ++value);
+    CHECK(manager.SetStateProperties(path, properties, nullptr));
+  }
+}
+
+// Updates all properties of a component with |size| properties per trait.
+WEAVE_BENCHMARK(ComponentManagerSetManyStateProperties) {
+  provider::test::FakeTaskRunner task_runner;
+  ComponentManagerImpl manager{&task_runner};
+  benchmark::AddComponents(&manager, 1, kTraitCount, state->size());
+  manager.SetStateValidationEnabled(true);
+  base::DictionaryValue properties;
+  int value = 0;
+  while (state->KeepRunning()) {
+    ++value;
+    for (size_t i = 0; i < kTraitCount; ++i) {
+      for (size_t j = 0; j < state->size(); ++j) {
+        properties.SetInteger(base::StringPrintf("trait%zu.prop%zu", i, j),
+                              value);
+      }
+    }
+    CHECK(manager.SetStateProperties("comp0", properties, nullptr));
+  }
+}
+
+WEAVE_BENCHMARK(ComponentManagerFindComponent) {
+  provider::test::FakeTaskRunner task_runner;
+  ComponentManagerImpl manager{&task_runner};
+  benchmark::AddComponents(&manager, state->size(), kTraitCount,
+                           kPropertyCount);
+  std::string path = base::StringPrintf("comp%zu", state->size() - 1);
+  while (state->KeepRunning())
+    CHECK(manager.FindComponent(path, nullptr));
+}
+
+WEAVE_BENCHMARK(ComponentManagerParseCommandInstance) {
+  provider::test::FakeTaskRunner task_runner;
+  ComponentManagerImpl manager{&task_runner};
+  benchmark::AddComponents(&manager, state->size(), kTraitCount,
+                           kPropertyCount);
+  base::DictionaryValue command;
+  command.SetString("name", "trait0.cmd");
+  command.SetString("component",
+                    base::StringPrintf("comp%zu", state->size() - 1));
+  command.SetInteger("parameters.value", 1);
+  while (state->KeepRunning()) {
+    CHECK(manager.ParseCommandInstance(command, Command::Origin::kLocal,
+                                       UserRole::kOwner, nullptr, nullptr));
+  }
+}
+
+}  // namespace weave
@@ -4,8 +4,9 @@
 
 #include "src/component_manager_impl.h"
 
-#include <base/strings/string_number_conversions.h>
-#include <base/strings/string_util.h>
+#include <algorithm>
+
+#include <base/bind.h>
 #include <base/strings/stringprintf.h>
 
 #include "src/commands/schema_constants.h"
@@ -18,6 +19,8 @@ namespace weave {
 namespace {
 // Max of 100 state update events should be enough in the queue.
 const size_t kMaxStateChangeQueueSize = 100;
+// Number of recent state changes kept for GetStateChangesSince().
+const size_t kMaxStateHistorySize = 100;
 
 const char kMinimalRole[] = "minimalRole";
 
@@ -80,6 +83,26 @@ void RemoveInaccessibleState(const ComponentManagerImpl* manager,
   }
 }
 
+// Splits a full state property name "trait.property" into its parts.
+bool SplitStatePropertyName(const std::string& name,
+                            std::pair<std::string, std::string>* parts,
+                            ErrorPtr* error) {
+  auto pair = SplitAtFirst(name, ".", true);
+  if (pair.first.empty()) {
+    return Error::AddToPrintf(error, FROM_HERE,
+                              errors::commands::kPropertyMissing,
+                              "Empty state package in '%s'", name.c_str());
+  }
+  if (pair.second.empty()) {
+    return Error::AddToPrintf(
+        error, FROM_HERE, errors::commands::kPropertyMissing,
+        "State property name not specified in '%s'", name.c_str());
+  }
+  if (parts)
+    *parts = std::move(pair);
+  return true;
+}
+
 }  // anonymous namespace
 
 template <>
@@ -89,7 +112,16 @@ LIBWEAVE_EXPORT EnumToStringMap<UserRole>::EnumToStringMap()
 ComponentManagerImpl::ComponentManagerImpl(provider::TaskRunner* task_runner,
                                            base::Clock* clock)
     : clock_{clock ? clock : &default_clock_},
-      command_queue_{task_runner, clock_} {}
+      command_queue_{task_runner, clock_} {
+  components_.SetOnComponentRemovedCallback(
+      base::Bind(&ComponentManagerImpl::SaveStateChangesOfRemovedComponent,
+                 base::Unretained(this)));
+}
+
+ComponentManagerImpl::StateProperty::StateProperty(const std::string& trait,
+                                                  const std::string& name,
+                                                  uint32_t id)
+    : trait{trait}, name{name}, id{id} {}
 
 ComponentManagerImpl::~ComponentManagerImpl() {}
 
@@ -97,18 +129,6 @@ bool ComponentManagerImpl::AddComponent(const std::string& path,
                                         const std::string& name,
                                         const std::vector<std::string>& traits,
                                         ErrorPtr* error) {
-  base::DictionaryValue* root = &components_;
-  if (!path.empty()) {
-    root = FindComponentGraftNode(path, error);
-    if (!root)
-      return false;
-  }
-  if (root->GetWithoutPathExpansion(name, nullptr)) {
-    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
-                              "Component '%s' already exists at path '%s'",
-                              name.c_str(), path.c_str());
-  }
-
   // Check to make sure the declared traits are already defined.
   for (const std::string& trait : traits) {
     if (!FindTraitDefinition(trait)) {
@@ -117,11 +137,8 @@ bool ComponentManagerImpl::AddComponent(const std::string& path,
                                 "Trait '%s' is undefined", trait.c_str());
     }
   }
-  std::unique_ptr<base::DictionaryValue> dict{new base::DictionaryValue};
-  std::unique_ptr<base::ListValue> traits_list{new base::ListValue};
-  traits_list->AppendStrings(traits);
-  dict->Set("traits", std::move(traits_list));
-  root->SetWithoutPathExpansion(name, std::move(dict));
+  if (!components_.AddComponent(path, name, traits, error))
+    return false;
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
   return true;
@@ -132,22 +149,8 @@ bool ComponentManagerImpl::AddComponentArrayItem(
     const std::string& name,
     const std::vector<std::string>& traits,
     ErrorPtr* error) {
-  base::DictionaryValue* root = &components_;
-  if (!path.empty()) {
-    root = FindComponentGraftNode(path, error);
-    if (!root)
-      return false;
-  }
-  base::ListValue* array_value = nullptr;
-  if (!root->GetListWithoutPathExpansion(name, &array_value)) {
-    array_value = new base::ListValue;
-    root->SetWithoutPathExpansion(name, array_value);
-  }
-  std::unique_ptr<base::DictionaryValue> dict{new base::DictionaryValue};
-  std::unique_ptr<base::ListValue> traits_list{new base::ListValue};
-  traits_list->AppendStrings(traits);
-  dict->Set("traits", std::move(traits_list));
-  array_value->Append(std::move(dict));
+  if (!components_.AddComponentArrayItem(path, name, traits, error))
+    return false;
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
   return true;
@@ -156,19 +159,8 @@ bool ComponentManagerImpl::AddComponentArrayItem(
 bool ComponentManagerImpl::RemoveComponent(const std::string& path,
                                            const std::string& name,
                                            ErrorPtr* error) {
-  base::DictionaryValue* root = &components_;
-  if (!path.empty()) {
-    root = FindComponentGraftNode(path, error);
-    if (!root)
-      return false;
-  }
-
-  if (!root->RemoveWithoutPathExpansion(name, nullptr)) {
-    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
-                              "Component '%s' does not exist at path '%s'",
-                              name.c_str(), path.c_str());
-  }
-
+  if (!components_.RemoveComponent(path, name, error))
+    return false;
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
   return true;
@@ -178,28 +170,8 @@ bool ComponentManagerImpl::RemoveComponentArrayItem(const std::string& path,
                                                     const std::string& name,
                                                     size_t index,
                                                     ErrorPtr* error) {
-  base::DictionaryValue* root = &components_;
-  if (!path.empty()) {
-    root = FindComponentGraftNode(path, error);
-    if (!root)
-      return false;
-  }
-
-  base::ListValue* array_value = nullptr;
-  if (!root->GetListWithoutPathExpansion(name, &array_value)) {
-    return Error::AddToPrintf(
-        error, FROM_HERE, errors::commands::kInvalidState,
-        "There is no component array named '%s' at path '%s'", name.c_str(),
-        path.c_str());
-  }
-
-  if (!array_value->Remove(index, nullptr)) {
-    return Error::AddToPrintf(
-        error, FROM_HERE, errors::commands::kInvalidState,
-        "Component array '%s' at path '%s' does not have an element %zu",
-        name.c_str(), path.c_str(), index);
-  }
-
+  if (!components_.RemoveComponentArrayItem(path, name, index, error))
+    return false;
   for (const auto& cb : on_componet_tree_changed_)
     cb.Run();
   return true;
@@ -233,6 +205,12 @@ bool ComponentManagerImpl::LoadTraits(const base::DictionaryValue& dict,
         break;
       }
     } else {
+      const base::DictionaryValue* trait = nullptr;
+      CHECK(it.value().GetAsDictionary(&trait));
+      if (!CompileTraitValidators(it.key(), *trait, error)) {
+        result = false;
+        break;
+      }
       traits_.Set(it.key(), it.value().CreateDeepCopy());
       modified = true;
     }
@@ -279,12 +257,22 @@ std::unique_ptr<CommandInstance> ComponentManagerImpl::ParseCommandInstance(
   if (id)
     *id = command_id;
 
-  if (!command_instance)
+  if (!command_instance ||
+      !ValidateCommandInstance(command_instance.get(), role, error)) {
     return nullptr;
+  }
+  if (id)
+    *id = command_instance->GetID();
+  return command_instance;
+}
 
+bool ComponentManagerImpl::ValidateCommandInstance(
+    CommandInstance* command_instance,
+    UserRole role,
+    ErrorPtr* error) {
   UserRole minimal_role;
   if (!GetCommandMinimalRole(command_instance->GetName(), &minimal_role, error))
-    return nullptr;
+    return false;
 
   if (role < minimal_role) {
     return Error::AddToPrintf(error, FROM_HERE, "access_denied",
@@ -310,25 +298,15 @@ std::unique_ptr<CommandInstance> ComponentManagerImpl::ParseCommandInstance(
     command_instance->SetComponent(component_path);
   }
 
-  const base::DictionaryValue* component = FindComponent(component_path, error);
+  const ComponentNode* component =
+      components_.FindComponent(component_path, error);
   if (!component)
-    return nullptr;
+    return false;
 
   // Check that the command's trait is supported by the given component.
   auto pair = SplitAtFirst(command_instance->GetName(), ".", true);
-
-  bool trait_supported = false;
-  const base::ListValue* supported_traits = nullptr;
-  if (component->GetList("traits", &supported_traits)) {
-    for (const auto& value : *supported_traits) {
-      std::string trait;
-      CHECK(value->GetAsString(&trait));
-      if (trait == pair.first) {
-        trait_supported = true;
-        break;
-      }
-    }
-  }
+  const std::string* trait = components_.FindName(pair.first);
+  bool trait_supported = trait && component->HasTrait(trait);
 
   if (!trait_supported) {
     return Error::AddToPrintf(error, FROM_HERE, "trait_not_supported",
@@ -336,14 +314,16 @@ std::unique_ptr<CommandInstance> ComponentManagerImpl::ParseCommandInstance(
                               component_path.c_str(), pair.first.c_str());
   }
 
-  if (command_id.empty()) {
-    command_id = std::to_string(++next_command_id_);
-    command_instance->SetID(command_id);
-    if (id)
-      *id = command_id;
+  auto validator = command_validators_.find(command_instance->GetName());
+  if (validator != command_validators_.end() &&
+      !validator->second->Validate(command_instance->GetParameters(), error)) {
+    return false;
   }
 
-  return command_instance;
+  if (command_instance->GetID().empty())
+    command_instance->SetID(std::to_string(++next_command_id_));
+
+  return true;
 }
 
 CommandInstance* ComponentManagerImpl::FindCommand(const std::string& id) {
@@ -376,7 +356,8 @@ void ComponentManagerImpl::AddCommandHandler(
 const base::DictionaryValue* ComponentManagerImpl::FindComponent(
     const std::string& path,
     ErrorPtr* error) const {
-  return FindComponentAt(&components_, path, error);
+  const ComponentNode* component = components_.FindComponent(path, error);
+  return component ? &component->json() : nullptr;
 }
 
 const base::DictionaryValue* ComponentManagerImpl::FindTraitDefinition(
@@ -458,11 +439,11 @@ void ComponentManagerImpl::AddStateChangedCallback(
 
 std::unique_ptr<base::DictionaryValue>
 ComponentManagerImpl::GetComponentsForUserRole(UserRole role) const {
-  auto components = components_.CreateDeepCopy();
+  auto components = components_.GetJson().CreateDeepCopy();
   // Build a list of all state properties that are inaccessible to the given
   // user. These properties will be removed from the components collection
   // returned from this method.
-  for (base::DictionaryValue::Iterator it_component(components_);
+  for (base::DictionaryValue::Iterator it_component(components_.GetJson());
        !it_component.IsAtEnd(); it_component.Advance()) {
     base::DictionaryValue* component = nullptr;
     CHECK(components->GetDictionary(it_component.key(), &component));
@@ -472,28 +453,18 @@ ComponentManagerImpl::GetComponentsForUserRole(UserRole role) const {
   return components;
 }
 
+void ComponentManagerImpl::SetStateValidationEnabled(bool enabled) {
+  validate_state_ = enabled;
+}
+
 bool ComponentManagerImpl::SetStateProperties(const std::string& component_path,
                                               const base::DictionaryValue& dict,
                                               ErrorPtr* error) {
-  base::DictionaryValue* component =
-      FindMutableComponent(component_path, error);
-  if (!component)
+  ComponentNode* component = components_.FindComponent(component_path, error);
+  if (!component || !ValidateState(dict, error))
     return false;
 
-  base::DictionaryValue* state = nullptr;
-  if (!component->GetDictionary("state", &state)) {
-    state = new base::DictionaryValue;
-    component->Set("state", state);
-  }
-  state->MergeDictionary(&dict);
-  last_state_change_id_++;
-  auto& queue = state_change_queues_[component_path];
-  if (!queue)
-    queue.reset(new StateChangeQueue{kMaxStateChangeQueueSize});
-  base::Time timestamp = clock_->Now();
-  queue->NotifyPropertiesUpdated(timestamp, dict);
-  for (const auto& cb : on_state_changed_)
-    cb.Run();
+  UpdateState(component, dict);
   return true;
 }
 
@@ -509,23 +480,14 @@ const base::Value* ComponentManagerImpl::GetStateProperty(
     const std::string& component_path,
     const std::string& name,
     ErrorPtr* error) const {
-  const base::DictionaryValue* component = FindComponent(component_path, error);
+  const ComponentNode* component =
+      components_.FindComponent(component_path, error);
   if (!component)
     return nullptr;
-  auto pair = SplitAtFirst(name, ".", true);
-  if (pair.first.empty()) {
-    return Error::AddToPrintf(error, FROM_HERE,
-                              errors::commands::kPropertyMissing,
-                              "Empty state package in '%s'", name.c_str());
-  }
-  if (pair.second.empty()) {
-    return Error::AddToPrintf(
-        error, FROM_HERE, errors::commands::kPropertyMissing,
-        "State property name not specified in '%s'", name.c_str());
-  }
-  std::string key = base::StringPrintf("state.%s", name.c_str());
+  if (!SplitStatePropertyName(name, nullptr, error))
+    return nullptr;
   const base::Value* value = nullptr;
-  if (!component->Get(key, &value)) {
+  if (!component->state() || !component->state()->Get(name, &value)) {
     return Error::AddToPrintf(error, FROM_HERE,
                               errors::commands::kPropertyMissing,
                               "State property '%s' not found in component '%s'",
@@ -538,35 +500,119 @@ bool ComponentManagerImpl::SetStateProperty(const std::string& component_path,
                                             const std::string& name,
                                             const base::Value& value,
                                             ErrorPtr* error) {
+  if (!SplitStatePropertyName(name, nullptr, error))
+    return false;
   base::DictionaryValue dict;
-  auto pair = SplitAtFirst(name, ".", true);
-  if (pair.first.empty()) {
-    return Error::AddToPrintf(error, FROM_HERE,
-                              errors::commands::kPropertyMissing,
-                              "Empty state package in '%s'", name.c_str());
-  }
-  if (pair.second.empty()) {
-    return Error::AddToPrintf(
-        error, FROM_HERE, errors::commands::kPropertyMissing,
-        "State property name not specified in '%s'", name.c_str());
-  }
   dict.Set(name, value.CreateDeepCopy());
   return SetStateProperties(component_path, dict, error);
 }
 
+ComponentHandle ComponentManagerImpl::GetComponentHandle(
+    const std::string& component_path,
+    ErrorPtr* error) const {
+  const ComponentNode* component =
+      components_.FindComponent(component_path, error);
+  return component ? component->handle() : ComponentHandle{};
+}
+
+StatePropertyHandle ComponentManagerImpl::GetStatePropertyHandle(
+    const std::string& name,
+    ErrorPtr* error) {
+  auto it = state_property_ids_.find(name);
+  if (it != state_property_ids_.end())
+    return StatePropertyHandle{it->second};
+
+  std::pair<std::string, std::string> pair;
+  if (!SplitStatePropertyName(name, &pair, error))
+    return StatePropertyHandle{};
+  // SetStateProperty() expands "trait.a.b" into nested dictionaries, handles
+  // only address top-level properties of a trait.
+  if (pair.second.find('.') != std::string::npos) {
+    Error::AddToPrintf(error, FROM_HERE, errors::commands::kPropertyMissing,
+                       "Nested state property '%s' has no handle",
+                       name.c_str());
+    return StatePropertyHandle{};
+  }
+  state_properties_.emplace_back(
+      pair.first, pair.second,
+      state_property_names_.GetId(pair.first, pair.second));
+  uint32_t id = state_properties_.size();
+  state_property_ids_.emplace(name, id);
+  return StatePropertyHandle{id};
+}
+
+bool ComponentManagerImpl::SetStatePropertiesByHandle(
+    ComponentHandle component,
+    const base::DictionaryValue& dict,
+    ErrorPtr* error) {
+  ComponentNode* node = components_.FindComponent(component);
+  if (!node) {
+    return Error::AddTo(error, FROM_HERE, errors::commands::kInvalidState,
+                        "Component handle is no longer valid");
+  }
+  if (!ValidateState(dict, error))
+    return false;
+  UpdateState(node, dict);
+  return true;
+}
+
+bool ComponentManagerImpl::SetStatePropertyByHandle(
+    ComponentHandle component,
+    StatePropertyHandle property,
+    const base::Value& value,
+    ErrorPtr* error) {
+  ComponentNode* node = components_.FindComponent(component);
+  if (!node) {
+    return Error::AddTo(error, FROM_HERE, errors::commands::kInvalidState,
+                        "Component handle is no longer valid");
+  }
+  if (property.id == 0 || property.id > state_properties_.size()) {
+    return Error::AddTo(error, FROM_HERE, errors::commands::kPropertyMissing,
+                        "Invalid state property handle");
+  }
+  StateProperty* prop = &state_properties_[property.id - 1];
+  if (!ValidateStateProperty(prop, value, error))
+    return false;
+
+  // Same as MergeDictionary() of {"trait": {"name": value}} into the state.
+  base::DictionaryValue* state = node->GetOrCreateState();
+  base::DictionaryValue* trait = nullptr;
+  if (!state->GetDictionaryWithoutPathExpansion(prop->trait, &trait)) {
+    trait = new base::DictionaryValue;
+    state->SetWithoutPathExpansion(prop->trait, trait);
+  }
+  const base::DictionaryValue* dict = nullptr;
+  base::DictionaryValue* old_dict = nullptr;
+  if (value.GetAsDictionary(&dict) &&
+      trait->GetDictionaryWithoutPathExpansion(prop->name, &old_dict)) {
+    old_dict->MergeDictionary(dict);
+  } else {
+    trait->SetWithoutPathExpansion(prop->name, value.CreateDeepCopy());
+  }
+
+  BeginStateChange();
+  RecordStateChange(node, clock_->Now(), prop->id, value);
+  EndStateChange();
+  return true;
+}
+
 ComponentManager::StateSnapshot
 ComponentManagerImpl::GetAndClearRecordedStateChanges() {
   StateSnapshot snapshot;
   snapshot.update_id = GetLastStateChangeId();
-  for (auto& pair : state_change_queues_) {
-    auto changes = pair.second->GetAndClearRecordedStateChanges();
-    auto component = pair.first;
-    auto conv = [component](weave::StateChange& change) {
-      return ComponentStateChange{change.timestamp, component,
-                                  std::move(change.changed_properties)};
-    };
-    std::transform(changes.begin(), changes.end(),
-                   std::back_inserter(snapshot.state_changes), conv);
+  snapshot.state_changes.swap(removed_state_changes_);
+  for (ComponentHandle handle : state_changed_components_) {
+    // Changes of the components removed since are in
+    // |removed_state_changes_|.
+    const ComponentNode* component = components_.FindComponent(handle);
+    if (!component)
+      continue;
+    auto changes =
+        component->state_change_queue()->GetAndClearRecordedStateChanges();
+    for (auto& change : changes) {
+      snapshot.state_changes.emplace_back(change.timestamp, component->path(),
+                                          std::move(change.changed_properties));
+    }
   }
 
   // Sort events by the timestamp.
@@ -574,143 +620,253 @@ ComponentManagerImpl::GetAndClearRecordedStateChanges() {
                  const ComponentStateChange& rhs) {
     return lhs.timestamp < rhs.timestamp;
   };
-  std::sort(snapshot.state_changes.begin(), snapshot.state_changes.end(), pred);
-  state_change_queues_.clear();
+  std::stable_sort(snapshot.state_changes.begin(),
+                   snapshot.state_changes.end(), pred);
+  state_changed_components_.clear();
   return snapshot;
 }
 
+bool ComponentManagerImpl::SetStateChangeQueueSize(
+    const std::string& component_path,
+    size_t max_queue_size,
+    ErrorPtr* error) {
+  ComponentNode* component = components_.FindComponent(component_path, error);
+  if (!component)
+    return false;
+  if (max_queue_size == 0) {
+    Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidPropValue,
+                       "Invalid state change queue size for '%s'",
+                       component_path.c_str());
+    return false;
+  }
+  component->GetOrCreateStateChangeQueue(max_queue_size, &state_property_names_)
+      ->SetMaxQueueSize(max_queue_size);
+  return true;
+}
+
+bool ComponentManagerImpl::GetStateChangesSince(
+    UpdateID id,
+    std::vector<ComponentStateChange>* changes) const {
+  // The history only covers the last kMaxStateHistorySize changes.
+  if (id > last_state_change_id_ ||
+      id + kMaxStateHistorySize < last_state_change_id_) {
+    return false;
+  }
+  // Components of the items of |changes| added here.
+  const size_t first_change = changes->size();
+  std::vector<const ComponentNode*> changed_components;
+  for (const auto& entry : state_history_) {
+    if (entry.id <= id)
+      continue;
+    // Removal of the component is reported as a component tree change.
+    const ComponentNode* component = components_.FindComponent(entry.component);
+    if (!component || !component->state())
+      continue;
+    const auto& name = state_property_names_.GetName(entry.property);
+    const base::DictionaryValue* trait = nullptr;
+    const base::Value* value = nullptr;
+    if (!component->state()->GetDictionaryWithoutPathExpansion(name.first,
+                                                               &trait) ||
+        !trait->GetWithoutPathExpansion(name.second, &value)) {
+      continue;
+    }
+
+    auto it = std::find(changed_components.begin(), changed_components.end(),
+                        component);
+    ComponentStateChange* change = nullptr;
+    if (it == changed_components.end()) {
+      changed_components.push_back(component);
+      changes->emplace_back(
+          entry.timestamp, component->path(),
+          std::unique_ptr<base::DictionaryValue>{new base::DictionaryValue});
+      change = &changes->back();
+    } else {
+      change = &(*changes)[first_change + (it - changed_components.begin())];
+      change->timestamp = entry.timestamp;
+    }
+    base::DictionaryValue* patch_trait = nullptr;
+    if (!change->changed_properties->GetDictionaryWithoutPathExpansion(
+            name.first, &patch_trait)) {
+      patch_trait = new base::DictionaryValue;
+      change->changed_properties->SetWithoutPathExpansion(name.first,
+                                                          patch_trait);
+    }
+    patch_trait->SetWithoutPathExpansion(name.second, value->CreateDeepCopy());
+  }
+  return true;
+}
+
 void ComponentManagerImpl::NotifyStateUpdatedOnServer(UpdateID id) {
   on_server_state_updated_.Notify(id);
 }
 
 ComponentManager::Token ComponentManagerImpl::AddServerStateUpdatedCallback(
     const base::Callback<void(UpdateID)>& callback) {
-  if (state_change_queues_.empty())
+  if (state_changed_components_.empty())
     callback.Run(GetLastStateChangeId());
   return Token{on_server_state_updated_.Add(callback)};
 }
 
-std::string ComponentManagerImpl::FindComponentWithTrait(
-    const std::string& trait) const {
-  for (base::DictionaryValue::Iterator it(components_); !it.IsAtEnd();
-       it.Advance()) {
-    const base::ListValue* supported_traits = nullptr;
-    const base::DictionaryValue* component = nullptr;
-    CHECK(it.value().GetAsDictionary(&component));
-    if (component->GetList("traits", &supported_traits)) {
-      for (const auto& value : *supported_traits) {
-        std::string supported_trait;
-        CHECK(value->GetAsString(&supported_trait));
-        if (trait == supported_trait)
-          return it.key();
-      }
+void ComponentManagerImpl::UpdateState(ComponentNode* component,
+                                       const base::DictionaryValue& dict) {
+  component->GetOrCreateState()->MergeDictionary(&dict);
+  BeginStateChange();
+  const base::Time timestamp = clock_->Now();
+  for (base::DictionaryValue::Iterator trait(dict); !trait.IsAtEnd();
+       trait.Advance()) {
+    const base::DictionaryValue* properties = nullptr;
+    CHECK(trait.value().GetAsDictionary(&properties));
+    for (base::DictionaryValue::Iterator it(*properties); !it.IsAtEnd();
+         it.Advance()) {
+      RecordStateChange(component, timestamp,
+                        state_property_names_.GetId(trait.key(), it.key()),
+                        it.value());
     }
   }
-  return std::string{};
+  EndStateChange();
 }
 
-base::DictionaryValue* ComponentManagerImpl::FindComponentGraftNode(
-    const std::string& path,
-    ErrorPtr* error) {
-  base::DictionaryValue* root = nullptr;
-  base::DictionaryValue* component = FindMutableComponent(path, error);
-  if (component && !component->GetDictionary("components", &root)) {
-    root = new base::DictionaryValue;
-    component->Set("components", root);
+void ComponentManagerImpl::BeginStateChange() {
+  last_state_change_id_++;
+  while (!state_history_.empty() &&
+         state_history_.front().id + kMaxStateHistorySize <=
+             last_state_change_id_) {
+    state_history_.pop_front();
   }
-  return root;
 }
 
-base::DictionaryValue* ComponentManagerImpl::FindMutableComponent(
-    const std::string& path,
-    ErrorPtr* error) {
-  return const_cast<base::DictionaryValue*>(
-      FindComponentAt(&components_, path, error));
+void ComponentManagerImpl::EndStateChange() {
+  for (const auto& cb : on_state_changed_)
+    cb.Run();
 }
 
-const base::DictionaryValue* ComponentManagerImpl::FindComponentAt(
-    const base::DictionaryValue* root,
-    const std::string& path,
+void ComponentManagerImpl::RecordStateChange(ComponentNode* component,
+                                             base::Time timestamp,
+                                             uint32_t property,
+                                             const base::Value& value) {
+  StateChangeQueue* queue = component->GetOrCreateStateChangeQueue(
+      kMaxStateChangeQueueSize, &state_property_names_);
+  if (queue->IsEmpty())
+    state_changed_components_.push_back(component->handle());
+  queue->NotifyPropertyUpdated(timestamp, property, value);
+  state_history_.push_back(
+      StateHistoryEntry{last_state_change_id_, timestamp, component->handle(),
+                        property});
+}
+
+bool ComponentManagerImpl::CompileTraitValidators(
+    const std::string& name,
+    const base::DictionaryValue& trait,
     ErrorPtr* error) {
-  auto parts = Split(path, ".", true, false);
-  std::string root_path;
-  for (size_t i = 0; i < parts.size(); i++) {
-    auto element = SplitAtFirst(parts[i], "[", true);
-    int array_index = -1;
-    if (element.first.empty()) {
-      return Error::AddToPrintf(
-          error, FROM_HERE, errors::commands::kPropertyMissing,
-          "Empty path element at '%s'", root_path.c_str());
-    }
-    if (!element.second.empty()) {
-      if (element.second.back() != ']') {
-        return Error::AddToPrintf(
-            error, FROM_HERE, errors::commands::kPropertyMissing,
-            "Invalid array element syntax '%s'", parts[i].c_str());
+  std::unordered_map<std::string, std::unique_ptr<SchemaValidator>> commands;
+  const base::DictionaryValue* command_defs = nullptr;
+  if (trait.GetDictionaryWithoutPathExpansion("commands", &command_defs)) {
+    for (base::DictionaryValue::Iterator it(*command_defs); !it.IsAtEnd();
+         it.Advance()) {
+      const base::DictionaryValue* command = nullptr;
+      const base::DictionaryValue* parameters = nullptr;
+      if (!it.value().GetAsDictionary(&command) ||
+          !command->GetDictionaryWithoutPathExpansion("parameters",
+                                                      &parameters)) {
+        continue;
       }
-      element.second.pop_back();
-      std::string index_str;
-      base::TrimWhitespaceASCII(element.second, base::TrimPositions::TRIM_ALL,
-                                &index_str);
-      if (!base::StringToInt(index_str, &array_index) || array_index < 0) {
+      auto validator = SchemaValidator::CompileProperties(*parameters, error);
+      if (!validator) {
         return Error::AddToPrintf(
-            error, FROM_HERE, errors::commands::kInvalidPropValue,
-            "Invalid array index '%s'", element.second.c_str());
+            error, FROM_HERE, errors::commands::kTypeMismatch,
+            "Invalid parameters of command '%s.%s'", name.c_str(),
+            it.key().c_str());
       }
+      commands.emplace(name + '.' + it.key(), std::move(validator));
     }
+  }
 
-    if (!root_path.empty()) {
-      // We have processed at least one item in the path before, so now |root|
-      // points to the actual parent component. We need the root to point to
-      // the 'components' element containing child sub-components instead.
-      if (!root->GetDictionary("components", &root)) {
-        return Error::AddToPrintf(error, FROM_HERE,
-                                  errors::commands::kPropertyMissing,
-                                  "Component '%s' does not exist at '%s'",
-                                  element.first.c_str(), root_path.c_str());
-      }
+  std::unique_ptr<SchemaValidator> state;
+  const base::DictionaryValue* state_defs = nullptr;
+  if (trait.GetDictionaryWithoutPathExpansion("state", &state_defs)) {
+    state = SchemaValidator::CompileProperties(*state_defs, error);
+    if (!state) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kTypeMismatch,
+                                "Invalid state of trait '%s'", name.c_str());
     }
+  }
 
-    const base::Value* value = nullptr;
-    if (!root->GetWithoutPathExpansion(element.first, &value)) {
-      Error::AddToPrintf(error, FROM_HERE, errors::commands::kPropertyMissing,
-                         "Component '%s' does not exist at '%s'",
-                         element.first.c_str(), root_path.c_str());
-      return nullptr;
+  for (auto& pair : commands)
+    command_validators_[pair.first] = std::move(pair.second);
+  if (state) {
+    state_validators_[name] = std::move(state);
+    // Look up the replaced validator again.
+    for (auto& property : state_properties_) {
+      if (property.trait == name)
+        property.validator_resolved = false;
     }
+  }
+  return true;
+}
 
-    if (value->GetType() == base::Value::TYPE_LIST && array_index < 0) {
+bool ComponentManagerImpl::ValidateState(const base::DictionaryValue& dict,
+                                         ErrorPtr* error) const {
+  if (!validate_state_)
+    return true;
+  for (base::DictionaryValue::Iterator it(dict); !it.IsAtEnd(); it.Advance()) {
+    if (!it.value().IsType(base::Value::TYPE_DICTIONARY)) {
       return Error::AddToPrintf(error, FROM_HERE,
                                 errors::commands::kTypeMismatch,
-                                "Element '%s.%s' is an array",
-                                root_path.c_str(), element.first.c_str());
+                                "State of trait '%s' must be an object",
+                                it.key().c_str());
     }
-    if (value->GetType() == base::Value::TYPE_DICTIONARY && array_index >= 0) {
-      return Error::AddToPrintf(error, FROM_HERE,
-                                errors::commands::kTypeMismatch,
-                                "Element '%s.%s' is not an array",
-                                root_path.c_str(), element.first.c_str());
+    auto validator = state_validators_.find(it.key());
+    if (validator != state_validators_.end() &&
+        !validator->second->ValidatePatch(it.value(), error)) {
+      return false;
     }
+  }
+  return true;
+}
 
-    if (value->GetType() == base::Value::TYPE_DICTIONARY) {
-      CHECK(value->GetAsDictionary(&root));
-    } else {
-      const base::ListValue* component_array = nullptr;
-      CHECK(value->GetAsList(&component_array));
-      const base::Value* component_value = nullptr;
-      if (!component_array->Get(array_index, &component_value) ||
-          !component_value->GetAsDictionary(&root)) {
-        return Error::AddToPrintf(
-            error, FROM_HERE, errors::commands::kPropertyMissing,
-            "Element '%s.%s' does not contain item #%d", root_path.c_str(),
-            element.first.c_str(), array_index);
-      }
-    }
-    if (!root_path.empty())
-      root_path += '.';
-    root_path += parts[i];
+bool ComponentManagerImpl::ValidateStateProperty(StateProperty* property,
+                                                 const base::Value& value,
+                                                 ErrorPtr* error) {
+  if (!validate_state_)
+    return true;
+  if (!property->validator_resolved) {
+    auto validator = state_validators_.find(property->trait);
+    property->validator = validator != state_validators_.end()
+                              ? validator->second.get()
+                              : nullptr;
+    property->has_schema_property =
+        property->validator &&
+        property->validator->FindProperty(property->name,
+                                          &property->schema_property);
+    property->validator_resolved = true;
+  }
+  if (!property->validator)
+    return true;
+  if (!property->has_schema_property) {
+    return Error::AddToPrintf(error, FROM_HERE,
+                              errors::commands::kInvalidPropValue,
+                              "Unknown property '%s'", property->name.c_str());
   }
-  return root;
+  return property->validator->ValidateProperty(property->schema_property,
+                                               value, error);
+}
+
+void ComponentManagerImpl::SaveStateChangesOfRemovedComponent(
+    const ComponentNode& component) {
+  if (!component.state_change_queue())
+    return;
+  auto changes =
+      component.state_change_queue()->GetAndClearRecordedStateChanges();
+  for (auto& change : changes) {
+    removed_state_changes_.emplace_back(change.timestamp, component.path(),
+                                        std::move(change.changed_properties));
+  }
+}
+
+std::string ComponentManagerImpl::FindComponentWithTrait(
+    const std::string& trait) const {
+  return components_.FindComponentWithTrait(trait);
 }
 
 }  // namespace weave
@@ -5,10 +5,15 @@
 #ifndef LIBWEAVE_SRC_COMPONENT_MANAGER_IMPL_H_
 #define LIBWEAVE_SRC_COMPONENT_MANAGER_IMPL_H_
 
+#include <deque>
+#include <unordered_map>
+
 #include <base/time/default_clock.h>
 
 #include "src/commands/command_queue.h"
 #include "src/component_manager.h"
+#include "src/component_tree.h"
+#include "src/schema_validator.h"
 #include "src/states/state_change_queue.h"
 
 namespace weave {
@@ -83,6 +88,9 @@ class ComponentManagerImpl final : public ComponentManager {
       UserRole role,
       std::string* id,
       ErrorPtr* error) override;
+  bool ValidateCommandInstance(CommandInstance* command_instance,
+                               UserRole role,
+                               ErrorPtr* error) override;
 
   // Find a command instance with the given ID in the command queue.
   CommandInstance* FindCommand(const std::string& id) override;
@@ -135,7 +143,7 @@ class ComponentManagerImpl final : public ComponentManager {
 
   // Returns the full JSON dictionary containing component instances.
   const base::DictionaryValue& GetComponents() const override {
-    return components_;
+    return components_.GetJson();
   }
 
   // Returns a JSON dictionary containing component instances with state
@@ -143,6 +151,10 @@ class ComponentManagerImpl final : public ComponentManager {
   std::unique_ptr<base::DictionaryValue> GetComponentsForUserRole(
       UserRole role) const override;
 
+  // Enables checking state changes against the "state" schemas of their
+  // traits. Off by default.
+  void SetStateValidationEnabled(bool enabled) override;
+
   // Component state manipulation methods.
   bool SetStateProperties(const std::string& component_path,
                           const base::DictionaryValue& dict,
@@ -157,12 +169,28 @@ class ComponentManagerImpl final : public ComponentManager {
                         const std::string& name,
                         const base::Value& value,
                         ErrorPtr* error) override;
+  ComponentHandle GetComponentHandle(const std::string& component_path,
+                                     ErrorPtr* error) const override;
+  StatePropertyHandle GetStatePropertyHandle(const std::string& name,
+                                             ErrorPtr* error) override;
+  bool SetStatePropertiesByHandle(ComponentHandle component,
+                                  const base::DictionaryValue& dict,
+                                  ErrorPtr* error) override;
+  bool SetStatePropertyByHandle(ComponentHandle component,
+                                StatePropertyHandle property,
+                                const base::Value& value,
+                                ErrorPtr* error) override;
 
   void AddStateChangedCallback(const base::Closure& callback) override;
 
   // Returns the recorded state changes since last time this method was called.
   StateSnapshot GetAndClearRecordedStateChanges() override;
 
+  // Sets the maximum number of state change records kept for the component.
+  bool SetStateChangeQueueSize(const std::string& component_path,
+                               size_t max_queue_size,
+                               ErrorPtr* error) override;
+
   // Called to notify that the state patch with |id| has been successfully sent
   // to the server and processed.
   void NotifyStateUpdatedOnServer(UpdateID id) override;
@@ -173,6 +201,10 @@ class ComponentManagerImpl final : public ComponentManager {
     return last_state_change_id_;
   }
 
+  bool GetStateChangesSince(
+      UpdateID id,
+      std::vector<ComponentStateChange>* changes) const override;
+
   // Subscribes for device state update notifications from cloud server.
   // The |callback| will be called every time a state patch with given ID is
   // successfully received and processed by Weave server.
@@ -190,19 +222,55 @@ class ComponentManagerImpl final : public ComponentManager {
   std::string FindComponentWithTrait(const std::string& trait) const override;
 
  private:
-  // A helper method to find a JSON element of component at |path| to add new
-  // sub-components to.
-  base::DictionaryValue* FindComponentGraftNode(const std::string& path,
-                                                ErrorPtr* error);
-  base::DictionaryValue* FindMutableComponent(const std::string& path,
-                                              ErrorPtr* error);
-
-  // Helper method to find a sub-component given a root node and a relative path
-  // from the root to the target component.
-  static const base::DictionaryValue* FindComponentAt(
-      const base::DictionaryValue* root,
-      const std::string& path,
-      ErrorPtr* error);
+  // State property resolved by GetStatePropertyHandle().
+  struct StateProperty {
+    StateProperty(const std::string& trait,
+                  const std::string& name,
+                  uint32_t id);
+
+    std::string trait;
+    std::string name;
+    uint32_t id;  // ID in |state_property_names_|.
+    // The state validator of |trait| and the property in it, looked up on
+    // first use after the traits change. |validator| is nullptr if the trait
+    // has no state definition.
+    bool validator_resolved{false};
+    const SchemaValidator* validator{nullptr};
+    bool has_schema_property{false};
+    uint32_t schema_property{0};
+  };
+
+  // Merges |dict| into the state of |component| and records the change.
+  void UpdateState(ComponentNode* component, const base::DictionaryValue& dict);
+  // Starts a new state change: increments the state change ID and drops the
+  // changes the history no longer keeps.
+  void BeginStateChange();
+  // Notifies the subscribers about the state change.
+  void EndStateChange();
+  // Records the new |value| of |property| of |component| for the cloud and
+  // the state history.
+  void RecordStateChange(ComponentNode* component,
+                         base::Time timestamp,
+                         uint32_t property,
+                         const base::Value& value);
+
+  // Compiles the command parameter and state schemas of trait |name|.
+  bool CompileTraitValidators(const std::string& name,
+                              const base::DictionaryValue& trait,
+                              ErrorPtr* error);
+
+  // Validates a state patch ({"trait": {"prop": value}}) against the state
+  // schemas of the traits, if enabled by SetStateValidationEnabled(). Traits
+  // without a definition are not checked.
+  bool ValidateState(const base::DictionaryValue& dict, ErrorPtr* error) const;
+  // Same for a single property, with the validator cached in |property|.
+  bool ValidateStateProperty(StateProperty* property,
+                             const base::Value& value,
+                             ErrorPtr* error);
+
+  // Moves the pending state changes of |component|, which is being removed
+  // from |components_|, to |removed_state_changes_|.
+  void SaveStateChangesOfRemovedComponent(const ComponentNode& component);
 
   base::DefaultClock default_clock_;
   base::Clock* clock_{nullptr};
@@ -215,13 +283,45 @@ class ComponentManagerImpl final : public ComponentManager {
   base::CallbackList<void(UpdateID)> on_server_state_updated_;
 
   base::DictionaryValue traits_;      // Trait definitions.
-  base::DictionaryValue components_;  // Component instances.
+  // Validators compiled from |traits_|. Command parameter validators are
+  // keyed by the full command name, state validators by the trait name.
+  std::unordered_map<std::string, std::unique_ptr<SchemaValidator>>
+      command_validators_;
+  std::unordered_map<std::string, std::unique_ptr<SchemaValidator>>
+      state_validators_;
+  bool validate_state_{false};
+  // IDs of the state properties, shared by the state change queues of the
+  // components and the state history. Defined before |components_|, which
+  // owns the queues.
+  StatePropertyNames state_property_names_;
+  ComponentTree components_;         // Component instances.
   CommandQueue command_queue_;  // Command queue containing command instances.
   std::vector<base::Closure> on_trait_changed_;
   std::vector<base::Closure> on_componet_tree_changed_;
   std::vector<base::Closure> on_state_changed_;
   uint32_t next_command_id_{0};
-  std::map<std::string, std::unique_ptr<StateChangeQueue>> state_change_queues_;
+  // Components which have state changes not yet returned from
+  // GetAndClearRecordedStateChanges(), in order of their first change.
+  std::vector<ComponentHandle> state_changed_components_;
+  // Changes of the components removed since, not yet returned from
+  // GetAndClearRecordedStateChanges().
+  std::vector<ComponentStateChange> removed_state_changes_;
+
+  // Properties changed by the most recent state changes, for
+  // GetStateChangesSince(). Only the IDs are recorded, the values are read
+  // from the current state.
+  struct StateHistoryEntry {
+    UpdateID id;
+    base::Time timestamp;
+    ComponentHandle component;
+    uint32_t property;  // ID in |state_property_names_|.
+  };
+  std::deque<StateHistoryEntry> state_history_;
+
+  // State property names resolved by GetStatePropertyHandle(). The ID of a
+  // StatePropertyHandle is a 1-based index into |state_properties_|.
+  std::vector<StateProperty> state_properties_;
+  std::map<std::string, uint32_t> state_property_ids_;
 
   DISALLOW_COPY_AND_ASSIGN(ComponentManagerImpl);
 };
@@ -805,6 +805,67 @@ TEST_F(ComponentManagerTest, ParseCommandInstance) {
                 .get());
 }
 
+TEST_F(ComponentManagerTest, ParseCommandInstanceValidatesParameters) {
+  const char kTraits[] = R"({
+    "trait1": {
+      "commands": {
+        "command1": {
+          "minimalRole": "user",
+          "parameters": {
+            "level": { "type": "integer", "minimum": 0, "maximum": 10 },
+            "mode": { "type": "string", "enum": [ "on", "off" ] }
+          }
+        }
+      }
+    }
+  })";
+  auto traits = CreateDictionaryValue(kTraits);
+  ASSERT_TRUE(manager_.LoadTraits(*traits, nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp1", {"trait1"}, nullptr));
+
+  auto command = CreateDictionaryValue(R"({
+    "name": "trait1.command1",
+    "parameters": { "level": 5, "mode": "on" }
+  })");
+  EXPECT_NE(nullptr,
+            manager_.ParseCommandInstance(*command, Command::Origin::kLocal,
+                                          UserRole::kUser, nullptr, nullptr)
+                .get());
+
+  const char* kInvalidParameters[] = {
+      R"({ "level": 11 })", R"({ "level": "5" })", R"({ "mode": "auto" })",
+      R"({ "speed": 1 })",
+  };
+  for (const char* parameters : kInvalidParameters) {
+    command->Set("parameters", CreateDictionaryValue(parameters));
+    ErrorPtr error;
+    EXPECT_EQ(nullptr,
+              manager_.ParseCommandInstance(*command, Command::Origin::kLocal,
+                                            UserRole::kUser, nullptr, &error)
+                  .get())
+        << parameters;
+    EXPECT_NE(nullptr, error.get());
+  }
+}
+
+TEST_F(ComponentManagerTest, LoadTraitsInvalidSchema) {
+  auto traits = CreateDictionaryValue(R"({
+    "trait1": { "state": { "prop1": { "type": "integer", "minimum": "x" } } }
+  })");
+  ErrorPtr error;
+  EXPECT_FALSE(manager_.LoadTraits(*traits, &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+  EXPECT_EQ(nullptr, manager_.FindTraitDefinition("trait1"));
+
+  traits = CreateDictionaryValue(R"({
+    "trait1": { "state": { "prop1": { "type": "integr" } } }
+  })");
+  error.reset();
+  EXPECT_FALSE(manager_.LoadTraits(*traits, &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+  EXPECT_EQ(nullptr, manager_.FindTraitDefinition("trait1"));
+}
+
 TEST_F(ComponentManagerTest, AddCommand) {
   const char kTraits[] = R"({
     "trait1": {
@@ -1163,6 +1224,221 @@ TEST_F(ComponentManagerTest, SetGetStateProperty) {
   EXPECT_EQ(nullptr, manager_.GetStateProperty("comp1", "trait2", nullptr));
 }
 
+TEST_F(ComponentManagerTest, SetStatePropertyValidation) {
+  const char kTraits[] = R"({
+    "trait1": {
+      "state": {
+        "prop1": { "type": "integer" },
+        "obj": {
+          "type": "object",
+          "properties": {
+            "a": { "type": "integer" },
+            "b": { "type": "integer" }
+          },
+          "required": [ "a", "b" ]
+        }
+      }
+    }
+  })";
+  ASSERT_TRUE(manager_.LoadTraits(*CreateDictionaryValue(kTraits), nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp1", {"trait1"}, nullptr));
+
+  // State is not checked unless enabled.
+  base::StringValue str{"x"};
+  EXPECT_TRUE(manager_.SetStateProperty("comp1", "trait1.prop1", str, nullptr));
+  EXPECT_TRUE(manager_.SetStateProperty("comp1", "trait1.p", str, nullptr));
+
+  manager_.SetStateValidationEnabled(true);
+  EXPECT_FALSE(manager_.SetStateProperty("comp1", "trait1.prop1", str, nullptr));
+  EXPECT_FALSE(manager_.SetStateProperty("comp1", "trait1.p", str, nullptr));
+  EXPECT_FALSE(manager_.SetStateProperties(
+      "comp1", *CreateDictionaryValue("{'trait1': {'obj': {'a': 'x'}}}"),
+      nullptr));
+
+  // Patches are merged into the state, so required properties may be left
+  // out.
+  base::FundamentalValue one{1};
+  EXPECT_TRUE(manager_.SetStateProperty("comp1", "trait1.obj.a", one, nullptr));
+  EXPECT_TRUE(manager_.SetStateProperties(
+      "comp1", *CreateDictionaryValue("{'trait1': {'obj': {'b': 2}}}"),
+      nullptr));
+  EXPECT_JSON_EQ("{'a': 1, 'b': 2}",
+                 *manager_.GetStateProperty("comp1", "trait1.obj", nullptr));
+}
+
+TEST_F(ComponentManagerTest, SetStatePropertyByHandle) {
+  CreateTestComponentTree(&manager_);
+
+  ComponentHandle comp3 =
+      manager_.GetComponentHandle("comp1.comp2[1].comp3", nullptr);
+  ComponentHandle comp2 =
+      manager_.GetComponentHandle("comp1.comp2[0]", nullptr);
+  StatePropertyHandle prop = manager_.GetStatePropertyHandle("t4.p", nullptr);
+  EXPECT_NE(0u, prop.id);
+  EXPECT_EQ(prop.id, manager_.GetStatePropertyHandle("t4.p", nullptr).id);
+  EXPECT_EQ(0u, manager_.GetStatePropertyHandle("t4", nullptr).id);
+  EXPECT_EQ(0u, manager_.GetComponentHandle("comp5", nullptr).generation);
+
+  base::FundamentalValue value(1);
+  ASSERT_TRUE(manager_.SetStatePropertyByHandle(comp3, prop, value, nullptr));
+  const base::Value* result =
+      manager_.GetStateProperty("comp1.comp2[1].comp3", "t4.p", nullptr);
+  ASSERT_NE(nullptr, result);
+  EXPECT_TRUE(value.Equals(result));
+
+  // Removing an array item keeps handles to the following items valid.
+  ASSERT_TRUE(manager_.RemoveComponentArrayItem("comp1", "comp2", 0, nullptr));
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(comp2, prop, value, nullptr));
+  ASSERT_TRUE(manager_.SetStatePropertiesByHandle(
+      comp3, *CreateDictionaryValue("{'t4': {'p': 2}}"), nullptr));
+  result = manager_.GetStateProperty("comp1.comp2[0].comp3", "t4.p", nullptr);
+  ASSERT_NE(nullptr, result);
+  EXPECT_JSON_EQ("2", *result);
+
+  auto snapshot = manager_.GetAndClearRecordedStateChanges();
+  ASSERT_EQ(1u, snapshot.state_changes.size());
+  EXPECT_EQ("comp1.comp2[0].comp3", snapshot.state_changes[0].component);
+
+  ASSERT_TRUE(manager_.RemoveComponent("", "comp1", nullptr));
+  ErrorPtr error;
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(comp3, prop, value, &error));
+  EXPECT_NE(nullptr, error.get());
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(comp3, StatePropertyHandle{},
+                                                 value, nullptr));
+}
+
+TEST_F(ComponentManagerTest, SetStatePropertyByHandleValidation) {
+  const char kTraits[] = R"({
+    "trait1": {
+      "state": {
+        "prop1": { "type": "integer" },
+        "obj": { "type": "object" }
+      }
+    }
+  })";
+  ASSERT_TRUE(manager_.LoadTraits(*CreateDictionaryValue(kTraits), nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp1", {"trait1"}, nullptr));
+  manager_.SetStateValidationEnabled(true);
+  ComponentHandle comp1 = manager_.GetComponentHandle("comp1", nullptr);
+  StatePropertyHandle prop1 =
+      manager_.GetStatePropertyHandle("trait1.prop1", nullptr);
+  StatePropertyHandle obj =
+      manager_.GetStatePropertyHandle("trait1.obj", nullptr);
+  StatePropertyHandle unknown =
+      manager_.GetStatePropertyHandle("trait1.unknown", nullptr);
+  StatePropertyHandle prop2 =
+      manager_.GetStatePropertyHandle("trait2.prop2", nullptr);
+
+  ErrorPtr error;
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(
+      comp1, prop1, base::StringValue{"x"}, &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+  EXPECT_EQ("Expected 'prop1' to be of type 'integer'", error->GetMessage());
+  error.reset();
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(
+      comp1, unknown, base::FundamentalValue{1}, &error));
+  EXPECT_EQ("Unknown property 'unknown'", error->GetMessage());
+
+  // Dictionaries are merged into the state.
+  EXPECT_TRUE(manager_.SetStatePropertyByHandle(
+      comp1, obj, *CreateDictionaryValue("{'a': 1}"), nullptr));
+  EXPECT_TRUE(manager_.SetStatePropertyByHandle(
+      comp1, obj, *CreateDictionaryValue("{'b': 2}"), nullptr));
+  EXPECT_JSON_EQ("{'a': 1, 'b': 2}",
+                 *manager_.GetStateProperty("comp1", "trait1.obj", nullptr));
+
+  // State of traits without a definition is not checked, until the trait is
+  // defined.
+  EXPECT_TRUE(manager_.SetStatePropertyByHandle(
+      comp1, prop2, base::StringValue{"x"}, nullptr));
+  const char kTraits2[] = R"({
+    "trait2": { "state": { "prop2": { "type": "integer" } } }
+  })";
+  ASSERT_TRUE(manager_.LoadTraits(*CreateDictionaryValue(kTraits2), nullptr));
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(
+      comp1, prop2, base::StringValue{"x"}, nullptr));
+  EXPECT_TRUE(manager_.SetStatePropertyByHandle(
+      comp1, prop2, base::FundamentalValue{2}, nullptr));
+}
+
+TEST_F(ComponentManagerTest, SetStatePropertyByHandleMatchesByName) {
+  const char kTraits[] = R"({
+    "trait1": { "state": { "obj": { "type": "object" } } }
+  })";
+  ASSERT_TRUE(manager_.LoadTraits(*CreateDictionaryValue(kTraits), nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp1", {"trait1"}, nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp2", {"trait1"}, nullptr));
+
+  base::FundamentalValue value{1};
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp1", "trait1.obj", *CreateDictionaryValue("{'a': 1}"), nullptr));
+  ASSERT_TRUE(manager_.SetStatePropertyByHandle(
+      manager_.GetComponentHandle("comp2", nullptr),
+      manager_.GetStatePropertyHandle("trait1.obj", nullptr),
+      *CreateDictionaryValue("{'a': 1}"), nullptr));
+  EXPECT_JSON_EQ("{'a': 1}",
+                 *manager_.GetStateProperty("comp1", "trait1.obj", nullptr));
+  EXPECT_JSON_EQ("{'a': 1}",
+                 *manager_.GetStateProperty("comp2", "trait1.obj", nullptr));
+
+  // Nested names are expanded by SetStateProperty(), but have no handle.
+  ASSERT_TRUE(
+      manager_.SetStateProperty("comp1", "trait1.obj.b", value, nullptr));
+  EXPECT_JSON_EQ("{'a': 1, 'b': 1}",
+                 *manager_.GetStateProperty("comp1", "trait1.obj", nullptr));
+  ErrorPtr error;
+  StatePropertyHandle nested =
+      manager_.GetStatePropertyHandle("trait1.obj.b", &error);
+  EXPECT_EQ(0u, nested.id);
+  EXPECT_EQ(errors::commands::kPropertyMissing, error->GetCode());
+  EXPECT_FALSE(manager_.SetStatePropertyByHandle(
+      manager_.GetComponentHandle("comp2", nullptr), nested, value, nullptr));
+}
+
+TEST_F(ComponentManagerTest, StateChangesOfRemovedComponent) {
+  CreateTestComponentTree(&manager_);
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp1.comp2[1].comp3", "t4.p", base::FundamentalValue{1}, nullptr));
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp1.comp2[0]", "t4.p", base::FundamentalValue{2}, nullptr));
+  ASSERT_TRUE(manager_.SetStateProperty("comp1", "t4.p",
+                                        base::FundamentalValue{3}, nullptr));
+
+  // Pending changes of removed components are still published.
+  ASSERT_TRUE(manager_.RemoveComponentArrayItem("comp1", "comp2", 1, nullptr));
+  ASSERT_TRUE(manager_.RemoveComponent("", "comp1", nullptr));
+  auto snapshot = manager_.GetAndClearRecordedStateChanges();
+  ASSERT_EQ(3u, snapshot.state_changes.size());
+  EXPECT_EQ("comp1.comp2[1].comp3", snapshot.state_changes[0].component);
+  EXPECT_JSON_EQ("{'t4': {'p': 1}}",
+                 *snapshot.state_changes[0].changed_properties);
+  EXPECT_EQ("comp1.comp2[0]", snapshot.state_changes[1].component);
+  EXPECT_EQ("comp1", snapshot.state_changes[2].component);
+  EXPECT_TRUE(manager_.GetAndClearRecordedStateChanges().state_changes.empty());
+}
+
+TEST_F(ComponentManagerTest, StateChangesOfComponentNotRemoved) {
+  CreateTestComponentTree(&manager_);
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp1.comp2[1]", "t4.p", base::FundamentalValue{1}, nullptr));
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp1.comp2[1].comp3", "t4.p", base::FundamentalValue{2}, nullptr));
+
+  // Failed removals leave the changes with the live components.
+  EXPECT_FALSE(manager_.RemoveComponentArrayItem("comp1", "comp2", 2, nullptr));
+  EXPECT_FALSE(manager_.RemoveComponent("comp1.comp2[1]", "comp5", nullptr));
+  // The item moved by a removal keeps its changes under its new path.
+  ASSERT_TRUE(manager_.RemoveComponentArrayItem("comp1", "comp2", 0, nullptr));
+  auto snapshot = manager_.GetAndClearRecordedStateChanges();
+  ASSERT_EQ(2u, snapshot.state_changes.size());
+  EXPECT_EQ("comp1.comp2[0]", snapshot.state_changes[0].component);
+  EXPECT_JSON_EQ("{'t4': {'p': 1}}",
+                 *snapshot.state_changes[0].changed_properties);
+  EXPECT_EQ("comp1.comp2[0].comp3", snapshot.state_changes[1].component);
+  EXPECT_JSON_EQ("{'t4': {'p': 2}}",
+                 *snapshot.state_changes[1].changed_properties);
+}
+
 TEST_F(ComponentManagerTest, AddStateChangedCallback) {
   const char kTraits[] = R"({
     "trait1": {
@@ -1300,6 +1576,110 @@ TEST_F(ComponentManagerTest, ComponentStateUpdates) {
   EXPECT_EQ(snapshot.update_id, updates2.front());
 }
 
+TEST_F(ComponentManagerTest, SetStateChangeQueueSize) {
+  const char kTraits[] = R"({
+    "trait1": {
+      "state": {
+        "prop1": { "type": "integer" }
+      }
+    }
+  })";
+  auto traits = CreateDictionaryValue(kTraits);
+  ASSERT_TRUE(manager_.LoadTraits(*traits, nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp1", {"trait1"}, nullptr));
+  ASSERT_TRUE(manager_.SetStateChangeQueueSize("comp1", 2, nullptr));
+  EXPECT_FALSE(manager_.SetStateChangeQueueSize("comp1", 0, nullptr));
+  EXPECT_FALSE(manager_.SetStateChangeQueueSize("comp2", 2, nullptr));
+
+  base::Time time = base::Time::Now();
+  for (int i = 0; i < 5; i++) {
+    EXPECT_CALL(clock_, Now())
+        .WillRepeatedly(Return(time + base::TimeDelta::FromSeconds(i)));
+    ASSERT_TRUE(manager_.SetStateProperty(
+        "comp1", "trait1.prop1", base::FundamentalValue{i}, nullptr));
+  }
+  auto snapshot = manager_.GetAndClearRecordedStateChanges();
+  ASSERT_EQ(2u, snapshot.state_changes.size());
+  EXPECT_JSON_EQ(R"({"trait1":{"prop1":3}})",
+                 *snapshot.state_changes[0].changed_properties);
+  EXPECT_JSON_EQ(R"({"trait1":{"prop1":4}})",
+                 *snapshot.state_changes[1].changed_properties);
+}
+
+TEST_F(ComponentManagerTest, GetStateChangesSince) {
+  const char kTraits[] = R"({
+    "trait1": {
+      "state": {
+        "prop1": { "type": "integer" },
+        "prop2": { "type": "string" }
+      }
+    }
+  })";
+  auto traits = CreateDictionaryValue(kTraits);
+  ASSERT_TRUE(manager_.LoadTraits(*traits, nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp1", {"trait1"}, nullptr));
+  ASSERT_TRUE(manager_.AddComponent("", "comp2", {"trait1"}, nullptr));
+  EXPECT_CALL(clock_, Now()).WillRepeatedly(Return(base::Time::Now()));
+
+  auto start_id = manager_.GetLastStateChangeId();
+  std::vector<ComponentStateChange> changes;
+  EXPECT_TRUE(manager_.GetStateChangesSince(start_id, &changes));
+  EXPECT_TRUE(changes.empty());
+  EXPECT_FALSE(manager_.GetStateChangesSince(start_id + 1, &changes));
+
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(manager_.SetStateProperty(
+        "comp1", "trait1.prop1", base::FundamentalValue{i}, nullptr));
+  }
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp2", "trait1.prop2", base::StringValue{"a"}, nullptr));
+  ASSERT_TRUE(manager_.SetStateProperty(
+      "comp1", "trait1.prop2", base::StringValue{"b"}, nullptr));
+
+  // One change per component with the current values of the properties
+  // changed since, in order of the first change.
+  EXPECT_TRUE(manager_.GetStateChangesSince(start_id + 1, &changes));
+  ASSERT_EQ(2u, changes.size());
+  EXPECT_EQ("comp1", changes[0].component);
+  EXPECT_JSON_EQ(R"({"trait1":{"prop1":2,"prop2":"b"}})",
+                 *changes[0].changed_properties);
+  EXPECT_EQ("comp2", changes[1].component);
+  EXPECT_JSON_EQ(R"({"trait1":{"prop2":"a"}})",
+                 *changes[1].changed_properties);
+
+  changes.clear();
+  EXPECT_TRUE(manager_.GetStateChangesSince(start_id + 4, &changes));
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_JSON_EQ(R"({"trait1":{"prop2":"b"}})",
+                 *changes[0].changed_properties);
+
+  // The history is not consumed by reading it, nor by the cloud publisher.
+  manager_.GetAndClearRecordedStateChanges();
+  changes.clear();
+  EXPECT_TRUE(manager_.GetStateChangesSince(start_id, &changes));
+  EXPECT_EQ(2u, changes.size());
+
+  // Changes of removed components are not returned.
+  ASSERT_TRUE(manager_.RemoveComponent("", "comp2", nullptr));
+  changes.clear();
+  EXPECT_TRUE(manager_.GetStateChangesSince(start_id, &changes));
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_EQ("comp1", changes[0].component);
+
+  // Old changes are dropped eventually.
+  for (int i = 0; i < 200; i++) {
+    ASSERT_TRUE(manager_.SetStateProperty(
+        "comp1", "trait1.prop1", base::FundamentalValue{i}, nullptr));
+  }
+  EXPECT_FALSE(manager_.GetStateChangesSince(start_id, &changes));
+  changes.clear();
+  EXPECT_TRUE(manager_.GetStateChangesSince(
+      manager_.GetLastStateChangeId() - 10, &changes));
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_JSON_EQ(R"({"trait1":{"prop1":199}})",
+                 *changes[0].changed_properties);
+}
+
 TEST_F(ComponentManagerTest, FindComponentWithTrait) {
   const char kTraits[] = R"({
     "trait1": {},
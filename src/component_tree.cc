@@ -0,0 +1,382 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/component_tree.h"
+
+#include <algorithm>
+
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
+#include <base/strings/stringprintf.h>
+
+#include "src/commands/schema_constants.h"
+#include "src/string_utils.h"
+
+namespace weave {
+
+namespace {
+
+std::string MakePath(const ComponentNode& parent,
+                     const std::string& name,
+                     int index) {
+  std::string path = parent.path();
+  if (!path.empty())
+    path += '.';
+  path += name;
+  if (index >= 0)
+    path += base::StringPrintf("[%d]", index);
+  return path;
+}
+
+}  // anonymous namespace
+
+ComponentNode::ComponentNode(ComponentNode* parent,
+                             const std::string* name,
+                             base::DictionaryValue* json)
+    : parent_{parent}, name_{name}, json_{json} {}
+
+bool ComponentNode::HasTrait(const std::string* trait) const {
+  return std::find(traits_.begin(), traits_.end(), trait) != traits_.end();
+}
+
+base::DictionaryValue* ComponentNode::GetOrCreateState() {
+  if (!state_) {
+    state_ = new base::DictionaryValue;
+    json_->Set("state", state_);
+  }
+  return state_;
+}
+
+StateChangeQueue* ComponentNode::GetOrCreateStateChangeQueue(
+    size_t max_queue_size,
+    StatePropertyNames* names) {
+  if (!state_change_queue_)
+    state_change_queue_.reset(new StateChangeQueue{max_queue_size, names});
+  return state_change_queue_.get();
+}
+
+base::DictionaryValue* ComponentNode::GetOrCreateComponentsJson() {
+  if (!components_) {
+    components_ = new base::DictionaryValue;
+    json_->Set("components", components_);
+  }
+  return components_;
+}
+
+ComponentTree::ComponentTree() : root_{nullptr, nullptr, nullptr} {
+  root_.components_ = &json_;
+}
+
+ComponentTree::~ComponentTree() {}
+
+ComponentNode* ComponentTree::FindComponent(const std::string& path,
+                                            ErrorPtr* error) const {
+  // Fast path for canonical component paths.
+  auto it = path_index_.find(path);
+  if (it != path_index_.end())
+    return it->second;
+
+  // Slow path: parse the path to allow whitespace and to report errors.
+  auto parts = Split(path, ".", true, false);
+  std::string root_path;
+  const ComponentNode* node = &root_;
+  for (size_t i = 0; i < parts.size(); i++) {
+    auto element = SplitAtFirst(parts[i], "[", true);
+    int array_index = -1;
+    if (element.first.empty()) {
+      return Error::AddToPrintf(
+          error, FROM_HERE, errors::commands::kPropertyMissing,
+          "Empty path element at '%s'", root_path.c_str());
+    }
+    if (!element.second.empty()) {
+      if (element.second.back() != ']') {
+        return Error::AddToPrintf(
+            error, FROM_HERE, errors::commands::kPropertyMissing,
+            "Invalid array element syntax '%s'", parts[i].c_str());
+      }
+      element.second.pop_back();
+      std::string index_str;
+      base::TrimWhitespaceASCII(element.second, base::TrimPositions::TRIM_ALL,
+                                &index_str);
+      if (!base::StringToInt(index_str, &array_index) || array_index < 0) {
+        return Error::AddToPrintf(
+            error, FROM_HERE, errors::commands::kInvalidPropValue,
+            "Invalid array index '%s'", element.second.c_str());
+      }
+    }
+
+    const std::string* name = FindName(element.first);
+    auto child = name ? node->children_.find(name) : node->children_.end();
+    if (child == node->children_.end()) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kPropertyMissing,
+                                "Component '%s' does not exist at '%s'",
+                                element.first.c_str(), root_path.c_str());
+    }
+
+    if (child->second.is_array && array_index < 0) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kTypeMismatch,
+                                "Element '%s.%s' is an array",
+                                root_path.c_str(), element.first.c_str());
+    }
+    if (!child->second.is_array && array_index >= 0) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kTypeMismatch,
+                                "Element '%s.%s' is not an array",
+                                root_path.c_str(), element.first.c_str());
+    }
+
+    if (child->second.is_array) {
+      const auto& items = child->second.items;
+      if (static_cast<size_t>(array_index) >= items.size()) {
+        return Error::AddToPrintf(
+            error, FROM_HERE, errors::commands::kPropertyMissing,
+            "Element '%s.%s' does not contain item #%d", root_path.c_str(),
+            element.first.c_str(), array_index);
+      }
+      node = items[array_index].get();
+    } else {
+      node = child->second.component.get();
+    }
+    if (!root_path.empty())
+      root_path += '.';
+    root_path += parts[i];
+  }
+  return const_cast<ComponentNode*>(node);
+}
+
+ComponentNode* ComponentTree::FindComponent(ComponentHandle handle) const {
+  if (handle.slot >= handle_slots_.size())
+    return nullptr;
+  const HandleSlot& slot = handle_slots_[handle.slot];
+  return slot.generation == handle.generation ? slot.node : nullptr;
+}
+
+ComponentNode* ComponentTree::AddComponent(
+    const std::string& parent_path,
+    const std::string& name,
+    const std::vector<std::string>& traits,
+    ErrorPtr* error) {
+  ComponentNode* parent = FindParent(parent_path, error);
+  if (!parent)
+    return nullptr;
+
+  const std::string* interned_name = Intern(name);
+  auto& child = parent->children_[interned_name];
+  if (child.component || child.is_array) {
+    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
+                              "Component '%s' already exists at path '%s'",
+                              name.c_str(), parent_path.c_str());
+  }
+
+  base::DictionaryValue* json = new base::DictionaryValue;
+  parent->GetOrCreateComponentsJson()->SetWithoutPathExpansion(name, json);
+  child.component = CreateNode(parent, interned_name, traits, json);
+  UpdatePaths(child.component.get(), -1);
+  return child.component.get();
+}
+
+ComponentNode* ComponentTree::AddComponentArrayItem(
+    const std::string& parent_path,
+    const std::string& name,
+    const std::vector<std::string>& traits,
+    ErrorPtr* error) {
+  ComponentNode* parent = FindParent(parent_path, error);
+  if (!parent)
+    return nullptr;
+
+  const std::string* interned_name = Intern(name);
+  auto& child = parent->children_[interned_name];
+  if (child.component) {
+    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
+                              "Component '%s' at path '%s' is not an array",
+                              name.c_str(), parent_path.c_str());
+  }
+
+  base::DictionaryValue* components_json = parent->GetOrCreateComponentsJson();
+  base::ListValue* array_value = nullptr;
+  if (!child.is_array) {
+    child.is_array = true;
+    array_value = new base::ListValue;
+    components_json->SetWithoutPathExpansion(name, array_value);
+  } else {
+    CHECK(components_json->GetListWithoutPathExpansion(name, &array_value));
+  }
+
+  base::DictionaryValue* json = new base::DictionaryValue;
+  array_value->Append(json);
+  child.items.push_back(CreateNode(parent, interned_name, traits, json));
+  ComponentNode* node = child.items.back().get();
+  UpdatePaths(node, child.items.size() - 1);
+  return node;
+}
+
+bool ComponentTree::RemoveComponent(const std::string& parent_path,
+                                    const std::string& name,
+                                    ErrorPtr* error) {
+  ComponentNode* parent = FindParent(parent_path, error);
+  if (!parent)
+    return false;
+
+  const std::string* interned_name = FindName(name);
+  auto child = interned_name ? parent->children_.find(interned_name)
+                             : parent->children_.end();
+  if (child == parent->children_.end()) {
+    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kInvalidState,
+                              "Component '%s' does not exist at path '%s'",
+                              name.c_str(), parent_path.c_str());
+  }
+
+  if (child->second.is_array) {
+    for (const auto& item : child->second.items)
+      RemoveFromIndex(item.get(), true);
+  } else {
+    RemoveFromIndex(child->second.component.get(), true);
+  }
+  parent->children_.erase(child);
+  CHECK(parent->GetOrCreateComponentsJson()->RemoveWithoutPathExpansion(
+      name, nullptr));
+  return true;
+}
+
+bool ComponentTree::RemoveComponentArrayItem(const std::string& parent_path,
+                                             const std::string& name,
+                                             size_t index,
+                                             ErrorPtr* error) {
+  ComponentNode* parent = FindParent(parent_path, error);
+  if (!parent)
+    return false;
+
+  const std::string* interned_name = FindName(name);
+  auto child = interned_name ? parent->children_.find(interned_name)
+                             : parent->children_.end();
+  if (child == parent->children_.end() || !child->second.is_array) {
+    return Error::AddToPrintf(
+        error, FROM_HERE, errors::commands::kInvalidState,
+        "There is no component array named '%s' at path '%s'", name.c_str(),
+        parent_path.c_str());
+  }
+
+  auto& items = child->second.items;
+  if (index >= items.size()) {
+    return Error::AddToPrintf(
+        error, FROM_HERE, errors::commands::kInvalidState,
+        "Component array '%s' at path '%s' does not have an element %zu",
+        name.c_str(), parent_path.c_str(), index);
+  }
+
+  RemoveFromIndex(items[index].get(), true);
+  items.erase(items.begin() + index);
+  base::ListValue* array_value = nullptr;
+  CHECK(parent->GetOrCreateComponentsJson()->GetListWithoutPathExpansion(
+      name, &array_value));
+  CHECK(array_value->Remove(index, nullptr));
+
+  // The items following the removed one have been shifted down.
+  for (size_t i = index; i < items.size(); i++) {
+    RemoveFromIndex(items[i].get(), false);
+    UpdatePaths(items[i].get(), i);
+  }
+  return true;
+}
+
+const std::string* ComponentTree::FindName(const std::string& name) const {
+  auto it = names_.find(name);
+  return it != names_.end() ? &*it : nullptr;
+}
+
+std::string ComponentTree::FindComponentWithTrait(
+    const std::string& trait) const {
+  const std::string* interned_trait = FindName(trait);
+  if (!interned_trait)
+    return std::string{};
+
+  for (base::DictionaryValue::Iterator it(json_); !it.IsAtEnd(); it.Advance()) {
+    auto child = root_.children_.find(FindName(it.key()));
+    CHECK(child != root_.children_.end());
+    if (!child->second.is_array &&
+        child->second.component->HasTrait(interned_trait)) {
+      return it.key();
+    }
+  }
+  return std::string{};
+}
+
+const std::string* ComponentTree::Intern(const std::string& name) {
+  return &*names_.insert(name).first;
+}
+
+ComponentNode* ComponentTree::FindParent(const std::string& path,
+                                         ErrorPtr* error) const {
+  if (path.empty())
+    return const_cast<ComponentNode*>(&root_);
+  return FindComponent(path, error);
+}
+
+std::unique_ptr<ComponentNode> ComponentTree::CreateNode(
+    ComponentNode* parent,
+    const std::string* name,
+    const std::vector<std::string>& traits,
+    base::DictionaryValue* json) {
+  std::unique_ptr<ComponentNode> node{new ComponentNode{parent, name, json}};
+  std::unique_ptr<base::ListValue> traits_list{new base::ListValue};
+  traits_list->AppendStrings(traits);
+  json->Set("traits", std::move(traits_list));
+  node->traits_.reserve(traits.size());
+  for (const std::string& trait : traits)
+    node->traits_.push_back(Intern(trait));
+
+  uint32_t slot_index = handle_slots_.size();
+  if (free_handle_slots_.empty()) {
+    handle_slots_.emplace_back();
+  } else {
+    slot_index = free_handle_slots_.back();
+    free_handle_slots_.pop_back();
+  }
+  HandleSlot& slot = handle_slots_[slot_index];
+  slot.node = node.get();
+  slot.generation++;
+  node->handle_.slot = slot_index;
+  node->handle_.generation = slot.generation;
+  return node;
+}
+
+void ComponentTree::UpdatePaths(ComponentNode* node, int index) {
+  node->path_ = MakePath(*node->parent_, *node->name_, index);
+  path_index_[node->path_] = node;
+  for (const auto& pair : node->children_) {
+    const ComponentNode::Child& child = pair.second;
+    if (child.is_array) {
+      for (size_t i = 0; i < child.items.size(); i++)
+        UpdatePaths(child.items[i].get(), i);
+    } else {
+      UpdatePaths(child.component.get(), -1);
+    }
+  }
+}
+
+void ComponentTree::RemoveFromIndex(const ComponentNode* node,
+                                    bool release_handles) {
+  path_index_.erase(node->path_);
+  if (release_handles) {
+    HandleSlot& slot = handle_slots_[node->handle_.slot];
+    slot.node = nullptr;
+    slot.generation++;
+    free_handle_slots_.push_back(node->handle_.slot);
+  }
+  for (const auto& pair : node->children_) {
+    const ComponentNode::Child& child = pair.second;
+    if (child.is_array) {
+      for (const auto& item : child.items)
+        RemoveFromIndex(item.get(), release_handles);
+    } else {
+      RemoveFromIndex(child.component.get(), release_handles);
+    }
+  }
+  if (release_handles && !on_component_removed_.is_null())
+    on_component_removed_.Run(*node);
+}
+
+}  // namespace weave
@@ -0,0 +1,198 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_COMPONENT_TREE_H_
+#define LIBWEAVE_SRC_COMPONENT_TREE_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/values.h>
+#include <weave/device.h>
+#include <weave/error.h>
+
+#include "src/states/state_change_queue.h"
+
+namespace weave {
+
+// A single component instance in the component tree.
+// Component and trait names are interned by the owning ComponentTree, so
+// they can be compared by pointer. Each node also references the JSON object
+// that represents this component in ComponentTree::GetJson().
+class ComponentNode final {
+ public:
+  // Full path to the component, e.g. "stove.burners[2]".
+  const std::string& path() const { return path_; }
+
+  // Handle which can be used to find this node in constant time.
+  ComponentHandle handle() const { return handle_; }
+
+  // JSON representation of the component ("traits", "state", "components").
+  const base::DictionaryValue& json() const { return *json_; }
+
+  // Interned names of the traits this component supports.
+  const std::vector<const std::string*>& traits() const { return traits_; }
+
+  // Checks if the component supports the trait. |trait| must be an interned
+  // name obtained from ComponentTree::FindName().
+  bool HasTrait(const std::string* trait) const;
+
+  // Returns the "state" object of the component, or nullptr if no state has
+  // been set yet.
+  const base::DictionaryValue* state() const { return state_; }
+
+  // Returns the "state" object of the component, creating it if needed.
+  base::DictionaryValue* GetOrCreateState();
+
+  // Queue of state changes of this component not yet sent to the server.
+  // Created on first use, with the property IDs of |names|, and destroyed with
+  // the component.
+  StateChangeQueue* GetOrCreateStateChangeQueue(size_t max_queue_size,
+                                                StatePropertyNames* names);
+  StateChangeQueue* state_change_queue() const {
+    return state_change_queue_.get();
+  }
+
+ private:
+  friend class ComponentTree;
+
+  // A named child entry. Either a single component or a component array.
+  struct Child {
+    bool is_array{false};
+    std::unique_ptr<ComponentNode> component;
+    std::vector<std::unique_ptr<ComponentNode>> items;
+  };
+
+  ComponentNode(ComponentNode* parent,
+                const std::string* name,
+                base::DictionaryValue* json);
+
+  // Returns the "components" object of the component, creating it if needed.
+  base::DictionaryValue* GetOrCreateComponentsJson();
+
+  ComponentNode* parent_;
+  const std::string* name_;
+  std::string path_;
+  ComponentHandle handle_;
+  base::DictionaryValue* json_;
+  base::DictionaryValue* state_{nullptr};
+  base::DictionaryValue* components_{nullptr};
+  std::vector<const std::string*> traits_;
+  std::unordered_map<const std::string*, Child> children_;
+  std::unique_ptr<StateChangeQueue> state_change_queue_;
+
+  DISALLOW_COPY_AND_ASSIGN(ComponentNode);
+};
+
+// Typed, indexed storage for component instances. Keeps a path-to-node index
+// for constant time lookup of canonical component paths, and mirrors the tree
+// into a DictionaryValue which is exposed as the JSON representation of the
+// components.
+class ComponentTree final {
+ public:
+  ComponentTree();
+  ~ComponentTree();
+
+  // Returns the JSON dictionary containing all component instances.
+  const base::DictionaryValue& GetJson() const { return json_; }
+
+  // Finds a component instance by its full path.
+  ComponentNode* FindComponent(const std::string& path, ErrorPtr* error) const;
+
+  // Finds a component instance by its handle. Returns nullptr if the
+  // component has been removed.
+  ComponentNode* FindComponent(ComponentHandle handle) const;
+
+  // Adds a new component |name| under the component at |parent_path| (or at
+  // the root level if |parent_path| is empty).
+  ComponentNode* AddComponent(const std::string& parent_path,
+                              const std::string& name,
+                              const std::vector<std::string>& traits,
+                              ErrorPtr* error);
+
+  // Appends a new item to the component array |name| under the component at
+  // |parent_path|. The array is created if it does not exist yet.
+  ComponentNode* AddComponentArrayItem(const std::string& parent_path,
+                                       const std::string& name,
+                                       const std::vector<std::string>& traits,
+                                       ErrorPtr* error);
+
+  // Runs |callback| with each component removed from the tree, sub-components
+  // first, once the removal has been validated and before the component is
+  // destroyed.
+  void SetOnComponentRemovedCallback(
+      const base::Callback<void(const ComponentNode& node)>& callback) {
+    on_component_removed_ = callback;
+  }
+
+  // Removes the component |name| under the component at |parent_path|.
+  bool RemoveComponent(const std::string& parent_path,
+                       const std::string& name,
+                       ErrorPtr* error);
+
+  // Removes the item |index| from the component array |name| under the
+  // component at |parent_path|. Paths of the following items are updated.
+  bool RemoveComponentArrayItem(const std::string& parent_path,
+                                const std::string& name,
+                                size_t index,
+                                ErrorPtr* error);
+
+  // Returns the interned instance of |name|, or nullptr if no component or
+  // trait with this name was ever added to the tree.
+  const std::string* FindName(const std::string& name) const;
+
+  // Returns the path of the first root-level component (in JSON key order)
+  // that supports |trait|, or an empty string if there is none.
+  std::string FindComponentWithTrait(const std::string& trait) const;
+
+ private:
+  const std::string* Intern(const std::string& name);
+
+  // Finds the parent node for add/remove operations. Empty path is the root.
+  ComponentNode* FindParent(const std::string& path, ErrorPtr* error) const;
+
+  // Creates a child node backed by the JSON object |json|.
+  std::unique_ptr<ComponentNode> CreateNode(
+      ComponentNode* parent,
+      const std::string* name,
+      const std::vector<std::string>& traits,
+      base::DictionaryValue* json);
+
+  // Updates the path of |node| and of all its descendants and registers them
+  // in |path_index_|. |index| is the position of |node| in its component
+  // array, or -1 if |node| is not an array item.
+  void UpdatePaths(ComponentNode* node, int index);
+
+  // Removes |node| and all its descendants from |path_index_|. If
+  // |release_handles| is true, also invalidates their handles and runs
+  // |on_component_removed_|.
+  void RemoveFromIndex(const ComponentNode* node, bool release_handles);
+
+  // Entry of the handle table. |generation| is odd while the slot is in use,
+  // so a zero-initialized ComponentHandle never matches a live slot.
+  struct HandleSlot {
+    ComponentNode* node{nullptr};
+    uint32_t generation{0};
+  };
+
+  base::DictionaryValue json_;
+  ComponentNode root_;
+  std::unordered_set<std::string> names_;
+  std::unordered_map<std::string, ComponentNode*> path_index_;
+  std::vector<HandleSlot> handle_slots_;
+  std::vector<uint32_t> free_handle_slots_;
+
+  base::Callback<void(const ComponentNode& node)> on_component_removed_;
+
+  DISALLOW_COPY_AND_ASSIGN(ComponentTree);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_COMPONENT_TREE_H_
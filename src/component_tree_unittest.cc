@@ -0,0 +1,140 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/component_tree.h"
+
+#include <string>
+#include <vector>
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+namespace weave {
+
+class ComponentTreeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_NE(nullptr, tree_.AddComponent("", "stove", {"t1"}, nullptr));
+    for (size_t i = 0; i < 3; i++) {
+      ASSERT_NE(nullptr, tree_.AddComponentArrayItem("stove", "burners", {"t2"},
+                                                     nullptr));
+    }
+    ASSERT_NE(nullptr,
+              tree_.AddComponent("stove.burners[2]", "knob", {"t3"}, nullptr));
+  }
+
+  ComponentTree tree_;
+};
+
+TEST_F(ComponentTreeTest, Json) {
+  const char kExpected[] = R"({
+    "stove": {
+      "traits": ["t1"],
+      "components": {
+        "burners": [
+          {"traits": ["t2"]},
+          {"traits": ["t2"]},
+          {
+            "traits": ["t2"],
+            "components": {"knob": {"traits": ["t3"]}}
+          }
+        ]
+      }
+    }
+  })";
+  EXPECT_JSON_EQ(kExpected, tree_.GetJson());
+}
+
+TEST_F(ComponentTreeTest, FindComponent) {
+  const ComponentNode* node =
+      tree_.FindComponent("stove.burners[2].knob", nullptr);
+  ASSERT_NE(nullptr, node);
+  EXPECT_EQ("stove.burners[2].knob", node->path());
+  EXPECT_TRUE(node->HasTrait(tree_.FindName("t3")));
+  EXPECT_FALSE(node->HasTrait(tree_.FindName("t2")));
+  EXPECT_EQ(node, tree_.FindComponent(" stove. burners [ 2 ] .knob", nullptr));
+
+  ErrorPtr error;
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove.burners[3]", &error));
+  EXPECT_NE(nullptr, error.get());
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove.knob", nullptr));
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove[0]", nullptr));
+  EXPECT_EQ(nullptr, tree_.FindName("unknown"));
+}
+
+TEST_F(ComponentTreeTest, RemoveArrayItemUpdatesPaths) {
+  ASSERT_TRUE(tree_.RemoveComponentArrayItem("stove", "burners", 0, nullptr));
+  const ComponentNode* node =
+      tree_.FindComponent("stove.burners[1].knob", nullptr);
+  ASSERT_NE(nullptr, node);
+  EXPECT_EQ("stove.burners[1].knob", node->path());
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove.burners[2]", nullptr));
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove.burners[2].knob", nullptr));
+  EXPECT_FALSE(tree_.RemoveComponentArrayItem("stove", "burners", 2, nullptr));
+}
+
+TEST_F(ComponentTreeTest, RemoveComponent) {
+  ASSERT_TRUE(tree_.RemoveComponent("", "stove", nullptr));
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove.burners[2].knob", nullptr));
+  EXPECT_EQ(nullptr, tree_.FindComponent("stove", nullptr));
+  EXPECT_JSON_EQ("{}", tree_.GetJson());
+  EXPECT_FALSE(tree_.RemoveComponent("", "stove", nullptr));
+}
+
+TEST_F(ComponentTreeTest, OnComponentRemoved) {
+  std::vector<std::string> removed;
+  tree_.SetOnComponentRemovedCallback(base::Bind(
+      [](std::vector<std::string>* removed, const ComponentNode& node) {
+        removed->push_back(node.path());
+      },
+      base::Unretained(&removed)));
+  EXPECT_FALSE(tree_.RemoveComponentArrayItem("stove", "burners", 3, nullptr));
+  EXPECT_FALSE(tree_.RemoveComponent("stove", "knob", nullptr));
+  EXPECT_TRUE(removed.empty());
+
+  ASSERT_TRUE(tree_.RemoveComponentArrayItem("stove", "burners", 2, nullptr));
+  EXPECT_EQ((std::vector<std::string>{"stove.burners[2].knob",
+                                      "stove.burners[2]"}),
+            removed);
+}
+
+TEST_F(ComponentTreeTest, Handles) {
+  ComponentNode* burner = tree_.FindComponent("stove.burners[1]", nullptr);
+  ComponentNode* knob = tree_.FindComponent("stove.burners[2].knob", nullptr);
+  ASSERT_NE(nullptr, burner);
+  ASSERT_NE(nullptr, knob);
+  ComponentHandle burner_handle = burner->handle();
+  ComponentHandle knob_handle = knob->handle();
+  EXPECT_EQ(burner, tree_.FindComponent(burner_handle));
+  EXPECT_EQ(knob, tree_.FindComponent(knob_handle));
+  EXPECT_EQ(nullptr, tree_.FindComponent(ComponentHandle{}));
+
+  ASSERT_TRUE(tree_.RemoveComponentArrayItem("stove", "burners", 1, nullptr));
+  EXPECT_EQ(nullptr, tree_.FindComponent(burner_handle));
+  EXPECT_EQ(knob, tree_.FindComponent(knob_handle));
+
+  // Slots of removed components are reused with a new generation.
+  ComponentNode* node = tree_.AddComponent("", "oven", {}, nullptr);
+  ASSERT_NE(nullptr, node);
+  EXPECT_EQ(burner_handle.slot, node->handle().slot);
+  EXPECT_EQ(nullptr, tree_.FindComponent(burner_handle));
+}
+
+TEST_F(ComponentTreeTest, State) {
+  ComponentNode* node = tree_.FindComponent("stove.burners[1]", nullptr);
+  ASSERT_NE(nullptr, node);
+  EXPECT_EQ(nullptr, node->state());
+  node->GetOrCreateState()->SetInteger("t2.power", 5);
+  EXPECT_JSON_EQ(R"({"traits": ["t2"], "state": {"t2": {"power": 5}}})",
+                 node->json());
+}
+
+TEST_F(ComponentTreeTest, FindComponentWithTrait) {
+  EXPECT_EQ("stove", tree_.FindComponentWithTrait("t1"));
+  EXPECT_EQ("", tree_.FindComponentWithTrait("t2"));
+  EXPECT_EQ("", tree_.FindComponentWithTrait("t4"));
+}
+
+}  // namespace weave
@@ -57,6 +57,14 @@ const char kXmppEndpoint[] = "talk.google.com:5223";
 
 namespace {
 
+// Settings are saved once there were no further changes for
+// |kSaveWindowSeconds|, but no later than |kSaveMaxDelaySeconds| after the
+// first unsaved change.
+const int kSaveWindowSeconds = 1;
+const int kSaveMaxDelaySeconds = 5;
+// A failed save is retried after |kSaveRetrySeconds|.
+const int kSaveRetrySeconds = 5;
+
 const int kCurrentConfigVersion = 2;
 
 void MigrateFromV0(base::DictionaryValue* dict) {
@@ -132,15 +140,26 @@ template <>
 LIBWEAVE_EXPORT EnumToStringMap<RootClientTokenOwner>::EnumToStringMap()
     : EnumToStringMap(kRootClientTokenOwnerMap) {}
 
-Config::Config(provider::ConfigStore* config_store)
+Config::Config(provider::ConfigStore* config_store,
+               provider::TaskRunner* task_runner)
     : defaults_{CreateDefaultSettings(config_store)},
       settings_{defaults_},
-      config_store_{config_store} {
+      config_store_{config_store},
+      task_runner_{task_runner},
+      save_timer_{task_runner,
+                  base::Bind(&Config::SaveNow, base::Unretained(this))} {
   Transaction change{this};
   change.save_ = false;
   change.LoadState();
 }
 
+Config::~Config() {
+  // Don't lose the changes waiting for the posted save, or those that failed
+  // to save.
+  if (dirty_)
+    save_timer_.RunNow();
+}
+
 void Config::AddOnChangedCallback(const OnChangedCallback& callback) {
   on_changed_.push_back(callback);
   // Force to read current state.
@@ -179,6 +198,7 @@ void Config::Transaction::LoadState() {
     LOG(INFO) << "State version mismatch. expected: " << kCurrentConfigVersion
               << ", loaded: " << loaded_version;
     save_ = true;
+    changed_ = true;
   }
 
   switch (loaded_version) {
@@ -259,10 +279,18 @@ void Config::Transaction::LoadState() {
   }
 }
 
-void Config::Save() {
+void Config::Save(bool right_away) {
   if (!config_store_)
     return;
+  dirty_ = true;
+  if (!task_runner_ || right_away)
+    return save_timer_.RunNow();
+  save_timer_.Schedule(base::TimeDelta::FromSeconds(kSaveWindowSeconds),
+                       base::TimeDelta::FromSeconds(kSaveMaxDelaySeconds));
+}
 
+void Config::SaveNow() {
+  dirty_ = false;
   base::DictionaryValue dict;
   dict.SetInteger(config_keys::kVersion, kCurrentConfigVersion);
 
@@ -295,7 +323,17 @@ void Config::Save() {
 
   config_store_->SaveSettings(
       kConfigName, json_string,
-      base::Bind([](ErrorPtr error) { CHECK(!error); }));
+      base::Bind(&Config::OnSaveDone, weak_ptr_factory_.GetWeakPtr()));
+}
+
+void Config::OnSaveDone(ErrorPtr error) {
+  if (!error)
+    return;
+  // Settings are saved as a whole, so any later save retries this one.
+  LOG(ERROR) << "Failed to save settings: " << error->GetMessage();
+  dirty_ = true;
+  if (task_runner_)
+    save_timer_.ScheduleOnce(base::TimeDelta::FromSeconds(kSaveRetrySeconds));
 }
 
 Config::Transaction::~Transaction() {
@@ -305,8 +343,8 @@ Config::Transaction::~Transaction() {
 void Config::Transaction::Commit() {
   if (!config_)
     return;
-  if (save_)
-    config_->Save();
+  if (save_ && changed_)
+    config_->Save(save_now_);
   for (const auto& cb : config_->on_changed_)
     cb.Run(*settings_);
   config_ = nullptr;
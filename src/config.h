@@ -11,9 +11,12 @@
 
 #include <base/callback.h>
 #include <base/gtest_prod_util.h>
+#include <base/memory/weak_ptr.h>
 #include <weave/error.h>
 #include <weave/provider/config_store.h>
+#include <weave/provider/task_runner.h>
 
+#include "src/debounced_closure.h"
 #include "src/privet/privet_types.h"
 
 namespace weave {
@@ -39,16 +42,20 @@ class Config final {
   };
 
   using OnChangedCallback = base::Callback<void(const weave::Settings&)>;
-  ~Config() = default;
+  ~Config();
 
-  explicit Config(provider::ConfigStore* config_store);
+  // If |task_runner| is set, transactions committed in quick succession are
+  // saved together after a short delay. Changes of the registration
+  // credentials are saved right away.
+  explicit Config(provider::ConfigStore* config_store,
+                  provider::TaskRunner* task_runner = nullptr);
 
   void AddOnChangedCallback(const OnChangedCallback& callback);
   const Config::Settings& GetSettings() const;
   const Config::Settings& GetDefaults() const;
 
   // Allows editing of config. Makes sure that callbacks were called and changes
-  // were saved.
+  // were saved. Settings are only saved if a setter changed them.
   // User can commit changes by calling Commit method or by destroying the
   // object.
   class Transaction final {
@@ -60,47 +67,54 @@ class Config final {
 
     ~Transaction();
 
-    void set_client_id(const std::string& id) { settings_->client_id = id; }
+    void set_client_id(const std::string& id) {
+      Set(&settings_->client_id, id);
+    }
     void set_client_secret(const std::string& secret) {
-      settings_->client_secret = secret;
+      Set(&settings_->client_secret, secret);
+    }
+    void set_api_key(const std::string& key) { Set(&settings_->api_key, key); }
+    void set_oauth_url(const std::string& url) {
+      Set(&settings_->oauth_url, url);
     }
-    void set_api_key(const std::string& key) { settings_->api_key = key; }
-    void set_oauth_url(const std::string& url) { settings_->oauth_url = url; }
     void set_service_url(const std::string& url) {
-      settings_->service_url = url;
+      Set(&settings_->service_url, url);
     }
     void set_xmpp_endpoint(const std::string& endpoint) {
-      settings_->xmpp_endpoint = endpoint;
+      Set(&settings_->xmpp_endpoint, endpoint);
     }
-    void set_name(const std::string& name) { settings_->name = name; }
+    void set_name(const std::string& name) { Set(&settings_->name, name); }
     void set_description(const std::string& description) {
-      settings_->description = description;
+      Set(&settings_->description, description);
     }
     void set_location(const std::string& location) {
-      settings_->location = location;
+      Set(&settings_->location, location);
     }
     void set_local_anonymous_access_role(AuthScope role) {
-      settings_->local_anonymous_access_role = role;
+      Set(&settings_->local_anonymous_access_role, role);
     }
     void set_local_access_enabled(bool enabled) {
-      settings_->local_access_enabled = enabled;
+      Set(&settings_->local_access_enabled, enabled);
+    }
+    void set_cloud_id(const std::string& id) {
+      SetCredential(&settings_->cloud_id, id);
     }
-    void set_cloud_id(const std::string& id) { settings_->cloud_id = id; }
     void set_refresh_token(const std::string& token) {
-      settings_->refresh_token = token;
+      SetCredential(&settings_->refresh_token, token);
     }
     void set_robot_account(const std::string& account) {
-      settings_->robot_account = account;
+      SetCredential(&settings_->robot_account, account);
     }
     void set_last_configured_ssid(const std::string& ssid) {
-      settings_->last_configured_ssid = ssid;
+      Set(&settings_->last_configured_ssid, ssid);
     }
     void set_secret(const std::vector<uint8_t>& secret) {
-      settings_->secret = secret;
+      SetCredential(&settings_->secret, secret);
     }
     void set_root_client_token_owner(
         RootClientTokenOwner root_client_token_owner) {
-      settings_->root_client_token_owner = root_client_token_owner;
+      SetCredential(&settings_->root_client_token_owner,
+                    root_client_token_owner);
     }
 
     void Commit();
@@ -108,7 +122,28 @@ class Config final {
    private:
     FRIEND_TEST_ALL_PREFIXES(ConfigTest, Setters);
     void set_device_id(const std::string& id) {
-      config_->settings_.device_id = id;
+      Set(&settings_->device_id, id);
+    }
+
+    // Sets |field| and records whether the settings changed.
+    template <typename T>
+    void Set(T* field, const T& value) {
+      if (*field == value)
+        return;
+      *field = value;
+      changed_ = true;
+    }
+
+    // Like Set(), but a change is saved without waiting for further changes.
+    // The server knows the device by its cloud credentials, and the local
+    // owner's root token is derived from the secret, so they must survive a
+    // crash.
+    template <typename T>
+    void SetCredential(T* field, const T& value) {
+      if (*field == value)
+        return;
+      Set(field, value);
+      save_now_ = true;
     }
 
     friend class Config;
@@ -116,16 +151,29 @@ class Config final {
     Config* config_;
     Settings* settings_;
     bool save_{true};
+    bool changed_{false};
+    bool save_now_{false};
   };
 
  private:
-  void Save();
+  // Saves the settings, after a coalescing window if there is |task_runner_|
+  // and not |right_away|.
+  void Save(bool right_away);
+  void SaveNow();
+  void OnSaveDone(ErrorPtr error);
 
   const Settings defaults_;
   Settings settings_;
   provider::ConfigStore* config_store_{nullptr};
+  provider::TaskRunner* task_runner_{nullptr};
+  // Set while the settings differ from the last successfully saved ones.
+  bool dirty_{false};
+  // Runs SaveNow() once a burst of changes is over.
+  DebouncedClosure save_timer_;
   std::vector<OnChangedCallback> on_changed_;
 
+  base::WeakPtrFactory<Config> weak_ptr_factory_{this};
+
   DISALLOW_COPY_AND_ASSIGN(Config);
 };
 
@@ -9,6 +9,7 @@
 #include <base/bind.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
 #include <weave/provider/test/mock_config_store.h>
 #include <weave/test/unittest_utils.h>
 
@@ -320,4 +321,176 @@ TEST_F(ConfigTest, Setters) {
   change.Commit();
 }
 
+TEST_F(ConfigTest, UnchangedSettingsNotSaved) {
+  EXPECT_CALL(*this, OnConfigChanged(_)).Times(1);
+  EXPECT_CALL(config_store_, SaveSettings(_, _, _)).Times(0);
+  Config::Transaction change{config_.get()};
+  change.set_name(GetSettings().name);
+  change.set_local_access_enabled(GetSettings().local_access_enabled);
+  change.Commit();
+}
+
+TEST_F(ConfigTest, SavesCoalesced) {
+  provider::test::FakeTaskRunner task_runner;
+  config_.reset(new Config{&config_store_, &task_runner});
+
+  Config::Transaction{config_.get()}.set_name("name");
+  // Changes within the coalescing window are saved together.
+  task_runner.PostDelayedTask(
+      FROM_HERE, base::Bind(
+                     [](Config* config) {
+                       Config::Transaction{config}.set_description("text");
+                     },
+                     base::Unretained(config_.get())),
+      base::TimeDelta::FromMilliseconds(500));
+  task_runner.RunOnce();
+  EXPECT_EQ("text", GetSettings().description);
+
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<1, 2>(
+          Invoke([](const std::string& json, const DoneCallback& callback) {
+            auto dict = test::CreateDictionaryValue(json);
+            std::string value;
+            EXPECT_TRUE(dict->GetString("name", &value));
+            EXPECT_EQ("name", value);
+            EXPECT_TRUE(dict->GetString("description", &value));
+            EXPECT_EQ("text", value);
+            callback.Run(nullptr);
+          })));
+  task_runner.Run();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // Changes keep restarting the window, but are saved once the maximum delay
+  // passes, and again after the last change.
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _)).Times(2);
+  for (int i = 0; i < 10; ++i) {
+    task_runner.PostDelayedTask(
+        FROM_HERE, base::Bind(
+                       [](Config* config, int i) {
+                         Config::Transaction{config}.set_name(
+                             "name" + std::to_string(i));
+                       },
+                       base::Unretained(config_.get()), i),
+        base::TimeDelta::FromMilliseconds(900 * i));
+  }
+  task_runner.Run();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // A pending save is done when the config is destroyed.
+  Config::Transaction{config_.get()}.set_name("new_name");
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<2>(
+          Invoke([](const DoneCallback& callback) { callback.Run(nullptr); })));
+  config_.reset();
+}
+
+TEST_F(ConfigTest, FailedSaveRetried) {
+  EXPECT_CALL(*this, OnConfigChanged(_)).Times(1);
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<2>(Invoke([](const DoneCallback& callback) {
+        ErrorPtr error;
+        Error::AddTo(&error, FROM_HERE, "write_error", "Disk full");
+        callback.Run(std::move(error));
+      })));
+  Config::Transaction{config_.get()}.set_name("name");
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // The settings stay unsaved, and are saved again on destruction.
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<1, 2>(
+          Invoke([](const std::string& json, const DoneCallback& callback) {
+            auto dict = test::CreateDictionaryValue(json);
+            std::string value;
+            EXPECT_TRUE(dict->GetString("name", &value));
+            EXPECT_EQ("name", value);
+            callback.Run(nullptr);
+          })));
+  config_.reset();
+}
+
+TEST_F(ConfigTest, CredentialsSavedRightAway) {
+  provider::test::FakeTaskRunner task_runner;
+  config_.reset(new Config{&config_store_, &task_runner});
+
+  // Pending changes are saved along with the credentials.
+  Config::Transaction{config_.get()}.set_name("name");
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<1, 2>(
+          Invoke([](const std::string& json, const DoneCallback& callback) {
+            auto dict = test::CreateDictionaryValue(json);
+            std::string value;
+            EXPECT_TRUE(dict->GetString("name", &value));
+            EXPECT_EQ("name", value);
+            EXPECT_TRUE(dict->GetString("cloud_id", &value));
+            EXPECT_EQ("cloud_id", value);
+            EXPECT_TRUE(dict->GetString("refresh_token", &value));
+            EXPECT_EQ("token", value);
+            callback.Run(nullptr);
+          })));
+  Config::Transaction change{config_.get()};
+  change.set_cloud_id("cloud_id");
+  change.set_refresh_token("token");
+  change.Commit();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // Nothing is left to save.
+  EXPECT_CALL(config_store_, SaveSettings(_, _, _)).Times(0);
+  task_runner.Run();
+  config_.reset();
+}
+
+TEST_F(ConfigTest, LocalOwnerSavedRightAway) {
+  provider::test::FakeTaskRunner task_runner;
+  config_.reset(new Config{&config_store_, &task_runner});
+
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<1, 2>(
+          Invoke([](const std::string& json, const DoneCallback& callback) {
+            auto dict = test::CreateDictionaryValue(json);
+            std::string value;
+            EXPECT_TRUE(dict->GetString("secret", &value));
+            EXPECT_EQ("AQIDBAU=", value);
+            EXPECT_TRUE(dict->GetString("root_client_token_owner", &value));
+            EXPECT_EQ("client", value);
+            callback.Run(nullptr);
+          })));
+  Config::Transaction change{config_.get()};
+  change.set_secret({1, 2, 3, 4, 5});
+  change.set_root_client_token_owner(RootClientTokenOwner::kClient);
+  change.Commit();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // Nothing is left to save.
+  EXPECT_CALL(config_store_, SaveSettings(_, _, _)).Times(0);
+  task_runner.Run();
+  config_.reset();
+}
+
+TEST_F(ConfigTest, FailedSaveRetriedLater) {
+  provider::test::FakeTaskRunner task_runner;
+  config_.reset(new Config{&config_store_, &task_runner});
+
+  EXPECT_CALL(config_store_, SaveSettings(kConfigName, _, _))
+      .WillOnce(WithArgs<2>(Invoke([](const DoneCallback& callback) {
+        ErrorPtr error;
+        Error::AddTo(&error, FROM_HERE, "write_error", "Disk full");
+        callback.Run(std::move(error));
+      })))
+      .WillOnce(WithArgs<1, 2>(
+          Invoke([](const std::string& json, const DoneCallback& callback) {
+            auto dict = test::CreateDictionaryValue(json);
+            std::string value;
+            EXPECT_TRUE(dict->GetString("robot_account", &value));
+            EXPECT_EQ("robot", value);
+            callback.Run(nullptr);
+          })));
+  Config::Transaction{config_.get()}.set_robot_account("robot");
+  task_runner.Run();
+  testing::Mock::VerifyAndClearExpectations(&config_store_);
+
+  // The retry saved the settings.
+  EXPECT_CALL(config_store_, SaveSettings(_, _, _)).Times(0);
+  config_.reset();
+}
+
 }  // namespace weave
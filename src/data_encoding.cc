@@ -38,6 +38,34 @@ std::string Base64EncodeHelper(const void* data, size_t size) {
   return std::string{buffer.begin(), buffer.begin() + out_size};
 }
 
+// Decodes straight into |output|, which is either a std::string or a
+// std::vector<uint8_t>.
+template <typename T>
+bool Base64DecodeHelper(const std::string& input, T* output) {
+  std::string temp_buffer;
+  const std::string* data = &input;
+  if (input.find_first_of("\r\n") != std::string::npos) {
+    base::ReplaceChars(input, "\n", "", &temp_buffer);
+    base::ReplaceChars(temp_buffer, "\r", "", &temp_buffer);
+    data = &temp_buffer;
+  }
+  // base64 decoded data has 25% fewer bytes than the original (since every
+  // 3 source octets are encoded as 4 characters in base64).
+  // modp_b64_decode_len provides an upper estimate of the size of the output
+  // data.
+  output->resize(modp_b64_decode_len(data->size()));
+
+  size_t size_read = modp_b64_decode(reinterpret_cast<char*>(&(*output)[0]),
+                                     data->data(), data->size());
+  if (size_read == MODP_B64_ERROR) {
+    output->resize(0);
+    return false;
+  }
+  output->resize(size_read);
+
+  return true;
+}
+
 }  // namespace
 
 std::string UrlEncode(const char* data, bool encodeSpaceAsPlus) {
@@ -122,28 +150,11 @@ std::string Base64EncodeWrapLines(const void* data, size_t size) {
 }
 
 bool Base64Decode(const std::string& input, std::vector<uint8_t>* output) {
-  std::string temp_buffer;
-  const std::string* data = &input;
-  if (input.find_first_of("\r\n") != std::string::npos) {
-    base::ReplaceChars(input, "\n", "", &temp_buffer);
-    base::ReplaceChars(temp_buffer, "\r", "", &temp_buffer);
-    data = &temp_buffer;
-  }
-  // base64 decoded data has 25% fewer bytes than the original (since every
-  // 3 source octets are encoded as 4 characters in base64).
-  // modp_b64_decode_len provides an upper estimate of the size of the output
-  // data.
-  output->resize(modp_b64_decode_len(data->size()));
-
-  size_t size_read = modp_b64_decode(reinterpret_cast<char*>(output->data()),
-                                     data->data(), data->size());
-  if (size_read == MODP_B64_ERROR) {
-    output->resize(0);
-    return false;
-  }
-  output->resize(size_read);
+  return Base64DecodeHelper(input, output);
+}
 
-  return true;
+bool Base64Decode(const std::string& input, std::string* output) {
+  return Base64DecodeHelper(input, output);
 }
 
 }  // namespace weave
@@ -48,6 +48,7 @@ std::string Base64EncodeWrapLines(const void* data, size_t size);
 
 // Decodes the input string from Base64.
 bool Base64Decode(const std::string& input, std::vector<uint8_t>* output);
+bool Base64Decode(const std::string& input, std::string* output);
 
 // Helper wrappers to use std::string and std::vector<uint8_t> as binary data
 // containers.
@@ -63,13 +64,6 @@ inline std::string Base64Encode(const std::string& input) {
 inline std::string Base64EncodeWrapLines(const std::string& input) {
   return Base64EncodeWrapLines(input.data(), input.size());
 }
-inline bool Base64Decode(const std::string& input, std::string* output) {
-  std::vector<uint8_t> blob;
-  if (!Base64Decode(input, &blob))
-    return false;
-  *output = std::string{blob.begin(), blob.end()};
-  return true;
-}
 
 }  // namespace weave
 
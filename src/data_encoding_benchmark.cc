@@ -0,0 +1,61 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/data_encoding.h"
+
+#include <base/logging.h>
+
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+// Returns |size| KiB of data with all byte values.
+std::string CreateData(size_t size) {
+  std::string data(size * 1024, 0);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<char>(i);
+  return data;
+}
+
+}  // namespace
+
+WEAVE_BENCHMARK(Base64Encode) {
+  std::string data = CreateData(state->size());
+  while (state->KeepRunning())
+    Base64Encode(data.data(), data.size());
+}
+
+WEAVE_BENCHMARK(Base64Decode) {
+  std::string data = CreateData(state->size());
+  std::string encoded = Base64Encode(data.data(), data.size());
+  std::vector<uint8_t> decoded;
+  while (state->KeepRunning())
+    CHECK(Base64Decode(encoded, &decoded));
+}
+
+WEAVE_BENCHMARK(UrlEncode) {
+  std::string data = CreateData(state->size());
+  // UrlEncode() takes a null-terminated string.
+  for (auto& c : data) {
+    if (c == 0)
+      c = ' ';
+  }
+  while (state->KeepRunning())
+    UrlEncode(data.c_str(), true);
+}
+
+WEAVE_BENCHMARK(UrlDecode) {
+  std::string data = CreateData(state->size());
+  for (auto& c : data) {
+    if (c == 0)
+      c = ' ';
+  }
+  std::string encoded = UrlEncode(data.c_str(), true);
+  while (state->KeepRunning())
+    UrlDecode(encoded.c_str());
+}
+
+}  // namespace weave
@@ -0,0 +1,53 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/debounced_closure.h"
+
+#include <base/bind.h>
+
+namespace weave {
+
+DebouncedClosure::DebouncedClosure(provider::TaskRunner* task_runner,
+                                   const base::Closure& closure)
+    : task_runner_{task_runner}, closure_{closure} {}
+
+void DebouncedClosure::Schedule(base::TimeDelta window,
+                                base::TimeDelta max_delay) {
+  // Every request restarts the window. The first request of a batch also
+  // starts a timer bounding the delay of the batch (|window_id| of 0).
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&DebouncedClosure::OnTimeout,
+                            weak_ptr_factory_.GetWeakPtr(), batch_id_,
+                            ++window_id_),
+      window);
+  ScheduleOnce(max_delay);
+}
+
+void DebouncedClosure::ScheduleOnce(base::TimeDelta delay) {
+  if (scheduled_)
+    return;
+  scheduled_ = true;
+  task_runner_->PostDelayedTask(
+      FROM_HERE, base::Bind(&DebouncedClosure::OnTimeout,
+                            weak_ptr_factory_.GetWeakPtr(), batch_id_, 0),
+      delay);
+}
+
+void DebouncedClosure::RunNow() {
+  Cancel();
+  closure_.Run();
+}
+
+void DebouncedClosure::Cancel() {
+  ++batch_id_;
+  scheduled_ = false;
+}
+
+void DebouncedClosure::OnTimeout(int batch_id, int window_id) {
+  if (batch_id != batch_id_ || (window_id != 0 && window_id != window_id_))
+    return;
+  RunNow();
+}
+
+}  // namespace weave
@@ -0,0 +1,55 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_DEBOUNCED_CLOSURE_H_
+#define LIBWEAVE_SRC_DEBOUNCED_CLOSURE_H_
+
+#include <base/callback.h>
+#include <base/macros.h>
+#include <base/memory/weak_ptr.h>
+#include <base/time/time.h>
+#include <weave/provider/task_runner.h>
+
+namespace weave {
+
+// Runs a closure once a burst of requests is over. Every request restarts a
+// coalescing window, and the closure runs when a window passes without
+// another request, but no later than a maximum delay after the first request
+// of the burst.
+class DebouncedClosure final {
+ public:
+  DebouncedClosure(provider::TaskRunner* task_runner,
+                   const base::Closure& closure);
+
+  // Requests a run of the closure after |window|, or |max_delay| after the
+  // first pending request, whichever comes first.
+  void Schedule(base::TimeDelta window, base::TimeDelta max_delay);
+  // Requests a run of the closure after |delay| unless one is pending already.
+  void ScheduleOnce(base::TimeDelta delay);
+  // Drops the pending request, if any, and runs the closure.
+  void RunNow();
+  // Drops the pending request, if any.
+  void Cancel();
+
+  bool is_scheduled() const { return scheduled_; }
+
+ private:
+  void OnTimeout(int batch_id, int window_id);
+
+  provider::TaskRunner* task_runner_{nullptr};
+  base::Closure closure_;
+  // Set while a timer to run the closure is pending.
+  bool scheduled_{false};
+  // Identify the current batch of requests and its latest coalescing window.
+  // Timers of earlier batches and windows are ignored.
+  int batch_id_{0};
+  int window_id_{0};
+
+  base::WeakPtrFactory<DebouncedClosure> weak_ptr_factory_{this};
+  DISALLOW_COPY_AND_ASSIGN(DebouncedClosure);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_DEBOUNCED_CLOSURE_H_
@@ -0,0 +1,97 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/debounced_closure.h"
+
+#include <base/bind.h>
+#include <gtest/gtest.h>
+#include <weave/provider/test/fake_task_runner.h>
+
+namespace weave {
+
+class DebouncedClosureTest : public testing::Test {
+ protected:
+  void OnRun() { run_times_.push_back(Now()); }
+
+  base::Time Now() { return task_runner_.GetClock()->Now(); }
+
+  // Posts a task scheduling the closure |delay| from now.
+  void ScheduleAfter(base::TimeDelta delay) {
+    task_runner_.PostDelayedTask(
+        FROM_HERE, base::Bind(&DebouncedClosure::Schedule,
+                              base::Unretained(&closure_), kWindow, kMaxDelay),
+        delay);
+  }
+
+  const base::TimeDelta kWindow{base::TimeDelta::FromSeconds(1)};
+  const base::TimeDelta kMaxDelay{base::TimeDelta::FromSeconds(5)};
+
+  provider::test::FakeTaskRunner task_runner_;
+  std::vector<base::Time> run_times_;
+  DebouncedClosure closure_{
+      &task_runner_,
+      base::Bind(&DebouncedClosureTest::OnRun, base::Unretained(this))};
+};
+
+TEST_F(DebouncedClosureTest, RunsAfterWindow) {
+  base::Time start = Now();
+  closure_.Schedule(kWindow, kMaxDelay);
+  closure_.Schedule(kWindow, kMaxDelay);
+  EXPECT_TRUE(closure_.is_scheduled());
+  task_runner_.Run();
+  EXPECT_EQ(std::vector<base::Time>{start + kWindow}, run_times_);
+  EXPECT_FALSE(closure_.is_scheduled());
+}
+
+TEST_F(DebouncedClosureTest, RequestsRestartWindow) {
+  base::Time start = Now();
+  closure_.Schedule(kWindow, kMaxDelay);
+  ScheduleAfter(base::TimeDelta::FromMilliseconds(500));
+  task_runner_.Run();
+  EXPECT_EQ(std::vector<base::Time>{start +
+                                    base::TimeDelta::FromMilliseconds(1500)},
+            run_times_);
+}
+
+TEST_F(DebouncedClosureTest, MaxDelayBoundsBurst) {
+  base::Time start = Now();
+  closure_.Schedule(kWindow, kMaxDelay);
+  for (int i = 1; i < 10; ++i)
+    ScheduleAfter(base::TimeDelta::FromMilliseconds(900 * i));
+  task_runner_.Run();
+  // The burst is cut at |kMaxDelay|, and its remaining requests start another
+  // batch.
+  EXPECT_EQ((std::vector<base::Time>{
+                start + kMaxDelay,
+                start + base::TimeDelta::FromMilliseconds(8100) + kWindow}),
+            run_times_);
+}
+
+TEST_F(DebouncedClosureTest, RunNowDropsPendingRequest) {
+  base::Time start = Now();
+  closure_.Schedule(kWindow, kMaxDelay);
+  closure_.RunNow();
+  EXPECT_FALSE(closure_.is_scheduled());
+  task_runner_.Run();
+  EXPECT_EQ(std::vector<base::Time>{start}, run_times_);
+}
+
+TEST_F(DebouncedClosureTest, Cancel) {
+  closure_.Schedule(kWindow, kMaxDelay);
+  closure_.Cancel();
+  EXPECT_FALSE(closure_.is_scheduled());
+  task_runner_.Run();
+  EXPECT_TRUE(run_times_.empty());
+}
+
+TEST_F(DebouncedClosureTest, ScheduleOnceKeepsPendingRequest) {
+  base::Time start = Now();
+  closure_.ScheduleOnce(base::TimeDelta::FromSeconds(2));
+  closure_.ScheduleOnce(base::TimeDelta::FromSeconds(1));
+  task_runner_.Run();
+  EXPECT_EQ(std::vector<base::Time>{start + base::TimeDelta::FromSeconds(2)},
+            run_times_);
+}
+
+}  // namespace weave
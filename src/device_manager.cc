@@ -35,11 +35,11 @@ DeviceManager::DeviceManager(provider::ConfigStore* config_store,
       dns_sd_{dns_sd},
       http_server_{http_server},
       wifi_{wifi},
-      config_{new Config{config_store}},
+      config_{new Config{config_store, task_runner}},
       component_manager_{new ComponentManagerImpl{task_runner}} {
   if (http_server) {
     access_revocation_manager_.reset(
-        new AccessRevocationManagerImpl{config_store});
+        new AccessRevocationManagerImpl{config_store, task_runner});
     auth_manager_.reset(
         new privet::AuthManager(config_.get(), access_revocation_manager_.get(),
                                 http_server->GetHttpsCertificateFingerprint()));
@@ -159,6 +159,32 @@ bool DeviceManager::SetStateProperty(const std::string& component,
   return component_manager_->SetStateProperty(component, name, value, error);
 }
 
+ComponentHandle DeviceManager::GetComponentHandle(const std::string& component,
+                                                  ErrorPtr* error) const {
+  return component_manager_->GetComponentHandle(component, error);
+}
+
+StatePropertyHandle DeviceManager::GetStatePropertyHandle(
+    const std::string& name,
+    ErrorPtr* error) {
+  return component_manager_->GetStatePropertyHandle(name, error);
+}
+
+bool DeviceManager::SetStatePropertiesByHandle(
+    ComponentHandle component,
+    const base::DictionaryValue& dict,
+    ErrorPtr* error) {
+  return component_manager_->SetStatePropertiesByHandle(component, dict, error);
+}
+
+bool DeviceManager::SetStatePropertyByHandle(ComponentHandle component,
+                                             StatePropertyHandle property,
+                                             const base::Value& value,
+                                             ErrorPtr* error) {
+  return component_manager_->SetStatePropertyByHandle(component, property,
+                                                      value, error);
+}
+
 void DeviceManager::AddCommandHandler(const std::string& component,
                                       const std::string& command_name,
                                       const CommandHandlerCallback& callback) {
@@ -197,6 +223,7 @@ void DeviceManager::AddPairingChangedCallbacks(
 }
 
 void DeviceManager::OnSettingsChanged(const Settings& settings) {
+  component_manager_->SetStateValidationEnabled(settings.validate_state);
   if (settings.local_access_enabled && http_server_) {
     StartPrivet();
   } else {
@@ -61,6 +61,17 @@ class DeviceManager final : public Device {
                         const std::string& name,
                         const base::Value& value,
                         ErrorPtr* error) override;
+  ComponentHandle GetComponentHandle(const std::string& component,
+                                     ErrorPtr* error) const override;
+  StatePropertyHandle GetStatePropertyHandle(const std::string& name,
+                                             ErrorPtr* error) override;
+  bool SetStatePropertiesByHandle(ComponentHandle component,
+                                  const base::DictionaryValue& dict,
+                                  ErrorPtr* error) override;
+  bool SetStatePropertyByHandle(ComponentHandle component,
+                                StatePropertyHandle property,
+                                const base::Value& value,
+                                ErrorPtr* error) override;
   void AddCommandHandler(const std::string& component,
                          const std::string& command_name,
                          const CommandHandlerCallback& callback) override;
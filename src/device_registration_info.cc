@@ -5,14 +5,12 @@
 #include "src/device_registration_info.h"
 
 #include <algorithm>
+#include <map>
 #include <memory>
-#include <set>
 #include <utility>
 #include <vector>
 
 #include <base/bind.h>
-#include <base/json/json_reader.h>
-#include <base/json/json_writer.h>
 #include <base/strings/string_number_conversions.h>
 #include <base/strings/stringprintf.h>
 #include <base/values.h>
@@ -26,6 +24,7 @@
 #include "src/data_encoding.h"
 #include "src/http_constants.h"
 #include "src/json_error_codes.h"
+#include "src/json_reader.h"
 #include "src/notification/xmpp_channel.h"
 #include "src/privet/auth_manager.h"
 #include "src/privet/constants.h"
@@ -40,6 +39,15 @@ namespace {
 
 const int kPollingPeriodSeconds = 7;
 
+// Bounds the cloud requests in flight, like a browser does for one host.
+const size_t kMaxCloudRequestsInFlight = 4;
+const size_t kMaxCommandUpdatesPerRequest = 50;
+
+// Keys of the cloud requests which run one at a time.
+const char kPatchStateRequestKey[] = "patchState";
+const char kDeviceResourceRequestKey[] = "deviceResource";
+const char kFetchCommandsRequestKey[] = "fetchCommands";
+
 namespace fetch_reason {
 
 const char kDeviceStart[] = "device_start";  // Initial queue fetch at startup.
@@ -115,6 +123,17 @@ void IgnoreCloudResultWithCallback(const DoneCallback& cb,
   cb.Run(std::move(error));
 }
 
+// Runs |callback| of a cloud request, then completes the request in the
+// scheduler.
+void RunCloudRequestCallback(
+    const base::Closure& done,
+    const DeviceRegistrationInfo::CloudRequestDoneCallback& callback,
+    const base::DictionaryValue& response,
+    ErrorPtr error) {
+  callback.Run(response, std::move(error));
+  done.Run();
+}
+
 class RequestSender final {
  public:
   RequestSender(HttpClient::Method method,
@@ -127,7 +146,7 @@ class RequestSender final {
     ++debug_id;
     VLOG(1) << "Sending request. id:" << debug_id
             << " method:" << EnumToString(method_) << " url:" << url_;
-    VLOG(2) << "Request data: " << data_;
+    VLOG(2) << "Request data: " << JsonWriter::Join(data_);
     auto on_done = [](
         int debug_id, const HttpClient::SendRequestCallback& callback,
         std::unique_ptr<HttpClient::Response> response, ErrorPtr error) {
@@ -142,8 +161,8 @@ class RequestSender final {
       VLOG(2) << "Response data: " << response->GetData();
       callback.Run(std::move(response), nullptr);
     };
-    transport_->SendRequest(method_, url_, GetFullHeaders(), data_,
-                            base::Bind(on_done, debug_id, callback));
+    transport_->SendRequestWithChunks(method_, url_, GetFullHeaders(), data_,
+                                      base::Bind(on_done, debug_id, callback));
   }
 
   void SetAccessToken(const std::string& access_token) {
@@ -151,6 +170,12 @@ class RequestSender final {
   }
 
   void SetData(const std::string& data, const std::string& mime_type) {
+    SetChunks({std::make_shared<const std::string>(data)}, mime_type);
+  }
+
+  // Sets the data without joining the chunks. They are shared with the
+  // transport.
+  void SetChunks(const JsonWriter::Chunks& data, const std::string& mime_type) {
     data_ = data;
     mime_type_ = mime_type;
   }
@@ -161,9 +186,10 @@ class RequestSender final {
   }
 
   void SetJsonData(const base::Value& json) {
-    std::string data;
-    CHECK(base::JSONWriter::Write(json, &data));
-    SetData(data, http::kJsonUtf8);
+    JsonWriter::Chunks data;
+    JsonWriter writer{false, &data};
+    writer.Value(json);
+    SetChunks(data, http::kJsonUtf8);
   }
 
  private:
@@ -178,7 +204,7 @@ class RequestSender final {
 
   HttpClient::Method method_;
   std::string url_;
-  std::string data_;
+  JsonWriter::Chunks data_;
   std::string mime_type_;
   std::string access_token_;
   HttpClient* transport_{nullptr};
@@ -186,11 +212,9 @@ class RequestSender final {
   DISALLOW_COPY_AND_ASSIGN(RequestSender);
 };
 
-std::unique_ptr<base::DictionaryValue> ParseJsonResponse(
-    const HttpClient::Response& response,
-    ErrorPtr* error) {
-  // Make sure we have a correct content type. Do not try to parse
-  // binary files, or HTML output. Limit to application/json and text/plain.
+// Makes sure we have a correct content type. Do not try to parse binary
+// files, or HTML output. Limit to application/json and text/plain.
+bool IsJsonResponse(const HttpClient::Response& response, ErrorPtr* error) {
   std::string content_type =
       SplitAtFirst(response.GetContentType(), ";", true).first;
 
@@ -199,15 +223,22 @@ std::unique_ptr<base::DictionaryValue> ParseJsonResponse(
         error, FROM_HERE, "non_json_content_type",
         "Unexpected content type: \'" + response.GetContentType() + "\'");
   }
+  return true;
+}
+
+std::unique_ptr<base::DictionaryValue> ParseJsonResponse(
+    const HttpClient::Response& response,
+    ErrorPtr* error) {
+  if (!IsJsonResponse(response, error))
+    return std::unique_ptr<base::DictionaryValue>();
 
   const std::string& json = response.GetData();
-  std::string error_message;
-  auto value = base::JSONReader::ReadAndReturnError(json, base::JSON_PARSE_RFC,
-                                                    nullptr, &error_message);
+  ErrorPtr parse_error;
+  auto value = ReadJson(json, {}, &parse_error);
   if (!value) {
     Error::AddToPrintf(error, FROM_HERE, errors::json::kParseError,
                        "Error '%s' occurred parsing JSON string '%s'",
-                       error_message.c_str(), json.c_str());
+                       parse_error->GetMessage().c_str(), json.c_str());
     return std::unique_ptr<base::DictionaryValue>();
   }
   auto dict_value = base::DictionaryValue::From(std::move(value));
@@ -219,6 +250,23 @@ std::unique_ptr<base::DictionaryValue> ParseJsonResponse(
   return dict_value;
 }
 
+// Same as ParseJsonResponse(), but reports the response to |handler|.
+bool ReadJsonResponse(const HttpClient::Response& response,
+                      JsonHandler* handler,
+                      ErrorPtr* error) {
+  if (!IsJsonResponse(response, error))
+    return false;
+
+  const std::string& json = response.GetData();
+  ErrorPtr parse_error;
+  if (!ReadJsonEvents(json, handler, &parse_error)) {
+    return Error::AddToPrintf(error, FROM_HERE, errors::json::kParseError,
+                              "Error '%s' occurred parsing JSON string '%s'",
+                              parse_error->GetMessage().c_str(), json.c_str());
+  }
+  return true;
+}
+
 bool IsSuccessful(const HttpClient::Response& response) {
   int code = response.GetStatusCode();
   return code >= http::kContinue && code < http::kBadRequest;
@@ -237,6 +285,11 @@ DeviceRegistrationInfo::DeviceRegistrationInfo(
       task_runner_{task_runner},
       config_{config},
       component_manager_{component_manager},
+      cloud_request_scheduler_{kMaxCloudRequestsInFlight},
+      state_publish_timer_{
+          task_runner,
+          base::Bind(&DeviceRegistrationInfo::PublishStateUpdates,
+                     base::Unretained(this))},
       network_{network},
       auth_manager_{auth_manager} {
   cloud_backoff_policy_.reset(new BackoffEntry::Policy{});
@@ -249,6 +302,10 @@ DeviceRegistrationInfo::DeviceRegistrationInfo(
   cloud_backoff_policy_->always_use_initial_delay = false;
   cloud_backoff_entry_.reset(new BackoffEntry{cloud_backoff_policy_.get()});
   oauth2_backoff_entry_.reset(new BackoffEntry{cloud_backoff_policy_.get()});
+  command_update_batcher_.reset(new CommandUpdateBatcher{
+      task_runner_, kMaxCommandUpdatesPerRequest,
+      base::Bind(&DeviceRegistrationInfo::SendCommandUpdates, AsWeakPtr()),
+      base::Bind(&DeviceRegistrationInfo::FlushStateUpdates, AsWeakPtr())});
 
   bool revoked =
       !GetSettings().cloud_id.empty() && !HaveRegistrationCredentials();
@@ -511,7 +568,8 @@ void DeviceRegistrationInfo::GetDeviceInfo(
   ErrorPtr error;
   if (!VerifyRegistrationCredentials(&error))
     return callback.Run({}, std::move(error));
-  DoCloudRequest(HttpClient::Method::kGet, GetDeviceUrl(), nullptr, callback);
+  DoCloudRequest(CloudRequestScheduler::Priority::kDeviceResource,
+                 HttpClient::Method::kGet, GetDeviceUrl(), nullptr, callback);
 }
 
 void DeviceRegistrationInfo::RegisterDeviceError(const DoneCallback& callback,
@@ -706,20 +764,68 @@ void DeviceRegistrationInfo::RegisterDeviceOnAuthCodeSent(
 }
 
 void DeviceRegistrationInfo::DoCloudRequest(
+    CloudRequestScheduler::Priority priority,
     HttpClient::Method method,
     const std::string& url,
     const base::DictionaryValue* body,
     const CloudRequestDoneCallback& callback) {
+  DoCloudRequest(priority, method, url, body, nullptr, callback);
+}
+
+void DeviceRegistrationInfo::DoCloudRequest(
+    CloudRequestScheduler::Priority priority,
+    HttpClient::Method method,
+    const std::string& url,
+    const base::DictionaryValue* body,
+    const std::shared_ptr<JsonHandler>& response_handler,
+    const CloudRequestDoneCallback& callback) {
+  cloud_request_scheduler_.Schedule(
+      priority, {},
+      base::Bind(&DeviceRegistrationInfo::StartCloudRequest, AsWeakPtr(),
+                 CreateCloudRequestData(priority, method, url, body,
+                                        response_handler, callback)));
+}
+
+void DeviceRegistrationInfo::SendScheduledCloudRequest(
+    CloudRequestScheduler::Priority priority,
+    HttpClient::Method method,
+    const std::string& url,
+    const base::DictionaryValue* body,
+    const std::shared_ptr<JsonHandler>& response_handler,
+    const CloudRequestDoneCallback& callback) {
+  SendCloudRequest(CreateCloudRequestData(priority, method, url, body,
+                                          response_handler, callback));
+}
+
+std::shared_ptr<DeviceRegistrationInfo::CloudRequestData>
+DeviceRegistrationInfo::CreateCloudRequestData(
+    CloudRequestScheduler::Priority priority,
+    HttpClient::Method method,
+    const std::string& url,
+    const base::DictionaryValue* body,
+    const std::shared_ptr<JsonHandler>& response_handler,
+    const CloudRequestDoneCallback& callback) {
   // We make CloudRequestData shared here because we want to make sure
   // there is only one instance of callback and error_calback since
   // those may have move-only types and making a copy of the callback with
   // move-only types curried-in will invalidate the source callback.
   auto data = std::make_shared<CloudRequestData>();
+  data->priority = priority;
   data->method = method;
   data->url = url;
-  if (body)
-    base::JSONWriter::Write(*body, &data->body);
+  if (body) {
+    JsonWriter writer{false, &data->body};
+    writer.Value(*body);
+  }
+  data->response_handler = response_handler;
   data->callback = callback;
+  return data;
+}
+
+void DeviceRegistrationInfo::StartCloudRequest(
+    const std::shared_ptr<CloudRequestData>& data,
+    const base::Closure& done) {
+  data->callback = base::Bind(&RunCloudRequestCallback, done, data->callback);
   SendCloudRequest(data);
 }
 
@@ -737,19 +843,28 @@ void DeviceRegistrationInfo::SendCloudRequest(
     VLOG(1) << "Cloud request delayed for "
             << cloud_backoff_entry_->GetTimeUntilRelease()
             << " due to backoff policy";
+    // Other requests may run meanwhile, the retry queues up again afterwards.
+    cloud_request_scheduler_.Suspend();
     return task_runner_->PostDelayedTask(
-        FROM_HERE, base::Bind(&DeviceRegistrationInfo::SendCloudRequest,
+        FROM_HERE, base::Bind(&DeviceRegistrationInfo::ResumeCloudRequest,
                               AsWeakPtr(), data),
         cloud_backoff_entry_->GetTimeUntilRelease());
   }
 
   RequestSender sender{data->method, data->url, http_client_};
-  sender.SetData(data->body, http::kJsonUtf8);
+  sender.SetChunks(data->body, http::kJsonUtf8);
   sender.SetAccessToken(access_token_);
   sender.Send(base::Bind(&DeviceRegistrationInfo::OnCloudRequestDone,
                          AsWeakPtr(), data));
 }
 
+void DeviceRegistrationInfo::ResumeCloudRequest(
+    const std::shared_ptr<const CloudRequestData>& data) {
+  cloud_request_scheduler_.Resume(
+      data->priority, base::Bind(&DeviceRegistrationInfo::SendCloudRequest,
+                                 AsWeakPtr(), data));
+}
+
 void DeviceRegistrationInfo::OnCloudRequestDone(
     const std::shared_ptr<const CloudRequestData>& data,
     std::unique_ptr<provider::HttpClient::Response> response,
@@ -779,6 +894,17 @@ void DeviceRegistrationInfo::OnCloudRequestDone(
     return data->callback.Run({}, nullptr);
   }
 
+  if (data->response_handler && IsSuccessful(*response)) {
+    if (!ReadJsonResponse(*response, data->response_handler.get(), &error)) {
+      cloud_backoff_entry_->InformOfRequest(false);
+      return data->callback.Run({}, std::move(error));
+    }
+    cloud_backoff_entry_->InformOfRequest(true);
+    SetGcdState(GcdState::kConnected);
+    return data->callback.Run({}, nullptr);
+  }
+
+  // Error responses are always parsed in full for ParseGCDError().
   auto json_resp = ParseJsonResponse(*response, &error);
   if (!json_resp) {
     cloud_backoff_entry_->InformOfRequest(false);
@@ -856,9 +982,13 @@ void DeviceRegistrationInfo::OnConnectedToCloud(ErrorPtr error) {
     return;
   LOG(INFO) << "Device connected to cloud server";
   connected_to_cloud_ = true;
-  FetchCommands(base::Bind(&DeviceRegistrationInfo::ProcessInitialCommandList,
-                           AsWeakPtr()),
-                fetch_reason::kDeviceStart);
+  // Not coalesced with the other fetches, as it is processed differently.
+  cloud_request_scheduler_.Schedule(
+      CloudRequestScheduler::Priority::kCommand, {},
+      base::Bind(&DeviceRegistrationInfo::FetchCommands, AsWeakPtr(),
+                 base::Bind(&DeviceRegistrationInfo::ProcessInitialCommandList,
+                            AsWeakPtr()),
+                 fetch_reason::kDeviceStart));
   // In case there are any pending state updates since we sent off the initial
   // UpdateDeviceResource() request, update the server with any state changes.
   PublishStateUpdates();
@@ -886,11 +1016,21 @@ void DeviceRegistrationInfo::UpdateCommand(
     const std::string& command_id,
     const base::DictionaryValue& command_patch,
     const DoneCallback& callback) {
-  DoCloudRequest(HttpClient::Method::kPatch,
+  DoCloudRequest(CloudRequestScheduler::Priority::kCommand,
+                 HttpClient::Method::kPatch,
                  GetServiceUrl("commands/" + command_id), &command_patch,
                  base::Bind(&IgnoreCloudResultWithCallback, callback));
 }
 
+void DeviceRegistrationInfo::SendCommandUpdates(
+    const base::DictionaryValue& body,
+    const DoneCallback& callback) {
+  DoCloudRequest(CloudRequestScheduler::Priority::kCommand,
+                 HttpClient::Method::kPost,
+                 GetServiceUrl("commands/batchUpdate"), &body,
+                 base::Bind(&IgnoreCloudResultWithCallback, callback));
+}
+
 void DeviceRegistrationInfo::NotifyCommandAborted(const std::string& command_id,
                                                   ErrorPtr error) {
   base::DictionaryValue command_patch;
@@ -906,18 +1046,19 @@ void DeviceRegistrationInfo::NotifyCommandAborted(const std::string& command_id,
 void DeviceRegistrationInfo::UpdateDeviceResource(
     const DoneCallback& callback) {
   queued_resource_update_callbacks_.emplace_back(callback);
-  if (!in_progress_resource_update_callbacks_.empty()) {
-    VLOG(1) << "Another request is already pending.";
-    return;
-  }
-
-  StartQueuedUpdateDeviceResource();
+  // If an update is queued already, it takes |callback| along.
+  cloud_request_scheduler_.Schedule(
+      CloudRequestScheduler::Priority::kDeviceResource,
+      kDeviceResourceRequestKey,
+      base::Bind(&DeviceRegistrationInfo::StartQueuedUpdateDeviceResource,
+                 AsWeakPtr()));
 }
 
-void DeviceRegistrationInfo::StartQueuedUpdateDeviceResource() {
+void DeviceRegistrationInfo::StartQueuedUpdateDeviceResource(
+    const base::Closure& done) {
   if (in_progress_resource_update_callbacks_.empty() &&
       queued_resource_update_callbacks_.empty())
-    return;
+    return done.Run();
 
   if (last_device_resource_updated_timestamp_.empty()) {
     // We don't know the current time stamp of the device resource from the
@@ -925,8 +1066,11 @@ void DeviceRegistrationInfo::StartQueuedUpdateDeviceResource() {
     // the request to guard against out-of-order requests overwriting settings
     // specified by later requests.
     VLOG(1) << "Getting the last device resource timestamp from server...";
-    GetDeviceInfo(base::Bind(&DeviceRegistrationInfo::OnDeviceInfoRetrieved,
-                             AsWeakPtr()));
+    SendScheduledCloudRequest(
+        CloudRequestScheduler::Priority::kDeviceResource,
+        HttpClient::Method::kGet, GetDeviceUrl(), nullptr, {},
+        base::Bind(&DeviceRegistrationInfo::OnDeviceInfoRetrieved, AsWeakPtr(),
+                   done));
     return;
   }
 
@@ -944,9 +1088,11 @@ void DeviceRegistrationInfo::StartQueuedUpdateDeviceResource() {
   std::string url = GetDeviceUrl(
       {}, {{"lastUpdateTimeMs", last_device_resource_updated_timestamp_}});
 
-  DoCloudRequest(HttpClient::Method::kPut, url, device_resource.get(),
-                 base::Bind(&DeviceRegistrationInfo::OnUpdateDeviceResourceDone,
-                            AsWeakPtr()));
+  SendScheduledCloudRequest(
+      CloudRequestScheduler::Priority::kDeviceResource,
+      HttpClient::Method::kPut, url, device_resource.get(), {},
+      base::Bind(&DeviceRegistrationInfo::OnUpdateDeviceResourceDone,
+                 AsWeakPtr(), done));
 }
 
 void DeviceRegistrationInfo::SendAuthInfo() {
@@ -973,7 +1119,8 @@ void DeviceRegistrationInfo::SendAuthInfo() {
   root->Set("localAuthInfo", std::move(auth));
 
   std::string url = GetDeviceUrl("upsertLocalAuthInfo", {});
-  DoCloudRequest(HttpClient::Method::kPost, url, root.get(),
+  DoCloudRequest(CloudRequestScheduler::Priority::kDeviceResource,
+                 HttpClient::Method::kPost, url, root.get(),
                  base::Bind(&DeviceRegistrationInfo::OnSendAuthInfoDone,
                             AsWeakPtr(), token));
 }
@@ -994,12 +1141,14 @@ void DeviceRegistrationInfo::OnSendAuthInfoDone(
 }
 
 void DeviceRegistrationInfo::OnDeviceInfoRetrieved(
+    const base::Closure& done,
     const base::DictionaryValue& device_info,
     ErrorPtr error) {
   if (error)
-    return OnUpdateDeviceResourceError(std::move(error));
-  if (UpdateDeviceInfoTimestamp(device_info))
-    StartQueuedUpdateDeviceResource();
+    return OnUpdateDeviceResourceError(done, std::move(error));
+  if (!UpdateDeviceInfoTimestamp(device_info))
+    return done.Run();
+  StartQueuedUpdateDeviceResource(done);
 }
 
 bool DeviceRegistrationInfo::UpdateDeviceInfoTimestamp(
@@ -1017,10 +1166,11 @@ bool DeviceRegistrationInfo::UpdateDeviceInfoTimestamp(
 }
 
 void DeviceRegistrationInfo::OnUpdateDeviceResourceDone(
+    const base::Closure& done,
     const base::DictionaryValue& device_info,
     ErrorPtr error) {
   if (error)
-    return OnUpdateDeviceResourceError(std::move(error));
+    return OnUpdateDeviceResourceError(done, std::move(error));
   UpdateDeviceInfoTimestamp(device_info);
 
   if (auth_manager_) {
@@ -1040,16 +1190,21 @@ void DeviceRegistrationInfo::OnUpdateDeviceResourceDone(
   auto callback_list = std::move(in_progress_resource_update_callbacks_);
   for (const auto& callback : callback_list)
     callback.Run(nullptr);
-  StartQueuedUpdateDeviceResource();
+  done.Run();
 }
 
-void DeviceRegistrationInfo::OnUpdateDeviceResourceError(ErrorPtr error) {
+void DeviceRegistrationInfo::OnUpdateDeviceResourceError(
+    const base::Closure& done,
+    ErrorPtr error) {
   if (error->HasError("invalid_last_update_time_ms")) {
     // If the server rejected our previous request, retrieve the latest
     // timestamp from the server and retry.
     VLOG(1) << "Getting the last device resource timestamp from server...";
-    GetDeviceInfo(base::Bind(&DeviceRegistrationInfo::OnDeviceInfoRetrieved,
-                             AsWeakPtr()));
+    SendScheduledCloudRequest(
+        CloudRequestScheduler::Priority::kDeviceResource,
+        HttpClient::Method::kGet, GetDeviceUrl(), nullptr, {},
+        base::Bind(&DeviceRegistrationInfo::OnDeviceInfoRetrieved, AsWeakPtr(),
+                   done));
     return;
   }
 
@@ -1059,15 +1214,13 @@ void DeviceRegistrationInfo::OnUpdateDeviceResourceError(ErrorPtr error) {
   auto callback_list = std::move(in_progress_resource_update_callbacks_);
   for (const auto& callback : callback_list)
     callback.Run(error->Clone());
-
-  StartQueuedUpdateDeviceResource();
+  done.Run();
 }
 
 void DeviceRegistrationInfo::OnFetchCommandsDone(
     const base::Callback<void(const base::ListValue&, ErrorPtr)>& callback,
     const base::DictionaryValue& json,
     ErrorPtr error) {
-  OnFetchCommandsReturned();
   if (error)
     return callback.Run({}, std::move(error));
   const base::ListValue* commands{nullptr};
@@ -1077,37 +1230,59 @@ void DeviceRegistrationInfo::OnFetchCommandsDone(
   callback.Run(commands ? *commands : empty, nullptr);
 }
 
-void DeviceRegistrationInfo::OnFetchCommandsReturned() {
-  fetch_commands_request_sent_ = false;
-  // If we have additional requests queued, send them out now.
-  if (fetch_commands_request_queued_)
-    FetchAndPublishCommands(queued_fetch_reason_);
-}
-
 void DeviceRegistrationInfo::FetchCommands(
     const base::Callback<void(const base::ListValue&, ErrorPtr)>& callback,
-    const std::string& reason) {
-  fetch_commands_request_sent_ = true;
-  fetch_commands_request_queued_ = false;
-  DoCloudRequest(
-      HttpClient::Method::kGet,
-      GetServiceUrl("commands/queue",
-                    {{"deviceId", GetSettings().cloud_id}, {"reason", reason}}),
-      nullptr, base::Bind(&DeviceRegistrationInfo::OnFetchCommandsDone,
-                          AsWeakPtr(), callback));
+    const std::string& reason,
+    const base::Closure& done) {
+  SendScheduledCloudRequest(
+      CloudRequestScheduler::Priority::kCommand, HttpClient::Method::kGet,
+      GetCommandQueueUrl(reason), nullptr, nullptr,
+      base::Bind(&RunCloudRequestCallback, done,
+                 base::Bind(&DeviceRegistrationInfo::OnFetchCommandsDone,
+                            AsWeakPtr(), callback)));
+}
+
+void DeviceRegistrationInfo::FetchNewCommands(const std::string& reason,
+                                              const base::Closure& done) {
+  // The commands are built while the response is parsed. Cloud commands carry
+  // many fields which are not needed to create a CommandInstance. They are
+  // skipped instead of being built from the response.
+  std::shared_ptr<CommandInstance::ListReader> reader{
+      new CommandInstance::ListReader{"commands", Command::Origin::kCloud}};
+  SendScheduledCloudRequest(
+      CloudRequestScheduler::Priority::kCommand, HttpClient::Method::kGet,
+      GetCommandQueueUrl(reason), nullptr, reader,
+      base::Bind(&RunCloudRequestCallback, done,
+                 base::Bind(&DeviceRegistrationInfo::OnFetchNewCommandsDone,
+                            AsWeakPtr(), reader)));
+}
+
+void DeviceRegistrationInfo::OnFetchNewCommandsDone(
+    const std::shared_ptr<CommandInstance::ListReader>& reader,
+    const base::DictionaryValue& /* json */,
+    ErrorPtr error) {
+  if (error)
+    return;
+  for (auto& entry : reader->entries()) {
+    PublishCommandInstance(std::move(entry.command), entry.id,
+                           std::move(entry.error));
+  }
+}
+
+std::string DeviceRegistrationInfo::GetCommandQueueUrl(
+    const std::string& reason) const {
+  return GetServiceUrl(
+      "commands/queue",
+      {{"deviceId", GetSettings().cloud_id}, {"reason", reason}});
 }
 
 void DeviceRegistrationInfo::FetchAndPublishCommands(
     const std::string& reason) {
-  if (fetch_commands_request_sent_) {
-    fetch_commands_request_queued_ = true;
-    queued_fetch_reason_ = reason;
-    return;
-  }
-
-  FetchCommands(base::Bind(&DeviceRegistrationInfo::PublishCommands,
-                           weak_factory_.GetWeakPtr()),
-                reason);
+  // A fetch queued already publishes the commands queued by now as well.
+  cloud_request_scheduler_.Schedule(
+      CloudRequestScheduler::Priority::kCommand, kFetchCommandsRequestKey,
+      base::Bind(&DeviceRegistrationInfo::FetchNewCommands, AsWeakPtr(),
+                 reason));
 }
 
 void DeviceRegistrationInfo::ProcessInitialCommandList(
@@ -1138,7 +1313,8 @@ void DeviceRegistrationInfo::ProcessInitialCommandList(
       auto cmd_copy = command_dict->CreateDeepCopy();
       cmd_copy->SetString("state", "aborted");
       // TODO(wiley) We could consider handling this error case more gracefully.
-      DoCloudRequest(HttpClient::Method::kPut,
+      DoCloudRequest(CloudRequestScheduler::Priority::kCommand,
+                     HttpClient::Method::kPut,
                      GetServiceUrl("commands/" + command_id), cmd_copy.get(),
                      base::Bind(&IgnoreCloudResult));
     } else {
@@ -1148,28 +1324,28 @@ void DeviceRegistrationInfo::ProcessInitialCommandList(
   }
 }
 
-void DeviceRegistrationInfo::PublishCommands(const base::ListValue& commands,
-                                             ErrorPtr error) {
-  if (error)
-    return;
-  for (const auto& command : commands) {
-    const base::DictionaryValue* command_dict{nullptr};
-    if (!command->GetAsDictionary(&command_dict)) {
-      LOG(WARNING) << "Not a command dictionary: " << *command;
-      continue;
-    }
-    PublishCommand(*command_dict);
-  }
-}
-
 void DeviceRegistrationInfo::PublishCommand(
     const base::DictionaryValue& command) {
   std::string command_id;
   ErrorPtr error;
-  auto command_instance = component_manager_->ParseCommandInstance(
-      command, Command::Origin::kCloud, UserRole::kOwner, &command_id, &error);
+  auto command_instance = CommandInstance::FromJson(
+      &command, Command::Origin::kCloud, &command_id, &error);
+  PublishCommandInstance(std::move(command_instance), command_id,
+                         std::move(error));
+}
+
+void DeviceRegistrationInfo::PublishCommandInstance(
+    std::unique_ptr<CommandInstance> command_instance,
+    const std::string& command_id,
+    ErrorPtr error) {
+  if (command_instance &&
+      !component_manager_->ValidateCommandInstance(
+          command_instance.get(), UserRole::kOwner, &error)) {
+    command_instance.reset();
+  }
   if (!command_instance) {
-    LOG(WARNING) << "Failed to parse a command instance: " << command;
+    LOG(WARNING) << "Failed to parse a command instance, ID: '" << command_id
+                 << "'";
     if (!command_id.empty())
       NotifyCommandAborted(command_id, std::move(error));
     return;
@@ -1181,9 +1357,13 @@ void DeviceRegistrationInfo::PublishCommand(
               << "' arrived, ID: " << command_instance->GetID();
     std::unique_ptr<BackoffEntry> backoff_entry{
         new BackoffEntry{cloud_backoff_policy_.get()}};
+    CloudCommandUpdateInterface* updater = this;
+    if (GetSettings().batch_command_updates)
+      updater = command_update_batcher_.get();
     std::unique_ptr<CloudCommandProxy> cloud_proxy{
-        new CloudCommandProxy{command_instance.get(), this, component_manager_,
-                              std::move(backoff_entry), task_runner_}};
+        new CloudCommandProxy{command_instance.get(), updater,
+                              component_manager_, std::move(backoff_entry),
+                              task_runner_}};
     // CloudCommandProxy::CloudCommandProxy() subscribe itself to Command
     // notifications. When Command is being destroyed it sends
     // ::OnCommandDestroyed() and CloudCommandProxy deletes itself.
@@ -1192,17 +1372,59 @@ void DeviceRegistrationInfo::PublishCommand(
   }
 }
 
-void DeviceRegistrationInfo::PublishStateUpdates() {
-  // If we have pending state update requests, don't send any more for now.
-  if (device_state_update_pending_)
+void DeviceRegistrationInfo::ScheduleStatePublish() {
+  const Config::Settings& settings = GetSettings();
+  if (settings.state_publish_window <= base::TimeDelta{})
+    return PublishStateUpdates();
+  state_publish_timer_.Schedule(settings.state_publish_window,
+                                settings.state_publish_max_delay);
+}
+
+void DeviceRegistrationInfo::FlushStateUpdates() {
+  if (!HaveRegistrationCredentials() || !connected_to_cloud_)
     return;
+  // Publish the changes recorded so far now, and drop the pending timers.
+  state_publish_timer_.RunNow();
+}
+
+void DeviceRegistrationInfo::PublishStateUpdates() {
+  // Only one state patch request is in flight at a time.
+  cloud_request_scheduler_.Schedule(
+      CloudRequestScheduler::Priority::kState, kPatchStateRequestKey,
+      base::Bind(&DeviceRegistrationInfo::SendStateUpdates, AsWeakPtr()));
+}
 
+void DeviceRegistrationInfo::SendStateUpdates(const base::Closure& done) {
+  // Merge the recorded changes into the unpublished ones, so that each
+  // component gets at most one patch.
   auto snapshot = component_manager_->GetAndClearRecordedStateChanges();
-  if (snapshot.state_changes.empty())
-    return;
+  if (!snapshot.state_changes.empty()) {
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < unpublished_state_changes_.size(); ++i)
+      index.emplace(unpublished_state_changes_[i].component, i);
+    for (auto& state_change : snapshot.state_changes) {
+      auto it = index.find(state_change.component);
+      if (it == index.end()) {
+        index.emplace(state_change.component,
+                      unpublished_state_changes_.size());
+        unpublished_state_changes_.push_back(std::move(state_change));
+        continue;
+      }
+      auto& target = unpublished_state_changes_[it->second];
+      target.timestamp = state_change.timestamp;
+      target.changed_properties->MergeDictionary(
+          state_change.changed_properties.get());
+    }
+    unpublished_state_update_id_ = snapshot.update_id;
+  }
+  if (unpublished_state_changes_.empty())
+    return done.Run();
 
+  size_t batch_size = std::min(unpublished_state_changes_.size(),
+                               GetSettings().state_publish_max_batch_size);
   std::unique_ptr<base::ListValue> patches{new base::ListValue};
-  for (auto& state_change : snapshot.state_changes) {
+  for (size_t i = 0; i < batch_size; ++i) {
+    auto& state_change = unpublished_state_changes_[i];
     std::unique_ptr<base::DictionaryValue> patch{new base::DictionaryValue};
     patch->SetString("timeMs",
                      std::to_string(state_change.timestamp.ToJavaTime()));
@@ -1210,31 +1432,43 @@ void DeviceRegistrationInfo::PublishStateUpdates() {
     patch->Set("patch", std::move(state_change.changed_properties));
     patches->Append(std::move(patch));
   }
+  unpublished_state_changes_.erase(
+      unpublished_state_changes_.begin(),
+      unpublished_state_changes_.begin() + batch_size);
 
   base::DictionaryValue body;
   body.SetString("requestTimeMs",
                  std::to_string(base::Time::Now().ToJavaTime()));
   body.Set("patches", std::move(patches));
 
-  device_state_update_pending_ = true;
-  DoCloudRequest(HttpClient::Method::kPost, GetDeviceUrl("patchState"), &body,
+  SendScheduledCloudRequest(
+      CloudRequestScheduler::Priority::kState,
+      HttpClient::Method::kPost, GetDeviceUrl("patchState"), &body, {},
+      base::Bind(&RunCloudRequestCallback, done,
                  base::Bind(&DeviceRegistrationInfo::OnPublishStateDone,
-                            AsWeakPtr(), snapshot.update_id));
+                            AsWeakPtr(), unpublished_state_update_id_)));
 }
 
 void DeviceRegistrationInfo::OnPublishStateDone(
     ComponentManager::UpdateID update_id,
     const base::DictionaryValue& reply,
     ErrorPtr error) {
-  device_state_update_pending_ = false;
   if (error) {
     LOG(ERROR) << "Permanent failure while trying to update device state";
-    return;
+    // Transient errors are retried already, so the patches of this batch are
+    // not sent again. The device resource carries the whole state instead.
+    UpdateDeviceResource(base::Bind(&IgnoreCloudError));
+  } else if (unpublished_state_changes_.empty()) {
+    // The update is complete once the remaining batches are sent as well.
+    component_manager_->NotifyStateUpdatedOnServer(update_id);
+  }
+  // Send the remaining batches right away. Changes recorded since the
+  // previous request had been sent out wait for their coalescing window,
+  // unless it is already over.
+  if (!unpublished_state_changes_.empty() ||
+      !state_publish_timer_.is_scheduled()) {
+    PublishStateUpdates();
   }
-  component_manager_->NotifyStateUpdatedOnServer(update_id);
-  // See if there were more pending state updates since the previous request
-  // had been sent out.
-  PublishStateUpdates();
 }
 
 void DeviceRegistrationInfo::SetGcdState(GcdState new_state) {
@@ -1259,7 +1493,7 @@ void DeviceRegistrationInfo::OnStateChanged() {
     return;
 
   // TODO(vitalybuka): Integrate BackoffEntry.
-  PublishStateUpdates();
+  ScheduleStatePublish();
 }
 
 void DeviceRegistrationInfo::OnComponentTreeChanged() {
@@ -1281,8 +1515,10 @@ void DeviceRegistrationInfo::OnConnected(const std::string& channel_name) {
   // If we have not successfully connected to the cloud server and we have not
   // initiated the first device resource update, there is nothing we need to
   // do now to update the server of the notification channel change.
-  if (!connected_to_cloud_ && in_progress_resource_update_callbacks_.empty())
+  if (!connected_to_cloud_ && in_progress_resource_update_callbacks_.empty() &&
+      queued_resource_update_callbacks_.empty()) {
     return;
+  }
 
   // Once we update the device resource with the new notification channel,
   // do the last poll for commands from the server, to make sure we have the
@@ -1320,7 +1556,15 @@ void DeviceRegistrationInfo::OnCommandCreated(
 
   VLOG(1) << "Command notification received: " << command;
 
-  // Manually fetch the command queue whenever a new command is received.
+  if (!command.empty()) {
+    // Push notifications carry the command, so there is no need to wait for
+    // the command queue round trip.
+    PublishCommand(command);
+    return;
+  }
+
+  // The command was too big to be delivered over the notification channel,
+  // or the notification came from the pull channel. Fetch the command queue.
   FetchAndPublishCommands(fetch_reason::kNewCommand);
 }
 
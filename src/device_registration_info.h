@@ -20,10 +20,16 @@
 #include <weave/provider/http_client.h>
 
 #include "src/backoff_entry.h"
+#include "src/cloud_request_scheduler.h"
 #include "src/commands/cloud_command_update_interface.h"
+#include "src/commands/command_instance.h"
+#include "src/commands/command_update_batcher.h"
 #include "src/component_manager.h"
 #include "src/config.h"
 #include "src/data_encoding.h"
+#include "src/debounced_closure.h"
+#include "src/json_reader.h"
+#include "src/json_writer.h"
 #include "src/notification/notification_channel.h"
 #include "src/notification/notification_delegate.h"
 #include "src/notification/pull_channel.h"
@@ -107,6 +113,9 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   void UpdateCommand(const std::string& command_id,
                      const base::DictionaryValue& command_patch,
                      const DoneCallback& callback) override;
+  // Publishes the state changes without waiting for the coalescing window
+  // (override from CloudCommandUpdateInterface).
+  void FlushStateUpdates() override;
 
   // TODO(vitalybuka): remove getters and pass config to dependent code.
   const Config::Settings& GetSettings() const { return config_->GetSettings(); }
@@ -114,6 +123,11 @@ class DeviceRegistrationInfo : public NotificationDelegate,
 
   GcdState GetGcdState() const { return gcd_state_; }
 
+  // Queue depth and latency of the cloud requests.
+  const CloudRequestScheduler& GetCloudRequestScheduler() const {
+    return cloud_request_scheduler_;
+  }
+
   // Checks whether we have credentials generated during registration.
   bool HaveRegistrationCredentials() const;
 
@@ -167,21 +181,55 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   // Do a HTTPS request to cloud services.
   // Handles many cases like reauthorization, 5xx HTTP response codes
   // and device removal.  It is a recommended way to do cloud API
-  // requests.
+  // requests. The request waits in |cloud_request_scheduler_| until it may
+  // start.
   // TODO(antonm): Consider moving into some other class.
-  void DoCloudRequest(provider::HttpClient::Method method,
+  void DoCloudRequest(CloudRequestScheduler::Priority priority,
+                      provider::HttpClient::Method method,
+                      const std::string& url,
+                      const base::DictionaryValue* body,
+                      const CloudRequestDoneCallback& callback);
+  // Same as above, but a successful response is reported to
+  // |response_handler| while it is parsed (see ReadJsonEvents()), and
+  // |callback| gets an empty dictionary. Error responses are still parsed in
+  // full.
+  void DoCloudRequest(CloudRequestScheduler::Priority priority,
+                      provider::HttpClient::Method method,
                       const std::string& url,
                       const base::DictionaryValue* body,
+                      const std::shared_ptr<JsonHandler>& response_handler,
                       const CloudRequestDoneCallback& callback);
+  // Same as above, but sends the request right away. Used by requests which
+  // have been started by |cloud_request_scheduler_| with |priority| already.
+  void SendScheduledCloudRequest(
+      CloudRequestScheduler::Priority priority,
+      provider::HttpClient::Method method,
+      const std::string& url,
+      const base::DictionaryValue* body,
+      const std::shared_ptr<JsonHandler>& response_handler,
+      const CloudRequestDoneCallback& callback);
 
   // Helper for DoCloudRequest().
   struct CloudRequestData {
+    CloudRequestScheduler::Priority priority;
     provider::HttpClient::Method method;
     std::string url;
-    std::string body;
+    JsonWriter::Chunks body;
+    std::shared_ptr<JsonHandler> response_handler;
     CloudRequestDoneCallback callback;
   };
+  std::shared_ptr<CloudRequestData> CreateCloudRequestData(
+      CloudRequestScheduler::Priority priority,
+      provider::HttpClient::Method method,
+      const std::string& url,
+      const base::DictionaryValue* body,
+      const std::shared_ptr<JsonHandler>& response_handler,
+      const CloudRequestDoneCallback& callback);
+  void StartCloudRequest(const std::shared_ptr<CloudRequestData>& data,
+                         const base::Closure& done);
   void SendCloudRequest(const std::shared_ptr<const CloudRequestData>& data);
+  // Continues a request suspended in |cloud_request_scheduler_| for backoff.
+  void ResumeCloudRequest(const std::shared_ptr<const CloudRequestData>& data);
   void OnCloudRequestDone(
       const std::shared_ptr<const CloudRequestData>& data,
       std::unique_ptr<provider::HttpClient::Response> response,
@@ -192,11 +240,14 @@ class DeviceRegistrationInfo : public NotificationDelegate,
       ErrorPtr error);
   void CheckAccessTokenError(ErrorPtr error);
 
+  // Device resource updates run one at a time. |done| completes the
+  // scheduled request of an update, including its retries.
   void UpdateDeviceResource(const DoneCallback& callback);
-  void StartQueuedUpdateDeviceResource();
-  void OnUpdateDeviceResourceDone(const base::DictionaryValue& device_info,
+  void StartQueuedUpdateDeviceResource(const base::Closure& done);
+  void OnUpdateDeviceResourceDone(const base::Closure& done,
+                                  const base::DictionaryValue& device_info,
                                   ErrorPtr error);
-  void OnUpdateDeviceResourceError(ErrorPtr error);
+  void OnUpdateDeviceResourceError(const base::Closure& done, ErrorPtr error);
 
   void SendAuthInfo();
   void OnSendAuthInfoDone(const std::vector<uint8_t>& token,
@@ -205,7 +256,8 @@ class DeviceRegistrationInfo : public NotificationDelegate,
 
   // Callback from GetDeviceInfo() to retrieve the device resource timestamp
   // and retry UpdateDeviceResource() call.
-  void OnDeviceInfoRetrieved(const base::DictionaryValue& device_info,
+  void OnDeviceInfoRetrieved(const base::Closure& done,
+                             const base::DictionaryValue& device_info,
                              ErrorPtr error);
 
   // Extracts the timestamp from the device resource and sets it to
@@ -214,16 +266,26 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   // resource or it is invalid.
   bool UpdateDeviceInfoTimestamp(const base::DictionaryValue& device_info);
 
+  // Fetches the command queue, as a request started by
+  // |cloud_request_scheduler_|.
   void FetchCommands(
       const base::Callback<void(const base::ListValue&, ErrorPtr)>& callback,
-      const std::string& reason);
+      const std::string& reason,
+      const base::Closure& done);
   void OnFetchCommandsDone(
       const base::Callback<void(const base::ListValue&, ErrorPtr)>& callback,
       const base::DictionaryValue& json,
       ErrorPtr);
-  // Called when FetchCommands completes (with either success or error).
-  // This method reschedules any pending/queued fetch requests.
-  void OnFetchCommandsReturned();
+
+  // Same as FetchCommands(), but builds the commands as the response is
+  // parsed and publishes them with PublishCommandInstance().
+  void FetchNewCommands(const std::string& reason, const base::Closure& done);
+  void OnFetchNewCommandsDone(
+      const std::shared_ptr<CommandInstance::ListReader>& reader,
+      const base::DictionaryValue& json,
+      ErrorPtr error);
+
+  std::string GetCommandQueueUrl(const std::string& reason) const;
 
   // Processes the command list that is fetched from the server on connection.
   // Aborts commands which are in transitional states and publishes queued
@@ -231,16 +293,25 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   void ProcessInitialCommandList(const base::ListValue& commands,
                                  ErrorPtr error);
 
-  void PublishCommands(const base::ListValue& commands, ErrorPtr error);
   void PublishCommand(const base::DictionaryValue& command);
+  // Validates |command_instance| and makes it available to local clients.
+  // If it is null, or not valid, aborts the cloud command |command_id| with
+  // |error|.
+  void PublishCommandInstance(std::unique_ptr<CommandInstance> command_instance,
+                              const std::string& command_id,
+                              ErrorPtr error);
 
   // Helper function to pull the pending command list from the server using
-  // FetchCommands() and make them available on D-Bus with PublishCommands().
-  // |backup_fetch| is set to true when performing backup ("just-in-case")
-  // command fetch while XMPP channel is up and running.
+  // FetchNewCommands() and make them available to local clients.
   void FetchAndPublishCommands(const std::string& reason);
 
+  // Publishes the state changes after the coalescing window configured in
+  // the settings.
+  void ScheduleStatePublish();
+  // Schedules a state patch request. The request sends the changes recorded
+  // by the time it starts.
   void PublishStateUpdates();
+  void SendStateUpdates(const base::Closure& done);
   void OnPublishStateDone(ComponentManager::UpdateID update_id,
                           const base::DictionaryValue& reply,
                           ErrorPtr error);
@@ -250,6 +321,10 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   // notify the server that the command is aborted by the device.
   void NotifyCommandAborted(const std::string& command_id, ErrorPtr error);
 
+  // Sends a batch of command updates collected by |command_update_batcher_|.
+  void SendCommandUpdates(const base::DictionaryValue& body,
+                          const DoneCallback& callback);
+
   // Builds Cloud API devices collection REST resource which matches
   // current state of the device including command definitions
   // for all supported commands and current device state.
@@ -318,17 +393,16 @@ class DeviceRegistrationInfo : public NotificationDelegate,
   std::unique_ptr<BackoffEntry> cloud_backoff_entry_;
   std::unique_ptr<BackoffEntry> oauth2_backoff_entry_;
 
-  // Flag set to true while a device state update patch request is in flight
-  // to the cloud server.
-  bool device_state_update_pending_{false};
-
-  // Set to true when command queue fetch request is in flight to the server.
-  bool fetch_commands_request_sent_{false};
-  // Set to true when another command queue fetch request is queued while
-  // another one was in flight.
-  bool fetch_commands_request_queued_{false};
-  // Specifies the reason for queued command fetch request.
-  std::string queued_fetch_reason_;
+  // Orders the cloud requests and bounds the number of them in flight.
+  CloudRequestScheduler cloud_request_scheduler_;
+  // Sends the command updates in batches if batch_command_updates is set.
+  std::unique_ptr<CommandUpdateBatcher> command_update_batcher_;
+  // State changes not sent to the server yet, at most one per component, and
+  // the ID of the last of them.
+  std::vector<ComponentStateChange> unpublished_state_changes_;
+  ComponentManager::UpdateID unpublished_state_update_id_{0};
+  // Runs PublishStateUpdates() once a burst of state changes is over.
+  DebouncedClosure state_publish_timer_;
 
   using ResourceUpdateCallbackList = std::vector<DoneCallback>;
   // Callbacks for device resource update request currently in flight to the
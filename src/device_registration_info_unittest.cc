@@ -132,7 +132,7 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
 
   void ReloadDefaults(bool allow_endpoints_override) {
     EXPECT_CALL(config_store_, LoadDefaults(_))
-        .WillOnce(Invoke([allow_endpoints_override](Settings* settings) {
+        .WillOnce(Invoke([this, allow_endpoints_override](Settings* settings) {
           settings->client_id = test_data::kClientId;
           settings->client_secret = test_data::kClientSecret;
           settings->api_key = test_data::kApiKey;
@@ -147,6 +147,9 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
           settings->service_url = test_data::kServiceUrl;
           settings->xmpp_endpoint = test_data::kXmppEndpoint;
           settings->allow_endpoints_override = allow_endpoints_override;
+          settings->batch_command_updates = batch_command_updates_;
+          settings->state_publish_max_batch_size =
+              state_publish_max_batch_size_;
           return true;
         }));
     config_.reset(new Config{&config_store_});
@@ -173,7 +176,15 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
   }
 
   void PublishCommands(const base::ListValue& commands) {
-    dev_reg_->PublishCommands(commands, nullptr);
+    for (const auto& command : commands) {
+      const base::DictionaryValue* command_dict{nullptr};
+      ASSERT_TRUE(command->GetAsDictionary(&command_dict));
+      dev_reg_->PublishCommand(*command_dict);
+    }
+  }
+
+  void OnCommandCreated(const base::DictionaryValue& command) {
+    dev_reg_->OnCommandCreated(command, "xmpp");
   }
 
   bool RefreshAccessToken(ErrorPtr* error) const {
@@ -192,6 +203,24 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
 
   void SetAccessToken() { dev_reg_->access_token_ = test_data::kAccessToken; }
 
+  void SetConnectedToCloud() { dev_reg_->connected_to_cloud_ = true; }
+
+  // Sends a request through the cloud request scheduler, ignoring the reply.
+  void DoCloudRequest(CloudRequestScheduler::Priority priority,
+                      HttpClient::Method method,
+                      const std::string& url) {
+    dev_reg_->DoCloudRequest(
+        priority, method, url, nullptr,
+        base::Bind([](const base::DictionaryValue& response, ErrorPtr error) {
+        }));
+  }
+
+  // The backoff entry runs on the real clock, which |task_runner_| does not
+  // advance.
+  void DisableCloudBackoff() {
+    dev_reg_->cloud_backoff_policy_->initial_delay_ms = 0;
+  }
+
   GcdState GetGcdState() const { return dev_reg_->GetGcdState(); }
 
   bool HaveRegistrationCredentials() const {
@@ -201,6 +230,8 @@ class DeviceRegistrationInfoTest : public ::testing::Test {
   void RegisterDevice(const RegistrationData registration_data,
                       const RegistrationData& expected_data);
 
+  bool batch_command_updates_{false};
+  size_t state_publish_max_batch_size_{50};
   provider::test::FakeTaskRunner task_runner_;
   provider::test::MockConfigStore config_store_;
   StrictMock<MockHttpClient> http_client_;
@@ -670,6 +701,197 @@ TEST_F(DeviceRegistrationInfoTest, OOBRegistrationStatus) {
   EXPECT_EQ(GcdState::kConnecting, GetGcdState());
 }
 
+TEST_F(DeviceRegistrationInfoTest, PublishStateUpdates) {
+  ReloadSettings(true, false);
+  SetAccessToken();
+  auto json_traits = CreateDictionaryValue(R"({
+    'robot': {'state': {'a': 'integer', 'b': 'integer'}}
+  })");
+  EXPECT_TRUE(component_manager_.LoadTraits(*json_traits, nullptr));
+  EXPECT_TRUE(component_manager_.AddComponent("", "comp", {"robot"}, nullptr));
+  SetConnectedToCloud();
+
+  base::Time start;
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kPost,
+                          dev_reg_->GetDeviceUrl("patchState"),
+                          HttpClient::Headers{GetAuthHeader(), GetJsonHeader()},
+                          _, _))
+      .WillOnce(WithArgs<3, 4>(Invoke([this, &start](
+          const std::string& data,
+          const HttpClient::SendRequestCallback& callback) {
+        // The burst of changes is published as a single, merged patch.
+        auto body = CreateDictionaryValue(data);
+        const base::ListValue* patches = nullptr;
+        EXPECT_TRUE(body->GetList("patches", &patches));
+        ASSERT_EQ(1u, patches->GetSize());
+        const base::DictionaryValue* patch = nullptr;
+        EXPECT_TRUE(patches->GetDictionary(0, &patch));
+        const base::DictionaryValue* properties = nullptr;
+        EXPECT_TRUE(patch->GetDictionary("patch", &properties));
+        EXPECT_JSON_EQ(R"({"robot": {"a": 3, "b": 2}})", *properties);
+        // Sent after the coalescing window of the last change.
+        EXPECT_EQ(start + base::TimeDelta::FromSeconds(1),
+                  task_runner_.GetClock()->Now());
+        base::DictionaryValue json;
+        callback.Run(ReplyWithJson(200, json), nullptr);
+        task_runner_.Break();
+      })));
+
+  ComponentManager::UpdateID published_id = 0;
+  auto token = component_manager_.AddServerStateUpdatedCallback(base::Bind(
+      [](ComponentManager::UpdateID* published_id,
+         ComponentManager::UpdateID id) { *published_id = id; },
+      base::Unretained(&published_id)));
+  for (int i = 1; i <= 3; i++) {
+    EXPECT_TRUE(component_manager_.SetStateProperty(
+        "comp", "robot.a", base::FundamentalValue{i}, nullptr));
+  }
+  EXPECT_TRUE(component_manager_.SetStateProperty(
+      "comp", "robot.b", base::FundamentalValue{2}, nullptr));
+  start = task_runner_.GetClock()->Now();
+  task_runner_.Run();
+  EXPECT_EQ(component_manager_.GetLastStateChangeId(), published_id);
+}
+
+TEST_F(DeviceRegistrationInfoTest, PublishStateBatchesAfterError) {
+  state_publish_max_batch_size_ = 1;
+  ReloadSettings(true, false);
+  SetAccessToken();
+  auto json_traits = CreateDictionaryValue(R"({
+    'robot': {'state': {'a': 'integer'}}
+  })");
+  EXPECT_TRUE(component_manager_.LoadTraits(*json_traits, nullptr));
+  EXPECT_TRUE(component_manager_.AddComponent("", "comp1", {"robot"}, nullptr));
+  EXPECT_TRUE(component_manager_.AddComponent("", "comp2", {"robot"}, nullptr));
+  SetConnectedToCloud();
+  DisableCloudBackoff();
+
+  std::vector<std::string> components;
+  auto reply = [&components](int status_code, const std::string& data,
+                             const HttpClient::SendRequestCallback& callback) {
+    auto body = CreateDictionaryValue(data);
+    const base::ListValue* patches = nullptr;
+    const base::DictionaryValue* patch = nullptr;
+    std::string component;
+    EXPECT_TRUE(body->GetList("patches", &patches));
+    ASSERT_EQ(1u, patches->GetSize());
+    EXPECT_TRUE(patches->GetDictionary(0, &patch));
+    EXPECT_TRUE(patch->GetString("component", &component));
+    components.push_back(component);
+    base::DictionaryValue json;
+    if (status_code != 200)
+      json.SetString("error", "invalid_patch");
+    callback.Run(ReplyWithJson(status_code, json), nullptr);
+  };
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kPost,
+                          dev_reg_->GetDeviceUrl("patchState"),
+                          HttpClient::Headers{GetAuthHeader(), GetJsonHeader()},
+                          _, _))
+      .WillOnce(WithArgs<3, 4>(Invoke(
+          [&reply](const std::string& data,
+                   const HttpClient::SendRequestCallback& callback) {
+            reply(400, data, callback);
+          })))
+      .WillOnce(WithArgs<3, 4>(Invoke(
+          [this, &reply](const std::string& data,
+                         const HttpClient::SendRequestCallback& callback) {
+            reply(200, data, callback);
+            task_runner_.Break();
+          })));
+  // The state of the failed batch reaches the server with the device
+  // resource, which starts with fetching its current timestamp.
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kGet, dev_reg_->GetDeviceUrl(),
+                          HttpClient::Headers{GetAuthHeader(), GetJsonHeader()},
+                          _, _));
+
+  EXPECT_TRUE(component_manager_.SetStateProperty(
+      "comp1", "robot.a", base::FundamentalValue{1}, nullptr));
+  EXPECT_TRUE(component_manager_.SetStateProperty(
+      "comp2", "robot.a", base::FundamentalValue{2}, nullptr));
+  task_runner_.Run();
+  EXPECT_EQ((std::vector<std::string>{"comp1", "comp2"}), components);
+}
+
+TEST_F(DeviceRegistrationInfoTest, CommandCreatedNotification) {
+  ReloadSettings(true, false);
+  SetAccessToken();
+  auto json_traits = CreateDictionaryValue(R"({
+    'robot': {
+      'commands': {
+        '_jump': {
+          'parameters': {'_height': 'integer'},
+          'minimalRole': 'user'
+        }
+      }
+    }
+  })");
+  EXPECT_TRUE(component_manager_.LoadTraits(*json_traits, nullptr));
+  EXPECT_TRUE(component_manager_.AddComponent("", "comp", {"robot"}, nullptr));
+  SetConnectedToCloud();
+
+  // The command from the notification is published without fetching the
+  // command queue; |http_client_| expects no requests.
+  OnCommandCreated(*CreateDictionaryValue(R"({
+    'name': 'robot._jump',
+    'component': 'comp',
+    'id': '1234',
+    'parameters': {'_height': 100}
+  })"));
+  EXPECT_NE(nullptr, component_manager_.FindCommand("1234"));
+}
+
+TEST_F(DeviceRegistrationInfoTest, CommandCreatedNotificationFetchesQueue) {
+  ReloadSettings(true, false);
+  SetAccessToken();
+  auto json_traits = CreateDictionaryValue(R"({
+    'robot': {
+      'commands': {
+        '_jump': {
+          'parameters': {'_height': 'integer'},
+          'minimalRole': 'user'
+        }
+      }
+    }
+  })");
+  EXPECT_TRUE(component_manager_.LoadTraits(*json_traits, nullptr));
+  EXPECT_TRUE(component_manager_.AddComponent("", "comp", {"robot"}, nullptr));
+  SetConnectedToCloud();
+
+  std::string queue_url = dev_reg_->GetServiceUrl(
+      "commands/queue",
+      {{"deviceId", test_data::kCloudId}, {"reason", "new_command"}});
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kGet, queue_url,
+                          HttpClient::Headers{GetAuthHeader(), GetJsonHeader()},
+                          _, _))
+      .WillOnce(WithArgs<4>(
+          Invoke([](const HttpClient::SendRequestCallback& callback) {
+            auto json = CreateDictionaryValue(R"({
+              'kind': 'weave#commandsListResponse',
+              'commands': [{
+                'kind': 'weave#command',
+                'id': '1234',
+                'name': 'robot._jump',
+                'component': 'comp',
+                'parameters': {'_height': 100},
+                'state': 'queued',
+                'progress': {},
+                'results': {}
+              }]
+            })");
+            callback.Run(ReplyWithJson(200, *json), nullptr);
+          })));
+
+  OnCommandCreated(base::DictionaryValue{});
+  Command* command = component_manager_.FindCommand("1234");
+  ASSERT_NE(nullptr, command);
+  EXPECT_EQ("comp", command->GetComponent());
+  EXPECT_JSON_EQ("{'_height': 100}", command->GetParameters());
+}
+
 class DeviceRegistrationInfoUpdateCommandTest
     : public DeviceRegistrationInfoTest {
  protected:
@@ -771,4 +993,120 @@ TEST_F(DeviceRegistrationInfoUpdateCommandTest, Cancel) {
   EXPECT_TRUE(command_->Cancel(nullptr));
 }
 
+TEST_F(DeviceRegistrationInfoUpdateCommandTest, PublishStateBeforeUpdate) {
+  SetConnectedToCloud();
+  base::Time start = task_runner_.GetClock()->Now();
+  testing::Sequence sequence;
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kPost,
+                          dev_reg_->GetDeviceUrl("patchState"),
+                          HttpClient::Headers{GetAuthHeader(), GetJsonHeader()},
+                          _, _))
+      .InSequence(sequence)
+      .WillOnce(WithArgs<4>(Invoke(
+          [this, start](const HttpClient::SendRequestCallback& callback) {
+            // The command update waits for the state, so the coalescing
+            // window is skipped.
+            EXPECT_EQ(start, task_runner_.GetClock()->Now());
+            base::DictionaryValue json;
+            callback.Run(ReplyWithJson(200, json), nullptr);
+          })));
+  EXPECT_CALL(
+      http_client_,
+      SendRequest(HttpClient::Method::kPatch, command_url_,
+                  HttpClient::Headers{GetAuthHeader(), GetJsonHeader()}, _, _))
+      .InSequence(sequence)
+      .WillOnce(WithArgs<3, 4>(
+          Invoke([this, start](
+              const std::string& data,
+              const HttpClient::SendRequestCallback& callback) {
+            EXPECT_JSON_EQ(R"({"state":"done", "results":{"status":"Ok"}})",
+                           *CreateDictionaryValue(data));
+            EXPECT_EQ(start, task_runner_.GetClock()->Now());
+            base::DictionaryValue json;
+            callback.Run(ReplyWithJson(200, json), nullptr);
+            task_runner_.Break();
+          })));
+
+  EXPECT_TRUE(component_manager_.SetStateProperty(
+      "comp", "robot.height", base::FundamentalValue{100}, nullptr));
+  EXPECT_TRUE(
+      command_->Complete(*CreateDictionaryValue("{'status': 'Ok'}"), nullptr));
+  task_runner_.Run();
+}
+
+TEST_F(DeviceRegistrationInfoUpdateCommandTest, RetriesDoNotBlockUpdate) {
+  const std::string url = dev_reg_->GetServiceUrl("failing");
+  EXPECT_CALL(http_client_, SendRequest(HttpClient::Method::kGet, url, _, _, _))
+      .WillRepeatedly(WithArgs<4>(
+          Invoke([](const HttpClient::SendRequestCallback& callback) {
+            std::unique_ptr<MockHttpClientResponse> response{
+                new StrictMock<MockHttpClientResponse>};
+            EXPECT_CALL(*response, GetStatusCode())
+                .WillRepeatedly(Return(http::kInternalServerError));
+            callback.Run(std::move(response), nullptr);
+          })));
+  for (size_t i = 0; i < 4; ++i) {
+    DoCloudRequest(CloudRequestScheduler::Priority::kDeviceResource,
+                   HttpClient::Method::kGet, url);
+  }
+
+  // The failed requests wait for their retries without holding a slot, so
+  // the command update is not queued behind them.
+  const auto& scheduler = dev_reg_->GetCloudRequestScheduler();
+  EXPECT_EQ(0u, scheduler.GetInFlightCount());
+  DoCloudRequest(CloudRequestScheduler::Priority::kCommand,
+                 HttpClient::Method::kPatch, command_url_);
+  EXPECT_EQ(0u,
+            scheduler.GetQueueSize(CloudRequestScheduler::Priority::kCommand));
+}
+
+class DeviceRegistrationInfoBatchUpdateCommandTest
+    : public DeviceRegistrationInfoUpdateCommandTest {
+ protected:
+  void SetUp() override {
+    batch_command_updates_ = true;
+    DeviceRegistrationInfoUpdateCommandTest::SetUp();
+  }
+};
+
+TEST_F(DeviceRegistrationInfoBatchUpdateCommandTest, BatchUpdate) {
+  auto commands_json = CreateValue(R"([{
+    'name':'robot._jump',
+    'component': 'comp',
+    'id':'5678',
+    'parameters': {'_height': 10},
+    'minimalRole': 'user'
+  }])");
+  const base::ListValue* command_list = nullptr;
+  ASSERT_TRUE(commands_json->GetAsList(&command_list));
+  PublishCommands(*command_list);
+  Command* command2 = component_manager_.FindCommand("5678");
+  ASSERT_NE(nullptr, command2);
+
+  EXPECT_CALL(http_client_,
+              SendRequest(HttpClient::Method::kPost,
+                          dev_reg_->GetServiceUrl("commands/batchUpdate"),
+                          HttpClient::Headers{GetAuthHeader(), GetJsonHeader()},
+                          _, _))
+      .WillOnce(WithArgs<3, 4>(
+          Invoke([](const std::string& data,
+                    const HttpClient::SendRequestCallback& callback) {
+            EXPECT_JSON_EQ((R"({"commands": [
+              {"id": "1234", "state": "done", "results": {"status": "Ok"}},
+              {"id": "5678", "state": "cancelled"}
+            ]})"),
+                           *CreateDictionaryValue(data));
+            base::DictionaryValue json;
+            callback.Run(ReplyWithJson(200, json), nullptr);
+          })));
+  EXPECT_TRUE(
+      command_->Complete(*CreateDictionaryValue("{'status': 'Ok'}"), nullptr));
+  EXPECT_TRUE(command2->Cancel(nullptr));
+  // The proxies send their updates from posted tasks, the batcher flushes
+  // after both of them.
+  for (size_t i = 0; i < 3; ++i)
+    task_runner_.RunOnce();
+}
+
 }  // namespace weave
@@ -10,9 +10,14 @@
 namespace weave {
 namespace http {
 
+const char kAccept[] = "Accept";
 const char kAuthorization[] = "Authorization";
 const char kContentType[] = "Content-Type";
+const char kETag[] = "ETag";
+const char kIfNoneMatch[] = "If-None-Match";
+const char kVary[] = "Vary";
 
+const char kCbor[] = "application/cbor";
 const char kJson[] = "application/json";
 const char kJsonUtf8[] = "application/json; charset=utf-8";
 const char kPlain[] = "text/plain";
@@ -10,6 +10,7 @@ namespace http {
 
 const int kContinue = 100;
 const int kOk = 200;
+const int kNotModified = 304;
 const int kBadRequest = 400;
 const int kDenied = 401;
 const int kForbidden = 403;
@@ -18,9 +19,14 @@ const int kInternalServerError = 500;
 const int kServiceUnavailable = 503;
 const int kNotSupported = 501;
 
+extern const char kAccept[];
 extern const char kAuthorization[];
 extern const char kContentType[];
+extern const char kETag[];
+extern const char kIfNoneMatch[];
+extern const char kVary[];
 
+extern const char kCbor[];
 extern const char kJson[];
 extern const char kJsonUtf8[];
 extern const char kPlain[];
@@ -0,0 +1,155 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/json_reader.h"
+
+#include <utility>
+#include <vector>
+
+#include "src/json_error_codes.h"
+
+namespace weave {
+
+namespace {
+
+// Builds the members selected by a set of paths from the parser events.
+class FieldSelector final : public JsonHandler {
+ public:
+  explicit FieldSelector(const std::set<std::string>& fields)
+      : fields_{fields} {}
+
+  std::unique_ptr<base::Value> TakeRoot() { return std::move(root_); }
+
+  void OnObjectBegin() override {
+    Begin(std::unique_ptr<base::Value>{new base::DictionaryValue});
+  }
+
+  Member OnMemberKey(base::StringPiece key) override {
+    key.CopyToString(&key_);
+    member_path_ = path_;
+    if (!member_path_.empty())
+      member_path_.push_back('.');
+    member_path_.append(key_);
+    if (fields_.count(member_path_))
+      return Member::kBuild;
+
+    // Visit the value if a field is nested inside it.
+    member_path_.push_back('.');
+    auto it = fields_.lower_bound(member_path_);
+    bool nested = it != fields_.end() &&
+                  it->compare(0, member_path_.size(), member_path_) == 0;
+    member_path_.pop_back();
+    return nested ? Member::kVisit : Member::kSkip;
+  }
+
+  void OnObjectEnd() override { End(); }
+
+  void OnListBegin() override {
+    Begin(std::unique_ptr<base::Value>{new base::ListValue});
+  }
+
+  void OnListEnd() override { End(); }
+
+  void OnString(base::StringPiece value) override {
+    Add(std::unique_ptr<base::Value>{
+        new base::StringValue{value.as_string()}});
+  }
+
+  void OnInteger(int value) override {
+    Add(std::unique_ptr<base::Value>{new base::FundamentalValue{value}});
+  }
+
+  void OnDouble(double value) override {
+    Add(std::unique_ptr<base::Value>{new base::FundamentalValue{value}});
+  }
+
+  void OnBoolean(bool value) override {
+    Add(std::unique_ptr<base::Value>{new base::FundamentalValue{value}});
+  }
+
+  void OnNull() override { Add(base::Value::CreateNullValue()); }
+
+  void OnValue(std::unique_ptr<base::Value> value) override {
+    Add(std::move(value));
+  }
+
+ private:
+  struct Container {
+    base::Value* value;
+    // Size of |path_| outside of the container.
+    size_t path_size;
+  };
+
+  base::Value* Add(std::unique_ptr<base::Value> value) {
+    base::Value* result = value.get();
+    base::DictionaryValue* dict = nullptr;
+    base::ListValue* list = nullptr;
+    if (containers_.empty())
+      root_ = std::move(value);
+    else if (containers_.back().value->GetAsDictionary(&dict))
+      dict->SetWithoutPathExpansion(key_, std::move(value));
+    else if (containers_.back().value->GetAsList(&list))
+      list->Append(std::move(value));
+    return result;
+  }
+
+  void Begin(std::unique_ptr<base::Value> container) {
+    // Objects in lists have the path of the list.
+    bool is_member = !containers_.empty() &&
+                     containers_.back().value->IsType(
+                         base::Value::TYPE_DICTIONARY);
+    containers_.push_back({Add(std::move(container)), path_.size()});
+    if (is_member)
+      path_ = member_path_;
+  }
+
+  void End() {
+    path_.resize(containers_.back().path_size);
+    containers_.pop_back();
+  }
+
+  const std::set<std::string>& fields_;
+  std::unique_ptr<base::Value> root_;
+  std::vector<Container> containers_;
+  // Path of the innermost object.
+  std::string path_;
+  std::string key_;
+  std::string member_path_;
+};
+
+}  // namespace
+
+bool ReadJsonEvents(const std::string& json,
+                    JsonHandler* handler,
+                    ErrorPtr* error) {
+  base::internal::JSONParser parser{base::JSON_PARSE_RFC};
+  if (!parser.Parse(json, handler)) {
+    Error::AddTo(error, FROM_HERE, errors::json::kParseError,
+                 parser.GetErrorMessage());
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<base::Value> ReadJson(const std::string& json,
+                                      const std::set<std::string>& fields,
+                                      ErrorPtr* error) {
+  if (!fields.empty()) {
+    FieldSelector selector{fields};
+    if (!ReadJsonEvents(json, &selector, error))
+      return nullptr;
+    return selector.TakeRoot();
+  }
+
+  // The values are detached from the input, so no copy of |json| is kept.
+  base::internal::JSONParser parser{base::JSON_DETACHABLE_CHILDREN};
+  std::unique_ptr<base::Value> value = parser.Parse(json);
+  if (!value) {
+    Error::AddTo(error, FROM_HERE, errors::json::kParseError,
+                 parser.GetErrorMessage());
+  }
+  return value;
+}
+
+}  // namespace weave
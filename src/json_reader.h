@@ -0,0 +1,40 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_JSON_READER_H_
+#define LIBWEAVE_SRC_JSON_READER_H_
+
+#include <memory>
+#include <set>
+#include <string>
+
+#include <base/json/json_parser.h>
+#include <base/values.h>
+#include <weave/error.h>
+
+namespace weave {
+
+// Receives the structure of a JSON document from ReadJsonEvents() as it is
+// parsed. The handler decides for each object member whether its value is
+// reported, built as a whole or skipped.
+using JsonHandler = base::internal::JSONParser::Handler;
+
+// Parses |json| and reports it to |handler| without building a value tree.
+// Accepts what base::JSONReader accepts. Returns false on error.
+bool ReadJsonEvents(const std::string& json,
+                    JsonHandler* handler,
+                    ErrorPtr* error);
+
+// Parses |json| into a value tree, like base::JSONReader does. If |fields| is
+// not empty, only the object members with the listed paths are built, e.g.
+// {"commands.id"} builds only the "id" members of the objects in the
+// top-level "commands" member. Lists do not add to the path. Other members
+// are checked for errors, but not built. This is done with a JsonHandler.
+std::unique_ptr<base::Value> ReadJson(const std::string& json,
+                                      const std::set<std::string>& fields,
+                                      ErrorPtr* error);
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_JSON_READER_H_
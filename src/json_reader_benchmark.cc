@@ -0,0 +1,122 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/json_reader.h"
+
+#include <base/json/json_reader.h>
+#include <base/json/json_writer.h>
+#include <base/strings/stringprintf.h>
+
+#include "src/commands/command_instance.h"
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kTraitCount = 4;
+const size_t kPropertyCount = 4;
+
+std::string CreateComponentsJson(size_t size) {
+  std::string json;
+  base::JSONWriter::Write(
+      *benchmark::CreateComponentTree(size, kTraitCount, kPropertyCount),
+      &json);
+  return json;
+}
+
+// Response of the commands/queue cloud request with |size| commands.
+std::string CreateCommandQueueJson(size_t size) {
+  base::ListValue commands;
+  for (size_t i = 0; i < size; ++i) {
+    std::unique_ptr<base::DictionaryValue> command{new base::DictionaryValue};
+    command->SetString("kind", "weave#command");
+    command->SetString("id", base::StringPrintf("command%zu", i));
+    command->SetString("deviceId", "4b5a2ba1-8fba-4d6b-a7e3-4b9c2e6f1d2a");
+    command->SetString("creatorEmail", "user@example.com");
+    command->SetString("component", base::StringPrintf("comp%zu", i));
+    command->SetString("name", "trait0.cmd");
+    command->SetInteger("parameters.value", 42);
+    command->SetString("state", "queued");
+    command->SetString("creationTimeMs", "1449101535000");
+    command->SetString("expirationTimeMs", "1449101595000");
+    command->SetString("expirationTimeoutMs", "60000");
+    command->SetString("lastUpdateTimeMs", "1449101535000");
+    command->Set("progress", new base::DictionaryValue);
+    command->Set("results", new base::DictionaryValue);
+    commands.Append(std::move(command));
+  }
+  base::DictionaryValue response;
+  response.SetString("kind", "weave#commandsListResponse");
+  response.Set("commands", commands.DeepCopy());
+  std::string json;
+  base::JSONWriter::Write(response, &json);
+  return json;
+}
+
+}  // namespace
+
+WEAVE_BENCHMARK(JSONReaderReadComponents) {
+  std::string json = CreateComponentsJson(state->size());
+  state->set_bytes(json.size());
+  while (state->KeepRunning())
+    CHECK(base::JSONReader::Read(json));
+}
+
+WEAVE_BENCHMARK(ReadJsonComponents) {
+  std::string json = CreateComponentsJson(state->size());
+  state->set_bytes(json.size());
+  while (state->KeepRunning())
+    CHECK(ReadJson(json, {}, nullptr));
+}
+
+WEAVE_BENCHMARK(JSONReaderReadCommandQueue) {
+  std::string json = CreateCommandQueueJson(state->size());
+  state->set_bytes(json.size());
+  while (state->KeepRunning())
+    CHECK(base::JSONReader::Read(json));
+}
+
+WEAVE_BENCHMARK(ReadJsonCommandQueue) {
+  std::string json = CreateCommandQueueJson(state->size());
+  state->set_bytes(json.size());
+  while (state->KeepRunning())
+    CHECK(ReadJson(json, {}, nullptr));
+}
+
+WEAVE_BENCHMARK(ReadJsonCommandQueueFields) {
+  std::string json = CreateCommandQueueJson(state->size());
+  const std::set<std::string> fields{"commands.id", "commands.name",
+                                     "commands.component",
+                                     "commands.parameters"};
+  state->set_bytes(json.size());
+  while (state->KeepRunning())
+    CHECK(ReadJson(json, fields, nullptr));
+}
+
+WEAVE_BENCHMARK(JSONReaderCommandQueueInstances) {
+  std::string json = CreateCommandQueueJson(state->size());
+  state->set_bytes(json.size());
+  while (state->KeepRunning()) {
+    auto response = base::DictionaryValue::From(base::JSONReader::Read(json));
+    const base::ListValue* commands = nullptr;
+    CHECK(response->GetList("commands", &commands));
+    for (const auto& command : *commands) {
+      CHECK(CommandInstance::FromJson(command.get(), Command::Origin::kCloud,
+                                      nullptr, nullptr));
+    }
+  }
+}
+
+WEAVE_BENCHMARK(ReadJsonCommandQueueInstances) {
+  std::string json = CreateCommandQueueJson(state->size());
+  state->set_bytes(json.size());
+  while (state->KeepRunning()) {
+    CommandInstance::ListReader reader{"commands", Command::Origin::kCloud};
+    CHECK(ReadJsonEvents(json, &reader, nullptr));
+    CHECK_EQ(state->size(), reader.entries().size());
+  }
+}
+
+}  // namespace weave
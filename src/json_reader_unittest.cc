@@ -0,0 +1,187 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/json_reader.h"
+
+#include <base/json/json_reader.h>
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/json_error_codes.h"
+
+namespace weave {
+
+namespace {
+
+// Records the parser events as text.
+class EventRecorder : public JsonHandler {
+ public:
+  std::string events;
+
+  void OnObjectBegin() override { events += "{"; }
+  Member OnMemberKey(base::StringPiece key) override {
+    events += key.as_string() + ":";
+    if (key == "build")
+      return Member::kBuild;
+    if (key == "skip")
+      return Member::kSkip;
+    return Member::kVisit;
+  }
+  void OnObjectEnd() override { events += "}"; }
+  void OnListBegin() override { events += "["; }
+  void OnListEnd() override { events += "]"; }
+  void OnString(base::StringPiece value) override {
+    events += "s(" + value.as_string() + ")";
+  }
+  void OnInteger(int value) override {
+    events += "i(" + std::to_string(value) + ")";
+  }
+  void OnDouble(double value) override { events += "d"; }
+  void OnBoolean(bool value) override { events += value ? "t" : "f"; }
+  void OnNull() override { events += "n"; }
+  void OnValue(std::unique_ptr<base::Value> value) override {
+    events += "v(" + std::to_string(value->GetType()) + ")";
+  }
+};
+
+}  // namespace
+
+TEST(JsonReaderTest, Handler) {
+  EventRecorder recorder;
+  EXPECT_TRUE(ReadJsonEvents(R"({
+    "a": [1, 2.5, "x\ny", true, false, null],
+    "build": {"b": [1]},
+    "skip": {"c": [1, {"d": "e"}]},
+    "f": {"g": {}}
+  })", &recorder, nullptr));
+  EXPECT_EQ("{a:[i(1)ds(x\ny)tfn]build:v(6)skip:f:{g:{}}}", recorder.events);
+}
+
+TEST(JsonReaderTest, HandlerErrors) {
+  EventRecorder recorder;
+  ErrorPtr error;
+  EXPECT_FALSE(ReadJsonEvents(R"({"skip": [01]})", &recorder, &error));
+  EXPECT_EQ(errors::json::kParseError, error->GetCode());
+  EXPECT_FALSE(ReadJsonEvents(R"({"build": [1,]})", &recorder, nullptr));
+  EXPECT_FALSE(ReadJsonEvents(R"({"a": 1} 2)", &recorder, nullptr));
+}
+
+TEST(JsonReaderTest, MatchesBaseJsonReader) {
+  const char* kValues[] = {
+      "{}",
+      "[]",
+      "0",
+      "-1",
+      "2147483648",
+      "1.5e3",
+      "-0.25E-2",
+      "\"\"",
+      R"("a\"b\\c\/d\b\f\n\r\t")",
+      R"("\u0041\u00e9\u20AC\ud83d\ude00")",
+      "\"\xC3\xA9\xF0\x9F\x98\x80\"",
+      R"( {
+        "a": [1, 2.5, "x", true, false, null, {"b": {}, "c": []}],
+        "d": {"e": {"f": [[1], {"g": 0.5}]}},
+        "h": "\u001f"
+      } )",
+  };
+  for (const char* json : kValues) {
+    auto expected = base::JSONReader::Read(json);
+    ASSERT_TRUE(expected) << json;
+    auto value = ReadJson(json, {}, nullptr);
+    ASSERT_TRUE(value) << json;
+    EXPECT_PRED2(test::IsEqualValue, *expected, *value) << json;
+  }
+}
+
+TEST(JsonReaderTest, Errors) {
+  const char* kValues[] = {
+      "",
+      " ",
+      "{",
+      "[1,]",
+      "{\"a\":1,}",
+      "{\"a\" 1}",
+      "{a:1}",
+      "[1 2]",
+      "01",
+      "1.",
+      ".5",
+      "1e",
+      "-",
+      "+1",
+      "1e400",
+      "tru",
+      "nul",
+      "\"abc",
+      "\"\\u12\"",
+      "\"\\udc00\"",
+      "\"\\ud83d\"",
+      "\"\\ud83d\\u0041\"",
+      "\"\xC3\"",
+      "\"\xFF\"",
+      "{} {}",
+  };
+  for (const char* json : kValues) {
+    ErrorPtr error;
+    EXPECT_FALSE(ReadJson(json, {}, &error)) << json;
+    ASSERT_TRUE(error) << json;
+    EXPECT_EQ(errors::json::kParseError, error->GetCode()) << json;
+  }
+}
+
+TEST(JsonReaderTest, ErrorPosition) {
+  ErrorPtr error;
+  EXPECT_FALSE(ReadJson("{\n  \"a\": [1,\n    ]\n}", {}, &error));
+  EXPECT_EQ("Line: 3, column: 6, Trailing comma not allowed.",
+            error->GetMessage());
+}
+
+TEST(JsonReaderTest, ErrorsInSkippedValues) {
+  const std::set<std::string> fields{"a"};
+  EXPECT_TRUE(ReadJson(R"({"a": 1, "skip": [{"b": "\n"}, 1.5, null]})",
+                       fields, nullptr));
+  EXPECT_FALSE(ReadJson(R"({"a": 1, "skip": ["\q"]})", fields, nullptr));
+  EXPECT_FALSE(ReadJson(R"({"a": 1, "skip": [01]})", fields, nullptr));
+  EXPECT_FALSE(ReadJson(R"({"a": 1, "skip": {"b" 1}})", fields, nullptr));
+  EXPECT_FALSE(ReadJson(R"({"a": 1, "skip": [nul]})", fields, nullptr));
+}
+
+TEST(JsonReaderTest, MaxDepth) {
+  // Same nesting limit as base::JSONReader.
+  std::string json;
+  for (int i = 0; i < 99; ++i)
+    json = "[" + json + "]";
+  EXPECT_TRUE(ReadJson(json, {}, nullptr));
+  EXPECT_FALSE(ReadJson("[" + json + "]", {}, nullptr));
+  EXPECT_FALSE(
+      ReadJson("{\"skip\": " + json + ", \"a\": 1}", {"a"}, nullptr));
+}
+
+TEST(JsonReaderTest, Fields) {
+  const char kJson[] = R"({
+    "kind": "list",
+    "commands": [
+      {"id": "1", "name": "a.b", "parameters": {"x": [1, {"y": 2}]},
+       "creator": {"id": "u"}},
+      {"id": "2", "results": {}},
+      "item"
+    ],
+    "next": {"page": 2, "token": "t"}
+  })";
+  auto value = ReadJson(kJson, {"commands.id", "commands.parameters",
+                                "next.token", "missing"},
+                        nullptr);
+  ASSERT_TRUE(value);
+  EXPECT_JSON_EQ(R"({
+    "commands": [
+      {"id": "1", "parameters": {"x": [1, {"y": 2}]}},
+      {"id": "2"},
+      "item"
+    ],
+    "next": {"token": "t"}
+  })", *value);
+}
+
+}  // namespace weave
@@ -0,0 +1,198 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/json_writer.h"
+
+#include <base/json/json_writer.h>
+#include <base/json/string_escape.h>
+#include <base/logging.h>
+
+#include "src/cbor.h"
+
+namespace weave {
+
+namespace {
+
+const char kPrettyPrintLineEnding[] = "\n";
+
+}  // anonymous namespace
+
+JsonWriter::JsonWriter(bool pretty_print, std::string* output)
+    : pretty_print_{pretty_print}, output_{output} {
+  CHECK(output_);
+}
+
+JsonWriter::JsonWriter(bool pretty_print, Chunks* chunks)
+    : pretty_print_{pretty_print}, output_{&buffer_}, chunks_{chunks} {
+  CHECK(chunks_);
+}
+
+JsonWriter::JsonWriter(Encoding encoding, Chunks* chunks)
+    : JsonWriter{false, chunks} {
+  cbor_ = encoding == Encoding::kCbor;
+}
+
+JsonWriter::~JsonWriter() {
+  DCHECK(containers_.empty());
+}
+
+const size_t JsonWriter::kChunkSize;
+
+std::string JsonWriter::Join(const Chunks& chunks) {
+  size_t size = 0;
+  for (const auto& chunk : chunks)
+    size += chunk->size();
+  std::string result;
+  result.reserve(size);
+  for (const auto& chunk : chunks)
+    result += *chunk;
+  return result;
+}
+
+void JsonWriter::BeginObject() {
+  BeginValue();
+  if (cbor_) {
+    CborEncodeMapStart(output_);
+  } else {
+    output_->push_back('{');
+    if (pretty_print_)
+      output_->append(kPrettyPrintLineEnding);
+  }
+  containers_.push_back(Container{true, false});
+  object_depth_++;
+}
+
+void JsonWriter::EndObject() {
+  CHECK(!containers_.empty() && containers_.back().is_object);
+  containers_.pop_back();
+  object_depth_--;
+  if (cbor_) {
+    CborEncodeBreak(output_);
+  } else {
+    if (pretty_print_) {
+      output_->append(kPrettyPrintLineEnding);
+      Indent();
+    }
+    output_->push_back('}');
+  }
+  EndValue();
+}
+
+void JsonWriter::Key(const std::string& key) {
+  CHECK(!containers_.empty() && containers_.back().is_object);
+  if (cbor_)
+    return CborEncodeString(key, output_);
+  Container& object = containers_.back();
+  if (object.has_members) {
+    output_->push_back(',');
+    if (pretty_print_)
+      output_->append(kPrettyPrintLineEnding);
+  }
+  object.has_members = true;
+  if (pretty_print_)
+    Indent();
+  base::EscapeJSONString(key, true, output_);
+  output_->push_back(':');
+  if (pretty_print_)
+    output_->push_back(' ');
+}
+
+void JsonWriter::BeginList() {
+  BeginValue();
+  if (cbor_) {
+    CborEncodeArrayStart(output_);
+  } else {
+    output_->push_back('[');
+    if (pretty_print_)
+      output_->push_back(' ');
+  }
+  containers_.push_back(Container{false, false});
+}
+
+void JsonWriter::EndList() {
+  CHECK(!containers_.empty() && !containers_.back().is_object);
+  containers_.pop_back();
+  if (cbor_) {
+    CborEncodeBreak(output_);
+  } else {
+    if (pretty_print_)
+      output_->push_back(' ');
+    output_->push_back(']');
+  }
+  EndValue();
+}
+
+void JsonWriter::Value(const base::Value& value) {
+  const base::DictionaryValue* dict = nullptr;
+  const base::ListValue* list = nullptr;
+  const base::StringValue* string = nullptr;
+  if (value.GetAsDictionary(&dict)) {
+    BeginObject();
+    for (base::DictionaryValue::Iterator it(*dict); !it.IsAtEnd();
+         it.Advance()) {
+      Key(it.key());
+      Value(it.value());
+    }
+    EndObject();
+  } else if (value.GetAsList(&list)) {
+    BeginList();
+    for (const auto& item : *list)
+      Value(*item);
+    EndList();
+  } else if (value.GetAsString(&string)) {
+    String(string->GetString());
+  } else {
+    BeginValue();
+    if (cbor_) {
+      CborEncode(value, output_);
+    } else {
+      std::string scalar;
+      base::JSONWriter::Write(value, &scalar);
+      output_->append(scalar);
+    }
+    EndValue();
+  }
+}
+
+void JsonWriter::String(const std::string& value) {
+  BeginValue();
+  if (cbor_)
+    CborEncodeString(value, output_);
+  else
+    base::EscapeJSONString(value, true, output_);
+  EndValue();
+}
+
+void JsonWriter::BeginValue() {
+  // CBOR has no separators.
+  if (cbor_ || containers_.empty() || containers_.back().is_object)
+    return;
+  Container& list = containers_.back();
+  if (list.has_members) {
+    output_->push_back(',');
+    if (pretty_print_)
+      output_->push_back(' ');
+  }
+  list.has_members = true;
+}
+
+void JsonWriter::EndValue() {
+  if (containers_.empty() && pretty_print_)
+    output_->append(kPrettyPrintLineEnding);
+  if (chunks_ && (containers_.empty() || buffer_.size() >= kChunkSize))
+    AppendChunk();
+}
+
+void JsonWriter::AppendChunk() {
+  chunks_->push_back(std::make_shared<const std::string>(std::move(buffer_)));
+  buffer_.clear();
+  if (!containers_.empty())
+    buffer_.reserve(kChunkSize);
+}
+
+void JsonWriter::Indent() {
+  output_->append(object_depth_ * 3, ' ');
+}
+
+}  // namespace weave
@@ -0,0 +1,92 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_JSON_WRITER_H_
+#define LIBWEAVE_SRC_JSON_WRITER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/values.h>
+
+namespace weave {
+
+// Incremental JSON writer. Allows to serialize a document piece by piece,
+// e.g. while walking a live data structure, without building a base::Value
+// for the whole document first. The output is identical to that of
+// base::JSONWriter with the same pretty-print setting.
+// The same document can be written as CBOR instead, see Encoding.
+class JsonWriter final {
+ public:
+  // Output as a chain of buffers. The buffers are immutable once written, so
+  // they can be shared, e.g. by a reply cache and the HTTP transport.
+  using Chunks = std::vector<std::shared_ptr<const std::string>>;
+
+  enum class Encoding {
+    // Minified JSON text.
+    kJson,
+    // CBOR (RFC 7049) as produced by CborEncode(), except that objects and
+    // lists are encoded as maps and arrays of indefinite length.
+    kCbor,
+  };
+
+  JsonWriter(bool pretty_print, std::string* output);
+  // Appends the output to |chunks| in buffers of about kChunkSize bytes, so a
+  // large document is never copied into a single string. The last buffer is
+  // appended when the top-level value is complete.
+  JsonWriter(bool pretty_print, Chunks* chunks);
+  JsonWriter(Encoding encoding, Chunks* chunks);
+  ~JsonWriter();
+
+  static const size_t kChunkSize = 16 * 1024;
+
+  // Joins |chunks| into a single string.
+  static std::string Join(const Chunks& chunks);
+
+  // Starts and ends an object. Members are written as Key() followed by a
+  // single value.
+  void BeginObject();
+  void EndObject();
+  void Key(const std::string& key);
+
+  // Starts and ends a list.
+  void BeginList();
+  void EndList();
+
+  // Writes a complete value, e.g. a member value or a list item.
+  void Value(const base::Value& value);
+  void String(const std::string& value);
+
+ private:
+  struct Container {
+    bool is_object;
+    bool has_members;
+  };
+
+  // Writes a separator if a value is added to a list.
+  void BeginValue();
+  // Terminates the document when the top-level value is complete.
+  void EndValue();
+  void Indent();
+  // Moves the current buffer to |chunks_|.
+  void AppendChunk();
+
+  bool pretty_print_;
+  bool cbor_{false};
+  std::string* output_;
+  // Output buffers and the buffer |output_| points to if writing chunks.
+  Chunks* chunks_{nullptr};
+  std::string buffer_;
+  std::vector<Container> containers_;
+  // Number of open objects, i.e. the indentation of the next object member.
+  size_t object_depth_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(JsonWriter);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_JSON_WRITER_H_
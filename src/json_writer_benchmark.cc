@@ -0,0 +1,48 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/json_writer.h"
+
+#include <base/json/json_reader.h>
+#include <base/json/json_writer.h>
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kTraitCount = 4;
+const size_t kPropertyCount = 4;
+
+std::unique_ptr<base::DictionaryValue> CreateComponents(size_t size) {
+  return benchmark::CreateComponentTree(size, kTraitCount, kPropertyCount);
+}
+
+}  // namespace
+
+WEAVE_BENCHMARK(JSONWriterWrite) {
+  auto components = CreateComponents(state->size());
+  std::string json;
+  while (state->KeepRunning())
+    base::JSONWriter::Write(*components, &json);
+}
+
+WEAVE_BENCHMARK(JSONReaderRead) {
+  std::string json;
+  base::JSONWriter::Write(*CreateComponents(state->size()), &json);
+  while (state->KeepRunning())
+    CHECK(base::JSONReader::Read(json));
+}
+
+WEAVE_BENCHMARK(JsonWriterValue) {
+  auto components = CreateComponents(state->size());
+  std::string json;
+  while (state->KeepRunning()) {
+    json.clear();
+    JsonWriter writer{false, &json};
+    writer.Value(*components);
+  }
+}
+
+}  // namespace weave
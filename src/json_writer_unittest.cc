@@ -0,0 +1,109 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/json_writer.h"
+
+#include <base/json/json_writer.h>
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/cbor.h"
+
+namespace weave {
+
+namespace {
+
+std::string Write(const base::Value& value, bool pretty_print) {
+  std::string json;
+  JsonWriter writer{pretty_print, &json};
+  writer.Value(value);
+  return json;
+}
+
+std::string WriteWithBase(const base::Value& value, bool pretty_print) {
+  std::string json;
+  base::JSONWriter::WriteWithOptions(
+      value, pretty_print ? base::JSONWriter::OPTIONS_PRETTY_PRINT : 0, &json);
+  return json;
+}
+
+}  // anonymous namespace
+
+TEST(JsonWriterTest, MatchesBaseJsonWriter) {
+  const char* kValues[] = {
+      "{}",
+      "[]",
+      "1",
+      "\"a\\\"b\"",
+      R"({
+        "a": [1, 2.5, "x", true, null, {"b": {}, "c": []}],
+        "d": {"e": {"f": [[1], {"g": 0.5}]}},
+        "h\n": "é"
+      })",
+  };
+  for (const char* json : kValues) {
+    auto value = test::CreateValue(json);
+    EXPECT_EQ(WriteWithBase(*value, false), Write(*value, false)) << json;
+    EXPECT_EQ(WriteWithBase(*value, true), Write(*value, true)) << json;
+  }
+}
+
+TEST(JsonWriterTest, Incremental) {
+  std::string json;
+  JsonWriter writer{false, &json};
+  writer.BeginObject();
+  writer.Key("a");
+  writer.BeginList();
+  writer.String("b");
+  writer.Value(base::FundamentalValue{1});
+  writer.EndList();
+  writer.Key("c");
+  writer.BeginObject();
+  writer.EndObject();
+  writer.EndObject();
+  EXPECT_EQ(R"({"a":["b",1],"c":{}})", json);
+}
+
+TEST(JsonWriterTest, Chunks) {
+  base::ListValue list;
+  for (int i = 0; i < 10000; ++i)
+    list.AppendString("item");
+  std::string json;
+  JsonWriter{false, &json}.Value(list);
+
+  JsonWriter::Chunks chunks;
+  JsonWriter writer{false, &chunks};
+  writer.Value(list);
+  EXPECT_EQ(json, JsonWriter::Join(chunks));
+  ASSERT_GT(chunks.size(), 1u);
+  for (size_t i = 0; i + 1 < chunks.size(); ++i) {
+    EXPECT_GE(chunks[i]->size(), JsonWriter::kChunkSize);
+    EXPECT_LT(chunks[i]->size(), JsonWriter::kChunkSize + 10);
+  }
+
+  // Each complete value is flushed into a chunk of its own.
+  writer.String("x");
+  EXPECT_EQ("\"x\"", *chunks.back());
+}
+
+TEST(JsonWriterTest, Cbor) {
+  const char kJson[] = R"({
+    "a": [1, -2, 2.5, "x", true, null, {"b": {}, "c": []}],
+    "d": {"e": {"f": [[1], {"g": 0.5}]}}
+  })";
+  JsonWriter::Chunks chunks;
+  JsonWriter writer{JsonWriter::Encoding::kCbor, &chunks};
+  writer.BeginObject();
+  writer.Key("h");
+  writer.String("i");
+  writer.Key("j");
+  writer.Value(*test::CreateValue(kJson));
+  writer.EndObject();
+
+  auto value = CborDecode(JsonWriter::Join(chunks), nullptr);
+  ASSERT_TRUE(value);
+  EXPECT_JSON_EQ(std::string{"{'h': 'i', 'j': "} + kJson + "}", *value);
+}
+
+}  // namespace weave
@@ -4,8 +4,13 @@
 
 #include "src/notification/notification_parser.h"
 
+#include <set>
+
 #include <base/logging.h>
 
+#include "src/commands/schema_constants.h"
+#include "src/json_reader.h"
+
 namespace weave {
 
 namespace {
@@ -68,4 +73,26 @@ bool ParseNotificationJson(const base::DictionaryValue& notification,
   return true;
 }
 
+bool ParseNotificationJson(const std::string& json,
+                           NotificationDelegate* delegate,
+                           const std::string& channel_name) {
+  const std::set<std::string> fields{
+      "kind",
+      "type",
+      "deviceId",
+      std::string{"command."} + commands::attributes::kCommand_Id,
+      std::string{"command."} + commands::attributes::kCommand_Name,
+      std::string{"command."} + commands::attributes::kCommand_Component,
+      std::string{"command."} + commands::attributes::kCommand_Parameters,
+  };
+  ErrorPtr error;
+  auto value = ReadJson(json, fields, &error);
+  const base::DictionaryValue* notification = nullptr;
+  if (!value || !value->GetAsDictionary(&notification)) {
+    LOG(WARNING) << "Failed to parse push notification: " << json;
+    return false;
+  }
+  return ParseNotificationJson(*notification, delegate, channel_name);
+}
+
 }  // namespace weave
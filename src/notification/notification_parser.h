@@ -20,6 +20,13 @@ bool ParseNotificationJson(const base::DictionaryValue& notification,
                            NotificationDelegate* delegate,
                            const std::string& channel_name);
 
+// Same as above, but parses the notification straight from its |json| text.
+// Only the members used by the notification dispatch and by CommandInstance
+// are built.
+bool ParseNotificationJson(const std::string& json,
+                           NotificationDelegate* delegate,
+                           const std::string& channel_name);
+
 }  // namespace weave
 
 #endif  // LIBWEAVE_SRC_NOTIFICATION_NOTIFICATION_PARSER_H_
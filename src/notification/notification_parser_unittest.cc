@@ -74,6 +74,43 @@ TEST_F(NotificationParserTest, CommandCreated) {
   EXPECT_TRUE(ParseNotificationJson(*json, &delegate_, "foo"));
 }
 
+TEST_F(NotificationParserTest, CommandCreatedJson) {
+  const char json[] = R"({
+    "kind": "weave#notification",
+    "type": "COMMAND_CREATED",
+    "deviceId": "device_id",
+    "command": {
+      "kind": "weave#command",
+      "deviceId": "device_id",
+      "state": "queued",
+      "name": "storage.list",
+      "component": "comp",
+      "parameters": {
+        "path": "/somepath1"
+      },
+      "expirationTimeMs": "1406036174811",
+      "id": "command_id",
+      "creationTimeMs": "1403444174811"
+    },
+    "commandId": "command_id"
+  })";
+
+  // Members of the command not needed to create it are not built.
+  const char expected_json[] = R"({
+      "name": "storage.list",
+      "component": "comp",
+      "parameters": {
+        "path": "/somepath1"
+      },
+      "id": "command_id"
+    })";
+
+  EXPECT_CALL(delegate_, OnCommandCreated(MatchDict(expected_json), "foo"))
+      .Times(1);
+  EXPECT_TRUE(ParseNotificationJson(json, &delegate_, "foo"));
+  EXPECT_FALSE(ParseNotificationJson("{", &delegate_, "foo"));
+}
+
 TEST_F(NotificationParserTest, DeviceDeleted) {
   auto json = CreateDictionaryValue(R"({
     "kind":"weave#notification",
@@ -10,9 +10,9 @@
 
 namespace weave {
 
-XmlNode::XmlNode(const std::string& name,
+XmlNode::XmlNode(std::string name,
                  std::map<std::string, std::string> attributes)
-    : name_{name}, attributes_{std::move(attributes)} {}
+    : name_{std::move(name)}, attributes_{std::move(attributes)} {}
 
 const std::string& XmlNode::name() const {
   return name_;
@@ -93,6 +93,10 @@ void XmlNode::AppendText(const std::string& text) {
   text_ += text;
 }
 
+void XmlNode::AppendText(const char* text, size_t length) {
+  text_.append(text, length);
+}
+
 void XmlNode::AddChild(std::unique_ptr<XmlNode> child) {
   child->parent_ = this;
   children_.push_back(std::move(child));
@@ -22,8 +22,7 @@ class XmppStreamParser;
 // class used to parse Xmpp data stream into individual stanzas.
 class XmlNode final {
  public:
-  XmlNode(const std::string& name,
-          std::map<std::string, std::string> attributes);
+  XmlNode(std::string name, std::map<std::string, std::string> attributes);
 
   // The node's name. E.g. in <foo bar="baz">quux</foo> this will return "foo".
   const std::string& name() const;
@@ -95,6 +94,8 @@ class XmlNode final {
   void SetText(const std::string& text);
   // Appends the |text| to the node's text string.
   void AppendText(const std::string& text);
+  // Appends |length| characters at |text| to the node's text string.
+  void AppendText(const char* text, size_t length);
 
   // Helper method used by FindFirstChild() and FindChildren(). Searches for
   // child node(s) matching |name_path|.
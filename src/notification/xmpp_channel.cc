@@ -8,6 +8,7 @@
 
 #include <base/bind.h>
 #include <base/strings/string_number_conversions.h>
+#include <base/strings/string_piece.h>
 #include <weave/provider/network.h>
 #include <weave/provider/task_runner.h>
 
@@ -111,13 +112,13 @@ void XmppChannel::OnMessageRead(size_t size, ErrorPtr error) {
   read_pending_ = false;
   if (error)
     return Restart();
-  std::string msg(read_socket_data_.data(), size);
-  VLOG(2) << "Received XMPP packet: '" << msg << "'";
+  VLOG(2) << "Received XMPP packet: '"
+          << base::StringPiece(read_socket_data_.data(), size) << "'";
 
   if (!size)
     return Restart();
 
-  stream_parser_.ParseData(msg);
+  stream_parser_.ParseData(read_socket_data_.data(), size);
   WaitForMessage();
 }
 
@@ -270,17 +271,16 @@ void XmppChannel::HandleMessageStanza(std::unique_ptr<XmlNode> stanza) {
     LOG(WARNING) << "XMPP message stanza is missing <push:data> element";
     return;
   }
-  std::string data = node->text();
   std::string json_data;
-  if (!Base64Decode(data, &json_data)) {
-    LOG(WARNING) << "Failed to decode base64-encoded message payload: " << data;
+  if (!Base64Decode(node->text(), &json_data)) {
+    LOG(WARNING) << "Failed to decode base64-encoded message payload: "
+                 << node->text();
     return;
   }
 
   VLOG(2) << "XMPP push notification data: " << json_data;
-  auto json_dict = LoadJsonDict(json_data, nullptr);
-  if (json_dict && delegate_)
-    ParseNotificationJson(*json_dict, delegate_, GetName());
+  if (delegate_)
+    ParseNotificationJson(json_data, delegate_, GetName());
 }
 
 void XmppChannel::CreateSslSocket() {
@@ -21,11 +21,15 @@ XmppStreamParser::~XmppStreamParser() {
 }
 
 void XmppStreamParser::ParseData(const std::string& data) {
-  XML_Parse(parser_, data.data(), data.size(), 0);
+  ParseData(data.data(), data.size());
+}
+
+void XmppStreamParser::ParseData(const char* data, size_t size) {
+  XML_Parse(parser_, data, size, 0);
 }
 
 void XmppStreamParser::Reset() {
-  std::stack<std::unique_ptr<XmlNode>>{}.swap(node_stack_);
+  node_stack_.clear();
   started_ = false;
 }
 
@@ -33,13 +37,7 @@ void XmppStreamParser::HandleElementStart(void* user_data,
                                           const XML_Char* element,
                                           const XML_Char** attr) {
   auto self = static_cast<XmppStreamParser*>(user_data);
-  std::map<std::string, std::string> attributes;
-  if (attr != nullptr) {
-    for (size_t n = 0; attr[n] != nullptr && attr[n + 1] != nullptr; n += 2) {
-      attributes.insert(std::make_pair(attr[n], attr[n + 1]));
-    }
-  }
-  self->OnOpenElement(element, std::move(attributes));
+  self->OnOpenElement(element, attr);
 }
 
 void XmppStreamParser::HandleElementEnd(void* user_data,
@@ -52,19 +50,26 @@ void XmppStreamParser::HandleCharData(void* user_data,
                                       const char* content,
                                       int length) {
   auto self = static_cast<XmppStreamParser*>(user_data);
-  self->OnCharData(std::string{content, static_cast<size_t>(length)});
+  self->OnCharData(content, static_cast<size_t>(length));
 }
 
-void XmppStreamParser::OnOpenElement(
-    const std::string& node_name,
-    std::map<std::string, std::string> attributes) {
+void XmppStreamParser::OnOpenElement(const char* node_name,
+                                     const char** attributes) {
+  // The attributes go straight from the expat buffers into the node.
+  std::unique_ptr<XmlNode> node{new XmlNode{node_name, {}}};
+  if (attributes != nullptr) {
+    for (size_t n = 0; attributes[n] != nullptr && attributes[n + 1] != nullptr;
+         n += 2) {
+      node->attributes_.emplace(attributes[n], attributes[n + 1]);
+    }
+  }
   if (!started_) {
     started_ = true;
     if (delegate_)
-      delegate_->OnStreamStart(node_name, std::move(attributes));
+      delegate_->OnStreamStart(node->name_, std::move(node->attributes_));
     return;
   }
-  node_stack_.emplace(new XmlNode{node_name, std::move(attributes)});
+  node_stack_.push_back(std::move(node));
 }
 
 void XmppStreamParser::OnCloseElement(const std::string& node_name) {
@@ -77,20 +82,20 @@ void XmppStreamParser::OnCloseElement(const std::string& node_name) {
     return;
   }
 
-  auto node = std::move(node_stack_.top());
-  node_stack_.pop();
+  auto node = std::move(node_stack_.back());
+  node_stack_.pop_back();
   if (!node_stack_.empty()) {
-    XmlNode* parent = node_stack_.top().get();
+    XmlNode* parent = node_stack_.back().get();
     parent->AddChild(std::move(node));
   } else if (delegate_) {
     delegate_->OnStanza(std::move(node));
   }
 }
 
-void XmppStreamParser::OnCharData(const std::string& text) {
+void XmppStreamParser::OnCharData(const char* text, size_t length) {
   if (!node_stack_.empty()) {
-    XmlNode* node = node_stack_.top().get();
-    node->AppendText(text);
+    XmlNode* node = node_stack_.back().get();
+    node->AppendText(text, length);
   }
 }
 
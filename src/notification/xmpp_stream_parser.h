@@ -9,8 +9,8 @@
 
 #include <map>
 #include <memory>
-#include <stack>
 #include <string>
+#include <vector>
 
 #include <base/macros.h>
 
@@ -57,6 +57,9 @@ class XmppStreamParser final {
 
   // Parses additional XML data received from an input stream.
   void ParseData(const std::string& data);
+  // Same as above, but parses |size| bytes at |data| in place, e.g. straight
+  // from a socket read buffer.
+  void ParseData(const char* data, size_t size);
 
   // Resets the parser to expect the top-level stream node again.
   void Reset();
@@ -70,15 +73,15 @@ class XmppStreamParser final {
   static void HandleCharData(void* user_data, const char* content, int length);
 
   // Reinterpreted callbacks from expat with some data pre-processed.
-  void OnOpenElement(const std::string& node_name,
-                     std::map<std::string, std::string> attributes);
+  void OnOpenElement(const char* node_name, const char** attributes);
   void OnCloseElement(const std::string& node_name);
-  void OnCharData(const std::string& text);
+  void OnCharData(const char* text, size_t length);
 
   Delegate* delegate_;
   XML_Parser parser_{nullptr};
   bool started_{false};
-  std::stack<std::unique_ptr<XmlNode>> node_stack_;
+  // Elements being parsed, innermost last. Keeps its capacity across stanzas.
+  std::vector<std::unique_ptr<XmlNode>> node_stack_;
 
   DISALLOW_COPY_AND_ASSIGN(XmppStreamParser);
 };
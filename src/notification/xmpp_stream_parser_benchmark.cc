@@ -0,0 +1,78 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/notification/xmpp_stream_parser.h"
+
+#include <algorithm>
+
+#include <base/logging.h>
+
+#include "src/notification/xml_node.h"
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const char kStreamStart[] =
+    "<stream:stream from=\"clouddevices.gserviceaccount.com\" id=\"76EEB8FDB449"
+    "5558\" version=\"1.0\" xmlns:stream=\"http://etherx.jabber.org/streams\" x"
+    "mlns=\"jabber:client\">";
+
+const char kPushStanza[] =
+    "<message from=\"cloud-devices@clouddevices.google.com/srvenc-xgbCfg9hX6tCp"
+    "xoMYsExqg==\" to=\"4783f652b387449fc52a76f9a16e616f@clouddevices.gservicea"
+    "ccount.com/5A85ED9C\"><push:push channel=\"cloud_devices\" xmlns:push=\"go"
+    "ogle:push\"><push:recipient to=\"4783f652b387449fc52a76f9a16e616f@clouddev"
+    "ices.gserviceaccount.com\"></push:recipient><push:data>eyJraW5kIjoiY2xvdWR"
+    "kZXZpY2VzI25vdGlmaWNhdGlvbiIsInR5cGUiOiJDT01NQU5EX0NSRUFURUQiLCJjb21tYW5kS"
+    "WQiOiIwNWE3MTA5MC1hZWE4LWMzNzQtOTYwNS0xZTRhY2JhNDRmM2Y4OTAzZmM3Yy01NjExLWI"
+    "5ODAtOTkyMy0yNjc2YjYwYzkxMGMiLCJkZXZpY2VJZCI6IjA1YTcxMDkwLWFlYTgtYzM3NC05N"
+    "jA1LTFlNGFjYmE0NGYzZiJ9</push:data></push:push></message>";
+
+class CountingDelegate : public XmppStreamParser::Delegate {
+ public:
+  void OnStreamStart(const std::string& node_name,
+                     std::map<std::string, std::string> attributes) override {}
+  void OnStreamEnd(const std::string& node_name) override {}
+  void OnStanza(std::unique_ptr<XmlNode> stanza) override { ++stanza_count_; }
+
+  size_t stanza_count_{0};
+};
+
+}  // namespace
+
+// Parses a chunk of |size| push notification stanzas.
+WEAVE_BENCHMARK(XmppStreamParserParseData) {
+  CountingDelegate delegate;
+  XmppStreamParser parser{&delegate};
+  parser.ParseData(kStreamStart);
+  std::string data;
+  for (size_t i = 0; i < state->size(); ++i)
+    data += kPushStanza;
+  while (state->KeepRunning())
+    parser.ParseData(data);
+  CHECK_EQ(state->iterations() * state->size(), delegate.stanza_count_);
+}
+
+// Same as above, but feeds the stanzas in socket sized reads from one buffer.
+WEAVE_BENCHMARK(XmppStreamParserParseBuffer) {
+  CountingDelegate delegate;
+  XmppStreamParser parser{&delegate};
+  parser.ParseData(kStreamStart);
+  std::string data;
+  for (size_t i = 0; i < state->size(); ++i)
+    data += kPushStanza;
+  const size_t kReadSize = 4096;
+  state->set_bytes(data.size());
+  while (state->KeepRunning()) {
+    for (size_t pos = 0; pos < data.size(); pos += kReadSize) {
+      parser.ParseData(data.data() + pos,
+                       std::min(kReadSize, data.size() - pos));
+    }
+  }
+  CHECK_EQ(state->iterations() * state->size(), delegate.stanza_count_);
+}
+
+}  // namespace weave
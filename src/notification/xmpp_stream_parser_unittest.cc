@@ -110,6 +110,20 @@ TEST_F(XmppStreamParserTest, PartialStartElement) {
   EXPECT_EQ(expected_attrs, stream_start_node_attributes_);
 }
 
+TEST_F(XmppStreamParserTest, ParseBuffer) {
+  // Only the first |size| bytes of the buffer are parsed, the rest is stale
+  // data from an earlier read.
+  const char kBuffer[] = "<foo><bar a=\"1\">baz</bar></foo><stale>";
+  parser_->ParseData(kBuffer, 5);
+  EXPECT_TRUE(stream_started_);
+  parser_->ParseData(kBuffer + 5, 20);
+  ASSERT_EQ(1u, stanzas_.size());
+  EXPECT_EQ("<bar a=\"1\">baz</bar>", stanzas_[0]->ToString());
+  parser_->ParseData(kBuffer + 25, 6);
+  EXPECT_FALSE(stream_started_);
+  EXPECT_EQ(1u, stanzas_.size());
+}
+
 TEST_F(XmppStreamParserTest, VariableLengthPackets) {
   std::string value;
   const std::string xml_data = kXmppStreamData;
@@ -31,8 +31,13 @@ namespace {
 
 const size_t kMaxMacaroonSize = 1024;
 const size_t kMaxPendingClaims = 10;
+const size_t kMaxCachedAccessTokens = 16;
 const char kInvalidTokenError[] = "invalid_token";
 const int kSessionIdTtlMinutes = 1;
+// Prefixes of the hashed access tokens, so that raw and Base64-encoded tokens
+// never share entries of the access token cache.
+const char kRawTokenDigestPrefix[] = "raw:";
+const char kEncodedTokenDigestPrefix[] = "b64:";
 
 template <class T>
 void AppendToArray(T value, std::vector<uint8_t>* array) {
@@ -155,18 +160,15 @@ bool IsClaimAllowed(RootClientTokenOwner curret, RootClientTokenOwner claimer) {
 }
 
 std::vector<uint8_t> CreateMacaroonToken(
-    const std::vector<uint8_t>& secret,
+    UwCryptoHmacKey* key,
     const base::Time& time,
     const std::vector<const UwMacaroonCaveat*>& caveats) {
-  CHECK_EQ(kSha256OutputSize, secret.size());
-
   UwMacaroonContext context{};
   CHECK(uw_macaroon_context_create_(ToJ2000Time(time), nullptr, 0, nullptr, 0,
                                     &context));
 
   UwMacaroon macaroon{};
-  CHECK(uw_macaroon_create_from_root_key_(&macaroon, secret.data(),
-                                          secret.size(), &context,
+  CHECK(uw_macaroon_create_from_hmac_key_(&macaroon, key, &context,
                                           caveats.data(), caveats.size()));
 
   std::vector<uint8_t> serialized_token(kMaxMacaroonSize);
@@ -220,18 +222,16 @@ bool LoadMacaroon(const std::vector<uint8_t>& token,
   return true;
 }
 
-bool VerifyMacaroon(const std::vector<uint8_t>& secret,
+bool VerifyMacaroon(UwCryptoHmacKey* key,
                     const UwMacaroon& macaroon,
                     const base::Time& time,
                     UwMacaroonValidationResult* result,
                     ErrorPtr* error) {
-  CHECK_EQ(kSha256OutputSize, secret.size());
   UwMacaroonContext context = {};
   CHECK(uw_macaroon_context_create_(ToJ2000Time(time), nullptr, 0, nullptr, 0,
                                     &context));
 
-  if (!uw_macaroon_validate_(&macaroon, secret.data(), secret.size(), &context,
-                             result)) {
+  if (!uw_macaroon_validate_with_hmac_key_(&macaroon, key, &context, result)) {
     return Error::AddTo(error, FROM_HERE, "invalid_token",
                         "Invalid token signature");
   }
@@ -273,8 +273,8 @@ AuthManager::AuthManager(Config* config,
                          const std::vector<uint8_t>& certificate_fingerprint)
     : config_{config},
       black_list_{black_list},
-      certificate_fingerprint_{certificate_fingerprint},
-      access_secret_{CreateSecret()} {
+      certificate_fingerprint_{certificate_fingerprint} {
+  SetAccessSecret(CreateSecret());
   if (black_list_) {
     black_list_->AddEntryAddedCallback(base::Bind(
         &AuthManager::ResetAccessSecret, weak_ptr_factory_.GetWeakPtr()));
@@ -293,8 +293,8 @@ AuthManager::AuthManager(const std::vector<uint8_t>& auth_secret,
                          base::Clock* clock,
                          AccessRevocationManager* black_list)
     : AuthManager(nullptr, black_list, certificate_fingerprint) {
-  access_secret_ = access_secret.size() == kSha256OutputSize ? access_secret
-                                                             : CreateSecret();
+  SetAccessSecret(access_secret.size() == kSha256OutputSize ? access_secret
+                                                            : CreateSecret());
   SetAuthSecret(auth_secret, RootClientTokenOwner::kNone);
   if (clock)
     clock_ = clock;
@@ -308,6 +308,9 @@ void AuthManager::SetAuthSecret(const std::vector<uint8_t>& secret,
     auth_secret_ = CreateSecret();
     owner = RootClientTokenOwner::kNone;
   }
+  auth_key_.reset(
+      uw_crypto_hmac_key_create_(auth_secret_.data(), auth_secret_.size()));
+  CHECK(auth_key_);
 
   if (!config_ || (config_->GetSettings().secret == auth_secret_ &&
                    config_->GetSettings().root_client_token_owner == owner)) {
@@ -335,7 +338,7 @@ std::vector<uint8_t> AuthManager::CreateAccessToken(const UserInfo& user_info,
   AppIdCaveat app{user_info.id().app};
   ExpirationCaveat expiration{now + ttl};
   return CreateMacaroonToken(
-      access_secret_, now,
+      access_key_.get(), now,
       {
 
           &issued.GetCaveat(), &scope.GetCaveat(), &user.GetCaveat(),
@@ -346,6 +349,51 @@ std::vector<uint8_t> AuthManager::CreateAccessToken(const UserInfo& user_info,
 bool AuthManager::ParseAccessToken(const std::vector<uint8_t>& token,
                                    UserInfo* user_info,
                                    ErrorPtr* error) const {
+  TokenDigest digest;
+  crypto::SHA256HashString(
+      kRawTokenDigestPrefix + std::string{token.begin(), token.end()},
+      digest.data(), digest.size());
+  return FindCachedAccessToken(digest, user_info) ||
+         VerifyAccessToken(token, digest, user_info, error);
+}
+
+bool AuthManager::ParseEncodedAccessToken(const std::string& token,
+                                          UserInfo* user_info,
+                                          ErrorPtr* error) const {
+  TokenDigest digest;
+  crypto::SHA256HashString(kEncodedTokenDigestPrefix + token, digest.data(),
+                           digest.size());
+  if (FindCachedAccessToken(digest, user_info))
+    return true;
+
+  std::vector<uint8_t> decoded;
+  if (!Base64Decode(token, &decoded)) {
+    Error::AddToPrintf(error, FROM_HERE, errors::kInvalidAuthorization,
+                       "Invalid token encoding: %s", token.c_str());
+    return false;
+  }
+  return VerifyAccessToken(decoded, digest, user_info, error);
+}
+
+bool AuthManager::FindCachedAccessToken(const TokenDigest& digest,
+                                        UserInfo* user_info) const {
+  for (const auto& cached : access_token_cache_) {
+    if (cached.digest != digest)
+      continue;
+    // Let the full validation report the expired token.
+    if (cached.expiration < Now())
+      return false;
+    if (user_info)
+      *user_info = cached.user_info;
+    return true;
+  }
+  return false;
+}
+
+bool AuthManager::VerifyAccessToken(const std::vector<uint8_t>& token,
+                                    const TokenDigest& digest,
+                                    UserInfo* user_info,
+                                    ErrorPtr* error) const {
   std::vector<uint8_t> buffer;
   UwMacaroon macaroon{};
 
@@ -353,7 +401,7 @@ bool AuthManager::ParseAccessToken(const std::vector<uint8_t>& token,
   const base::Time now = Now();
   if (!LoadMacaroon(token, &buffer, &macaroon, error) ||
       macaroon.num_caveats != 5 ||
-      !VerifyMacaroon(access_secret_, macaroon, now, &result, error)) {
+      !VerifyMacaroon(access_key_.get(), macaroon, now, &result, error)) {
     return Error::AddTo(error, FROM_HERE, errors::kInvalidAuthorization,
                         "Invalid token");
   }
@@ -381,9 +429,19 @@ bool AuthManager::ParseAccessToken(const std::vector<uint8_t>& token,
   std::vector<uint8_t> app_id{
       result.delegatees[1].id,
       result.delegatees[1].id + result.delegatees[1].id_len};
+  CachedAccessToken cached{
+      digest, UserInfo{auth_scope, UserAppId{type, user_id, app_id}},
+      FromJ2000Time(result.expiration_time)};
   if (user_info)
-    *user_info = UserInfo{auth_scope, UserAppId{type, user_id, app_id}};
+    *user_info = cached.user_info;
 
+  if (access_token_cache_.size() < kMaxCachedAccessTokens) {
+    access_token_cache_.push_back(std::move(cached));
+  } else {
+    access_token_cache_[next_cached_access_token_] = std::move(cached);
+    next_cached_access_token_ =
+        (next_cached_access_token_ + 1) % kMaxCachedAccessTokens;
+  }
   return true;
 }
 
@@ -440,7 +498,7 @@ std::vector<uint8_t> AuthManager::GetRootClientAuthToken(
                            ? kUwMacaroonCaveatCloudServiceIdGoogleWeave
                            : kUwMacaroonCaveatCloudServiceIdNotCloudRegistered};
   return CreateMacaroonToken(
-      auth_secret_, now,
+      auth_key_.get(), now,
       {
           &auth_token.GetCaveat(), &issued.GetCaveat(), &client.GetCaveat(),
       });
@@ -463,7 +521,7 @@ bool AuthManager::IsValidAuthToken(const std::vector<uint8_t>& token,
   UwMacaroon macaroon{};
   UwMacaroonValidationResult result{};
   if (!LoadMacaroon(token, &buffer, &macaroon, error) ||
-      !VerifyMacaroon(auth_secret_, macaroon, Now(), &result, error)) {
+      !VerifyMacaroon(auth_key_.get(), macaroon, Now(), &result, error)) {
     return Error::AddTo(error, FROM_HERE, errors::kInvalidAuthCode,
                         "Invalid token");
   }
@@ -482,7 +540,7 @@ bool AuthManager::CreateAccessTokenFromAuth(
   UwMacaroonValidationResult result{};
   const base::Time now = Now();
   if (!LoadMacaroon(auth_token, &buffer, &macaroon, error) ||
-      !VerifyMacaroon(auth_secret_, macaroon, now, &result, error)) {
+      !VerifyMacaroon(auth_key_.get(), macaroon, now, &result, error)) {
     return Error::AddTo(error, FROM_HERE, errors::kInvalidAuthCode,
                         "Invalid token");
   }
@@ -578,10 +636,24 @@ bool AuthManager::IsValidSessionId(const std::string& session_id) const {
          ssid_time <= Now();
 }
 
+void AuthManager::HmacKeyDeleter::operator()(UwCryptoHmacKey* key) const {
+  uw_crypto_hmac_key_destroy_(key);
+}
+
+void AuthManager::SetAccessSecret(const std::vector<uint8_t>& secret) {
+  CHECK_EQ(kSha256OutputSize, secret.size());
+  access_secret_ = secret;
+  access_key_.reset(
+      uw_crypto_hmac_key_create_(access_secret_.data(), access_secret_.size()));
+  CHECK(access_key_);
+  access_token_cache_.clear();
+  next_cached_access_token_ = 0;
+}
+
 void AuthManager::ResetAccessSecret() {
   auto new_secret = CreateSecret();
   CHECK(new_secret != access_secret_);
-  access_secret_.swap(new_secret);
+  SetAccessSecret(new_secret);
 }
 
 std::vector<uint8_t> AuthManager::DelegateToUser(
@@ -5,7 +5,9 @@
 #ifndef LIBWEAVE_SRC_PRIVET_AUTH_MANAGER_H_
 #define LIBWEAVE_SRC_PRIVET_AUTH_MANAGER_H_
 
+#include <array>
 #include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -16,6 +18,9 @@
 #include <weave/error.h>
 
 #include "src/privet/privet_types.h"
+#include "third_party/chromium/crypto/sha2.h"
+
+struct UwCryptoHmacKey;
 
 namespace weave {
 
@@ -45,6 +50,11 @@ class AuthManager {
   bool ParseAccessToken(const std::vector<uint8_t>& token,
                         UserInfo* user_info,
                         ErrorPtr* error) const;
+  // Same as ParseAccessToken() for a Base64 encoded |token|. Tokens found in
+  // the cache are not decoded.
+  bool ParseEncodedAccessToken(const std::string& token,
+                               UserInfo* user_info,
+                               ErrorPtr* error) const;
 
   const std::vector<uint8_t>& GetAuthSecret() const { return auth_secret_; }
   const std::vector<uint8_t>& GetAccessSecret() const { return access_secret_; }
@@ -78,8 +88,32 @@ class AuthManager {
  private:
   friend class AuthManagerTest;
 
+  // SHA-256 of an access token, in any encoding.
+  using TokenDigest = std::array<uint8_t, crypto::kSHA256Length>;
+
+  // Validated access token.
+  struct CachedAccessToken {
+    TokenDigest digest;
+    UserInfo user_info;
+    base::Time expiration;
+  };
+
+  struct HmacKeyDeleter {
+    void operator()(UwCryptoHmacKey* key) const;
+  };
+  using HmacKey = std::unique_ptr<UwCryptoHmacKey, HmacKeyDeleter>;
+
+  void SetAccessSecret(const std::vector<uint8_t>& secret);
   void ResetAccessSecret();
 
+  // Validates |token| and caches the result under |digest| if it's valid.
+  bool VerifyAccessToken(const std::vector<uint8_t>& token,
+                         const TokenDigest& digest,
+                         UserInfo* user_info,
+                         ErrorPtr* error) const;
+  bool FindCachedAccessToken(const TokenDigest& digest,
+                             UserInfo* user_info) const;
+
   // Test helpers. Device does not need to implement delegation.
   std::vector<uint8_t> DelegateToUser(const std::vector<uint8_t>& token,
                                       base::TimeDelta ttl,
@@ -94,10 +128,21 @@ class AuthManager {
   std::vector<uint8_t> auth_secret_;  // Persistent.
   std::vector<uint8_t> certificate_fingerprint_;
   std::vector<uint8_t> access_secret_;  // New on every reboot.
+  // |auth_secret_| and |access_secret_| set up to sign, so that the tokens do
+  // not hash the secrets again.
+  HmacKey auth_key_;
+  HmacKey access_key_;
 
   std::deque<std::pair<std::unique_ptr<AuthManager>, RootClientTokenOwner>>
       pending_claims_;
 
+  // Recently validated access tokens, valid until |access_secret_| changes.
+  // Clients reuse a token for many requests, the cache saves validating it
+  // every time.
+  mutable std::vector<CachedAccessToken> access_token_cache_;
+  // Index of the cache entry to replace next once the cache is full.
+  mutable size_t next_cached_access_token_{0};
+
   base::WeakPtrFactory<AuthManager> weak_ptr_factory_{this};
   DISALLOW_COPY_AND_ASSIGN(AuthManager);
 };
@@ -0,0 +1,59 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/privet/auth_manager.h"
+
+#include <base/time/default_clock.h>
+
+#include "src/config.h"
+#include "src/test/benchmark.h"
+
+namespace weave {
+namespace privet {
+
+namespace {
+
+const std::vector<uint8_t> kSecret{
+    78, 40, 39, 68, 29, 19, 70, 86, 38, 61, 13, 55, 33, 32, 51, 52,
+    34, 43, 97, 48, 8,  56, 11, 99, 50, 59, 24, 26, 31, 71, 76, 28};
+
+}  // namespace
+
+// Parses a local access token. The benchmark does not depend on the size.
+WEAVE_BENCHMARK(AuthManagerParseAccessToken) {
+  base::DefaultClock clock;
+  AuthManager auth{kSecret, {}, kSecret, &clock};
+  std::vector<uint8_t> token = auth.CreateAccessToken(
+      UserInfo{AuthScope::kUser,
+               UserAppId{AuthType::kLocal, {1, 2, 3}, {4, 5, 6}}},
+      base::TimeDelta::FromHours(1));
+  while (state->KeepRunning()) {
+    UserInfo user_info;
+    CHECK(auth.ParseAccessToken(token, &user_info, nullptr));
+  }
+}
+
+// Creates a local access token.
+WEAVE_BENCHMARK(AuthManagerCreateAccessToken) {
+  base::DefaultClock clock;
+  AuthManager auth{kSecret, {}, kSecret, &clock};
+  const UserInfo user_info{AuthScope::kUser,
+                           UserAppId{AuthType::kLocal, {1, 2, 3}, {4, 5, 6}}};
+  while (state->KeepRunning())
+    CHECK(!auth.CreateAccessToken(user_info, base::TimeDelta::FromHours(1))
+               .empty());
+}
+
+// Verifies a root client auth token, which no cache short-cuts.
+WEAVE_BENCHMARK(AuthManagerVerifyAuthToken) {
+  base::DefaultClock clock;
+  AuthManager auth{kSecret, {}, kSecret, &clock};
+  std::vector<uint8_t> token =
+      auth.GetRootClientAuthToken(RootClientTokenOwner::kClient);
+  while (state->KeepRunning())
+    CHECK(auth.IsValidAuthToken(token, nullptr));
+}
+
+}  // namespace privet
+}  // namespace weave
@@ -222,6 +222,36 @@ TEST_F(AuthManagerTest, AccessTokenAfterReset) {
   EXPECT_TRUE(auth_.ParseAccessToken(token2, &user_info, nullptr));
 }
 
+TEST_F(AuthManagerTest, ParseEncodedAccessToken) {
+  // More tokens than the cache holds.
+  std::vector<std::string> tokens;
+  for (size_t i = 0; i < 20; ++i) {
+    tokens.push_back(Base64Encode(auth_.CreateAccessToken(
+        UserInfo{AuthScope::kUser, TestUserId{std::to_string(i)}}, {})));
+  }
+  for (size_t repeat = 0; repeat < 2; ++repeat) {
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      UserInfo user_info;
+      EXPECT_TRUE(
+          auth_.ParseEncodedAccessToken(tokens[i], &user_info, nullptr));
+      EXPECT_EQ(AuthScope::kUser, user_info.scope());
+      EXPECT_EQ(TestUserId{std::to_string(i)}, user_info.id());
+    }
+  }
+
+  // The text of a cached encoded token is no valid raw token.
+  EXPECT_FALSE(auth_.ParseAccessToken(
+      std::vector<uint8_t>{tokens[0].begin(), tokens[0].end()}, nullptr,
+      nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(auth_.ParseEncodedAccessToken("!", nullptr, &error));
+  EXPECT_TRUE(error->HasError("invalidAuthorization"));
+
+  black_list_.changed_callback_.Run();
+  EXPECT_FALSE(auth_.ParseEncodedAccessToken(tokens[0], nullptr, nullptr));
+}
+
 TEST_F(AuthManagerTest, AccessTokenBeforeJ2000) {
   EXPECT_CALL(clock_, Now())
       .WillRepeatedly(Return(base::Time::FromTimeT(5678)));
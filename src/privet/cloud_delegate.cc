@@ -149,12 +149,29 @@ class CloudDelegateImpl : public CloudDelegate {
     return device_->GetSettings().xmpp_endpoint;
   }
 
-  std::unique_ptr<base::DictionaryValue> GetComponentsForUser(
-      const UserInfo& user_info) const override {
+  const base::DictionaryValue& GetComponents() const override {
+    return component_manager_->GetComponents();
+  }
+
+  uint64_t GetLastStateChangeId() const override {
+    return component_manager_->GetLastStateChangeId();
+  }
+
+  bool GetStateChangesSince(
+      uint64_t id,
+      std::vector<ComponentStateChange>* changes) const override {
+    return component_manager_->GetStateChangesSince(id, changes);
+  }
+
+  bool IsStatePropertyVisible(const std::string& name,
+                              const UserInfo& user_info) const override {
     UserRole role;
     std::string str_scope = EnumToString(user_info.scope());
     CHECK(StringToEnum(str_scope, &role));
-    return component_manager_->GetComponentsForUserRole(role);
+    UserRole minimal_role;
+    return !component_manager_->GetStateMinimalRole(name, &minimal_role,
+                                                    nullptr) ||
+           minimal_role <= role;
   }
 
   const base::DictionaryValue* FindComponent(const std::string& path,
@@ -23,6 +23,7 @@ class DictionaryValue;
 namespace weave {
 
 class ComponentManager;
+struct ComponentStateChange;
 class DeviceRegistrationInfo;
 
 namespace provider {
@@ -89,15 +90,28 @@ class CloudDelegate {
   virtual std::string GetServiceUrl() const = 0;
   virtual std::string GetXmppEndpoint() const = 0;
 
-  // Returns dictionary with component tree. The components contain only the
-  // state visible to the given user.
-  virtual std::unique_ptr<base::DictionaryValue> GetComponentsForUser(
-      const UserInfo& user_info) const = 0;
+  // Returns dictionary with the live component tree, including the state
+  // which may not be visible to the user. See IsStatePropertyVisible().
+  virtual const base::DictionaryValue& GetComponents() const = 0;
+
+  // Checks if the state property |name| ("trait.property") is visible to the
+  // given user.
+  virtual bool IsStatePropertyVisible(const std::string& name,
+                                      const UserInfo& user_info) const = 0;
 
   // Finds a component at the given path. Return nullptr in case of an error.
   virtual const base::DictionaryValue* FindComponent(const std::string& path,
                                                      ErrorPtr* error) const = 0;
 
+  // Returns an ID of the last state change.
+  virtual uint64_t GetLastStateChangeId() const = 0;
+
+  // Returns the state changes made after the state change |id|, or false if
+  // they are no longer available.
+  virtual bool GetStateChangesSince(
+      uint64_t id,
+      std::vector<ComponentStateChange>* changes) const = 0;
+
   // Returns dictionary with trait definitions.
   virtual const base::DictionaryValue& GetTraits() const = 0;
 
@@ -21,6 +21,7 @@
 
 using testing::_;
 using testing::AtLeast;
+using testing::DoAll;
 using testing::Return;
 using testing::ReturnRef;
 using testing::SaveArg;
@@ -190,8 +191,12 @@ class MockCloudDelegate : public CloudDelegate {
   MOCK_CONST_METHOD0(GetOAuthUrl, std::string());
   MOCK_CONST_METHOD0(GetServiceUrl, std::string());
   MOCK_CONST_METHOD0(GetXmppEndpoint, std::string());
-  MOCK_CONST_METHOD1(MockGetComponentsForUser,
-                     const base::DictionaryValue&(const UserInfo&));
+  MOCK_CONST_METHOD0(GetComponents, const base::DictionaryValue&());
+  MOCK_CONST_METHOD2(IsStatePropertyVisible,
+                     bool(const std::string&, const UserInfo&));
+  MOCK_CONST_METHOD0(GetLastStateChangeId, uint64_t());
+  MOCK_CONST_METHOD2(GetStateChangesSince,
+                     bool(uint64_t, std::vector<ComponentStateChange>*));
   MOCK_CONST_METHOD2(FindComponent,
                      const base::DictionaryValue*(const std::string& path,
                                                   ErrorPtr* error));
@@ -234,8 +239,12 @@ class MockCloudDelegate : public CloudDelegate {
     EXPECT_CALL(*this, GetCloudId()).WillRepeatedly(Return("TestCloudId"));
     test_dict_.Set("test", new base::DictionaryValue);
     EXPECT_CALL(*this, GetTraits()).WillRepeatedly(ReturnRef(test_dict_));
-    EXPECT_CALL(*this, MockGetComponentsForUser(_))
-        .WillRepeatedly(ReturnRef(test_dict_));
+    EXPECT_CALL(*this, GetComponents()).WillRepeatedly(ReturnRef(test_dict_));
+    EXPECT_CALL(*this, IsStatePropertyVisible(_, _))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(*this, GetLastStateChangeId()).WillRepeatedly(Return(0));
+    EXPECT_CALL(*this, GetStateChangesSince(_, _))
+        .WillRepeatedly(Return(false));
     EXPECT_CALL(*this, FindComponent(_, _)).Times(0);
 
     EXPECT_CALL(*this, AddOnTraitsChangedCallback(_))
@@ -259,12 +268,6 @@ class MockCloudDelegate : public CloudDelegate {
   base::Closure on_traits_changed_;
   base::Closure on_state_changed_;
   base::Closure on_components_changed_;
-
- private:
-  std::unique_ptr<base::DictionaryValue> GetComponentsForUser(
-      const UserInfo& user_info) const override {
-    return MockGetComponentsForUser(user_info).CreateDeepCopy();
-  }
 };
 
 }  // namespace privet
@@ -8,18 +8,24 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <tuple>
 #include <utility>
 
 #include <base/bind.h>
+#include <base/json/json_writer.h>
 #include <base/location.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
 #include <base/strings/stringprintf.h>
 #include <base/values.h>
 #include <weave/device.h>
 #include <weave/enum_to_string.h>
 #include <weave/provider/task_runner.h>
 
+#include "src/component_manager.h"
 #include "src/config.h"
 #include "src/http_constants.h"
+#include "src/json_writer.h"
 #include "src/privet/cloud_delegate.h"
 #include "src/privet/constants.h"
 #include "src/privet/device_delegate.h"
@@ -28,6 +34,7 @@
 #include "src/privet/wifi_delegate.h"
 #include "src/string_utils.h"
 #include "src/utils.h"
+#include "third_party/chromium/crypto/sha2.h"
 
 namespace weave {
 namespace privet {
@@ -113,9 +120,15 @@ std::string api_key;
 std::string service_url;
 std::string xmpp_endpoint;
 
+const size_t kMaxCachedComponentsReplies = 16;
+// Number of state fingerprints for which state changes can be returned,
+// matches the size of the state change history of the component manager.
+const size_t kMaxStateChangeIds = 100;
+
 const char kFingerprintKey[] = "fingerprint";
 const char kTraitsKey[] = "traits";
 const char kComponentsKey[] = "components";
+const char kStateKey[] = "state";
 const char kCommandsIdKey[] = "id";
 const char kPathKey[] = "path";
 const char kFilterKey[] = "filter";
@@ -125,9 +138,16 @@ const char kCommandsFingerprintKey[] = "commandsFingerprint";
 const char kTraitsFingerprintKey[] = "traitsFingerprint";
 const char kComponentsFingerprintKey[] = "componentsFingerprint";
 const char kWaitTimeoutKey[] = "waitTimeout";
+const char kIncludeStateChangesKey[] = "includeStateChanges";
+const char kStateChangesKey[] = "stateChanges";
+const char kStateChangeComponentKey[] = "component";
+const char kStateChangePatchKey[] = "patch";
 
 const char kInvalidParamValueFormat[] = "Invalid parameter: '%s'='%s'";
 
+// Bytes of the SHA-256 of a reply used in its entity tag.
+const size_t kETagHashSize = 16;
+
 template <class Container>
 std::unique_ptr<base::ListValue> ToValue(const Container& list) {
   std::unique_ptr<base::ListValue> value_list(new base::ListValue());
@@ -193,8 +213,53 @@ void SetStateProperties(const T& state, base::DictionaryValue* parent) {
   parent->Set(kErrorKey, ErrorToJson(*state.error()));
 }
 
+void ReplyWithJson(const PrivetHandler::ReplyCallback& callback,
+                   int status,
+                   const base::DictionaryValue& output) {
+  JsonWriter::Chunks json;
+  JsonWriter writer{callback.encoding(), &json};
+  writer.Value(output);
+  callback.Run(status, json, {});
+}
+
+// The entity tag is the first 128 bits of the SHA-256 of the reply body, so a
+// changed body gets a different tag, even across restarts. The tag of a CBOR
+// reply has a suffix, so that it never matches the tag of the JSON encoding of
+// the same reply (RFC 7232, section 2.3.3).
+std::string CreateETag(const JsonWriter::Chunks& output,
+                       JsonWriter::Encoding encoding) {
+  std::string body;
+  for (const auto& chunk : output)
+    body += *chunk;
+  uint8_t hash[kETagHashSize];
+  crypto::SHA256HashString(body, hash, sizeof(hash));
+  const char* suffix = encoding == JsonWriter::Encoding::kCbor ? "-cbor" : "";
+  return base::StringPrintf("\"%s%s\"",
+                            base::HexEncode(hash, sizeof(hash)).c_str(),
+                            suffix);
+}
+
+// Replaces the reply with an empty 304 reply if its entity tag is listed in
+// |if_none_match|. Tags are compared weakly (RFC 7232, section 3.2), so a
+// "W/" prefix echoed by a client or a proxy is ignored.
+void ReplyIfModified(const std::string& if_none_match,
+                     const PrivetHandler::RequestCallback& callback,
+                     int status,
+                     const JsonWriter::Chunks& output,
+                     const std::string& etag) {
+  if (status == http::kOk && !etag.empty()) {
+    for (auto tag : Split(if_none_match, ",", true, true)) {
+      if (tag.compare(0, 2, "W/") == 0)
+        base::TrimWhitespaceASCII(tag.substr(2), base::TRIM_ALL, &tag);
+      if (tag == etag || tag == "*")
+        return callback.Run(http::kNotModified, {}, etag);
+    }
+  }
+  callback.Run(status, output, etag);
+}
+
 void ReturnError(const Error& error,
-                 const PrivetHandler::RequestCallback& callback) {
+                 const PrivetHandler::ReplyCallback& callback) {
   int code = http::kInternalServerError;
   for (const auto& it : kReasonToCode) {
     if (error.HasError(it.reason)) {
@@ -204,14 +269,14 @@ void ReturnError(const Error& error,
   }
   std::unique_ptr<base::DictionaryValue> output{new base::DictionaryValue};
   output->Set(kErrorKey, ErrorToJson(error));
-  callback.Run(code, *output);
+  ReplyWithJson(callback, code, *output);
 }
 
-void OnCommandRequestSucceeded(const PrivetHandler::RequestCallback& callback,
+void OnCommandRequestSucceeded(const PrivetHandler::ReplyCallback& callback,
                                const base::DictionaryValue& output,
                                ErrorPtr error) {
   if (!error)
-    return callback.Run(http::kOk, output);
+    return ReplyWithJson(callback, http::kOk, output);
 
   if (error->HasError("unknown_command")) {
     Error::AddTo(&error, FROM_HERE, errors::kNotFound, "Unknown command ID");
@@ -319,51 +384,137 @@ AuthScope GetAnonymousMaxScope(const CloudDelegate& cloud,
   return cloud.GetAnonymousMaxScope();
 }
 
+// Writes the state of a component, leaving out properties which are not
+// visible to the user. Mirrors ComponentManager::GetComponentsForUserRole():
+// traits with no visible properties left are omitted, and so is "state".
+class StateWriter {
+ public:
+  StateWriter(const CloudDelegate& cloud, const UserInfo& user_info)
+      : cloud_{cloud}, user_info_{user_info} {}
+
+  bool IsVisible(const std::string& trait, const std::string& name) const {
+    return cloud_.IsStatePropertyVisible(trait + '.' + name, user_info_);
+  }
+
+  // Returns true if |trait_state| is written at all.
+  bool IsTraitVisible(const std::string& trait,
+                      const base::DictionaryValue& trait_state) const {
+    if (trait_state.empty())
+      return true;
+    for (base::DictionaryValue::Iterator it(trait_state); !it.IsAtEnd();
+         it.Advance()) {
+      if (IsVisible(trait, it.key()))
+        return true;
+    }
+    return false;
+  }
+
+  bool IsStateVisible(const base::DictionaryValue& state) const {
+    if (state.empty())
+      return true;
+    for (base::DictionaryValue::Iterator it(state); !it.IsAtEnd();
+         it.Advance()) {
+      const base::DictionaryValue* trait_state = nullptr;
+      CHECK(it.value().GetAsDictionary(&trait_state));
+      if (IsTraitVisible(it.key(), *trait_state))
+        return true;
+    }
+    return false;
+  }
+
+  void Write(const base::DictionaryValue& state, JsonWriter* writer) const {
+    writer->BeginObject();
+    for (base::DictionaryValue::Iterator it(state); !it.IsAtEnd();
+         it.Advance()) {
+      const base::DictionaryValue* trait_state = nullptr;
+      CHECK(it.value().GetAsDictionary(&trait_state));
+      if (!IsTraitVisible(it.key(), *trait_state))
+        continue;
+      writer->Key(it.key());
+      writer->BeginObject();
+      for (base::DictionaryValue::Iterator it_prop(*trait_state);
+           !it_prop.IsAtEnd(); it_prop.Advance()) {
+        if (IsVisible(it.key(), it_prop.key())) {
+          writer->Key(it_prop.key());
+          writer->Value(it_prop.value());
+        }
+      }
+      writer->EndObject();
+    }
+    writer->EndObject();
+  }
+
+ private:
+  const CloudDelegate& cloud_;
+  const UserInfo& user_info_;
+};
+
 // Forward-declaration.
-std::unique_ptr<base::DictionaryValue> CloneComponentTree(
-    const base::DictionaryValue& parent,
-    const std::set<std::string>& filter);
-
-// Clones a particular component JSON object in a manner similar to that of
-// DeepCopy(), except it includes only sub-objects specified in |filter| (if not
-// empty) and has special handling for "components" sub-dictionary.
-std::unique_ptr<base::DictionaryValue> CloneComponent(
-    const base::DictionaryValue& component,
-    const std::set<std::string>& filter) {
-  std::unique_ptr<base::DictionaryValue> clone{new base::DictionaryValue};
+void WriteComponentTree(const base::DictionaryValue& parent,
+                        const std::set<std::string>& filter,
+                        const StateWriter& state_writer,
+                        JsonWriter* writer);
+
+// Writes a particular component JSON object straight from the component tree.
+// Includes only sub-objects specified in |filter| (if not empty) and has
+// special handling for "state" and "components" sub-dictionaries.
+void WriteComponent(const base::DictionaryValue& component,
+                    const std::set<std::string>& filter,
+                    const StateWriter& state_writer,
+                    JsonWriter* writer) {
+  writer->BeginObject();
   for (base::DictionaryValue::Iterator it(component); !it.IsAtEnd();
        it.Advance()) {
-    if (filter.empty() || filter.find(it.key()) != filter.end()) {
-      if (it.key() == kComponentsKey) {
-        // Handle "components" separately as we need to recursively clone
-        // sub-components.
-        const base::DictionaryValue* sub_components = nullptr;
-        CHECK(it.value().GetAsDictionary(&sub_components));
-        clone->SetWithoutPathExpansion(
-            it.key(), CloneComponentTree(*sub_components, filter));
-      } else {
-        clone->SetWithoutPathExpansion(it.key(), it.value().CreateDeepCopy());
+    if (!filter.empty() && filter.find(it.key()) == filter.end())
+      continue;
+    if (it.key() == kComponentsKey) {
+      // Handle "components" separately as we need to recursively write
+      // sub-components.
+      const base::DictionaryValue* sub_components = nullptr;
+      CHECK(it.value().GetAsDictionary(&sub_components));
+      writer->Key(it.key());
+      WriteComponentTree(*sub_components, filter, state_writer, writer);
+    } else if (it.key() == kStateKey) {
+      const base::DictionaryValue* state = nullptr;
+      CHECK(it.value().GetAsDictionary(&state));
+      if (state_writer.IsStateVisible(*state)) {
+        writer->Key(it.key());
+        state_writer.Write(*state, writer);
       }
+    } else {
+      writer->Key(it.key());
+      writer->Value(it.value());
     }
   }
-  return clone;
+  writer->EndObject();
 }
 
-// Clones a dictionary containing a bunch of component JSON objects in a manner
-// similar to that of CreateDeepCopy(). Calls CloneComponent() on each instance
-// of the component sub-object.
-std::unique_ptr<base::DictionaryValue> CloneComponentTree(
-    const base::DictionaryValue& parent,
-    const std::set<std::string>& filter) {
-  std::unique_ptr<base::DictionaryValue> clone{new base::DictionaryValue};
+// Writes a dictionary containing a bunch of component JSON objects. Calls
+// WriteComponent() on each component, including the items of component
+// arrays.
+void WriteComponentTree(const base::DictionaryValue& parent,
+                        const std::set<std::string>& filter,
+                        const StateWriter& state_writer,
+                        JsonWriter* writer) {
+  writer->BeginObject();
   for (base::DictionaryValue::Iterator it(parent); !it.IsAtEnd();
        it.Advance()) {
+    writer->Key(it.key());
     const base::DictionaryValue* component = nullptr;
-    CHECK(it.value().GetAsDictionary(&component));
-    clone->SetWithoutPathExpansion(
-        it.key(), CloneComponent(*component, filter));
+    const base::ListValue* component_array = nullptr;
+    if (it.value().GetAsList(&component_array)) {
+      writer->BeginList();
+      for (const auto& item : *component_array) {
+        CHECK(item->GetAsDictionary(&component));
+        WriteComponent(*component, filter, state_writer, writer);
+      }
+      writer->EndList();
+    } else {
+      CHECK(it.value().GetAsDictionary(&component));
+      WriteComponent(*component, filter, state_writer, writer);
+    }
   }
-  return clone;
+  writer->EndObject();
 }
 
 }  // namespace
@@ -399,6 +550,8 @@ PrivetHandler::PrivetHandler(CloudDelegate* cloud,
   CHECK(security_);
   CHECK(clock_);
 
+  state_change_ids_.emplace_back(state_fingerprint_,
+                                 cloud_->GetLastStateChangeId());
   cloud_->AddOnTraitsChangedCallback(base::Bind(
       &PrivetHandler::OnTraitDefsChanged, weak_ptr_factory_.GetWeakPtr()));
   cloud_->AddOnStateChangedCallback(base::Bind(&PrivetHandler::OnStateChanged,
@@ -442,52 +595,73 @@ PrivetHandler::PrivetHandler(CloudDelegate* cloud,
 }
 
 PrivetHandler::~PrivetHandler() {
-  for (const auto& req : update_requests_)
-    ReplyToUpdateRequest(req.callback);
+  for (const auto& pair : update_requests_)
+    ReplyToUpdateRequest(pair.second);
 }
 
 void PrivetHandler::OnTraitDefsChanged() {
   ++traits_fingerprint_;
-  auto pred = [](const UpdateRequestParameters& params) {
-    return params.traits_fingerprint == 0;
-  };
-  auto last =
-      std::partition(update_requests_.begin(), update_requests_.end(), pred);
-  for (auto p = last; p != update_requests_.end(); ++p)
-    ReplyToUpdateRequest(p->callback);
-  update_requests_.erase(last, update_requests_.end());
+  traits_replies_.clear();
+  // Trait definitions control which state is visible to the user.
+  components_replies_.clear();
+  WakeUpdateRequests(&traits_waiters_);
 }
 
 void PrivetHandler::OnStateChanged() {
   // State updates also change the component tree, so update both fingerprints.
   ++state_fingerprint_;
   ++components_fingerprint_;
-  auto pred = [](const UpdateRequestParameters& params) {
-    return params.state_fingerprint == 0 && params.components_fingerprint == 0;
-  };
-  auto last =
-      std::partition(update_requests_.begin(), update_requests_.end(), pred);
-  for (auto p = last; p != update_requests_.end(); ++p)
-    ReplyToUpdateRequest(p->callback);
-  update_requests_.erase(last, update_requests_.end());
+  components_replies_.clear();
+  if (state_change_ids_.size() >= kMaxStateChangeIds)
+    state_change_ids_.pop_front();
+  state_change_ids_.emplace_back(state_fingerprint_,
+                                 cloud_->GetLastStateChangeId());
+  WakeUpdateRequests(&state_waiters_);
+  WakeUpdateRequests(&components_waiters_);
 }
 
 void PrivetHandler::OnComponentTreeChanged() {
   ++components_fingerprint_;
-  auto pred = [](const UpdateRequestParameters& params) {
-    return params.components_fingerprint == 0;
-  };
-  auto last =
-      std::partition(update_requests_.begin(), update_requests_.end(), pred);
-  for (auto p = last; p != update_requests_.end(); ++p)
-    ReplyToUpdateRequest(p->callback);
-  update_requests_.erase(last, update_requests_.end());
+  components_replies_.clear();
+  WakeUpdateRequests(&components_waiters_);
+}
+
+void PrivetHandler::WakeUpdateRequests(std::set<int>* waiters) {
+  if (waiters->empty())
+    return;
+  woken_update_requests_.insert(waiters->begin(), waiters->end());
+  waiters->clear();
+  // Reply to the woken requests from a task, so that a burst of changes, e.g.
+  // several state properties set by a command handler, results in a single
+  // reply with the final fingerprints.
+  if (wakeup_pending_)
+    return;
+  wakeup_pending_ = true;
+  device_->PostDelayedTask(
+      FROM_HERE, base::Bind(&PrivetHandler::OnUpdateRequestsWoken,
+                            weak_ptr_factory_.GetWeakPtr()),
+      {});
+}
+
+void PrivetHandler::OnUpdateRequestsWoken() {
+  wakeup_pending_ = false;
+  std::set<int> woken;
+  woken.swap(woken_update_requests_);
+  ReplyToUpdateRequests(woken);
 }
 
 void PrivetHandler::HandleRequest(const std::string& api,
                                   const std::string& auth_header,
+                                  const std::string& if_none_match,
+                                  JsonWriter::Encoding encoding,
                                   const base::DictionaryValue* input,
-                                  const RequestCallback& callback) {
+                                  const RequestCallback& reply_callback) {
+  ReplyCallback callback{encoding, reply_callback};
+  if (!if_none_match.empty()) {
+    callback = ReplyCallback{
+        encoding, base::Bind(&ReplyIfModified, if_none_match, reply_callback)};
+  }
+
   ErrorPtr error;
   if (!input) {
     Error::AddTo(&error, FROM_HERE, errors::kInvalidFormat, "Malformed JSON");
@@ -546,7 +720,7 @@ void PrivetHandler::AddSecureHandler(const std::string& path,
 
 void PrivetHandler::HandleInfo(const base::DictionaryValue&,
                                const UserInfo& user_info,
-                               const RequestCallback& callback) {
+                               const ReplyCallback& callback) {
   base::DictionaryValue output;
 
   std::string name = cloud_->GetName();
@@ -584,12 +758,12 @@ void PrivetHandler::HandleInfo(const base::DictionaryValue&,
   output.SetDouble(kInfoTimeKey, clock_->Now().ToJsTime());
   output.SetString(kInfoSessionIdKey, security_->CreateSessionId());
 
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandlePairingStart(const base::DictionaryValue& input,
                                        const UserInfo& user_info,
-                                       const RequestCallback& callback) {
+                                       const ReplyCallback& callback) {
   ErrorPtr error;
 
   std::string pairing_str;
@@ -626,12 +800,12 @@ void PrivetHandler::HandlePairingStart(const base::DictionaryValue& input,
   base::DictionaryValue output;
   output.SetString(kPairingSessionIdKey, id);
   output.SetString(kPairingDeviceCommitmentKey, commitment);
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandlePairingConfirm(const base::DictionaryValue& input,
                                          const UserInfo& user_info,
-                                         const RequestCallback& callback) {
+                                         const ReplyCallback& callback) {
   std::string id;
   input.GetString(kPairingSessionIdKey, &id);
 
@@ -649,12 +823,12 @@ void PrivetHandler::HandlePairingConfirm(const base::DictionaryValue& input,
   base::DictionaryValue output;
   output.SetString(kPairingFingerprintKey, fingerprint);
   output.SetString(kPairingSignatureKey, signature);
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandlePairingCancel(const base::DictionaryValue& input,
                                         const UserInfo& user_info,
-                                        const RequestCallback& callback) {
+                                        const ReplyCallback& callback) {
   std::string id;
   input.GetString(kPairingSessionIdKey, &id);
 
@@ -663,12 +837,12 @@ void PrivetHandler::HandlePairingCancel(const base::DictionaryValue& input,
     return ReturnError(*error, callback);
 
   base::DictionaryValue output;
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandleAuth(const base::DictionaryValue& input,
                                const UserInfo& user_info,
-                               const RequestCallback& callback) {
+                               const ReplyCallback& callback) {
   ErrorPtr error;
 
   std::string auth_code_type;
@@ -727,12 +901,12 @@ void PrivetHandler::HandleAuth(const base::DictionaryValue& input,
   output.SetInteger(kAuthExpiresInKey, access_token_ttl.InSeconds());
   output.SetString(kAuthScopeKey, EnumToString(access_token_scope));
 
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandleAccessControlClaim(const base::DictionaryValue& input,
                                              const UserInfo& user_info,
-                                             const RequestCallback& callback) {
+                                             const ReplyCallback& callback) {
   ErrorPtr error;
   auto token = security_->ClaimRootClientAuthToken(&error);
   if (token.empty())
@@ -740,13 +914,13 @@ void PrivetHandler::HandleAccessControlClaim(const base::DictionaryValue& input,
 
   base::DictionaryValue output;
   output.SetString(kAuthClientTokenKey, token);
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandleAccessControlConfirm(
     const base::DictionaryValue& input,
     const UserInfo& user_info,
-    const RequestCallback& callback) {
+    const ReplyCallback& callback) {
   ErrorPtr error;
 
   std::string token;
@@ -761,12 +935,12 @@ void PrivetHandler::HandleAccessControlConfirm(
     return ReturnError(*error, callback);
 
   base::DictionaryValue output;
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandleSetupStart(const base::DictionaryValue& input,
                                      const UserInfo& user_info,
-                                     const RequestCallback& callback) {
+                                     const ReplyCallback& callback) {
   std::string name{cloud_->GetName()};
   input.GetString(kNameKey, &name);
 
@@ -845,12 +1019,11 @@ void PrivetHandler::HandleSetupStart(const base::DictionaryValue& input,
 
 void PrivetHandler::HandleSetupStatus(const base::DictionaryValue&,
                                       const UserInfo& user_info,
-                                      const RequestCallback& callback) {
+                                      const ReplyCallback& callback) {
   ReplyWithSetupStatus(callback);
 }
 
-void PrivetHandler::ReplyWithSetupStatus(
-    const RequestCallback& callback) const {
+void PrivetHandler::ReplyWithSetupStatus(const ReplyCallback& callback) const {
   base::DictionaryValue output;
 
   const SetupState& state = cloud_->GetSetupState();
@@ -874,25 +1047,32 @@ void PrivetHandler::ReplyWithSetupStatus(
     }
   }
 
-  callback.Run(http::kOk, output);
+  ReplyWithJson(callback, http::kOk, output);
 }
 
 void PrivetHandler::HandleTraits(const base::DictionaryValue& input,
                                  const UserInfo& user_info,
-                                 const RequestCallback& callback) {
-  base::DictionaryValue output;
-  output.Set(kTraitsKey, cloud_->GetTraits().CreateDeepCopy());
-  output.SetString(kFingerprintKey, std::to_string(traits_fingerprint_));
+                                 const ReplyCallback& callback) {
+  CachedReply& reply = traits_replies_[callback.encoding()];
+  if (reply.output.empty()) {
+    JsonWriter writer{callback.encoding(), &reply.output};
+    writer.BeginObject();
+    writer.Key(kFingerprintKey);
+    writer.String(std::to_string(traits_fingerprint_));
+    writer.Key(kTraitsKey);
+    writer.Value(cloud_->GetTraits());
+    writer.EndObject();
+    reply.etag = CreateETag(reply.output, callback.encoding());
+  }
 
-  callback.Run(http::kOk, output);
+  callback.Run(http::kOk, reply.output, reply.etag);
 }
 
 void PrivetHandler::HandleComponents(const base::DictionaryValue& input,
                                      const UserInfo& user_info,
-                                     const RequestCallback& callback) {
+                                     const ReplyCallback& callback) {
   std::string path;
   std::set<std::string> filter;
-  std::unique_ptr<base::DictionaryValue> components;
 
   input.GetString(kPathKey, &path);
   const base::ListValue* filter_items = nullptr;
@@ -903,37 +1083,70 @@ void PrivetHandler::HandleComponents(const base::DictionaryValue& input,
         filter.insert(filter_item);
     }
   }
+
+  // The parts are serialized as a JSON list, so that no path or filter item
+  // can make two different requests share a key.
+  base::ListValue key_parts;
+  key_parts.AppendInteger(static_cast<int>(callback.encoding()));
+  key_parts.AppendString(EnumToString(user_info.scope()));
+  key_parts.AppendString(path);
+  for (const auto& filter_item : filter)
+    key_parts.AppendString(filter_item);
+  std::string key;
+  base::JSONWriter::Write(key_parts, &key);
+  auto cached = components_replies_.find(key);
+  if (cached != components_replies_.end()) {
+    return callback.Run(http::kOk, cached->second.output,
+                        cached->second.etag);
+  }
+
   const base::DictionaryValue* component = nullptr;
   if (!path.empty()) {
     ErrorPtr error;
     component = cloud_->FindComponent(path, &error);
     if (!component)
       return ReturnError(*error, callback);
-    components.reset(new base::DictionaryValue);
+  }
+
+  // The reply is written straight from the live component tree, applying
+  // |filter| and the user's access to the state on the fly.
+  StateWriter state_writer{*cloud_, user_info};
+  // Each distinct combination of the parameters gets an entry, so limit the
+  // number of entries kept between changes.
+  if (components_replies_.size() >= kMaxCachedComponentsReplies)
+    components_replies_.clear();
+  CachedReply& reply = components_replies_[key];
+  JsonWriter writer{callback.encoding(), &reply.output};
+  writer.BeginObject();
+  writer.Key(kComponentsKey);
+  if (component) {
+    writer.BeginObject();
     // Get the last element of the path and use it as a dictionary key here.
     auto parts = Split(path, ".", true, false);
-    components->Set(parts.back(), CloneComponent(*component, filter));
+    writer.Key(parts.back());
+    WriteComponent(*component, filter, state_writer, &writer);
+    writer.EndObject();
   } else {
-    components =
-        CloneComponentTree(*cloud_->GetComponentsForUser(user_info), filter);
+    WriteComponentTree(cloud_->GetComponents(), filter, state_writer, &writer);
   }
-  base::DictionaryValue output;
-  output.Set(kComponentsKey, std::move(components));
-  output.SetString(kFingerprintKey, std::to_string(components_fingerprint_));
+  writer.Key(kFingerprintKey);
+  writer.String(std::to_string(components_fingerprint_));
+  writer.EndObject();
+  reply.etag = CreateETag(reply.output, callback.encoding());
 
-  callback.Run(http::kOk, output);
+  callback.Run(http::kOk, reply.output, reply.etag);
 }
 
 void PrivetHandler::HandleCommandsExecute(const base::DictionaryValue& input,
                                           const UserInfo& user_info,
-                                          const RequestCallback& callback) {
+                                          const ReplyCallback& callback) {
   cloud_->AddCommand(input, user_info,
                      base::Bind(&OnCommandRequestSucceeded, callback));
 }
 
 void PrivetHandler::HandleCommandsStatus(const base::DictionaryValue& input,
                                          const UserInfo& user_info,
-                                         const RequestCallback& callback) {
+                                         const ReplyCallback& callback) {
   std::string id;
   if (!input.GetString(kCommandsIdKey, &id)) {
     ErrorPtr error;
@@ -947,14 +1160,14 @@ void PrivetHandler::HandleCommandsStatus(const base::DictionaryValue& input,
 
 void PrivetHandler::HandleCommandsList(const base::DictionaryValue& input,
                                        const UserInfo& user_info,
-                                       const RequestCallback& callback) {
+                                       const ReplyCallback& callback) {
   cloud_->ListCommands(user_info,
                        base::Bind(&OnCommandRequestSucceeded, callback));
 }
 
 void PrivetHandler::HandleCommandsCancel(const base::DictionaryValue& input,
                                          const UserInfo& user_info,
-                                         const RequestCallback& callback) {
+                                         const ReplyCallback& callback) {
   std::string id;
   if (!input.GetString(kCommandsIdKey, &id)) {
     ErrorPtr error;
@@ -968,7 +1181,7 @@ void PrivetHandler::HandleCommandsCancel(const base::DictionaryValue& input,
 
 void PrivetHandler::HandleCheckForUpdates(const base::DictionaryValue& input,
                                           const UserInfo& user_info,
-                                          const RequestCallback& callback) {
+                                          const ReplyCallback& callback) {
   int timeout_seconds = -1;
   input.GetInteger(kWaitTimeoutKey, &timeout_seconds);
   base::TimeDelta timeout = device_->GetHttpRequestTimeout();
@@ -984,8 +1197,6 @@ void PrivetHandler::HandleCheckForUpdates(const base::DictionaryValue& input,
   }
   if (timeout_seconds >= 0)
     timeout = std::min(timeout, base::TimeDelta::FromSeconds(timeout_seconds));
-  if (timeout == base::TimeDelta{})
-    return ReplyToUpdateRequest(callback);
 
   std::string state_fingerprint;
   std::string commands_fingerprint;
@@ -995,76 +1206,186 @@ void PrivetHandler::HandleCheckForUpdates(const base::DictionaryValue& input,
   input.GetString(kCommandsFingerprintKey, &commands_fingerprint);
   input.GetString(kTraitsFingerprintKey, &traits_fingerprint);
   input.GetString(kComponentsFingerprintKey, &components_fingerprint);
+
+  UpdateRequestParameters params;
+  params.callback = callback;
+  params.user_info = user_info;
+  input.GetBoolean(kIncludeStateChangesKey, &params.include_state_changes);
+  base::StringToUint64(state_fingerprint, &params.known_state_fingerprint);
+
+  if (timeout == base::TimeDelta{})
+    return ReplyToUpdateRequest(params);
+
   const bool ignore_state = state_fingerprint.empty();
   const bool ignore_commands = commands_fingerprint.empty();
   const bool ignore_traits = traits_fingerprint.empty();
   const bool ignore_components = components_fingerprint.empty();
   // If all fingerprints are missing, nothing to wait for, return immediately.
   if (ignore_state && ignore_commands && ignore_traits && ignore_components)
-    return ReplyToUpdateRequest(callback);
+    return ReplyToUpdateRequest(params);
   // If the current state fingerprint is different from the requested one,
   // return new fingerprints.
   if (!ignore_state && state_fingerprint != std::to_string(state_fingerprint_))
-    return ReplyToUpdateRequest(callback);
+    return ReplyToUpdateRequest(params);
   // If the current commands fingerprint is different from the requested one,
   // return new fingerprints.
   // NOTE: We are using traits fingerprint for command fingerprint as well.
   if (!ignore_commands &&
       commands_fingerprint != std::to_string(traits_fingerprint_)) {
-    return ReplyToUpdateRequest(callback);
+    return ReplyToUpdateRequest(params);
   }
   // If the current traits fingerprint is different from the requested one,
   // return new fingerprints.
   if (!ignore_traits &&
       traits_fingerprint != std::to_string(traits_fingerprint_)) {
-    return ReplyToUpdateRequest(callback);
+    return ReplyToUpdateRequest(params);
   }
   // If the current components fingerprint is different from the requested one,
   // return new fingerprints.
   if (!ignore_components &&
       components_fingerprint != std::to_string(components_fingerprint_)) {
-    return ReplyToUpdateRequest(callback);
+    return ReplyToUpdateRequest(params);
   }
 
-  UpdateRequestParameters params;
   params.request_id = ++last_update_request_id_;
-  params.callback = callback;
-  params.traits_fingerprint =
-      (ignore_traits && ignore_commands) ? 0 : traits_fingerprint_;
-  params.state_fingerprint = ignore_state ? 0 : state_fingerprint_;
-  params.components_fingerprint =
-      ignore_components ? 0 : components_fingerprint_;
-  update_requests_.push_back(params);
+  if (!ignore_traits || !ignore_commands)
+    traits_waiters_.insert(params.request_id);
+  if (!ignore_state)
+    state_waiters_.insert(params.request_id);
+  if (!ignore_components)
+    components_waiters_.insert(params.request_id);
   if (timeout != base::TimeDelta::Max()) {
-    device_->PostDelayedTask(
-        FROM_HERE,
-        base::Bind(&PrivetHandler::OnUpdateRequestTimeout,
-                   weak_ptr_factory_.GetWeakPtr(), last_update_request_id_),
-        timeout);
+    params.deadline = clock_->Now() + timeout;
+    update_timeouts_.emplace(params.deadline, params.request_id);
   }
+  update_requests_.emplace(params.request_id, params);
+  ScheduleUpdateRequestTimeout();
 }
 
 void PrivetHandler::ReplyToUpdateRequest(
-    const RequestCallback& callback) const {
-  base::DictionaryValue output;
-  output.SetString(kStateFingerprintKey, std::to_string(state_fingerprint_));
-  output.SetString(kCommandsFingerprintKey,
-                   std::to_string(traits_fingerprint_));
-  output.SetString(kTraitsFingerprintKey, std::to_string(traits_fingerprint_));
-  output.SetString(kComponentsFingerprintKey,
-                   std::to_string(components_fingerprint_));
-  callback.Run(http::kOk, output);
+    const UpdateRequestParameters& params) const {
+  params.callback.Run(http::kOk, CreateUpdateReply(params), {});
 }
 
-void PrivetHandler::OnUpdateRequestTimeout(int update_request_id) {
-  auto pred = [update_request_id](const UpdateRequestParameters& params) {
-    return params.request_id != update_request_id;
+JsonWriter::Chunks PrivetHandler::CreateUpdateReply(
+    const UpdateRequestParameters& params) const {
+  JsonWriter::Chunks json;
+  JsonWriter writer{params.callback.encoding(), &json};
+  writer.BeginObject();
+  writer.Key(kCommandsFingerprintKey);
+  writer.String(std::to_string(traits_fingerprint_));
+  if (params.include_state_changes)
+    WriteStateChanges(params, &writer);
+  writer.Key(kComponentsFingerprintKey);
+  writer.String(std::to_string(components_fingerprint_));
+  writer.Key(kStateFingerprintKey);
+  writer.String(std::to_string(state_fingerprint_));
+  writer.Key(kTraitsFingerprintKey);
+  writer.String(std::to_string(traits_fingerprint_));
+  writer.EndObject();
+  return json;
+}
+
+void PrivetHandler::WriteStateChanges(const UpdateRequestParameters& params,
+                                      JsonWriter* writer) const {
+  StateWriter state_writer{*cloud_, params.user_info};
+  // Find the state change ID the client's state fingerprint corresponds to.
+  auto pred = [](const std::pair<uint64_t, uint64_t>& item, uint64_t value) {
+    return item.first < value;
   };
-  auto last =
-      std::partition(update_requests_.begin(), update_requests_.end(), pred);
-  for (auto p = last; p != update_requests_.end(); ++p)
-    ReplyToUpdateRequest(p->callback);
-  update_requests_.erase(last, update_requests_.end());
+  auto it = std::lower_bound(state_change_ids_.begin(), state_change_ids_.end(),
+                             params.known_state_fingerprint, pred);
+  std::vector<ComponentStateChange> changes;
+  if (it == state_change_ids_.end() ||
+      it->first != params.known_state_fingerprint ||
+      !cloud_->GetStateChangesSince(it->second, &changes)) {
+    // The changes are not available, send the whole component tree instead.
+    writer->Key(kComponentsKey);
+    WriteComponentTree(cloud_->GetComponents(), {}, state_writer, writer);
+    return;
+  }
+
+  writer->Key(kStateChangesKey);
+  writer->BeginList();
+  for (const ComponentStateChange& change : changes) {
+    if (!state_writer.IsStateVisible(*change.changed_properties))
+      continue;
+    writer->BeginObject();
+    writer->Key(kStateChangeComponentKey);
+    writer->String(change.component);
+    writer->Key(kStateChangePatchKey);
+    state_writer.Write(*change.changed_properties, writer);
+    writer->EndObject();
+  }
+  writer->EndList();
+}
+
+void PrivetHandler::ReplyToUpdateRequests(const std::set<int>& request_ids) {
+  // Requests which get the same reply share a single serialized copy of it.
+  using ReplyKey = std::tuple<JsonWriter::Encoding, bool, AuthScope, uint64_t>;
+  std::map<ReplyKey, JsonWriter::Chunks> replies;
+  for (int id : request_ids) {
+    auto it = update_requests_.find(id);
+    if (it == update_requests_.end())
+      continue;
+    UpdateRequestParameters params = std::move(it->second);
+    RemoveUpdateRequest(it);
+    ReplyKey key{params.callback.encoding(), false, AuthScope::kNone, 0};
+    if (params.include_state_changes) {
+      key = ReplyKey{params.callback.encoding(), true,
+                     params.user_info.scope(), params.known_state_fingerprint};
+    }
+    auto reply = replies.find(key);
+    if (reply == replies.end())
+      reply = replies.emplace(key, CreateUpdateReply(params)).first;
+    params.callback.Run(http::kOk, reply->second, {});
+  }
+}
+
+void PrivetHandler::RemoveUpdateRequest(
+    std::map<int, UpdateRequestParameters>::iterator it) {
+  int id = it->first;
+  traits_waiters_.erase(id);
+  state_waiters_.erase(id);
+  components_waiters_.erase(id);
+  woken_update_requests_.erase(id);
+  if (!it->second.deadline.is_null()) {
+    auto range = update_timeouts_.equal_range(it->second.deadline);
+    for (auto timeout = range.first; timeout != range.second; ++timeout) {
+      if (timeout->second == id) {
+        update_timeouts_.erase(timeout);
+        break;
+      }
+    }
+  }
+  update_requests_.erase(it);
+}
+
+void PrivetHandler::ScheduleUpdateRequestTimeout() {
+  if (update_timeouts_.empty())
+    return;
+  // All requests share a single timer task for the earliest deadline. Tasks
+  // can't be cancelled, so a task stays pending even if its requests are
+  // answered earlier.
+  base::Time deadline = update_timeouts_.begin()->first;
+  if (!pending_timeouts_.empty() && *pending_timeouts_.begin() <= deadline)
+    return;
+  pending_timeouts_.insert(deadline);
+  device_->PostDelayedTask(
+      FROM_HERE, base::Bind(&PrivetHandler::OnUpdateRequestTimeout,
+                            weak_ptr_factory_.GetWeakPtr(), deadline),
+      std::max(deadline - clock_->Now(), base::TimeDelta{}));
+}
+
+void PrivetHandler::OnUpdateRequestTimeout(base::Time deadline) {
+  pending_timeouts_.erase(deadline);
+  std::set<int> expired;
+  for (auto it = update_timeouts_.begin();
+       it != update_timeouts_.end() && it->first <= deadline; ++it) {
+    expired.insert(it->second);
+  }
+  ReplyToUpdateRequests(expired);
+  ScheduleUpdateRequestTimeout();
 }
 
 }  // namespace privet
@@ -5,15 +5,21 @@
 #ifndef LIBWEAVE_SRC_PRIVET_PRIVET_HANDLER_H_
 #define LIBWEAVE_SRC_PRIVET_PRIVET_HANDLER_H_
 
+#include <deque>
 #include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <base/macros.h>
 #include <base/memory/weak_ptr.h>
 #include <base/time/default_clock.h>
+#include <base/time/time.h>
 #include <weave/settings.h>
 
+#include "src/json_writer.h"
 #include "src/privet/cloud_delegate.h"
 
 namespace base {
@@ -35,10 +41,33 @@ class PrivetHandler {
  public:
   // Callback to handle requests asynchronously.
   // |status| is HTTP status code.
-  // |output| is result returned in HTTP response. Contains result of
-  // successfully request of information about error.
-  using RequestCallback =
-      base::Callback<void(int status, const base::DictionaryValue& output)>;
+  // |output| is JSON or CBOR returned in HTTP response. Contains result of
+  // successfully request of information about error. The buffers may be
+  // shared with cached replies.
+  // |etag| is the entity tag of |output|, or empty if the reply has none.
+  using RequestCallback = base::Callback<void(int status,
+                                              const JsonWriter::Chunks& output,
+                                              const std::string& etag)>;
+
+  // RequestCallback of a request and the encoding to write its reply in.
+  class ReplyCallback {
+   public:
+    ReplyCallback() = default;
+    ReplyCallback(JsonWriter::Encoding encoding,
+                  const RequestCallback& callback)
+        : encoding_{encoding}, callback_{callback} {}
+
+    JsonWriter::Encoding encoding() const { return encoding_; }
+    void Run(int status,
+             const JsonWriter::Chunks& output,
+             const std::string& etag) const {
+      callback_.Run(status, output, etag);
+    }
+
+   private:
+    JsonWriter::Encoding encoding_{JsonWriter::Encoding::kJson};
+    RequestCallback callback_;
+  };
 
   PrivetHandler(CloudDelegate* cloud,
                 DeviceDelegate* device,
@@ -53,19 +82,26 @@ class PrivetHandler {
   // Handles HTTP/HTTPS Privet request.
   // |api| is the path from the HTTP request, e.g /privet/info.
   // |auth_header| is the Authentication header from HTTP request.
+  // |if_none_match| is the If-None-Match header from HTTP request. If it
+  // matches the entity tag of the reply, the reply has status 304 and no
+  // output.
+  // |encoding| is the encoding of the reply. Replies in different encodings
+  // have different entity tags.
   // |input| is the POST data from HTTP request. If nullptr, data format is
   // not valid JSON.
   // |callback| will be called exactly once during or after |HandleRequest|
   // call.
   void HandleRequest(const std::string& api,
                      const std::string& auth_header,
+                     const std::string& if_none_match,
+                     JsonWriter::Encoding encoding,
                      const base::DictionaryValue* input,
                      const RequestCallback& callback);
 
  private:
   using ApiHandler = void (PrivetHandler::*)(const base::DictionaryValue&,
                                              const UserInfo&,
-                                             const RequestCallback&);
+                                             const ReplyCallback&);
 
   // Adds a handler for both HTTP and HTTPS interfaces.
   void AddHandler(const std::string& path, ApiHandler handler, AuthScope scope);
@@ -77,56 +113,72 @@ class PrivetHandler {
 
   void HandleInfo(const base::DictionaryValue&,
                   const UserInfo& user_info,
-                  const RequestCallback& callback);
+                  const ReplyCallback& callback);
   void HandlePairingStart(const base::DictionaryValue& input,
                           const UserInfo& user_info,
-                          const RequestCallback& callback);
+                          const ReplyCallback& callback);
   void HandlePairingConfirm(const base::DictionaryValue& input,
                             const UserInfo& user_info,
-                            const RequestCallback& callback);
+                            const ReplyCallback& callback);
   void HandlePairingCancel(const base::DictionaryValue& input,
                            const UserInfo& user_info,
-                           const RequestCallback& callback);
+                           const ReplyCallback& callback);
   void HandleAuth(const base::DictionaryValue& input,
                   const UserInfo& user_info,
-                  const RequestCallback& callback);
+                  const ReplyCallback& callback);
   void HandleAccessControlClaim(const base::DictionaryValue& input,
                                 const UserInfo& user_info,
-                                const RequestCallback& callback);
+                                const ReplyCallback& callback);
   void HandleAccessControlConfirm(const base::DictionaryValue& input,
                                   const UserInfo& user_info,
-                                  const RequestCallback& callback);
+                                  const ReplyCallback& callback);
   void HandleSetupStart(const base::DictionaryValue& input,
                         const UserInfo& user_info,
-                        const RequestCallback& callback);
+                        const ReplyCallback& callback);
   void HandleSetupStatus(const base::DictionaryValue&,
                          const UserInfo& user_info,
-                         const RequestCallback& callback);
+                         const ReplyCallback& callback);
   void HandleCommandsExecute(const base::DictionaryValue& input,
                              const UserInfo& user_info,
-                             const RequestCallback& callback);
+                             const ReplyCallback& callback);
   void HandleCommandsStatus(const base::DictionaryValue& input,
                             const UserInfo& user_info,
-                            const RequestCallback& callback);
+                            const ReplyCallback& callback);
   void HandleCommandsList(const base::DictionaryValue& input,
                           const UserInfo& user_info,
-                          const RequestCallback& callback);
+                          const ReplyCallback& callback);
   void HandleCommandsCancel(const base::DictionaryValue& input,
                             const UserInfo& user_info,
-                            const RequestCallback& callback);
+                            const ReplyCallback& callback);
   void HandleCheckForUpdates(const base::DictionaryValue& input,
                              const UserInfo& user_info,
-                             const RequestCallback& callback);
+                             const ReplyCallback& callback);
   void HandleTraits(const base::DictionaryValue& input,
                     const UserInfo& user_info,
-                    const RequestCallback& callback);
+                    const ReplyCallback& callback);
   void HandleComponents(const base::DictionaryValue& input,
                         const UserInfo& user_info,
-                        const RequestCallback& callback);
-
-  void ReplyWithSetupStatus(const RequestCallback& callback) const;
-  void ReplyToUpdateRequest(const RequestCallback& callback) const;
-  void OnUpdateRequestTimeout(int update_request_id);
+                        const ReplyCallback& callback);
+
+  void ReplyWithSetupStatus(const ReplyCallback& callback) const;
+  struct UpdateRequestParameters;
+  void ReplyToUpdateRequest(const UpdateRequestParameters& params) const;
+  JsonWriter::Chunks CreateUpdateReply(
+      const UpdateRequestParameters& params) const;
+  // Writes state changes since the state fingerprint known to the client,
+  // or the whole component tree if they are not available.
+  void WriteStateChanges(const UpdateRequestParameters& params,
+                         JsonWriter* writer) const;
+  // Replies to the pending update requests with |request_ids| and removes
+  // them.
+  void ReplyToUpdateRequests(const std::set<int>& request_ids);
+  void RemoveUpdateRequest(
+      std::map<int, UpdateRequestParameters>::iterator it);
+  // Moves |waiters| to the set of requests to reply to on the next wakeup.
+  void WakeUpdateRequests(std::set<int>* waiters);
+  void OnUpdateRequestsWoken();
+  void ScheduleUpdateRequestTimeout();
+  void OnUpdateRequestTimeout(base::Time deadline);
 
   void OnTraitDefsChanged();
   void OnStateChanged();
@@ -147,18 +199,49 @@ class PrivetHandler {
   std::map<std::string, HandlerParameters> handlers_;
 
   struct UpdateRequestParameters {
-    RequestCallback callback;
+    ReplyCallback callback;
+    UserInfo user_info;
     int request_id{0};
-    uint64_t state_fingerprint{0};
-    uint64_t traits_fingerprint{0};
-    uint64_t components_fingerprint{0};
+    // Time to reply at if nothing changes, null if there is no timeout.
+    base::Time deadline;
+    // Whether the reply should include the state changes since
+    // |known_state_fingerprint|.
+    bool include_state_changes{false};
+    uint64_t known_state_fingerprint{0};
   };
-  std::vector<UpdateRequestParameters> update_requests_;
+  // Pending update requests keyed by request ID.
+  std::map<int, UpdateRequestParameters> update_requests_;
   int last_update_request_id_{0};
+  // IDs of the requests waiting for the respective fingerprint to change.
+  // A request waiting for several fingerprints is in several sets.
+  std::set<int> traits_waiters_;
+  std::set<int> state_waiters_;
+  std::set<int> components_waiters_;
+  // IDs of the requests to reply to when the pending wakeup task runs.
+  std::set<int> woken_update_requests_;
+  bool wakeup_pending_{false};
+  // Request IDs ordered by their deadline, and the deadlines of the posted
+  // timeout tasks.
+  std::multimap<base::Time, int> update_timeouts_;
+  std::set<base::Time> pending_timeouts_;
 
   uint64_t state_fingerprint_{1};
   uint64_t traits_fingerprint_{1};
   uint64_t components_fingerprint_{1};
+  // Pairs of state fingerprint and the ID of the last state change at the
+  // time, sorted by fingerprint.
+  std::deque<std::pair<uint64_t, uint64_t>> state_change_ids_;
+
+  // Serialized replies of /traits and /components. Valid until the
+  // respective fingerprint changes. Replies are keyed by their encoding,
+  // replies of /components also by the other parameters which affect them:
+  // user scope, path and filter.
+  struct CachedReply {
+    JsonWriter::Chunks output;
+    std::string etag;
+  };
+  std::map<JsonWriter::Encoding, CachedReply> traits_replies_;
+  std::map<std::string, CachedReply> components_replies_;
 
   base::WeakPtrFactory<PrivetHandler> weak_ptr_factory_{this};
 
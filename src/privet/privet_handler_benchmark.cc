@@ -0,0 +1,114 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/privet/privet_handler.h"
+
+#include <base/bind.h>
+#include <base/values.h>
+#include <gmock/gmock.h>
+#include <weave/provider/test/fake_task_runner.h>
+
+#include "src/component_manager_impl.h"
+#include "src/privet/mock_delegates.h"
+#include "src/test/benchmark.h"
+
+using testing::NiceMock;
+
+namespace weave {
+namespace privet {
+
+namespace {
+
+const size_t kTraitCount = 4;
+const size_t kPropertyCount = 4;
+
+void OnReply(int status,
+             const JsonWriter::Chunks& output,
+             const std::string& etag) {
+  CHECK_EQ(200, status) << JsonWriter::Join(output);
+}
+
+// Privet handler with mock delegates serving a device with |size|
+// components.
+class PrivetHandlerBenchmark {
+ public:
+  explicit PrivetHandlerBenchmark(size_t size) {
+    ComponentManagerImpl manager{&task_runner_};
+    benchmark::AddComponents(&manager, size, kTraitCount, kPropertyCount);
+    cloud_.test_dict_.Clear();
+    cloud_.test_dict_.MergeDictionary(&manager.GetComponents());
+    traits_.MergeDictionary(&manager.GetTraits());
+    EXPECT_CALL(cloud_, GetTraits()).WillRepeatedly(ReturnRef(traits_));
+    handler_.reset(new PrivetHandler{&cloud_, &device_, &security_, &wifi_});
+  }
+
+  void Run(benchmark::State* state,
+           const std::string& api,
+           const std::string& if_none_match,
+           const base::Closure& invalidate) {
+    base::DictionaryValue input;
+    while (state->KeepRunning()) {
+      if (!invalidate.is_null()) {
+        state->PauseTiming();
+        invalidate.Run();
+        state->ResumeTiming();
+      }
+      handler_->HandleRequest(api, "Privet 123", if_none_match,
+                              JsonWriter::Encoding::kJson, &input,
+                              base::Bind(&OnReply));
+    }
+  }
+
+  void Run(benchmark::State* state, const std::string& api) {
+    Run(state, api, {}, {});
+  }
+
+  NiceMock<MockCloudDelegate> cloud_;
+
+ private:
+  provider::test::FakeTaskRunner task_runner_;
+  NiceMock<MockDeviceDelegate> device_;
+  NiceMock<MockSecurityDelegate> security_;
+  NiceMock<MockWifiDelegate> wifi_;
+  base::DictionaryValue traits_;
+  std::unique_ptr<PrivetHandler> handler_;
+};
+
+}  // namespace
+
+WEAVE_BENCHMARK(PrivetHandlerInfo) {
+  PrivetHandlerBenchmark{state->size()}.Run(state, "/privet/info");
+}
+
+WEAVE_BENCHMARK(PrivetHandlerCheckForUpdates) {
+  PrivetHandlerBenchmark{state->size()}.Run(state,
+                                            "/privet/v3/checkForUpdates");
+}
+
+WEAVE_BENCHMARK(PrivetHandlerTraits) {
+  PrivetHandlerBenchmark{state->size()}.Run(state, "/privet/v3/traits");
+}
+
+// Serializes /traits after every change of the trait definitions.
+WEAVE_BENCHMARK(PrivetHandlerTraitsChanged) {
+  PrivetHandlerBenchmark benchmark{state->size()};
+  benchmark.Run(state, "/privet/v3/traits", {},
+                base::Bind(&MockCloudDelegate::NotifyOnTraitDefsChanged,
+                           base::Unretained(&benchmark.cloud_)));
+}
+
+WEAVE_BENCHMARK(PrivetHandlerComponents) {
+  PrivetHandlerBenchmark{state->size()}.Run(state, "/privet/v3/components");
+}
+
+// Serializes /components after every change of the component tree.
+WEAVE_BENCHMARK(PrivetHandlerComponentsChanged) {
+  PrivetHandlerBenchmark benchmark{state->size()};
+  benchmark.Run(state, "/privet/v3/components", {},
+                base::Bind(&MockCloudDelegate::NotifyOnComponentTreeChanged,
+                           base::Unretained(&benchmark.cloud_)));
+}
+
+}  // namespace privet
+}  // namespace weave
@@ -18,6 +18,9 @@
 #include <weave/device.h>
 #include <weave/test/unittest_utils.h>
 
+#include "src/cbor.h"
+#include "src/component_manager.h"
+#include "src/http_constants.h"
 #include "src/privet/constants.h"
 #include "src/privet/mock_delegates.h"
 #include "src/test/mock_clock.h"
@@ -102,7 +105,8 @@ class PrivetHandlerTest : public testing::Test {
       const std::string& api,
       const base::DictionaryValue* input) {
     output_.Clear();
-    handler_->HandleRequest(api, auth_header_, input,
+    handler_->HandleRequest(api, auth_header_, if_none_match_, encoding_,
+                            input,
                             base::Bind(&PrivetHandlerTest::HandlerCallback,
                                        base::Unretained(this)));
     return output_;
@@ -118,11 +122,14 @@ class PrivetHandlerTest : public testing::Test {
   void HandleUnknownRequest(const std::string& api) {
     output_.Clear();
     base::DictionaryValue dictionary;
-    handler_->HandleRequest(api, auth_header_, &dictionary,
+    handler_->HandleRequest(api, auth_header_, {}, JsonWriter::Encoding::kJson,
+                            &dictionary,
                             base::Bind(&PrivetHandlerTest::HandlerNoFound));
   }
 
   const base::DictionaryValue& GetResponse() const { return output_; }
+  int GetResponseStatus() const { return status_; }
+  const std::string& GetResponseETag() const { return etag_; }
   int GetResponseCount() const { return response_count_; }
 
   void SetNoWifiAndGcd() {
@@ -144,12 +151,29 @@ class PrivetHandlerTest : public testing::Test {
   testing::StrictMock<MockSecurityDelegate> security_;
   testing::StrictMock<MockWifiDelegate> wifi_;
   std::string auth_header_;
+  std::string if_none_match_;
+  JsonWriter::Encoding encoding_{JsonWriter::Encoding::kJson};
 
  private:
-  void HandlerCallback(int status, const base::DictionaryValue& output) {
+  void HandlerCallback(int status,
+                       const JsonWriter::Chunks& output,
+                       const std::string& etag) {
     output_.Clear();
     ++response_count_;
-    output_.MergeDictionary(&output);
+    status_ = status;
+    etag_ = etag;
+    if (status == http::kNotModified) {
+      EXPECT_TRUE(output.empty());
+      return;
+    }
+    if (encoding_ == JsonWriter::Encoding::kCbor) {
+      auto value = CborDecode(JsonWriter::Join(output), nullptr);
+      const base::DictionaryValue* dictionary = nullptr;
+      ASSERT_TRUE(value && value->GetAsDictionary(&dictionary));
+      output_.MergeDictionary(dictionary);
+    } else {
+      LoadTestJson(JsonWriter::Join(output), &output_);
+    }
     if (!output_.HasKey("error")) {
       EXPECT_EQ(200, status);
       return;
@@ -158,13 +182,17 @@ class PrivetHandlerTest : public testing::Test {
     output_.SetInteger("error.http_status", status);
   }
 
-  static void HandlerNoFound(int status, const base::DictionaryValue&) {
+  static void HandlerNoFound(int status,
+                             const JsonWriter::Chunks&,
+                             const std::string&) {
     EXPECT_EQ(404, status);
   }
 
   std::unique_ptr<PrivetHandler> handler_;
   base::DictionaryValue output_;
   int response_count_{0};
+  int status_{0};
+  std::string etag_;
   ConnectionState gcd_disabled_state_{ConnectionState::kDisabled};
 };
 
@@ -488,32 +516,90 @@ TEST_F(PrivetHandlerTest, ComponentsForUser) {
   const UserInfo kManager{AuthScope::kManager, TestUserId{"2"}};
   const UserInfo kUser{AuthScope::kUser, TestUserId{"3"}};
   const UserInfo kViewer{AuthScope::kViewer, TestUserId{"4"}};
-  const base::DictionaryValue components;
-  const std::string expected = R"({"components": {}, "fingerprint": "1"})";
+  base::DictionaryValue components;
+  LoadTestJson(R"({
+    "comp1": {
+      "traits": ["a"],
+      "state": {
+        "a": {"public": 1, "private": 5, "secret": 2},
+        "b": {"secret": 3}
+      },
+      "components": {
+        "comp2": [{"state": {"b": {"secret": 4}}}]
+      }
+    }
+  })", &components);
+  EXPECT_CALL(cloud_, GetComponents()).WillRepeatedly(ReturnRef(components));
+  // "secret" properties are only visible to the owner, "private" ones to
+  // users and above.
+  auto is_visible = [](const std::string& name, const UserInfo& user_info) {
+    if (name.find("secret") != std::string::npos)
+      return user_info.scope() == AuthScope::kOwner;
+    if (name.find("private") != std::string::npos)
+      return user_info.scope() >= AuthScope::kUser;
+    return true;
+  };
+  EXPECT_CALL(cloud_, IsStatePropertyVisible(_, _))
+      .WillRepeatedly(Invoke(is_visible));
 
   EXPECT_CALL(security_, ParseAccessToken(_, _, _))
       .WillOnce(DoAll(SetArgPointee<1>(kOwner), Return(true)));
-  EXPECT_CALL(cloud_, MockGetComponentsForUser(kOwner))
-      .WillOnce(ReturnRef(components));
-  EXPECT_JSON_EQ(expected, HandleRequest("/privet/v3/components", "{}"));
+  const char kExpectedOwner[] = R"({
+    "components": {
+      "comp1": {
+        "traits": ["a"],
+        "state": {
+          "a": {"public": 1, "private": 5, "secret": 2},
+          "b": {"secret": 3}
+        },
+        "components": {
+          "comp2": [{"state": {"b": {"secret": 4}}}]
+        }
+      }
+    },
+    "fingerprint": "1"
+  })";
+  EXPECT_JSON_EQ(kExpectedOwner,
+                 HandleRequest("/privet/v3/components", "{}"));
 
+  const char kExpectedUser[] = R"({
+    "components": {
+      "comp1": {
+        "traits": ["a"],
+        "state": {"a": {"public": 1, "private": 5}},
+        "components": {
+          "comp2": [{}]
+        }
+      }
+    },
+    "fingerprint": "1"
+  })";
   EXPECT_CALL(security_, ParseAccessToken(_, _, _))
       .WillOnce(DoAll(SetArgPointee<1>(kManager), Return(true)));
-  EXPECT_CALL(cloud_, MockGetComponentsForUser(kManager))
-      .WillOnce(ReturnRef(components));
-  EXPECT_JSON_EQ(expected, HandleRequest("/privet/v3/components", "{}"));
+  EXPECT_JSON_EQ(kExpectedUser,
+                 HandleRequest("/privet/v3/components", "{}"));
 
   EXPECT_CALL(security_, ParseAccessToken(_, _, _))
       .WillOnce(DoAll(SetArgPointee<1>(kUser), Return(true)));
-  EXPECT_CALL(cloud_, MockGetComponentsForUser(kUser))
-      .WillOnce(ReturnRef(components));
-  EXPECT_JSON_EQ(expected, HandleRequest("/privet/v3/components", "{}"));
+  EXPECT_JSON_EQ(kExpectedUser,
+                 HandleRequest("/privet/v3/components", "{}"));
 
   EXPECT_CALL(security_, ParseAccessToken(_, _, _))
       .WillOnce(DoAll(SetArgPointee<1>(kViewer), Return(true)));
-  EXPECT_CALL(cloud_, MockGetComponentsForUser(kViewer))
-      .WillOnce(ReturnRef(components));
-  EXPECT_JSON_EQ(expected, HandleRequest("/privet/v3/components", "{}"));
+  const char kExpectedViewer[] = R"({
+    "components": {
+      "comp1": {
+        "traits": ["a"],
+        "state": {"a": {"public": 1}},
+        "components": {
+          "comp2": [{}]
+        }
+      }
+    },
+    "fingerprint": "1"
+  })";
+  EXPECT_JSON_EQ(kExpectedViewer,
+                 HandleRequest("/privet/v3/components", "{}"));
 }
 
 class PrivetHandlerTestWithAuth : public PrivetHandlerTest {
@@ -785,6 +871,127 @@ TEST_F(PrivetHandlerTestWithAuth, Components) {
                  HandleRequest("/privet/v3/components", "{}"));
 }
 
+TEST_F(PrivetHandlerTestWithAuth, TraitsCached) {
+  base::DictionaryValue traits;
+  EXPECT_CALL(cloud_, GetTraits()).WillOnce(ReturnRef(traits));
+  EXPECT_JSON_EQ(R"({"traits": {}, "fingerprint": "1"})",
+                 HandleRequest("/privet/v3/traits", "{}"));
+  std::string etag = GetResponseETag();
+  // A quoted 128-bit digest of the reply.
+  EXPECT_EQ(34u, etag.size());
+  EXPECT_JSON_EQ(R"({"traits": {}, "fingerprint": "1"})",
+                 HandleRequest("/privet/v3/traits", "{}"));
+  EXPECT_EQ(etag, GetResponseETag());
+
+  LoadTestJson(R"({"trait1": {}})", &traits);
+  cloud_.NotifyOnTraitDefsChanged();
+  EXPECT_CALL(cloud_, GetTraits()).WillOnce(ReturnRef(traits));
+  EXPECT_JSON_EQ(R"({"traits": {"trait1": {}}, "fingerprint": "2"})",
+                 HandleRequest("/privet/v3/traits", "{}"));
+  EXPECT_NE(etag, GetResponseETag());
+}
+
+TEST_F(PrivetHandlerTestWithAuth, ComponentsCached) {
+  base::DictionaryValue components;
+  LoadTestJson(R"({"comp1": {"traits": ["a"], "state": {"a": {"p": 1}}}})",
+               &components);
+  EXPECT_CALL(cloud_, GetComponents()).WillOnce(ReturnRef(components));
+  HandleRequest("/privet/v3/components", "{}");
+  std::string etag = GetResponseETag();
+
+  // Served from the cache.
+  EXPECT_JSON_EQ(
+      R"({
+        "components": {"comp1": {"traits": ["a"], "state": {"a": {"p": 1}}}},
+        "fingerprint": "1"
+      })",
+      HandleRequest("/privet/v3/components", "{}"));
+  EXPECT_EQ(etag, GetResponseETag());
+
+  // A different filter is a different reply.
+  EXPECT_CALL(cloud_, GetComponents()).WillOnce(ReturnRef(components));
+  EXPECT_JSON_EQ(
+      R"({"components": {"comp1": {"traits": ["a"]}}, "fingerprint": "1"})",
+      HandleRequest("/privet/v3/components", R"({"filter": ["traits"]})"));
+  EXPECT_NE(etag, GetResponseETag());
+
+  cloud_.NotifyOnStateChanged();
+  EXPECT_CALL(cloud_, GetComponents()).WillOnce(ReturnRef(components));
+  HandleRequest("/privet/v3/components", "{}");
+  EXPECT_NE(etag, GetResponseETag());
+}
+
+TEST_F(PrivetHandlerTestWithAuth, ComponentsCachedFiltersDoNotCollide) {
+  base::DictionaryValue components;
+  LoadTestJson(R"({"comp1": {"traits": ["a"], "state": {"a": {"p": 1}}}})",
+               &components);
+  EXPECT_CALL(cloud_, GetComponents()).WillRepeatedly(ReturnRef(components));
+  EXPECT_JSON_EQ(
+      R"({"components": {"comp1": {}}, "fingerprint": "1"})",
+      HandleRequest("/privet/v3/components",
+                    R"({"filter": ["state,traits"]})"));
+
+  EXPECT_JSON_EQ(
+      R"({
+        "components": {"comp1": {"traits": ["a"], "state": {"a": {"p": 1}}}},
+        "fingerprint": "1"
+      })",
+      HandleRequest("/privet/v3/components",
+                    R"({"filter": ["state", "traits"]})"));
+}
+
+TEST_F(PrivetHandlerTestWithAuth, IfNoneMatch) {
+  HandleRequest("/privet/v3/components", "{}");
+  EXPECT_EQ(http::kOk, GetResponseStatus());
+  std::string etag = GetResponseETag();
+
+  if_none_match_ = "\"other\", " + etag;
+  HandleRequest("/privet/v3/components", "{}");
+  EXPECT_EQ(http::kNotModified, GetResponseStatus());
+  EXPECT_EQ(etag, GetResponseETag());
+
+  // Weak comparison ignores the "W/" prefix.
+  if_none_match_ = "W/ " + etag;
+  HandleRequest("/privet/v3/components", "{}");
+  EXPECT_EQ(http::kNotModified, GetResponseStatus());
+
+  cloud_.NotifyOnComponentTreeChanged();
+  EXPECT_JSON_EQ(R"({"components": {"test": {}}, "fingerprint": "2"})",
+                 HandleRequest("/privet/v3/components", "{}"));
+  EXPECT_EQ(http::kOk, GetResponseStatus());
+
+  // Replies without an entity tag are not affected.
+  if_none_match_ = "*";
+  HandleRequest("/privet/info", "{}");
+  EXPECT_EQ(http::kOk, GetResponseStatus());
+}
+
+TEST_F(PrivetHandlerTestWithAuth, Cbor) {
+  HandleRequest("/privet/v3/components", "{}");
+  std::string json_etag = GetResponseETag();
+
+  encoding_ = JsonWriter::Encoding::kCbor;
+  EXPECT_JSON_EQ(R"({"components": {"test": {}}, "fingerprint": "1"})",
+                 HandleRequest("/privet/v3/components", "{}"));
+  std::string cbor_etag = GetResponseETag();
+  EXPECT_FALSE(cbor_etag.empty());
+  EXPECT_NE(json_etag, cbor_etag);
+
+  // The entity tag of one encoding does not match the other.
+  if_none_match_ = json_etag;
+  HandleRequest("/privet/v3/components", "{}");
+  EXPECT_EQ(http::kOk, GetResponseStatus());
+  if_none_match_ = cbor_etag;
+  HandleRequest("/privet/v3/components", "{}");
+  EXPECT_EQ(http::kNotModified, GetResponseStatus());
+
+  if_none_match_.clear();
+  EXPECT_JSON_EQ(R"({"traits": {"test": {}}, "fingerprint": "1"})",
+                 HandleRequest("/privet/v3/traits", "{}"));
+  EXPECT_PRED2(IsEqualError, CodeWithReason(400, "invalidParams"),
+               HandleRequest("/privet/v3/commands/status", "{}"));
+}
+
 TEST_F(PrivetHandlerTestWithAuth, ComponentsWithFiltersAndPaths) {
   const char kComponents[] = R"({
     "comp1": {
@@ -812,8 +1019,7 @@ TEST_F(PrivetHandlerTestWithAuth, ComponentsWithFiltersAndPaths) {
   base::DictionaryValue components;
   LoadTestJson(kComponents, &components);
   EXPECT_CALL(cloud_, FindComponent(_, _)).WillRepeatedly(Return(nullptr));
-  EXPECT_CALL(cloud_, MockGetComponentsForUser(_))
-      .WillRepeatedly(ReturnRef(components));
+  EXPECT_CALL(cloud_, GetComponents()).WillRepeatedly(ReturnRef(components));
   const char kExpected1[] = R"({
     "components": {
       "comp1": {
@@ -1009,7 +1215,25 @@ TEST_F(PrivetHandlerTestWithAuth, CommandsList) {
   EXPECT_JSON_EQ(kExpected, HandleRequest("/privet/v3/commands/list", "{}"));
 }
 
-class PrivetHandlerCheckForUpdatesTest : public PrivetHandlerTestWithAuth {};
+class PrivetHandlerCheckForUpdatesTest : public PrivetHandlerTestWithAuth {
+ public:
+  void SetUp() override {
+    PrivetHandlerTestWithAuth::SetUp();
+    EXPECT_CALL(device_, PostDelayedTask(_, _, base::TimeDelta{}))
+        .WillRepeatedly(SaveArg<1>(&wakeup_));
+  }
+
+  // Runs the posted task which replies to the woken update requests.
+  void RunWakeup() {
+    base::Closure wakeup;
+    std::swap(wakeup, wakeup_);
+    if (!wakeup.is_null())
+      wakeup.Run();
+  }
+
+ private:
+  base::Closure wakeup_;
+};
 
 TEST_F(PrivetHandlerCheckForUpdatesTest, NoInput) {
   EXPECT_CALL(device_, GetHttpRequestTimeout())
@@ -1064,6 +1288,7 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollCommands) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnTraitDefsChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "2",
@@ -1086,6 +1311,7 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollTraits) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnTraitDefsChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "2",
@@ -1108,6 +1334,7 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollState) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnStateChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "1",
@@ -1130,6 +1357,7 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollComponents) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnComponentTreeChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "1",
@@ -1150,8 +1378,10 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollIgnoreTraits) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnTraitDefsChanged();
+  RunWakeup();
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnComponentTreeChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "2",
@@ -1172,10 +1402,13 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, LongPollIgnoreState) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnStateChanged();
+  RunWakeup();
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnComponentTreeChanged();
+  RunWakeup();
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnTraitDefsChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "2",
@@ -1312,6 +1545,7 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, ChangeBeforeTimeout) {
   EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
   EXPECT_EQ(0, GetResponseCount());
   cloud_.NotifyOnTraitDefsChanged();
+  RunWakeup();
   EXPECT_EQ(1, GetResponseCount());
   const char kExpected[] = R"({
    "commandsFingerprint": "2",
@@ -1324,5 +1558,124 @@ TEST_F(PrivetHandlerCheckForUpdatesTest, ChangeBeforeTimeout) {
   EXPECT_EQ(1, GetResponseCount());
 }
 
+TEST_F(PrivetHandlerCheckForUpdatesTest, StateChanges) {
+  EXPECT_CALL(device_, GetHttpRequestTimeout())
+      .WillOnce(Return(base::TimeDelta::Max()));
+  EXPECT_CALL(cloud_, GetLastStateChangeId()).WillRepeatedly(Return(7));
+  cloud_.NotifyOnStateChanged();
+
+  auto get_changes = [](uint64_t id,
+                        std::vector<ComponentStateChange>* changes) {
+    changes->emplace_back(base::Time{}, "comp",
+                          test::CreateDictionaryValue("{'t': {'p': 1}}"));
+    changes->emplace_back(base::Time{}, "comp.sub",
+                          test::CreateDictionaryValue("{'t': {'hidden': 2}}"));
+    return true;
+  };
+  EXPECT_CALL(cloud_, GetStateChangesSince(0, _)).WillOnce(Invoke(get_changes));
+  EXPECT_CALL(cloud_, IsStatePropertyVisible("t.hidden", _))
+      .WillRepeatedly(Return(false));
+
+  const char kInput[] = R"({
+   "stateFingerprint": "1",
+   "includeStateChanges": true
+  })";
+  const char kExpected[] = R"({
+   "commandsFingerprint": "1",
+   "stateFingerprint": "2",
+   "traitsFingerprint": "1",
+   "componentsFingerprint": "2",
+   "stateChanges": [{
+     "component": "comp",
+     "patch": {"t": {"p": 1}}
+   }]
+  })";
+  EXPECT_JSON_EQ(kExpected,
+                 HandleRequest("/privet/v3/checkForUpdates", kInput));
+  EXPECT_EQ(1, GetResponseCount());
+}
+
+TEST_F(PrivetHandlerCheckForUpdatesTest, StateChangesUnavailable) {
+  EXPECT_CALL(device_, GetHttpRequestTimeout())
+      .WillRepeatedly(Return(base::TimeDelta::Max()));
+  cloud_.NotifyOnStateChanged();
+  const char kExpected[] = R"({
+   "commandsFingerprint": "1",
+   "stateFingerprint": "2",
+   "traitsFingerprint": "1",
+   "componentsFingerprint": "2",
+   "components": {"test": {}}
+  })";
+
+  // Unknown state fingerprint.
+  const char kInput[] = R"({
+   "stateFingerprint": "100",
+   "includeStateChanges": true
+  })";
+  EXPECT_JSON_EQ(kExpected,
+                 HandleRequest("/privet/v3/checkForUpdates", kInput));
+
+  // State changes are no longer kept.
+  const char kInput2[] = R"({
+   "stateFingerprint": "1",
+   "includeStateChanges": true
+  })";
+  EXPECT_CALL(cloud_, GetStateChangesSince(0, _)).WillOnce(Return(false));
+  EXPECT_JSON_EQ(kExpected,
+                 HandleRequest("/privet/v3/checkForUpdates", kInput2));
+  EXPECT_EQ(2, GetResponseCount());
+}
+
+TEST_F(PrivetHandlerCheckForUpdatesTest, BatchedWakeup) {
+  EXPECT_CALL(device_, GetHttpRequestTimeout())
+      .WillRepeatedly(Return(base::TimeDelta::Max()));
+  const char kStateInput[] = R"({"stateFingerprint": "1"})";
+  const char kTraitsInput[] = R"({"traitsFingerprint": "1"})";
+  EXPECT_JSON_EQ("{}",
+                 HandleRequest("/privet/v3/checkForUpdates", kStateInput));
+  EXPECT_JSON_EQ("{}",
+                 HandleRequest("/privet/v3/checkForUpdates", kStateInput));
+  EXPECT_JSON_EQ("{}",
+                 HandleRequest("/privet/v3/checkForUpdates", kTraitsInput));
+
+  // A burst of state changes wakes the state waiters once, with the final
+  // fingerprints.
+  cloud_.NotifyOnStateChanged();
+  cloud_.NotifyOnStateChanged();
+  cloud_.NotifyOnStateChanged();
+  EXPECT_EQ(0, GetResponseCount());
+  RunWakeup();
+  EXPECT_EQ(2, GetResponseCount());
+  const char kExpected[] = R"({
+   "commandsFingerprint": "1",
+   "stateFingerprint": "4",
+   "traitsFingerprint": "1",
+   "componentsFingerprint": "4"
+  })";
+  EXPECT_JSON_EQ(kExpected, GetResponse());
+
+  cloud_.NotifyOnTraitDefsChanged();
+  RunWakeup();
+  EXPECT_EQ(3, GetResponseCount());
+}
+
+TEST_F(PrivetHandlerCheckForUpdatesTest, SharedTimeout) {
+  EXPECT_CALL(device_, GetHttpRequestTimeout())
+      .WillRepeatedly(Return(base::TimeDelta::Max()));
+  const char kInput[] = R"({
+   "stateFingerprint": "1",
+   "waitTimeout": 10
+  })";
+  base::Closure callback;
+  // Requests with the same deadline share a timer task.
+  EXPECT_CALL(device_, PostDelayedTask(_, _, base::TimeDelta::FromSeconds(10)))
+      .WillOnce(SaveArg<1>(&callback));
+  EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
+  EXPECT_JSON_EQ("{}", HandleRequest("/privet/v3/checkForUpdates", kInput));
+  EXPECT_EQ(0, GetResponseCount());
+  callback.Run();
+  EXPECT_EQ(2, GetResponseCount());
+}
+
 }  // namespace privet
 }  // namespace weave
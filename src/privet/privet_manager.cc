@@ -4,22 +4,25 @@
 
 #include "src/privet/privet_manager.h"
 
+#include <algorithm>
 #include <memory>
 #include <set>
 #include <string>
 
 #include <base/bind.h>
-#include <base/json/json_reader.h>
 #include <base/json/json_writer.h>
 #include <base/memory/weak_ptr.h>
 #include <base/strings/string_number_conversions.h>
+#include <base/strings/string_util.h>
 #include <base/values.h>
 #include <weave/provider/network.h>
 
 #include "src/bind_lambda.h"
+#include "src/cbor.h"
 #include "src/component_manager.h"
 #include "src/device_registration_info.h"
 #include "src/http_constants.h"
+#include "src/json_reader.h"
 #include "src/privet/auth_manager.h"
 #include "src/privet/cloud_delegate.h"
 #include "src/privet/constants.h"
@@ -38,6 +41,34 @@ using provider::DnsServiceDiscovery;
 using provider::HttpServer;
 using provider::Wifi;
 
+namespace {
+
+// Returns true if the Accept header of the request prefers CBOR to JSON.
+// Replies are JSON unless the client lists CBOR explicitly.
+bool PrefersCbor(const std::string& accept) {
+  double cbor_quality = 0;
+  double json_quality = 0;
+  for (const auto& item : Split(accept, ",", true, true)) {
+    auto params = Split(item, ";", true, true);
+    if (params.empty())
+      continue;
+    double quality = 1;
+    for (size_t i = 1; i < params.size(); ++i) {
+      auto param = SplitAtFirst(params[i], "=", true);
+      if (param.first == "q" && !base::StringToDouble(param.second, &quality))
+        quality = 0;
+    }
+    std::string type = base::ToLowerASCII(params.front());
+    if (type == http::kCbor)
+      cbor_quality = std::max(cbor_quality, quality);
+    else if (type == http::kJson || type == "application/*" || type == "*/*")
+      json_quality = std::max(json_quality, quality);
+  }
+  return cbor_quality > 0 && cbor_quality >= json_quality;
+}
+
+}  // namespace
+
 Manager::Manager(TaskRunner* task_runner) : task_runner_{task_runner} {}
 
 Manager::~Manager() {
@@ -131,38 +162,64 @@ void Manager::PrivetRequestHandler(
       SplitAtFirst(request->GetFirstHeader(http::kContentType), ";", true)
           .first;
 
-  return PrivetRequestHandlerWithData(request, content_type == http::kJson
-                                                   ? request->GetData()
-                                                   : std::string{});
+  bool has_data = content_type == http::kJson || content_type == http::kCbor;
+  return PrivetRequestHandlerWithData(
+      request, content_type, has_data ? request->GetData() : std::string{});
 }
 
 void Manager::PrivetRequestHandlerWithData(
     const std::shared_ptr<provider::HttpServer::Request>& request,
+    const std::string& content_type,
     const std::string& data) {
   std::string auth_header = request->GetFirstHeader(http::kAuthorization);
   base::DictionaryValue empty;
-  auto value = base::JSONReader::Read(data);
+  std::unique_ptr<base::Value> value;
+  if (content_type == http::kCbor)
+    value = CborDecode(data, nullptr);
+  else
+    value = ReadJson(data, {}, nullptr);
   const base::DictionaryValue* dictionary = &empty;
   if (value)
     value->GetAsDictionary(&dictionary);
 
   VLOG(3) << "Input: " << *dictionary;
 
+  JsonWriter::Encoding encoding =
+      PrefersCbor(request->GetFirstHeader(http::kAccept))
+          ? JsonWriter::Encoding::kCbor
+          : JsonWriter::Encoding::kJson;
   privet_handler_->HandleRequest(
-      request->GetPath(), auth_header, dictionary,
+      request->GetPath(), auth_header,
+      request->GetFirstHeader(http::kIfNoneMatch), encoding, dictionary,
       base::Bind(&Manager::PrivetResponseHandler,
-                 weak_ptr_factory_.GetWeakPtr(), request));
+                 weak_ptr_factory_.GetWeakPtr(), request, encoding));
 }
 
 void Manager::PrivetResponseHandler(
     const std::shared_ptr<provider::HttpServer::Request>& request,
+    JsonWriter::Encoding encoding,
     int status,
-    const base::DictionaryValue& output) {
-  VLOG(3) << "status: " << status << ", Output: " << output;
-  std::string data;
-  base::JSONWriter::WriteWithOptions(
-      output, base::JSONWriter::OPTIONS_PRETTY_PRINT, &data);
-  request->SendReply(status, data, http::kJson);
+    const JsonWriter::Chunks& output,
+    const std::string& etag) {
+  bool cbor = encoding == JsonWriter::Encoding::kCbor;
+  if (VLOG_IS_ON(3)) {
+    std::string reply = JsonWriter::Join(output);
+    if (cbor) {
+      auto value = CborDecode(reply, nullptr);
+      reply.clear();
+      if (value)
+        base::JSONWriter::Write(*value, &reply);
+    }
+    VLOG(3) << "status: " << status << ", Output: " << reply;
+  }
+  // Every reply is encoded as JSON or CBOR depending on the Accept header of
+  // the request, and so is its entity tag.
+  std::vector<std::pair<std::string, std::string>> headers{
+      {http::kVary, http::kAccept}};
+  if (!etag.empty())
+    headers.emplace_back(http::kETag, etag);
+  request->SendReplyWithChunks(status, output, cbor ? http::kCbor : http::kJson,
+                               headers);
 }
 
 void Manager::OnChanged() {
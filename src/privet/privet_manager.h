@@ -13,6 +13,7 @@
 #include <base/memory/weak_ptr.h>
 #include <weave/device.h>
 
+#include "src/json_writer.h"
 #include "src/privet/cloud_delegate.h"
 #include "src/privet/security_manager.h"
 #include "src/privet/wifi_bootstrap_manager.h"
@@ -65,14 +66,20 @@ class Manager {
   void PrivetRequestHandler(
       std::unique_ptr<provider::HttpServer::Request> request);
 
+  // Decodes |data| according to |content_type|, either JSON or CBOR.
   void PrivetRequestHandlerWithData(
       const std::shared_ptr<provider::HttpServer::Request>& request,
+      const std::string& content_type,
       const std::string& data);
 
+  // Sends |output| of the handler, already encoded in |encoding|, with the
+  // matching content type. A non-empty |etag| adds ETag and Vary headers.
   void PrivetResponseHandler(
       const std::shared_ptr<provider::HttpServer::Request>& request,
+      JsonWriter::Encoding encoding,
       int status,
-      const base::DictionaryValue& output);
+      const JsonWriter::Chunks& output,
+      const std::string& etag);
 
   void OnChanged();
   void OnConnectivityChanged();
@@ -186,14 +186,7 @@ bool SecurityManager::CreateAccessToken(AuthType auth_type,
 bool SecurityManager::ParseAccessToken(const std::string& token,
                                        UserInfo* user_info,
                                        ErrorPtr* error) const {
-  std::vector<uint8_t> decoded;
-  if (!Base64Decode(token, &decoded)) {
-    Error::AddToPrintf(error, FROM_HERE, errors::kInvalidAuthorization,
-                       "Invalid token encoding: %s", token.c_str());
-    return false;
-  }
-
-  return auth_manager_->ParseAccessToken(decoded, user_info, error);
+  return auth_manager_->ParseEncodedAccessToken(token, user_info, error);
 }
 
 std::set<PairingType> SecurityManager::GetPairingTypes() const {
@@ -0,0 +1,410 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/schema_validator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <base/json/json_writer.h>
+#include <base/logging.h>
+
+#include "src/commands/schema_constants.h"
+
+namespace weave {
+
+namespace {
+
+const char kType[] = "type";
+const char kEnum[] = "enum";
+const char kMinimum[] = "minimum";
+const char kMaximum[] = "maximum";
+const char kProperties[] = "properties";
+const char kRequired[] = "required";
+const char kAdditionalProperties[] = "additionalProperties";
+const char kItems[] = "items";
+
+std::string AppendPath(const std::string& path, const std::string& name) {
+  return path.empty() ? name : path + '.' + name;
+}
+
+const char* GetPathForError(const std::string& path) {
+  return path.empty() ? "value" : path.c_str();
+}
+
+std::string ValueToString(const base::Value& value) {
+  std::string result;
+  base::JSONWriter::Write(value, &result);
+  return result;
+}
+
+bool AddSchemaError(ErrorPtr* error,
+                    const std::string& keyword,
+                    const std::string& path) {
+  Error::AddToPrintf(error, FROM_HERE, errors::commands::kTypeMismatch,
+                     "Invalid '%s' in schema of '%s'", keyword.c_str(),
+                     GetPathForError(path));
+  return false;
+}
+
+}  // anonymous namespace
+
+const uint32_t SchemaValidator::kNone = static_cast<uint32_t>(-1);
+
+SchemaValidator::SchemaValidator() {}
+
+SchemaValidator::~SchemaValidator() {}
+
+std::unique_ptr<SchemaValidator> SchemaValidator::Compile(
+    const base::DictionaryValue& schema,
+    ErrorPtr* error) {
+  std::unique_ptr<SchemaValidator> validator{new SchemaValidator};
+  if (validator->CompileNode(schema, {}, error) == kNone)
+    validator.reset();
+  return validator;
+}
+
+std::unique_ptr<SchemaValidator> SchemaValidator::CompileProperties(
+    const base::DictionaryValue& properties,
+    ErrorPtr* error) {
+  std::unique_ptr<SchemaValidator> validator{new SchemaValidator};
+  validator->nodes_.emplace_back();
+  validator->nodes_.back().type = Type::kObject;
+  validator->nodes_.back().additional_properties = false;
+  if (!validator->CompilePropertiesOf(0, properties, {}, error))
+    validator.reset();
+  return validator;
+}
+
+bool SchemaValidator::Validate(const base::Value& value,
+                               ErrorPtr* error) const {
+  CHECK(!nodes_.empty());
+  return ValidateNode(0, value, nullptr, false, error);
+}
+
+bool SchemaValidator::ValidatePatch(const base::Value& value,
+                                    ErrorPtr* error) const {
+  CHECK(!nodes_.empty());
+  return ValidateNode(0, value, nullptr, true, error);
+}
+
+bool SchemaValidator::FindProperty(const std::string& name,
+                                   uint32_t* property) const {
+  CHECK(!nodes_.empty());
+  auto begin = properties_.begin() + nodes_[0].properties_begin;
+  auto end = properties_.begin() + nodes_[0].properties_end;
+  auto it = std::lower_bound(
+      begin, end, name, [](const Property& property, const std::string& name) {
+        return property.name < name;
+      });
+  if (it == end || it->name != name)
+    return false;
+  *property = it - properties_.begin();
+  return true;
+}
+
+bool SchemaValidator::ValidateProperty(uint32_t property,
+                                       const base::Value& value,
+                                       ErrorPtr* error) const {
+  const PathSegment path{nullptr, &properties_[property].name, 0};
+  return ValidateNode(properties_[property].node, value, &path, true, error);
+}
+
+std::string SchemaValidator::GetPath(const PathSegment* segment) {
+  if (!segment)
+    return {};
+  std::string path = GetPath(segment->parent);
+  if (!segment->name)
+    return path + '[' + std::to_string(segment->index) + ']';
+  return AppendPath(path, *segment->name);
+}
+
+uint32_t SchemaValidator::CompileNode(const base::DictionaryValue& schema,
+                                      const std::string& path,
+                                      ErrorPtr* error) {
+  uint32_t node_index = nodes_.size();
+  nodes_.emplace_back();
+  // |nodes_| grows while compiling sub-schemas, so a reference to the new
+  // node is only valid until the next recursive call.
+  Node* node = &nodes_.back();
+
+  const base::Value* value = nullptr;
+  if (schema.Get(kType, &value)) {
+    std::string type;
+    if (!value->GetAsString(&type)) {
+      AddSchemaError(error, kType, path);
+      return kNone;
+    }
+    if (type == "boolean") {
+      node->type = Type::kBoolean;
+    } else if (type == "integer") {
+      node->type = Type::kInteger;
+    } else if (type == "number") {
+      node->type = Type::kNumber;
+    } else if (type == "string") {
+      node->type = Type::kString;
+    } else if (type == "object") {
+      node->type = Type::kObject;
+    } else if (type == "array") {
+      node->type = Type::kArray;
+    } else {
+      // Most likely a typo, which would silently disable the validation.
+      AddSchemaError(error, kType, path);
+      return kNone;
+    }
+  }
+
+  if (schema.Get(kMinimum, &value)) {
+    if (!value->GetAsDouble(&node->minimum)) {
+      AddSchemaError(error, kMinimum, path);
+      return kNone;
+    }
+    node->has_minimum = true;
+  }
+
+  if (schema.Get(kMaximum, &value)) {
+    if (!value->GetAsDouble(&node->maximum)) {
+      AddSchemaError(error, kMaximum, path);
+      return kNone;
+    }
+    node->has_maximum = true;
+  }
+
+  if (schema.Get(kAdditionalProperties, &value)) {
+    // A schema for additional properties is not supported and is treated as
+    // "any additional property is allowed".
+    value->GetAsBoolean(&node->additional_properties);
+  }
+
+  if (schema.Get(kEnum, &value)) {
+    const base::ListValue* list = nullptr;
+    if (!value->GetAsList(&list)) {
+      AddSchemaError(error, kEnum, path);
+      return kNone;
+    }
+    node->enum_begin = enum_values_.size();
+    for (const auto& item : *list)
+      enum_values_.push_back(item->CreateDeepCopy());
+    node->enum_end = enum_values_.size();
+  }
+
+  if (schema.Get(kRequired, &value)) {
+    const base::ListValue* list = nullptr;
+    if (!value->GetAsList(&list)) {
+      AddSchemaError(error, kRequired, path);
+      return kNone;
+    }
+    node->required_begin = required_.size();
+    for (const auto& item : *list) {
+      std::string name;
+      if (!item->GetAsString(&name)) {
+        AddSchemaError(error, kRequired, path);
+        return kNone;
+      }
+      required_.push_back(name);
+    }
+    node->required_end = required_.size();
+  }
+
+  if (schema.Get(kProperties, &value)) {
+    const base::DictionaryValue* properties = nullptr;
+    if (!value->GetAsDictionary(&properties)) {
+      AddSchemaError(error, kProperties, path);
+      return kNone;
+    }
+    if (!CompilePropertiesOf(node_index, *properties, path, error))
+      return kNone;
+  }
+
+  if (schema.Get(kItems, &value)) {
+    const base::DictionaryValue* items = nullptr;
+    if (!value->GetAsDictionary(&items)) {
+      AddSchemaError(error, kItems, path);
+      return kNone;
+    }
+    uint32_t items_index = CompileNode(*items, path + "[]", error);
+    if (items_index == kNone)
+      return kNone;
+    nodes_[node_index].items = items_index;
+  }
+
+  return node_index;
+}
+
+bool SchemaValidator::CompilePropertiesOf(
+    uint32_t node_index,
+    const base::DictionaryValue& properties,
+    const std::string& path,
+    ErrorPtr* error) {
+  // Reserve a contiguous range for the properties of this node first, since
+  // compiling them appends properties of the nested objects. The iteration
+  // order of DictionaryValue keeps the range sorted by name.
+  uint32_t begin = properties_.size();
+  for (base::DictionaryValue::Iterator it(properties); !it.IsAtEnd();
+       it.Advance()) {
+    properties_.push_back(Property{it.key(), kNone});
+  }
+  nodes_[node_index].properties_begin = begin;
+  nodes_[node_index].properties_end = properties_.size();
+
+  uint32_t index = begin;
+  for (base::DictionaryValue::Iterator it(properties); !it.IsAtEnd();
+       it.Advance(), index++) {
+    std::string property_path = AppendPath(path, it.key());
+    const base::DictionaryValue* schema = nullptr;
+    base::DictionaryValue type_schema;
+    std::string type;
+    if (it.value().GetAsString(&type)) {
+      // Short form of a property schema: "name": "integer".
+      type_schema.SetString(kType, type);
+      schema = &type_schema;
+    } else if (!it.value().GetAsDictionary(&schema)) {
+      return AddSchemaError(error, kProperties, property_path);
+    }
+    uint32_t property_node = CompileNode(*schema, property_path, error);
+    if (property_node == kNone)
+      return false;
+    properties_[index].node = property_node;
+  }
+  return true;
+}
+
+bool SchemaValidator::ValidateNode(uint32_t node_index,
+                                   const base::Value& value,
+                                   const PathSegment* path,
+                                   bool patch,
+                                   ErrorPtr* error) const {
+  const Node& node = nodes_[node_index];
+
+  bool type_matches = true;
+  const char* type_name = nullptr;
+  switch (node.type) {
+    case Type::kAny:
+      break;
+    case Type::kBoolean:
+      type_matches = value.IsType(base::Value::TYPE_BOOLEAN);
+      type_name = "boolean";
+      break;
+    case Type::kInteger: {
+      double number = 0;
+      type_matches =
+          value.IsType(base::Value::TYPE_INTEGER) ||
+          (value.IsType(base::Value::TYPE_DOUBLE) &&
+           value.GetAsDouble(&number) && std::floor(number) == number);
+      type_name = "integer";
+      break;
+    }
+    case Type::kNumber:
+      type_matches = value.IsType(base::Value::TYPE_INTEGER) ||
+                     value.IsType(base::Value::TYPE_DOUBLE);
+      type_name = "number";
+      break;
+    case Type::kString:
+      type_matches = value.IsType(base::Value::TYPE_STRING);
+      type_name = "string";
+      break;
+    case Type::kObject:
+      type_matches = value.IsType(base::Value::TYPE_DICTIONARY);
+      type_name = "object";
+      break;
+    case Type::kArray:
+      type_matches = value.IsType(base::Value::TYPE_LIST);
+      type_name = "array";
+      break;
+  }
+  if (!type_matches) {
+    return Error::AddToPrintf(error, FROM_HERE, errors::commands::kTypeMismatch,
+                              "Expected '%s' to be of type '%s'",
+                              GetPathForError(GetPath(path)), type_name);
+  }
+
+  if (node.enum_begin != node.enum_end) {
+    auto begin = enum_values_.begin() + node.enum_begin;
+    auto end = enum_values_.begin() + node.enum_end;
+    auto match = [&value](const std::unique_ptr<base::Value>& item) {
+      return item->Equals(&value);
+    };
+    if (std::find_if(begin, end, match) == end) {
+      return Error::AddToPrintf(
+          error, FROM_HERE, errors::commands::kInvalidPropValue,
+          "Value %s of '%s' is not one of the allowed values",
+          ValueToString(value).c_str(), GetPathForError(GetPath(path)));
+    }
+  }
+
+  double number = 0;
+  if ((node.has_minimum || node.has_maximum) && value.GetAsDouble(&number)) {
+    if (node.has_minimum && number < node.minimum) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kInvalidPropValue,
+                                "Value %s of '%s' is less than minimum %g",
+                                ValueToString(value).c_str(),
+                                GetPathForError(GetPath(path)), node.minimum);
+    }
+    if (node.has_maximum && number > node.maximum) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kInvalidPropValue,
+                                "Value %s of '%s' is greater than maximum %g",
+                                ValueToString(value).c_str(),
+                                GetPathForError(GetPath(path)), node.maximum);
+    }
+  }
+
+  const base::DictionaryValue* dict = nullptr;
+  if (value.GetAsDictionary(&dict))
+    return ValidateObject(node, *dict, path, patch, error);
+
+  const base::ListValue* list = nullptr;
+  if (node.items != kNone && value.GetAsList(&list)) {
+    for (size_t i = 0; i < list->GetSize(); i++) {
+      const base::Value* item = nullptr;
+      CHECK(list->Get(i, &item));
+      const PathSegment item_path{path, nullptr, i};
+      if (!ValidateNode(node.items, *item, &item_path, false, error))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool SchemaValidator::ValidateObject(const Node& node,
+                                     const base::DictionaryValue& dict,
+                                     const PathSegment* path,
+                                     bool patch,
+                                     ErrorPtr* error) const {
+  // Properties missing from a patch keep their current values.
+  for (uint32_t i = node.required_begin; !patch && i < node.required_end;
+       i++) {
+    if (!dict.HasKey(required_[i])) {
+      return Error::AddToPrintf(
+          error, FROM_HERE, errors::commands::kPropertyMissing,
+          "Required property '%s' is missing",
+          AppendPath(GetPath(path), required_[i]).c_str());
+    }
+  }
+
+  // Both the dictionary and the property range are sorted by name, so the
+  // properties are matched in a single pass.
+  auto property = properties_.begin() + node.properties_begin;
+  auto properties_end = properties_.begin() + node.properties_end;
+  for (base::DictionaryValue::Iterator it(dict); !it.IsAtEnd(); it.Advance()) {
+    while (property != properties_end && property->name < it.key())
+      ++property;
+    if (property != properties_end && property->name == it.key()) {
+      const PathSegment property_path{path, &it.key(), 0};
+      if (!ValidateNode(property->node, it.value(), &property_path, patch,
+                        error)) {
+        return false;
+      }
+    } else if (!node.additional_properties) {
+      return Error::AddToPrintf(error, FROM_HERE,
+                                errors::commands::kInvalidPropValue,
+                                "Unknown property '%s'",
+                                AppendPath(GetPath(path), it.key()).c_str());
+    }
+  }
+  return true;
+}
+
+}  // namespace weave
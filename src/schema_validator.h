@@ -0,0 +1,145 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_SCHEMA_VALIDATOR_H_
+#define LIBWEAVE_SRC_SCHEMA_VALIDATOR_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/macros.h>
+#include <base/values.h>
+#include <weave/error.h>
+
+namespace weave {
+
+// Validator for values described by trait definition schemas, e.g. command
+// parameters and state properties. The schema is compiled once into a flat
+// array of nodes, so validation does not look at the schema JSON.
+// A property schema may also be given in the short form "name": "type".
+// Supported schema keywords are "type", "enum", "minimum", "maximum",
+// "properties", "required", "additionalProperties" and "items". Unknown
+// keywords are ignored.
+class SchemaValidator final {
+ public:
+  SchemaValidator();
+  ~SchemaValidator();
+
+  // Compiles the schema of a single value, e.g. {"type": "integer"}.
+  static std::unique_ptr<SchemaValidator> Compile(
+      const base::DictionaryValue& schema,
+      ErrorPtr* error);
+
+  // Compiles a set of named property schemas, such as the "parameters" of a
+  // command or the "state" of a trait, into a validator of an object with
+  // these properties. Properties not in |properties| are rejected, but none
+  // of the properties are required, so partial updates are accepted.
+  static std::unique_ptr<SchemaValidator> CompileProperties(
+      const base::DictionaryValue& properties,
+      ErrorPtr* error);
+
+  // Checks |value| against the compiled schema.
+  bool Validate(const base::Value& value, ErrorPtr* error) const;
+
+  // Same as Validate(), but for a patch which is deep-merged into an existing
+  // value, such as a state update. "required" is not checked for the objects
+  // of the patch, as the missing properties may already be set. Array items
+  // replace the existing items and are checked in full.
+  bool ValidatePatch(const base::Value& value, ErrorPtr* error) const;
+
+  // Finds the property |name| of a validator compiled by CompileProperties(),
+  // for ValidateProperty(). Returns false if there is no such property.
+  bool FindProperty(const std::string& name, uint32_t* property) const;
+
+  // Checks |value| of a property found by FindProperty(), the same way
+  // ValidatePatch() checks it in an object.
+  bool ValidateProperty(uint32_t property,
+                        const base::Value& value,
+                        ErrorPtr* error) const;
+
+ private:
+  enum class Type {
+    kAny,
+    kBoolean,
+    kInteger,
+    kNumber,
+    kString,
+    kObject,
+    kArray,
+  };
+
+  // Index meaning "no node".
+  static const uint32_t kNone;
+
+  // A compiled schema. Properties, enum values and required property names
+  // are contiguous ranges in the respective arrays of the validator.
+  struct Node {
+    Type type{Type::kAny};
+    bool additional_properties{true};
+    bool has_minimum{false};
+    bool has_maximum{false};
+    double minimum{0};
+    double maximum{0};
+    uint32_t items{kNone};
+    uint32_t properties_begin{0};
+    uint32_t properties_end{0};
+    uint32_t enum_begin{0};
+    uint32_t enum_end{0};
+    uint32_t required_begin{0};
+    uint32_t required_end{0};
+  };
+
+  // Named property of an object node. Sorted by name within an object.
+  struct Property {
+    std::string name;
+    uint32_t node;
+  };
+
+  // Compiles |schema| and returns the index of the new node, or kNone.
+  uint32_t CompileNode(const base::DictionaryValue& schema,
+                       const std::string& path,
+                       ErrorPtr* error);
+
+  // Compiles |properties| into the property range of |node_index|.
+  bool CompilePropertiesOf(uint32_t node_index,
+                           const base::DictionaryValue& properties,
+                           const std::string& path,
+                           ErrorPtr* error);
+
+  // Element of the path to the value being validated, a property name or an
+  // array index. Segments live on the stack of the validation calls and the
+  // path string is only built for an error.
+  struct PathSegment {
+    const PathSegment* parent;
+    const std::string* name;  // nullptr for an array item.
+    size_t index;
+  };
+
+  static std::string GetPath(const PathSegment* segment);
+
+  // |patch| skips the "required" checks of objects, see ValidatePatch().
+  bool ValidateNode(uint32_t node_index,
+                    const base::Value& value,
+                    const PathSegment* path,
+                    bool patch,
+                    ErrorPtr* error) const;
+
+  bool ValidateObject(const Node& node,
+                      const base::DictionaryValue& dict,
+                      const PathSegment* path,
+                      bool patch,
+                      ErrorPtr* error) const;
+
+  std::vector<Node> nodes_;
+  std::vector<Property> properties_;
+  std::vector<std::unique_ptr<base::Value>> enum_values_;
+  std::vector<std::string> required_;
+
+  DISALLOW_COPY_AND_ASSIGN(SchemaValidator);
+};
+
+}  // namespace weave
+
+#endif  // LIBWEAVE_SRC_SCHEMA_VALIDATOR_H_
@@ -0,0 +1,196 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/schema_validator.h"
+
+#include <gtest/gtest.h>
+#include <weave/test/unittest_utils.h>
+
+#include "src/commands/schema_constants.h"
+
+namespace weave {
+
+using test::CreateDictionaryValue;
+using test::CreateValue;
+
+namespace {
+
+std::unique_ptr<SchemaValidator> CompileProperties(const char* json) {
+  auto properties = CreateDictionaryValue(json);
+  auto validator = SchemaValidator::CompileProperties(*properties, nullptr);
+  CHECK(validator);
+  return validator;
+}
+
+}  // anonymous namespace
+
+TEST(SchemaValidatorTest, Types) {
+  auto validator = CompileProperties(R"({
+    "b": {"type": "boolean"},
+    "i": {"type": "integer"},
+    "n": {"type": "number"},
+    "s": {"type": "string"},
+    "o": {"type": "object"},
+    "a": {"type": "array"},
+    "x": {},
+    "y": "integer"
+  })");
+  EXPECT_TRUE(validator->Validate(*CreateValue(R"({
+    "b": true, "i": 2, "n": 2.5, "s": "str", "o": {"k": 1}, "a": [1, "2"],
+    "x": null
+  })"), nullptr));
+  EXPECT_TRUE(validator->Validate(*CreateValue("{'i': 3.0, 'n': 3}"), nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'i': 2.5}"), &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+  EXPECT_EQ("Expected 'i' to be of type 'integer'", error->GetMessage());
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'s': 1}"), nullptr));
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'y': 'a'}"), nullptr));
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'b': 'true'}"), nullptr));
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'o': []}"), nullptr));
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'a': {}}"), nullptr));
+  EXPECT_FALSE(validator->Validate(*CreateValue("[]"), nullptr));
+}
+
+TEST(SchemaValidatorTest, UnknownProperty) {
+  auto validator = CompileProperties("{'a': {'type': 'integer'}}");
+  EXPECT_TRUE(validator->Validate(*CreateValue("{}"), nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'a': 1, 'b': 2}"), &error));
+  EXPECT_EQ(errors::commands::kInvalidPropValue, error->GetCode());
+  EXPECT_EQ("Unknown property 'b'", error->GetMessage());
+}
+
+TEST(SchemaValidatorTest, EnumAndRange) {
+  auto validator = CompileProperties(R"({
+    "mode": {"type": "string", "enum": ["on", "off"]},
+    "level": {"type": "integer", "minimum": 1, "maximum": 10},
+    "ratio": {"type": "number", "minimum": 0.5}
+  })");
+  EXPECT_TRUE(validator->Validate(
+      *CreateValue("{'mode': 'on', 'level': 10, 'ratio': 0.5}"), nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'mode': 'auto'}"), &error));
+  EXPECT_EQ(errors::commands::kInvalidPropValue, error->GetCode());
+  EXPECT_EQ("Value \"auto\" of 'mode' is not one of the allowed values",
+            error->GetMessage());
+  error.reset();
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'level': 11}"), &error));
+  EXPECT_EQ("Value 11 of 'level' is greater than maximum 10",
+            error->GetMessage());
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'level': 0}"), nullptr));
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'ratio': 0.4}"), nullptr));
+}
+
+TEST(SchemaValidatorTest, NestedObjectsAndArrays) {
+  auto validator = CompileProperties(R"({
+    "color": {
+      "type": "object",
+      "properties": {
+        "r": {"type": "integer", "minimum": 0, "maximum": 255},
+        "g": {"type": "integer", "minimum": 0, "maximum": 255}
+      },
+      "required": ["r"],
+      "additionalProperties": false
+    },
+    "list": {"type": "array", "items": {"type": "integer"}}
+  })");
+  EXPECT_TRUE(validator->Validate(
+      *CreateValue("{'color': {'r': 1, 'g': 2}, 'list': [1, 2]}"), nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'color': {'g': 2}}"),
+                                   &error));
+  EXPECT_EQ(errors::commands::kPropertyMissing, error->GetCode());
+  EXPECT_EQ("Required property 'color.r' is missing", error->GetMessage());
+  error.reset();
+  EXPECT_FALSE(validator->Validate(
+      *CreateValue("{'color': {'r': 1, 'b': 2}}"), &error));
+  EXPECT_EQ("Unknown property 'color.b'", error->GetMessage());
+  error.reset();
+  EXPECT_FALSE(validator->Validate(
+      *CreateValue("{'color': {'r': 256}}"), &error));
+  EXPECT_EQ("Value 256 of 'color.r' is greater than maximum 255",
+            error->GetMessage());
+  error.reset();
+  EXPECT_FALSE(validator->Validate(*CreateValue("{'list': [1, 'a']}"),
+                                   &error));
+  EXPECT_EQ("Expected 'list[1]' to be of type 'integer'", error->GetMessage());
+}
+
+TEST(SchemaValidatorTest, ValidatePatch) {
+  auto validator = CompileProperties(R"({
+    "color": {
+      "type": "object",
+      "properties": {
+        "r": {"type": "integer"},
+        "g": {"type": "integer"}
+      },
+      "required": ["r"]
+    },
+    "points": {
+      "type": "array",
+      "items": {
+        "type": "object",
+        "properties": {"x": {"type": "integer"}},
+        "required": ["x"]
+      }
+    }
+  })");
+  // Missing properties of a patch keep their current values.
+  EXPECT_TRUE(validator->ValidatePatch(*CreateValue("{'color': {'g': 2}}"),
+                                       nullptr));
+  uint32_t color = 0;
+  ASSERT_TRUE(validator->FindProperty("color", &color));
+  EXPECT_TRUE(validator->ValidateProperty(color, *CreateValue("{'g': 2}"),
+                                          nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(validator->ValidatePatch(
+      *CreateValue("{'color': {'g': 'a'}}"), &error));
+  EXPECT_EQ("Expected 'color.g' to be of type 'integer'", error->GetMessage());
+  // Array items replace the current items, so they must be complete.
+  error.reset();
+  EXPECT_FALSE(validator->ValidatePatch(*CreateValue("{'points': [{}]}"),
+                                        &error));
+  EXPECT_EQ("Required property 'points[0].x' is missing",
+            error->GetMessage());
+}
+
+TEST(SchemaValidatorTest, Compile) {
+  auto schema = CreateDictionaryValue("{'type': 'integer', 'enum': [1, 2]}");
+  auto validator = SchemaValidator::Compile(*schema, nullptr);
+  ASSERT_TRUE(validator);
+  EXPECT_TRUE(validator->Validate(*CreateValue("2"), nullptr));
+
+  ErrorPtr error;
+  EXPECT_FALSE(validator->Validate(*CreateValue("3"), &error));
+  EXPECT_EQ("Value 3 of 'value' is not one of the allowed values",
+            error->GetMessage());
+}
+
+TEST(SchemaValidatorTest, InvalidSchema) {
+  ErrorPtr error;
+  auto schema = CreateDictionaryValue("{'a': {'type': 'integer', 'enum': 1}}");
+  EXPECT_FALSE(SchemaValidator::CompileProperties(*schema, &error));
+  EXPECT_EQ(errors::commands::kTypeMismatch, error->GetCode());
+  EXPECT_EQ("Invalid 'enum' in schema of 'a'", error->GetMessage());
+
+  schema = CreateDictionaryValue("{'a': 1}");
+  EXPECT_FALSE(SchemaValidator::CompileProperties(*schema, nullptr));
+  schema = CreateDictionaryValue("{'a': {'minimum': 'x'}}");
+  EXPECT_FALSE(SchemaValidator::CompileProperties(*schema, nullptr));
+
+  error.reset();
+  schema = CreateDictionaryValue("{'a': {'type': 'integr'}}");
+  EXPECT_FALSE(SchemaValidator::CompileProperties(*schema, &error));
+  EXPECT_EQ("Invalid 'type' in schema of 'a'", error->GetMessage());
+  schema = CreateDictionaryValue("{'a': 'integr'}");
+  EXPECT_FALSE(SchemaValidator::CompileProperties(*schema, nullptr));
+}
+
+}  // namespace weave
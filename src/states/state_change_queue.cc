@@ -4,50 +4,247 @@
 
 #include "src/states/state_change_queue.h"
 
+#include <algorithm>
+
 #include <base/logging.h>
 
 namespace weave {
 
-StateChangeQueue::StateChangeQueue(size_t max_queue_size)
-    : max_queue_size_(max_queue_size) {
-  CHECK_GT(max_queue_size_, 0U) << "Max queue size must not be zero";
+StatePropertyNames::StatePropertyNames() {}
+
+StatePropertyNames::~StatePropertyNames() {}
+
+uint32_t StatePropertyNames::GetId(const std::string& trait,
+                                   const std::string& name) {
+  auto& ids = ids_[trait];
+  auto it = ids.find(name);
+  if (it != ids.end())
+    return it->second;
+  uint32_t id = names_.size();
+  names_.emplace_back(trait, name);
+  ids.emplace(name, id);
+  return id;
+}
+
+StateChangeQueue::Delta::Delta() {}
+
+StateChangeQueue::Delta::~Delta() {}
+
+void StateChangeQueue::Delta::Set(uint32_t property,
+                                  const base::Value& value) {
+  property_ = property;
+  type_ = value.GetType();
+  switch (type_) {
+    case base::Value::TYPE_NULL:
+      break;
+    case base::Value::TYPE_BOOLEAN:
+      CHECK(value.GetAsBoolean(&bool_value_));
+      break;
+    case base::Value::TYPE_INTEGER:
+      CHECK(value.GetAsInteger(&int_value_));
+      break;
+    case base::Value::TYPE_DOUBLE:
+      CHECK(value.GetAsDouble(&double_value_));
+      break;
+    case base::Value::TYPE_STRING:
+      // Reuses the buffer of the previous string value.
+      CHECK(value.GetAsString(&string_value_));
+      break;
+    default:
+      value_ = value.CreateDeepCopy();
+      break;
+  }
+}
+
+void StateChangeQueue::Delta::Merge(const base::Value& value) {
+  const base::DictionaryValue* dict = nullptr;
+  if (type_ == base::Value::TYPE_DICTIONARY && value.GetAsDictionary(&dict)) {
+    static_cast<base::DictionaryValue*>(value_.get())->MergeDictionary(dict);
+    return;
+  }
+  Set(property_, value);
+}
+
+bool StateChangeQueue::Delta::MergeNewer(const Delta& delta) {
+  if (type_ != base::Value::TYPE_DICTIONARY ||
+      delta.type_ != base::Value::TYPE_DICTIONARY) {
+    return false;
+  }
+  Merge(*delta.value_);
+  return true;
 }
 
+std::unique_ptr<base::Value> StateChangeQueue::Delta::CreateValue() const {
+  switch (type_) {
+    case base::Value::TYPE_NULL:
+      return base::Value::CreateNullValue();
+    case base::Value::TYPE_BOOLEAN:
+      return std::unique_ptr<base::Value>{
+          new base::FundamentalValue{bool_value_}};
+    case base::Value::TYPE_INTEGER:
+      return std::unique_ptr<base::Value>{
+          new base::FundamentalValue{int_value_}};
+    case base::Value::TYPE_DOUBLE:
+      return std::unique_ptr<base::Value>{
+          new base::FundamentalValue{double_value_}};
+    case base::Value::TYPE_STRING:
+      return std::unique_ptr<base::Value>{new base::StringValue{string_value_}};
+    default:
+      return value_->CreateDeepCopy();
+  }
+}
+
+StateChangeQueue::StateChangeQueue(size_t max_queue_size,
+                                   StatePropertyNames* names)
+    : records_(max_queue_size), names_{names} {
+  CHECK_GT(max_queue_size, 0U) << "Max queue size must not be zero";
+  if (!names_) {
+    own_names_.reset(new StatePropertyNames);
+    names_ = own_names_.get();
+  }
+}
+
+StateChangeQueue::~StateChangeQueue() {}
+
 bool StateChangeQueue::NotifyPropertiesUpdated(
     base::Time timestamp,
     const base::DictionaryValue& changed_properties) {
-  auto& stored_changes = state_changes_[timestamp];
-  // Merge the old property set.
-  if (stored_changes)
-    stored_changes->MergeDictionary(&changed_properties);
-  else
-    stored_changes = changed_properties.CreateDeepCopy();
-
-  while (state_changes_.size() > max_queue_size_) {
-    // Queue is full.
-    // Merge the two oldest records into one. The merge strategy is:
-    //  - Move non-existent properties from element [old] to [new].
-    //  - If both [old] and [new] specify the same property,
-    //    keep the value of [new].
-    //  - Keep the timestamp of [new].
-    auto element_old = state_changes_.begin();
-    auto element_new = std::next(element_old);
-    // This will skip elements that exist in both [old] and [new].
-    element_old->second->MergeDictionary(element_new->second.get());
-    std::swap(element_old->second, element_new->second);
-    state_changes_.erase(element_old);
+  Record* record = GetRecordForChange(timestamp);
+  for (base::DictionaryValue::Iterator trait(changed_properties);
+       !trait.IsAtEnd(); trait.Advance()) {
+    const base::DictionaryValue* properties = nullptr;
+    CHECK(trait.value().GetAsDictionary(&properties));
+    for (base::DictionaryValue::Iterator it(*properties); !it.IsAtEnd();
+         it.Advance()) {
+      UpdateProperty(record, names_->GetId(trait.key(), it.key()), it.value());
+    }
   }
   return true;
 }
 
+void StateChangeQueue::NotifyPropertyUpdated(base::Time timestamp,
+                                             uint32_t property,
+                                             const base::Value& value) {
+  UpdateProperty(GetRecordForChange(timestamp), property, value);
+}
+
+StateChangeQueue::Record* StateChangeQueue::GetRecordForChange(
+    base::Time timestamp) {
+  Record* record = nullptr;
+  if (size_ > 0 && timestamp <= GetRecord(size_ - 1).timestamp) {
+    // Merge the old property set.
+    record = &GetRecord(size_ - 1);
+  } else if (size_ == 1 && records_.size() == 1) {
+    // The only record is merged into the new one.
+    record = &GetRecord(0);
+    record->timestamp = timestamp;
+  } else {
+    if (size_ == records_.size()) {
+      // Queue is full.
+      MergeOldestRecord();
+    }
+    record = &GetRecord(size_++);
+    record->timestamp = timestamp;
+    record->size = 0;
+  }
+  return record;
+}
+
+void StateChangeQueue::UpdateProperty(Record* record,
+                                      uint32_t property,
+                                      const base::Value& value) {
+  bool inserted = false;
+  size_t index = FindOrInsert(record, property, &inserted);
+  Delta* delta = record->deltas[index].get();
+  if (inserted)
+    delta->Set(property, value);
+  else
+    delta->Merge(value);
+}
+
 std::vector<StateChange> StateChangeQueue::GetAndClearRecordedStateChanges() {
   std::vector<StateChange> changes;
-  changes.reserve(state_changes_.size());
-  for (auto& pair : state_changes_) {
-    changes.push_back(StateChange{pair.first, std::move(pair.second)});
+  changes.reserve(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    Record& record = GetRecord(i);
+    std::unique_ptr<base::DictionaryValue> properties{
+        new base::DictionaryValue};
+    for (size_t j = 0; j < record.size; ++j) {
+      const Delta& delta = *record.deltas[j];
+      const auto& name = names_->GetName(delta.property());
+      base::DictionaryValue* trait = nullptr;
+      if (!properties->GetDictionaryWithoutPathExpansion(name.first, &trait)) {
+        trait = new base::DictionaryValue;
+        properties->SetWithoutPathExpansion(name.first, trait);
+      }
+      trait->SetWithoutPathExpansion(name.second,
+                                     delta.CreateValue().release());
+    }
+    changes.push_back(StateChange{record.timestamp, std::move(properties)});
+    record.size = 0;
   }
-  state_changes_.clear();
+  head_ = 0;
+  size_ = 0;
   return changes;
 }
 
+void StateChangeQueue::SetMaxQueueSize(size_t max_queue_size) {
+  CHECK_GT(max_queue_size, 0U) << "Max queue size must not be zero";
+  while (size_ > max_queue_size)
+    MergeOldestRecord();
+  std::vector<Record> records(max_queue_size);
+  for (size_t i = 0; i < size_; ++i)
+    std::swap(records[i], GetRecord(i));
+  records_.swap(records);
+  head_ = 0;
+}
+
+size_t StateChangeQueue::FindOrInsert(Record* record,
+                                     uint32_t property,
+                                     bool* inserted) {
+  auto begin = record->deltas.begin();
+  auto end = begin + record->size;
+  auto pos = std::lower_bound(
+      begin, end, property,
+      [](const std::unique_ptr<Delta>& delta, uint32_t property) {
+        return delta->property() < property;
+      });
+  size_t index = pos - begin;
+  *inserted = pos == end || (*pos)->property() != property;
+  if (!*inserted)
+    return index;
+
+  if (record->size == record->deltas.size())
+    record->deltas.emplace_back(new Delta);
+  // Move the first spare slot to |index|.
+  begin = record->deltas.begin();
+  std::rotate(begin + index, begin + record->size, begin + record->size + 1);
+  record->size++;
+  return index;
+}
+
+void StateChangeQueue::MergeOldestRecord() {
+  CHECK_GT(size_, 1U);
+  // Merge the two oldest records into one. The merge strategy is:
+  //  - Move non-existent properties from element [old] to [new].
+  //  - If both [old] and [new] specify the same property,
+  //    keep the value of [new], merged over [old] for dictionaries.
+  //  - Keep the timestamp of [new].
+  Record& element_old = GetRecord(0);
+  Record& element_new = GetRecord(1);
+  for (size_t i = 0; i < element_old.size; ++i) {
+    std::unique_ptr<Delta>& delta = element_old.deltas[i];
+    bool inserted = false;
+    size_t index = FindOrInsert(&element_new, delta->property(), &inserted);
+    // Exchange the value with the spare slot inserted into [new], or with
+    // the value of [new] merged over it.
+    std::unique_ptr<Delta>& delta_new = element_new.deltas[index];
+    if (inserted || delta->MergeNewer(*delta_new))
+      delta_new.swap(delta);
+  }
+  element_old.size = 0;
+  head_ = (head_ + 1) % records_.size();
+  size_--;
+}
+
 }  // namespace weave
@@ -7,6 +7,8 @@
 
 #include <map>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <base/macros.h>
@@ -27,22 +29,126 @@ struct StateChange {
   std::unique_ptr<base::DictionaryValue> changed_properties;
 };
 
+// State property names ("trait", "property") interned as IDs. One instance
+// can be shared by the queues of all components, so that the IDs are known
+// to their owner as well.
+class StatePropertyNames {
+ public:
+  StatePropertyNames();
+  ~StatePropertyNames();
+
+  // Returns the ID of the property |trait|.|name|, interning it if needed.
+  uint32_t GetId(const std::string& trait, const std::string& name);
+
+  const std::pair<std::string, std::string>& GetName(uint32_t id) const {
+    return names_[id];
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>> names_;
+  std::map<std::string, std::map<std::string, uint32_t>> ids_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatePropertyNames);
+};
+
 // An object to record and retrieve device state change notification events.
+// Changes are kept in a fixed-capacity ring buffer of records, each holding
+// the changed property values sorted by their ID in StatePropertyNames. Slots
+// of records and values are reused, so recording scalar property values does
+// not allocate memory once the queue has warmed up.
 class StateChangeQueue {
  public:
-  explicit StateChangeQueue(size_t max_queue_size);
+  // Property IDs are interned in |names| if set, otherwise in a table of the
+  // queue.
+  explicit StateChangeQueue(size_t max_queue_size,
+                            StatePropertyNames* names = nullptr);
+  ~StateChangeQueue();
 
+  // Records |changed_properties|, a dictionary of trait objects with the new
+  // property values. Changes with the same (or an earlier) timestamp as the
+  // last record are merged into that record.
   bool NotifyPropertiesUpdated(base::Time timestamp,
                                const base::DictionaryValue& changed_properties);
+  // Records a new |value| of the property with ID |property|, the same way.
+  void NotifyPropertyUpdated(base::Time timestamp,
+                             uint32_t property,
+                             const base::Value& value);
   std::vector<StateChange> GetAndClearRecordedStateChanges();
 
+  // Returns true if there are no recorded changes.
+  bool IsEmpty() const { return size_ == 0; }
+
+  // Changes the maximum queue size. Merges the oldest records if there are
+  // more than |max_queue_size| of them.
+  void SetMaxQueueSize(size_t max_queue_size);
+  size_t max_queue_size() const { return records_.size(); }
+
  private:
-  // Maximum queue size. If it is full, the oldest state update records are
-  // merged together until the queue size is within the size limit.
-  const size_t max_queue_size_;
+  // A new value of a single property.
+  class Delta {
+   public:
+    Delta();
+    ~Delta();
+
+    uint32_t property() const { return property_; }
+
+    // Replaces the value. Dictionaries are merged like MergeDictionary()
+    // does for the whole state.
+    void Set(uint32_t property, const base::Value& value);
+    void Merge(const base::Value& value);
+    // Merges the dictionary of the newer |delta| over this one. Returns false
+    // if the values are not both dictionaries and |delta| replaces this one.
+    bool MergeNewer(const Delta& delta);
+    std::unique_ptr<base::Value> CreateValue() const;
+
+   private:
+    uint32_t property_{0};
+    base::Value::Type type_{base::Value::TYPE_NULL};
+    // Scalar values are stored inline, others are deep-copied into |value_|.
+    bool bool_value_{false};
+    int int_value_{0};
+    double double_value_{0};
+    std::string string_value_;
+    std::unique_ptr<base::Value> value_;
+
+    DISALLOW_COPY_AND_ASSIGN(Delta);
+  };
+
+  // Property values changed at |timestamp|. Only the first |size| items of
+  // |deltas| are used, sorted by property ID. The rest are spare slots.
+  struct Record {
+    base::Time timestamp;
+    std::vector<std::unique_ptr<Delta>> deltas;
+    size_t size{0};
+  };
+
+  // Returns the record to store the changes made at |timestamp| in.
+  Record* GetRecordForChange(base::Time timestamp);
+  void UpdateProperty(Record* record,
+                      uint32_t property,
+                      const base::Value& value);
+
+  Record& GetRecord(size_t index) {
+    return records_[(head_ + index) % records_.size()];
+  }
+
+  // Returns the index of the slot for |property| in |record|, inserting a
+  // spare one at the right position if the record has no value for it yet.
+  // |inserted| is set to true if the slot was inserted.
+  size_t FindOrInsert(Record* record, uint32_t property, bool* inserted);
+
+  // Merges the oldest record into the next one and drops it. Values of the
+  // newer record win.
+  void MergeOldestRecord();
+
+  // Ring buffer of records. Its size is the maximum queue size. The oldest
+  // record is at |head_|.
+  std::vector<Record> records_;
+  size_t head_{0};
+  size_t size_{0};
 
-  // Accumulated list of device state change notifications.
-  std::map<base::Time, std::unique_ptr<base::DictionaryValue>> state_changes_;
+  std::unique_ptr<StatePropertyNames> own_names_;
+  StatePropertyNames* names_{nullptr};
 
   DISALLOW_COPY_AND_ASSIGN(StateChangeQueue);
 };
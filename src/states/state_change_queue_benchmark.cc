@@ -0,0 +1,65 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/states/state_change_queue.h"
+
+#include <base/strings/stringprintf.h>
+
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kMaxQueueSize = 100;
+
+// Returns changes of |size| properties of a single trait.
+std::unique_ptr<base::DictionaryValue> CreateChanges(size_t size) {
+  std::unique_ptr<base::DictionaryValue> changes{new base::DictionaryValue};
+  for (size_t i = 0; i < size; ++i)
+    changes->SetInteger(base::StringPrintf("trait.prop%zu", i), 1);
+  return changes;
+}
+
+}  // namespace
+
+// Records changes of |size| properties with increasing timestamps, so the
+// queue is full and merges the oldest record most of the time.
+WEAVE_BENCHMARK(StateChangeQueueNotifyPropertiesUpdated) {
+  StateChangeQueue queue{kMaxQueueSize};
+  auto changes = CreateChanges(state->size());
+  base::Time timestamp = base::Time::FromTimeT(1410000000);
+  while (state->KeepRunning()) {
+    timestamp += base::TimeDelta::FromMilliseconds(1);
+    queue.NotifyPropertiesUpdated(timestamp, *changes);
+  }
+}
+
+// Records changes of |size| properties with the same timestamp, so they are
+// merged into the last record.
+WEAVE_BENCHMARK(StateChangeQueueMergePropertiesUpdated) {
+  StateChangeQueue queue{kMaxQueueSize};
+  auto changes = CreateChanges(state->size());
+  base::Time timestamp = base::Time::FromTimeT(1410000000);
+  while (state->KeepRunning())
+    queue.NotifyPropertiesUpdated(timestamp, *changes);
+}
+
+// Retrieves a full queue of changes of |size| properties each.
+WEAVE_BENCHMARK(StateChangeQueueGetAndClearRecordedStateChanges) {
+  StateChangeQueue queue{kMaxQueueSize};
+  auto changes = CreateChanges(state->size());
+  base::Time timestamp = base::Time::FromTimeT(1410000000);
+  while (state->KeepRunning()) {
+    state->PauseTiming();
+    for (size_t i = 0; i < kMaxQueueSize; ++i) {
+      timestamp += base::TimeDelta::FromMilliseconds(1);
+      queue.NotifyPropertiesUpdated(timestamp, *changes);
+    }
+    state->ResumeTiming();
+    CHECK_EQ(kMaxQueueSize, queue.GetAndClearRecordedStateChanges().size());
+  }
+}
+
+}  // namespace weave
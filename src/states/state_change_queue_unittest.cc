@@ -116,4 +116,96 @@ TEST_F(StateChangeQueueTest, MaxQueueSize) {
   EXPECT_JSON_EQ(expected2, *changes[1].changed_properties);
 }
 
+TEST_F(StateChangeQueueTest, MaxQueueSizeOne) {
+  queue_.reset(new StateChangeQueue(1));
+  base::Time start_time = base::Time::Now();
+  base::TimeDelta time_delta = base::TimeDelta::FromMinutes(1);
+
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      start_time,
+      *CreateDictionaryValue("{'prop': {'name1': 1, 'name2': 2}}")));
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      start_time + time_delta,
+      *CreateDictionaryValue("{'prop': {'name1': 3}}")));
+
+  auto changes = queue_->GetAndClearRecordedStateChanges();
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_EQ(start_time + time_delta, changes[0].timestamp);
+  EXPECT_JSON_EQ("{'prop': {'name1': 3, 'name2': 2}}",
+                 *changes[0].changed_properties);
+}
+
+TEST_F(StateChangeQueueTest, MaxQueueSizeDictionaryProperty) {
+  queue_.reset(new StateChangeQueue(1));
+  base::Time start_time = base::Time::Now();
+  base::TimeDelta time_delta = base::TimeDelta::FromMinutes(1);
+
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      start_time, *CreateDictionaryValue(
+                      "{'trait': {'prop': {'a': 1, 'b': {'c': 2, 'd': 3}}}}")));
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      start_time + time_delta,
+      *CreateDictionaryValue("{'trait': {'prop': {'b': {'c': 4}, 'e': 5}}}")));
+
+  auto changes = queue_->GetAndClearRecordedStateChanges();
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_EQ(start_time + time_delta, changes[0].timestamp);
+  EXPECT_JSON_EQ(
+      "{'trait': {'prop': {'a': 1, 'b': {'c': 4, 'd': 3}, 'e': 5}}}",
+      *changes[0].changed_properties);
+}
+
+TEST_F(StateChangeQueueTest, SetMaxQueueSize) {
+  base::Time start_time = base::Time::Now();
+  base::TimeDelta time_delta = base::TimeDelta::FromMinutes(1);
+  for (int i = 0; i < 5; i++) {
+    auto properties = CreateDictionaryValue("{'prop': {}}");
+    properties->SetInteger("prop.name" + std::to_string(i), i);
+    properties->SetInteger("prop.last", i);
+    ASSERT_TRUE(queue_->NotifyPropertiesUpdated(start_time + i * time_delta,
+                                                *properties));
+  }
+  queue_->SetMaxQueueSize(2);
+  EXPECT_EQ(2u, queue_->max_queue_size());
+
+  auto changes = queue_->GetAndClearRecordedStateChanges();
+  ASSERT_EQ(2u, changes.size());
+  EXPECT_EQ(start_time + 3 * time_delta, changes[0].timestamp);
+  EXPECT_JSON_EQ(
+      "{'prop': {'name0': 0, 'name1': 1, 'name2': 2, 'name3': 3, 'last': 3}}",
+      *changes[0].changed_properties);
+  EXPECT_EQ(start_time + 4 * time_delta, changes[1].timestamp);
+  EXPECT_JSON_EQ("{'prop': {'name4': 4, 'last': 4}}",
+                 *changes[1].changed_properties);
+
+  // The queue is reused after it has been cleared.
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      start_time, *CreateDictionaryValue("{'prop': {'name1': 'a'}}")));
+  changes = queue_->GetAndClearRecordedStateChanges();
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_JSON_EQ("{'prop': {'name1': 'a'}}", *changes[0].changed_properties);
+}
+
+TEST_F(StateChangeQueueTest, ValueTypes) {
+  base::Time timestamp = base::Time::Now();
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      timestamp, *CreateDictionaryValue(R"({
+        'trait1': {'b': true, 'i': 1, 'd': 1.5, 's': 'str', 'n': null},
+        'trait2': {'l': [1, 2], 'o': {'x': 1, 'y': {'z': 2}}}
+      })")));
+  // Dictionaries are merged, other values are replaced.
+  ASSERT_TRUE(queue_->NotifyPropertiesUpdated(
+      timestamp, *CreateDictionaryValue(R"({
+        'trait1': {'s': 5},
+        'trait2': {'l': [3], 'o': {'y': {'w': 3}}}
+      })")));
+
+  auto changes = queue_->GetAndClearRecordedStateChanges();
+  ASSERT_EQ(1u, changes.size());
+  EXPECT_JSON_EQ(R"({
+    'trait1': {'b': true, 'i': 1, 'd': 1.5, 's': 5, 'n': null},
+    'trait2': {'l': [3], 'o': {'x': 1, 'y': {'z': 2, 'w': 3}}}
+  })", *changes[0].changed_properties);
+}
+
 }  // namespace weave
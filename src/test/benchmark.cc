@@ -0,0 +1,200 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/test/benchmark.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <base/logging.h>
+#include <base/strings/string_number_conversions.h>
+#include <base/strings/stringprintf.h>
+
+#include <weave/provider/test/fake_task_runner.h>
+
+#include "src/component_manager_impl.h"
+#include "src/string_utils.h"
+
+namespace weave {
+namespace benchmark {
+
+namespace {
+
+struct Benchmark {
+  const char* name;
+  BenchmarkFunction function;
+};
+
+std::vector<Benchmark>& GetBenchmarks() {
+  static std::vector<Benchmark>* benchmarks = new std::vector<Benchmark>;
+  return *benchmarks;
+}
+
+const char kUsage[] =
+    "Usage: libweave_benchmarks [--filter=SUBSTRING] [--sizes=N,N,...]\n"
+    "                           [--min_time_ms=N]\n"
+    "  --filter       runs only the benchmarks with SUBSTRING in the name\n"
+    "  --sizes        sizes of the synthetic device model (default 1,10,100)\n"
+    "  --min_time_ms  minimum run time of each benchmark (default 200)\n";
+
+bool ParseSwitch(const char* arg, const char* name, std::string* value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=')
+    return false;
+  *value = arg + length + 1;
+  return true;
+}
+
+}  // namespace
+
+State::State(size_t size, base::TimeDelta min_time)
+    : size_{size}, min_time_{min_time} {}
+
+bool State::KeepRunning() {
+  if (batch_left_ > 0) {
+    --batch_left_;
+    ++iterations_;
+    return true;
+  }
+  if (running_) {
+    PauseTiming();
+    if (elapsed_ >= min_time_)
+      return false;
+    // Check the time less often for fast benchmarks.
+    if (batch_size_ < 1000000 && elapsed_ < min_time_ / 100)
+      batch_size_ *= 10;
+  }
+  ResumeTiming();
+  batch_left_ = batch_size_ - 1;
+  ++iterations_;
+  return true;
+}
+
+void State::PauseTiming() {
+  CHECK(running_);
+  elapsed_ += base::TimeTicks::Now() - start_;
+  running_ = false;
+}
+
+void State::ResumeTiming() {
+  CHECK(!running_);
+  running_ = true;
+  start_ = base::TimeTicks::Now();
+}
+
+bool RegisterBenchmark(const char* name, BenchmarkFunction function) {
+  GetBenchmarks().push_back(Benchmark{name, function});
+  return true;
+}
+
+std::unique_ptr<base::DictionaryValue> CreateTraits(size_t trait_count,
+                                                    size_t property_count) {
+  std::unique_ptr<base::DictionaryValue> traits{new base::DictionaryValue};
+  for (size_t i = 0; i < trait_count; ++i) {
+    std::unique_ptr<base::DictionaryValue> trait{new base::DictionaryValue};
+    for (size_t j = 0; j < property_count; ++j) {
+      trait->SetString(base::StringPrintf("state.prop%zu.type", j), "integer");
+    }
+    trait->SetString("commands.cmd.parameters.value.type", "integer");
+    trait->SetString("commands.cmd.minimalRole", "user");
+    traits->SetWithoutPathExpansion(base::StringPrintf("trait%zu", i),
+                                    trait.release());
+  }
+  return traits;
+}
+
+void AddComponents(ComponentManager* manager,
+                   size_t component_count,
+                   size_t trait_count,
+                   size_t property_count) {
+  CHECK(manager->LoadTraits(*CreateTraits(trait_count, property_count),
+                            nullptr));
+  std::vector<std::string> traits;
+  for (size_t i = 0; i < trait_count; ++i)
+    traits.push_back(base::StringPrintf("trait%zu", i));
+  for (size_t i = 0; i < component_count; ++i) {
+    std::string name = base::StringPrintf("comp%zu", i);
+    CHECK(manager->AddComponent("", name, traits, nullptr));
+    base::DictionaryValue state;
+    for (const auto& trait : traits) {
+      for (size_t j = 0; j < property_count; ++j) {
+        state.SetInteger(base::StringPrintf("%s.prop%zu", trait.c_str(), j),
+                         0);
+      }
+    }
+    CHECK(manager->SetStateProperties(name, state, nullptr));
+  }
+}
+
+std::unique_ptr<base::DictionaryValue> CreateComponentTree(
+    size_t component_count,
+    size_t trait_count,
+    size_t property_count) {
+  provider::test::FakeTaskRunner task_runner;
+  ComponentManagerImpl manager{&task_runner};
+  AddComponents(&manager, component_count, trait_count, property_count);
+  return manager.GetComponents().CreateDeepCopy();
+}
+
+}  // namespace benchmark
+}  // namespace weave
+
+int main(int argc, char** argv) {
+  logging::LoggingSettings settings;
+  settings.logging_dest = logging::LOG_TO_SYSTEM_DEBUG_LOG;
+  logging::InitLogging(settings);
+  logging::SetLogItems(false, false, false, false);
+  logging::SetMinLogLevel(logging::LOG_WARNING);
+
+  std::string filter;
+  std::vector<size_t> sizes{1, 10, 100};
+  base::TimeDelta min_time = base::TimeDelta::FromMilliseconds(200);
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (weave::benchmark::ParseSwitch(argv[i], "--filter", &value)) {
+      filter = value;
+    } else if (weave::benchmark::ParseSwitch(argv[i], "--sizes", &value)) {
+      sizes.clear();
+      for (const auto& item : weave::Split(value, ",", true, true)) {
+        size_t size = 0;
+        if (!base::StringToSizeT(item, &size) || size == 0) {
+          fprintf(stderr, "%s", weave::benchmark::kUsage);
+          return 1;
+        }
+        sizes.push_back(size);
+      }
+    } else if (weave::benchmark::ParseSwitch(argv[i], "--min_time_ms",
+                                             &value)) {
+      int ms = 0;
+      if (!base::StringToInt(value, &ms) || ms <= 0) {
+        fprintf(stderr, "%s", weave::benchmark::kUsage);
+        return 1;
+      }
+      min_time = base::TimeDelta::FromMilliseconds(ms);
+    } else {
+      fprintf(stderr, "%s", weave::benchmark::kUsage);
+      return 1;
+    }
+  }
+
+  printf("%-40s %6s %12s %14s %10s\n", "Benchmark", "Size", "Iterations",
+         "ns/iteration", "Bytes");
+  for (const auto& benchmark : weave::benchmark::GetBenchmarks()) {
+    if (!filter.empty() && !strstr(benchmark.name, filter.c_str()))
+      continue;
+    for (size_t size : sizes) {
+      weave::benchmark::State state{size, min_time};
+      benchmark.function(&state);
+      CHECK_GT(state.iterations(), 0u) << benchmark.name;
+      double ns = state.elapsed().InMillisecondsF() * 1e6 / state.iterations();
+      std::string bytes =
+          state.bytes() > 0 ? std::to_string(state.bytes()) : std::string{};
+      printf("%-40s %6zu %12zu %14.1f %10s\n", benchmark.name, size,
+             state.iterations(), ns, bytes.c_str());
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBWEAVE_SRC_TEST_BENCHMARK_H_
+#define LIBWEAVE_SRC_TEST_BENCHMARK_H_
+
+#include <memory>
+#include <string>
+
+#include <base/macros.h>
+#include <base/time/time.h>
+#include <base/values.h>
+
+namespace weave {
+
+class ComponentManager;
+
+namespace benchmark {
+
+// Controls the measurement loop of a single benchmark run:
+//
+//   WEAVE_BENCHMARK(Foo) {
+//     ...set up for state->size()...
+//     while (state->KeepRunning())
+//       ...code to measure...
+//   }
+class State final {
+ public:
+  State(size_t size, base::TimeDelta min_time);
+
+  // Returns true while the benchmark should run another iteration. The loop
+  // runs until the measured time reaches the minimum run time.
+  bool KeepRunning();
+
+  // Excludes the time spent between the calls from the measurement, e.g.
+  // for resetting the state after each iteration.
+  void PauseTiming();
+  void ResumeTiming();
+
+  // Size of the synthetic device model, e.g. the number of components.
+  size_t size() const { return size_; }
+
+  size_t iterations() const { return iterations_; }
+  base::TimeDelta elapsed() const { return elapsed_; }
+
+  // Size of the data produced by each iteration, e.g. an encoded message.
+  // Reported along with the time if set.
+  void set_bytes(size_t bytes) { bytes_ = bytes; }
+  size_t bytes() const { return bytes_; }
+
+ private:
+  const size_t size_;
+  const base::TimeDelta min_time_;
+  size_t iterations_{0};
+  // Number of iterations left before the time is checked again.
+  size_t batch_left_{0};
+  size_t batch_size_{1};
+  bool running_{false};
+  base::TimeTicks start_;
+  base::TimeDelta elapsed_;
+  size_t bytes_{0};
+
+  DISALLOW_COPY_AND_ASSIGN(State);
+};
+
+using BenchmarkFunction = void (*)(State* state);
+
+// Adds a benchmark to the list run by the benchmark runner. Use
+// WEAVE_BENCHMARK() instead of calling this directly.
+bool RegisterBenchmark(const char* name, BenchmarkFunction function);
+
+// Synthetic device model for the benchmarks. Traits are named "trait<N>" and
+// have |property_count| integer state properties "prop<N>" and a command
+// "cmd" with an integer parameter "value". Components are named "comp<N>"
+// and each supports all of the traits.
+std::unique_ptr<base::DictionaryValue> CreateTraits(size_t trait_count,
+                                                    size_t property_count);
+void AddComponents(ComponentManager* manager,
+                   size_t component_count,
+                   size_t trait_count,
+                   size_t property_count);
+// Returns the component tree of a device with the components above.
+std::unique_ptr<base::DictionaryValue> CreateComponentTree(
+    size_t component_count,
+    size_t trait_count,
+    size_t property_count);
+
+}  // namespace benchmark
+}  // namespace weave
+
+#define WEAVE_BENCHMARK(name)                                         \
+  static void Benchmark##name(::weave::benchmark::State* state);      \
+  static const bool benchmark_##name##_registered =                   \
+      ::weave::benchmark::RegisterBenchmark(#name, &Benchmark##name); \
+  static void Benchmark##name(::weave::benchmark::State* state)
+
+#endif  // LIBWEAVE_SRC_TEST_BENCHMARK_H_
@@ -48,6 +48,10 @@ class MockComponentManager : public ComponentManager {
                                 UserRole role,
                                 std::string* id,
                                 ErrorPtr* error));
+  MOCK_METHOD3(ValidateCommandInstance,
+               bool(CommandInstance* command_instance,
+                    UserRole role,
+                    ErrorPtr* error));
   MOCK_METHOD1(FindCommand, CommandInstance*(const std::string& id));
   MOCK_METHOD1(AddCommandAddedCallback,
                void(const CommandQueue::CommandCallback& callback));
@@ -77,6 +81,7 @@ class MockComponentManager : public ComponentManager {
   MOCK_CONST_METHOD0(GetComponents, const base::DictionaryValue&());
   MOCK_CONST_METHOD1(MockGetComponentsForUserRole,
                      base::DictionaryValue*(UserRole));
+  MOCK_METHOD1(SetStateValidationEnabled, void(bool enabled));
   MOCK_METHOD3(SetStateProperties,
                bool(const std::string& component_path,
                     const base::DictionaryValue& dict,
@@ -94,10 +99,28 @@ class MockComponentManager : public ComponentManager {
                     const std::string& name,
                     const base::Value& value,
                     ErrorPtr* error));
+  MOCK_CONST_METHOD2(GetComponentHandle,
+                     ComponentHandle(const std::string& component_path,
+                                     ErrorPtr* error));
+  MOCK_METHOD2(GetStatePropertyHandle,
+               StatePropertyHandle(const std::string& name, ErrorPtr* error));
+  MOCK_METHOD3(SetStatePropertiesByHandle,
+               bool(ComponentHandle component,
+                    const base::DictionaryValue& dict,
+                    ErrorPtr* error));
+  MOCK_METHOD4(SetStatePropertyByHandle,
+               bool(ComponentHandle component,
+                    StatePropertyHandle property,
+                    const base::Value& value,
+                    ErrorPtr* error));
   MOCK_METHOD1(AddStateChangedCallback, void(const base::Closure& callback));
   MOCK_METHOD0(MockGetAndClearRecordedStateChanges, StateSnapshot&());
   MOCK_METHOD1(NotifyStateUpdatedOnServer, void(UpdateID id));
+  MOCK_METHOD3(SetStateChangeQueueSize,
+               bool(const std::string&, size_t, ErrorPtr*));
   MOCK_CONST_METHOD0(GetLastStateChangeId, UpdateID());
+  MOCK_CONST_METHOD2(GetStateChangesSince,
+                     bool(UpdateID, std::vector<ComponentStateChange>*));
   MOCK_METHOD1(MockAddServerStateUpdatedCallback,
                base::CallbackList<void(UpdateID)>::Subscription*(
                    const base::Callback<void(UpdateID)>& callback));
@@ -0,0 +1,129 @@
+// Copyright 2015 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <base/strings/stringprintf.h>
+#include <base/values.h>
+#include "src/test/benchmark.h"
+
+namespace weave {
+
+namespace {
+
+const size_t kTraitCount = 4;
+const size_t kPropertyCount = 4;
+// Keys of the large dictionary benchmarks per unit of size.
+const size_t kLargeDictionaryKeys = 100;
+
+// Paths of all state properties of the components of the benchmark tree.
+std::vector<std::string> GetStatePropertyPaths(size_t component_count) {
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < component_count; ++i) {
+    for (size_t j = 0; j < kTraitCount; ++j) {
+      for (size_t k = 0; k < kPropertyCount; ++k) {
+        paths.push_back(
+            base::StringPrintf("comp%zu.state.trait%zu.prop%zu", i, j, k));
+      }
+    }
+  }
+  return paths;
+}
+
+// Keys of a large flat dictionary, in a shuffled but repeatable order.
+std::vector<std::string> GetShuffledKeys(size_t count) {
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < count; ++i)
+    keys.push_back(base::StringPrintf("key%zu", i));
+  std::minstd_rand random;
+  std::shuffle(keys.begin(), keys.end(), random);
+  return keys;
+}
+
+}  // namespace
+
+WEAVE_BENCHMARK(DictionaryValueGetStateProperties) {
+  auto components = benchmark::CreateComponentTree(state->size(), kTraitCount,
+                                                   kPropertyCount);
+  auto paths = GetStatePropertyPaths(state->size());
+  while (state->KeepRunning()) {
+    for (const auto& path : paths) {
+      int value = 0;
+      CHECK(components->GetInteger(path, &value));
+    }
+  }
+}
+
+WEAVE_BENCHMARK(DictionaryValueGetCommandDefinitions) {
+  auto traits = benchmark::CreateTraits(state->size(), kPropertyCount);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < state->size(); ++i)
+    paths.push_back(base::StringPrintf("trait%zu.commands.cmd", i));
+  while (state->KeepRunning()) {
+    for (const auto& path : paths) {
+      const base::DictionaryValue* command = nullptr;
+      CHECK(traits->GetDictionary(path, &command));
+    }
+  }
+}
+
+WEAVE_BENCHMARK(DictionaryValueIterateComponents) {
+  auto components = benchmark::CreateComponentTree(state->size(), kTraitCount,
+                                                   kPropertyCount);
+  while (state->KeepRunning()) {
+    size_t count = 0;
+    for (base::DictionaryValue::Iterator it(*components); !it.IsAtEnd();
+         it.Advance()) {
+      const base::DictionaryValue* traits = nullptr;
+      CHECK(it.value().GetAsDictionary(&traits));
+      count += traits->size();
+    }
+    CHECK_EQ(count, 2 * state->size());
+  }
+}
+
+WEAVE_BENCHMARK(DictionaryValueDeepCopyComponents) {
+  auto components = benchmark::CreateComponentTree(state->size(), kTraitCount,
+                                                   kPropertyCount);
+  while (state->KeepRunning())
+    components->CreateDeepCopy();
+}
+
+WEAVE_BENCHMARK(DictionaryValueSetStateProperties) {
+  auto paths = GetStatePropertyPaths(state->size());
+  while (state->KeepRunning()) {
+    base::DictionaryValue components;
+    for (const auto& path : paths)
+      components.SetInteger(path, 0);
+  }
+}
+
+// Fills a single dictionary with 100 * |size| keys in random order, the worst
+// case for the sorted vector storage of DictionaryValue.
+WEAVE_BENCHMARK(DictionaryValueInsertLarge) {
+  auto keys = GetShuffledKeys(kLargeDictionaryKeys * state->size());
+  while (state->KeepRunning()) {
+    base::DictionaryValue dict;
+    for (const auto& key : keys)
+      dict.SetIntegerWithoutPathExpansion(key, 0);
+  }
+}
+
+// Removes the keys of a large dictionary in random order.
+WEAVE_BENCHMARK(DictionaryValueRemoveLarge) {
+  auto keys = GetShuffledKeys(kLargeDictionaryKeys * state->size());
+  base::DictionaryValue filled;
+  for (const auto& key : keys)
+    filled.SetIntegerWithoutPathExpansion(key, 0);
+  std::shuffle(keys.begin(), keys.end(), std::minstd_rand{});
+  while (state->KeepRunning()) {
+    auto dict = filled.CreateDeepCopy();
+    for (const auto& key : keys)
+      CHECK(dict->RemoveWithoutPathExpansion(key, nullptr));
+  }
+}
+
+}  // namespace weave
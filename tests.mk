@@ -66,6 +66,28 @@ export-test : out/$(BUILD_MODE)/libweave_exports_testrunner
 testall : test export-test
 check : testall
 
+###
+# benchmarks
+
+BENCHMARK_FLAGS ?=
+
+weave_benchmark_obj_files := $(WEAVE_BENCHMARK_SRC_FILES:%.cc=out/$(BUILD_MODE)/%.o)
+
+$(weave_benchmark_obj_files) : out/$(BUILD_MODE)/%.o : %.cc
+	mkdir -p $(dir $@)
+	$(CXX) $(DEFS_TEST) $(INCLUDES) $(CFLAGS) $(CFLAGS_$(BUILD_MODE)) $(CFLAGS_CC) -c -o $@ $<
+
+out/$(BUILD_MODE)/libweave_benchmarks : \
+	$(weave_benchmark_obj_files) \
+	out/$(BUILD_MODE)/libweave_common.a \
+	out/$(BUILD_MODE)/libweave-test.a \
+	$(third_party_gtest_lib) \
+	$(third_party_gmock_lib)
+	$(CXX) -o $@ $^ $(CFLAGS) -lcrypto -lexpat -lpthread -lrt
+
+benchmark : out/$(BUILD_MODE)/libweave_benchmarks
+	$(TEST_ENV) $< $(BENCHMARK_FLAGS)
+
 ###
 # coverage
 # This runs coverage against unit tests, invoke with "make coverage".
@@ -82,4 +104,4 @@ run_coverage: test
 
 coverage: run_coverage
 
-.PHONY : check coverage run_coverage test export-test testall
+.PHONY : benchmark check coverage run_coverage test export-test testall
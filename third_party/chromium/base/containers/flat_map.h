@@ -0,0 +1,115 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_CONTAINERS_FLAT_MAP_H_
+#define BASE_CONTAINERS_FLAT_MAP_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace base {
+
+// Map which keeps its entries in a vector sorted by key. Lookups are binary
+// searches over contiguous memory, and the entries need no allocations of
+// their own. Insertions and removals move the entries after their position,
+// so the map is meant for small maps which are read more often than written.
+// Inserting keys in increasing order takes amortized constant time.
+//
+// Unlike std::map, insertions and removals invalidate the iterators and the
+// references to the entries.
+template <class Key, class Mapped, class Compare = std::less<Key>>
+class flat_map {
+ public:
+  using key_type = Key;
+  using mapped_type = Mapped;
+  using value_type = std::pair<Key, Mapped>;
+  using container_type = std::vector<value_type>;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+  using size_type = typename container_type::size_type;
+
+  flat_map() {}
+
+  iterator begin() { return entries_.begin(); }
+  const_iterator begin() const { return entries_.begin(); }
+  iterator end() { return entries_.end(); }
+  const_iterator end() const { return entries_.end(); }
+
+  size_type size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+  void reserve(size_type size) { entries_.reserve(size); }
+  void clear() { entries_.clear(); }
+  void swap(flat_map& other) { entries_.swap(other.entries_); }
+
+  // The lookups accept any type of key which |Compare| can compare with
+  // |Key|, e.g. a StringPiece for std::string keys, to avoid conversions.
+  template <class K>
+  iterator lower_bound(const K& key) {
+    return std::lower_bound(entries_.begin(), entries_.end(), key,
+                            KeyCompare());
+  }
+  template <class K>
+  const_iterator lower_bound(const K& key) const {
+    return std::lower_bound(entries_.begin(), entries_.end(), key,
+                            KeyCompare());
+  }
+
+  template <class K>
+  iterator find(const K& key) {
+    iterator it = lower_bound(key);
+    return it == end() || Compare()(key, it->first) ? end() : it;
+  }
+  template <class K>
+  const_iterator find(const K& key) const {
+    const_iterator it = lower_bound(key);
+    return it == end() || Compare()(key, it->first) ? end() : it;
+  }
+
+  template <class K>
+  size_type count(const K& key) const {
+    return find(key) == end() ? 0 : 1;
+  }
+
+  // Returns the value of |key|, inserting a default constructed one if the
+  // key is not in the map.
+  Mapped& operator[](const Key& key) {
+    // Maps are often built in key order, e.g. from sorted JSON.
+    if (entries_.empty() || Compare()(entries_.back().first, key)) {
+      entries_.emplace_back(key, Mapped());
+      return entries_.back().second;
+    }
+    iterator it = lower_bound(key);
+    if (it == end() || Compare()(key, it->first))
+      it = entries_.emplace(it, key, Mapped());
+    return it->second;
+  }
+
+  iterator erase(iterator position) { return entries_.erase(position); }
+  size_type erase(const Key& key) {
+    iterator it = find(key);
+    if (it == end())
+      return 0;
+    erase(it);
+    return 1;
+  }
+
+ private:
+  struct KeyCompare {
+    template <class K>
+    bool operator()(const value_type& entry, const K& key) const {
+      return Compare()(entry.first, key);
+    }
+  };
+
+  // Sorted by key, without duplicates.
+  container_type entries_;
+};
+
+}  // namespace base
+
+#endif  // BASE_CONTAINERS_FLAT_MAP_H_
@@ -0,0 +1,74 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/containers/flat_map.h"
+
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace base {
+
+TEST(FlatMapTest, Insert) {
+  flat_map<std::string, int> map;
+  EXPECT_TRUE(map.empty());
+  map["b"] = 2;
+  map["d"] = 4;
+  map["a"] = 1;
+  map["c"] = 3;
+  map["b"] = 5;
+  EXPECT_EQ(4u, map.size());
+
+  std::string keys;
+  int sum = 0;
+  for (const auto& entry : map) {
+    keys += entry.first;
+    sum += entry.second;
+  }
+  EXPECT_EQ("abcd", keys);
+  EXPECT_EQ(13, sum);
+}
+
+TEST(FlatMapTest, Find) {
+  flat_map<std::string, int> map;
+  map["a"] = 1;
+  map["c"] = 3;
+  EXPECT_EQ(1, map.find("a")->second);
+  EXPECT_EQ(3, map.find("c")->second);
+  EXPECT_EQ(map.end(), map.find("b"));
+  EXPECT_EQ(map.end(), map.find("d"));
+  EXPECT_EQ(1u, map.count("a"));
+  EXPECT_EQ(0u, map.count("b"));
+  EXPECT_EQ("c", map.lower_bound("b")->first);
+}
+
+TEST(FlatMapTest, Erase) {
+  flat_map<std::string, std::unique_ptr<int>> map;
+  map["a"].reset(new int(1));
+  map["b"].reset(new int(2));
+  map["c"].reset(new int(3));
+  EXPECT_EQ(1u, map.erase("b"));
+  EXPECT_EQ(0u, map.erase("b"));
+  auto it = map.erase(map.find("a"));
+  EXPECT_EQ("c", it->first);
+  EXPECT_EQ(3, *it->second);
+  EXPECT_EQ(1u, map.size());
+  map.clear();
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(FlatMapTest, Swap) {
+  flat_map<int, int> map1;
+  map1[1] = 1;
+  flat_map<int, int> map2;
+  map2[2] = 2;
+  map2[3] = 3;
+  map1.swap(map2);
+  EXPECT_EQ(2u, map1.size());
+  EXPECT_EQ(1u, map2.size());
+  EXPECT_EQ(1, map2[1]);
+}
+
+}  // namespace base
@@ -187,6 +187,7 @@ class StackMarker {
 
 JSONParser::JSONParser(int options)
     : options_(options),
+      handler_(nullptr),
       start_pos_(nullptr),
       pos_(nullptr),
       end_pos_(nullptr),
@@ -209,28 +210,9 @@ std::unique_ptr<Value> JSONParser::Parse(StringPiece input) {
   // be used anywhere.
   if (!(options_ & JSON_DETACHABLE_CHILDREN)) {
     input_copy = MakeUnique<std::string>(input.as_string());
-    start_pos_ = input_copy->data();
+    StartInput(input_copy->data(), input_copy->length());
   } else {
-    start_pos_ = input.data();
-  }
-  pos_ = start_pos_;
-  end_pos_ = start_pos_ + input.length();
-  index_ = 0;
-  line_number_ = 1;
-  index_last_line_ = 0;
-
-  error_code_ = JSONReader::JSON_NO_ERROR;
-  error_line_ = 0;
-  error_column_ = 0;
-
-  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
-  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // ParseNextToken function mis-treating a Unicode BOM as an invalid
-  // character and returning NULL.
-  if (CanConsume(3) && static_cast<uint8_t>(*pos_) == 0xEF &&
-      static_cast<uint8_t>(*(pos_ + 1)) == 0xBB &&
-      static_cast<uint8_t>(*(pos_ + 2)) == 0xBF) {
-    NextNChars(3);
+    StartInput(input.data(), input.length());
   }
 
   // Parse the first and any nested tokens.
@@ -238,13 +220,8 @@ std::unique_ptr<Value> JSONParser::Parse(StringPiece input) {
   if (!root)
     return nullptr;
 
-  // Make sure the input stream is at an end.
-  if (GetNextToken() != T_END_OF_INPUT) {
-    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
-      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
-      return nullptr;
-    }
-  }
+  if (!IsAtEndOfInput())
+    return nullptr;
 
   // Dictionaries and lists can contain JSONStringValues, so wrap them in a
   // hidden root.
@@ -269,6 +246,18 @@ std::unique_ptr<Value> JSONParser::Parse(StringPiece input) {
   return root;
 }
 
+bool JSONParser::Parse(StringPiece input, Handler* handler) {
+  // Built values are handed to |handler| and must not refer to |input|.
+  const int options = options_;
+  options_ |= JSON_DETACHABLE_CHILDREN;
+  handler_ = handler;
+  StartInput(input.data(), input.length());
+  bool result = VisitToken(GetNextToken()) && IsAtEndOfInput();
+  handler_ = nullptr;
+  options_ = options;
+  return result;
+}
+
 JSONReader::JsonParseError JSONParser::error_code() const {
   return error_code_;
 }
@@ -593,6 +582,255 @@ Value* JSONParser::ConsumeList() {
   return list.release();
 }
 
+bool JSONParser::VisitToken(Token token) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+      return VisitDictionary();
+    case T_ARRAY_BEGIN:
+      return VisitList();
+    case T_STRING: {
+      StringBuilder string;
+      if (!ConsumeStringRaw(&string))
+        return false;
+      handler_->OnString(string.CanBeStringPiece()
+                             ? string.AsStringPiece()
+                             : StringPiece(string.AsString()));
+      return true;
+    }
+    case T_NUMBER: {
+      StringPiece number;
+      if (!ConsumeNumberRaw(&number))
+        return false;
+      int num_int;
+      if (StringToInt(number, &num_int)) {
+        handler_->OnInteger(num_int);
+        return true;
+      }
+      double num_double;
+      if (StringToDouble(number.as_string(), &num_double) &&
+          std::isfinite(num_double)) {
+        handler_->OnDouble(num_double);
+        return true;
+      }
+      return false;
+    }
+    case T_BOOL_TRUE:
+    case T_BOOL_FALSE:
+    case T_NULL: {
+      const char first = *pos_;
+      if (!ConsumeLiteralRaw())
+        return false;
+      if (first == 'n')
+        handler_->OnNull();
+      else
+        handler_->OnBoolean(first == 't');
+      return true;
+    }
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
+  }
+}
+
+bool JSONParser::VisitDictionary() {
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  handler_->OnObjectBegin();
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_OBJECT_END) {
+    if (token != T_STRING) {
+      ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+      return false;
+    }
+    StringBuilder key;
+    if (!ConsumeStringRaw(&key))
+      return false;
+
+    NextChar();
+    if (GetNextToken() != T_OBJECT_PAIR_SEPARATOR) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    NextChar();
+    switch (handler_->OnMemberKey(key.CanBeStringPiece()
+                                      ? key.AsStringPiece()
+                                      : StringPiece(key.AsString()))) {
+      case Handler::Member::kVisit:
+        if (!VisitToken(GetNextToken()))
+          return false;
+        break;
+      case Handler::Member::kBuild: {
+        std::unique_ptr<Value> value(ParseNextToken());
+        if (!value)
+          return false;
+        handler_->OnValue(std::move(value));
+        break;
+      }
+      case Handler::Member::kSkip:
+        if (!SkipToken(GetNextToken()))
+          return false;
+        break;
+    }
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_OBJECT_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_OBJECT_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 0);
+      return false;
+    }
+  }
+
+  handler_->OnObjectEnd();
+  return true;
+}
+
+bool JSONParser::VisitList() {
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  handler_->OnListBegin();
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_ARRAY_END) {
+    if (!VisitToken(token))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_ARRAY_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_ARRAY_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+  }
+
+  handler_->OnListEnd();
+  return true;
+}
+
+bool JSONParser::SkipToken(Token token) {
+  switch (token) {
+    case T_OBJECT_BEGIN:
+      return SkipDictionary();
+    case T_ARRAY_BEGIN:
+      return SkipList();
+    case T_STRING: {
+      StringBuilder string;
+      return ConsumeStringRaw(&string);
+    }
+    case T_NUMBER: {
+      StringPiece number;
+      return ConsumeNumberRaw(&number);
+    }
+    case T_BOOL_TRUE:
+    case T_BOOL_FALSE:
+    case T_NULL:
+      return ConsumeLiteralRaw();
+    default:
+      ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
+      return false;
+  }
+}
+
+bool JSONParser::SkipDictionary() {
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_OBJECT_END) {
+    if (token != T_STRING) {
+      ReportError(JSONReader::JSON_UNQUOTED_DICTIONARY_KEY, 1);
+      return false;
+    }
+    StringBuilder key;
+    if (!ConsumeStringRaw(&key))
+      return false;
+
+    NextChar();
+    if (GetNextToken() != T_OBJECT_PAIR_SEPARATOR) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+
+    NextChar();
+    if (!SkipToken(GetNextToken()))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_OBJECT_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_OBJECT_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 0);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool JSONParser::SkipList() {
+  StackMarker depth_check(&stack_depth_);
+  if (depth_check.IsTooDeep()) {
+    ReportError(JSONReader::JSON_TOO_MUCH_NESTING, 1);
+    return false;
+  }
+
+  NextChar();
+  Token token = GetNextToken();
+  while (token != T_ARRAY_END) {
+    if (!SkipToken(token))
+      return false;
+
+    NextChar();
+    token = GetNextToken();
+    if (token == T_LIST_SEPARATOR) {
+      NextChar();
+      token = GetNextToken();
+      if (token == T_ARRAY_END && !(options_ & JSON_ALLOW_TRAILING_COMMAS)) {
+        ReportError(JSONReader::JSON_TRAILING_COMMA, 1);
+        return false;
+      }
+    } else if (token != T_ARRAY_END) {
+      ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
+      return false;
+    }
+  }
+  return true;
+}
+
 Value* JSONParser::ConsumeString() {
   StringBuilder string;
   if (!ConsumeStringRaw(&string))
@@ -823,6 +1061,24 @@ void JSONParser::DecodeUTF8(const int32_t& point, StringBuilder* dest) {
 }
 
 Value* JSONParser::ConsumeNumber() {
+  StringPiece num_string;
+  if (!ConsumeNumberRaw(&num_string))
+    return nullptr;
+
+  int num_int;
+  if (StringToInt(num_string, &num_int))
+    return new FundamentalValue(num_int);
+
+  double num_double;
+  if (StringToDouble(num_string.as_string(), &num_double) &&
+      std::isfinite(num_double)) {
+    return new FundamentalValue(num_double);
+  }
+
+  return nullptr;
+}
+
+bool JSONParser::ConsumeNumberRaw(StringPiece* number) {
   const char* num_start = pos_;
   const int start_index = index_;
   int end_index = start_index;
@@ -832,7 +1088,7 @@ Value* JSONParser::ConsumeNumber() {
 
   if (!ReadInt(false)) {
     ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-    return nullptr;
+    return false;
   }
   end_index = index_;
 
@@ -840,12 +1096,12 @@ Value* JSONParser::ConsumeNumber() {
   if (*pos_ == '.') {
     if (!CanConsume(1)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return false;
     }
     NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return false;
     }
     end_index = index_;
   }
@@ -857,7 +1113,7 @@ Value* JSONParser::ConsumeNumber() {
       NextChar();
     if (!ReadInt(true)) {
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return false;
     }
     end_index = index_;
   }
@@ -877,25 +1133,14 @@ Value* JSONParser::ConsumeNumber() {
       break;
     default:
       ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-      return nullptr;
+      return false;
   }
 
   pos_ = exit_pos;
   index_ = exit_index;
 
-  StringPiece num_string(num_start, end_index - start_index);
-
-  int num_int;
-  if (StringToInt(num_string, &num_int))
-    return new FundamentalValue(num_int);
-
-  double num_double;
-  if (StringToDouble(num_string.as_string(), &num_double) &&
-      std::isfinite(num_double)) {
-    return new FundamentalValue(num_double);
-  }
-
-  return nullptr;
+  *number = StringPiece(num_start, end_index - start_index);
+  return true;
 }
 
 bool JSONParser::ReadInt(bool allow_leading_zeros) {
@@ -918,6 +1163,20 @@ bool JSONParser::ReadInt(bool allow_leading_zeros) {
 }
 
 Value* JSONParser::ConsumeLiteral() {
+  const char first = *pos_;
+  if (!ConsumeLiteralRaw())
+    return nullptr;
+  switch (first) {
+    case 't':
+      return new FundamentalValue(true);
+    case 'f':
+      return new FundamentalValue(false);
+    default:
+      return Value::CreateNullValue().release();
+  }
+}
+
+bool JSONParser::ConsumeLiteralRaw() {
   switch (*pos_) {
     case 't': {
       const char kTrueLiteral[] = "true";
@@ -925,10 +1184,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kTrueLen - 1) ||
           !StringsAreEqual(pos_, kTrueLiteral, kTrueLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return nullptr;
+        return false;
       }
       NextNChars(kTrueLen - 1);
-      return new FundamentalValue(true);
+      return true;
     }
     case 'f': {
       const char kFalseLiteral[] = "false";
@@ -936,10 +1195,10 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kFalseLen - 1) ||
           !StringsAreEqual(pos_, kFalseLiteral, kFalseLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return nullptr;
+        return false;
       }
       NextNChars(kFalseLen - 1);
-      return new FundamentalValue(false);
+      return true;
     }
     case 'n': {
       const char kNullLiteral[] = "null";
@@ -947,14 +1206,14 @@ Value* JSONParser::ConsumeLiteral() {
       if (!CanConsume(kNullLen - 1) ||
           !StringsAreEqual(pos_, kNullLiteral, kNullLen)) {
         ReportError(JSONReader::JSON_SYNTAX_ERROR, 1);
-        return nullptr;
+        return false;
       }
       NextNChars(kNullLen - 1);
-      return Value::CreateNullValue().release();
+      return true;
     }
     default:
       ReportError(JSONReader::JSON_UNEXPECTED_TOKEN, 1);
-      return nullptr;
+      return false;
   }
 }
 
@@ -963,6 +1222,40 @@ bool JSONParser::StringsAreEqual(const char* one, const char* two, size_t len) {
   return strncmp(one, two, len) == 0;
 }
 
+void JSONParser::StartInput(const char* start, size_t length) {
+  start_pos_ = start;
+  pos_ = start_pos_;
+  end_pos_ = start_pos_ + length;
+  index_ = 0;
+  line_number_ = 1;
+  index_last_line_ = 0;
+
+  error_code_ = JSONReader::JSON_NO_ERROR;
+  error_line_ = 0;
+  error_column_ = 0;
+
+  // When the input JSON string starts with a UTF-8 Byte-Order-Mark
+  // <0xEF 0xBB 0xBF>, advance the start position to avoid the
+  // ParseNextToken function mis-treating a Unicode BOM as an invalid
+  // character and returning NULL.
+  if (CanConsume(3) && static_cast<uint8_t>(*pos_) == 0xEF &&
+      static_cast<uint8_t>(*(pos_ + 1)) == 0xBB &&
+      static_cast<uint8_t>(*(pos_ + 2)) == 0xBF) {
+    NextNChars(3);
+  }
+}
+
+bool JSONParser::IsAtEndOfInput() {
+  // Make sure the input stream is at an end.
+  if (GetNextToken() != T_END_OF_INPUT) {
+    if (!CanConsume(1) || (NextChar() && GetNextToken() != T_END_OF_INPUT)) {
+      ReportError(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, 1);
+      return false;
+    }
+  }
+  return true;
+}
+
 void JSONParser::ReportError(JSONReader::JsonParseError code,
                              int column_adjust) {
   error_code_ = code;
@@ -53,6 +53,40 @@ class BASE_EXPORT JSONParser {
   // result as a Value owned by the caller.
   std::unique_ptr<Value> Parse(StringPiece input);
 
+  // Receives the structure of a document from Parse(StringPiece, Handler*)
+  // as it is parsed, without a Value tree being built for it. Strings passed
+  // to the handler are only valid during the call.
+  class BASE_EXPORT Handler {
+   public:
+    // What the parser does with the value of an object member.
+    enum class Member {
+      kVisit,  // Reports the value to the handler.
+      kBuild,  // Builds the value and passes it to OnValue().
+      kSkip,   // Checks the value for errors, but does not report it.
+    };
+
+    virtual ~Handler() {}
+
+    virtual void OnObjectBegin() {}
+    // Called with the key of each object member before its value.
+    virtual Member OnMemberKey(StringPiece key) = 0;
+    virtual void OnObjectEnd() {}
+    virtual void OnListBegin() {}
+    virtual void OnListEnd() {}
+    virtual void OnString(StringPiece value) {}
+    virtual void OnInteger(int value) {}
+    virtual void OnDouble(double value) {}
+    virtual void OnBoolean(bool value) {}
+    virtual void OnNull() {}
+    // Called with the value of a member built on request of OnMemberKey().
+    virtual void OnValue(std::unique_ptr<Value> value) {}
+  };
+
+  // Parses the input string according to the set options and reports it to
+  // |handler|. Values built for the handler never refer to |input|, as with
+  // JSON_DETACHABLE_CHILDREN. Returns false on error.
+  bool Parse(StringPiece input, Handler* handler);
+
   // Returns the error code.
   JSONReader::JsonParseError error_code() const;
 
@@ -175,6 +209,18 @@ class BASE_EXPORT JSONParser {
   // ListValue.
   Value* ConsumeList();
 
+  // Takes a token like ParseToken() and reports the value to |handler_|
+  // instead of building it. Returns false on error.
+  bool VisitToken(Token token);
+  bool VisitDictionary();
+  bool VisitList();
+
+  // Takes a token like ParseToken() and checks the value, but does not build
+  // it. Returns false on error.
+  bool SkipToken(Token token);
+  bool SkipDictionary();
+  bool SkipList();
+
   // Calls through ConsumeStringRaw and wraps it in a value.
   Value* ConsumeString();
 
@@ -197,6 +243,9 @@ class BASE_EXPORT JSONParser {
   // Assuming that the parser is wound to the start of a valid JSON number,
   // this parses and converts it to either an int or double value.
   Value* ConsumeNumber();
+  // Consumes a number like ConsumeNumber() and sets |number| to its text.
+  // Returns false on error.
+  bool ConsumeNumberRaw(StringPiece* number);
   // Helper that reads characters that are ints. Returns true if a number was
   // read and false on error.
   bool ReadInt(bool allow_leading_zeros);
@@ -204,10 +253,21 @@ class BASE_EXPORT JSONParser {
   // Consumes the literal values of |true|, |false|, and |null|, assuming the
   // parser is wound to the first character of any of those.
   Value* ConsumeLiteral();
+  // Consumes a literal like ConsumeLiteral() without building a value.
+  // Returns false on error.
+  bool ConsumeLiteralRaw();
 
   // Compares two string buffers of a given length.
   static bool StringsAreEqual(const char* left, const char* right, size_t len);
 
+  // Resets the parser to the start of |length| bytes at |start|, skipping a
+  // UTF-8 Byte-Order-Mark.
+  void StartInput(const char* start, size_t length);
+
+  // Returns whether only whitespace and comments follow the root value.
+  // Reports an error otherwise.
+  bool IsAtEndOfInput();
+
   // Sets the error information to |code| at the current column, based on
   // |index_| and |index_last_line_|, with an optional positive/negative
   // adjustment by |column_adjust|.
@@ -221,6 +281,9 @@ class BASE_EXPORT JSONParser {
   // base::JSONParserOptions that control parsing.
   int options_;
 
+  // Receives the document while Parse(StringPiece, Handler*) runs.
+  Handler* handler_;
+
   // Pointer to the start of the input data.
   const char* start_pos_;
 
@@ -21,6 +21,17 @@ namespace base {
 
 namespace {
 
+#if defined(BASE_DICTIONARY_VALUE_STD_MAP)
+// std::map only looks up keys of its key type.
+std::string StorageKey(StringPiece key) {
+  return key.as_string();
+}
+#else
+StringPiece StorageKey(StringPiece key) {
+  return key;
+}
+#endif
+
 std::unique_ptr<Value> CopyWithoutEmptyChildren(const Value& node);
 
 // Make a deep copy of |node|, but don't include empty lists or dictionaries
@@ -445,19 +456,21 @@ bool DictionaryValue::Get(StringPiece path,
   for (size_t delimiter_position = current_path.find('.');
        delimiter_position != std::string::npos;
        delimiter_position = current_path.find('.')) {
-    const DictionaryValue* child_dictionary = NULL;
-    if (!current_dictionary->GetDictionaryWithoutPathExpansion(
-            current_path.substr(0, delimiter_position).as_string(),
-            &child_dictionary)) {
+    auto entry = current_dictionary->dictionary_.find(
+        StorageKey(current_path.substr(0, delimiter_position)));
+    if (entry == current_dictionary->dictionary_.end() ||
+        !entry->second->GetAsDictionary(&current_dictionary)) {
       return false;
     }
-
-    current_dictionary = child_dictionary;
     current_path = current_path.substr(delimiter_position + 1);
   }
 
-  return current_dictionary->GetWithoutPathExpansion(current_path.as_string(),
-                                                     out_value);
+  auto entry = current_dictionary->dictionary_.find(StorageKey(current_path));
+  if (entry == current_dictionary->dictionary_.end())
+    return false;
+  if (out_value)
+    *out_value = entry->second.get();
+  return true;
 }
 
 bool DictionaryValue::Get(StringPiece path, Value** out_value)  {
@@ -29,6 +29,7 @@
 
 #include "base/base_export.h"
 #include "base/compiler_specific.h"
+#include "base/containers/flat_map.h"
 #include "base/macros.h"
 #include "base/strings/string_piece.h"
 
@@ -202,7 +203,22 @@ class BASE_EXPORT BinaryValue : public Value {
 // are |std::string|s and should be UTF-8 encoded.
 class BASE_EXPORT DictionaryValue : public Value {
  public:
+  // The entries are kept in a vector sorted by key. Most dictionaries are
+  // small and read far more often than written, and lookups and iteration
+  // then run over contiguous memory. Inserting or erasing a key moves the
+  // entries after it, so filling a dictionary of thousands of keys in random
+  // order is quadratic. Builds with such dictionaries can define
+  // BASE_DICTIONARY_VALUE_STD_MAP to store the entries in a std::map.
+#if defined(BASE_DICTIONARY_VALUE_STD_MAP)
   using Storage = std::map<std::string, std::unique_ptr<Value>>;
+#else
+  // Compares keys with StringPieces, so path components can be looked up
+  // without copying them.
+  struct KeyLess {
+    bool operator()(StringPiece a, StringPiece b) const { return a < b; }
+  };
+  using Storage = flat_map<std::string, std::unique_ptr<Value>, KeyLess>;
+#endif
   // Returns |value| if it is a dictionary, nullptr otherwise.
   static std::unique_ptr<DictionaryValue> From(std::unique_ptr<Value> value);
 
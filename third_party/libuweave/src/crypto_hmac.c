@@ -6,26 +6,25 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 
-bool uw_crypto_hmac_(const uint8_t* key,
-                     size_t key_len,
-                     const UwCryptoHmacMsg messages[],
-                     size_t num_messages,
-                     uint8_t* truncated_digest,
-                     size_t truncated_digest_len) {
-  HMAC_CTX context = {0};
-  HMAC_CTX_init(&context);
-  if (!HMAC_Init(&context, key, key_len, EVP_sha256()))
-    return false;
+struct UwCryptoHmacKey {
+  HMAC_CTX context;
+};
 
+static bool hmac_update_final_(HMAC_CTX* context,
+                               const UwCryptoHmacMsg messages[],
+                               size_t num_messages,
+                               uint8_t* truncated_digest,
+                               size_t truncated_digest_len) {
   for (size_t i = 0; i < num_messages; ++i) {
     if (messages[i].num_bytes &&
         (!messages[i].bytes ||
-         !HMAC_Update(&context, messages[i].bytes, messages[i].num_bytes))) {
+         !HMAC_Update(context, messages[i].bytes, messages[i].num_bytes))) {
       return false;
     }
   }
@@ -38,10 +37,68 @@ bool uw_crypto_hmac_(const uint8_t* key,
   uint8_t digest[kFullDigestLen];
   uint32_t len = kFullDigestLen;
 
-  bool result = HMAC_Final(&context, digest, &len) && kFullDigestLen == len;
-  HMAC_CTX_cleanup(&context);
+  bool result = HMAC_Final(context, digest, &len) && kFullDigestLen == len;
   if (result) {
     memcpy(truncated_digest, digest, truncated_digest_len);
   }
   return result;
 }
+
+bool uw_crypto_hmac_(const uint8_t* key,
+                     size_t key_len,
+                     const UwCryptoHmacMsg messages[],
+                     size_t num_messages,
+                     uint8_t* truncated_digest,
+                     size_t truncated_digest_len) {
+  HMAC_CTX context = {0};
+  HMAC_CTX_init(&context);
+  bool result = HMAC_Init(&context, key, key_len, EVP_sha256()) &&
+                hmac_update_final_(&context, messages, num_messages,
+                                   truncated_digest, truncated_digest_len);
+  HMAC_CTX_cleanup(&context);
+  return result;
+}
+
+UwCryptoHmacKey* uw_crypto_hmac_key_create_(const uint8_t* key,
+                                            size_t key_len) {
+  UwCryptoHmacKey* hmac_key = calloc(1, sizeof(UwCryptoHmacKey));
+  if (hmac_key == NULL) {
+    return NULL;
+  }
+  HMAC_CTX_init(&hmac_key->context);
+  if (!HMAC_Init_ex(&hmac_key->context, key, key_len, EVP_sha256(), NULL)) {
+    uw_crypto_hmac_key_destroy_(hmac_key);
+    return NULL;
+  }
+  return hmac_key;
+}
+
+bool uw_crypto_hmac_key_set_(UwCryptoHmacKey* hmac_key,
+                             const uint8_t* key,
+                             size_t key_len) {
+  // A NULL key would keep the previous one.
+  if (hmac_key == NULL || key == NULL) {
+    return false;
+  }
+  return HMAC_Init_ex(&hmac_key->context, key, key_len, NULL, NULL);
+}
+
+bool uw_crypto_hmac_with_key_(UwCryptoHmacKey* hmac_key,
+                              const UwCryptoHmacMsg messages[],
+                              size_t num_messages,
+                              uint8_t* truncated_digest,
+                              size_t truncated_digest_len) {
+  // Without a key HMAC_Init_ex() restarts from the hashed padded key.
+  return hmac_key != NULL &&
+         HMAC_Init_ex(&hmac_key->context, NULL, 0, NULL, NULL) &&
+         hmac_update_final_(&hmac_key->context, messages, num_messages,
+                            truncated_digest, truncated_digest_len);
+}
+
+void uw_crypto_hmac_key_destroy_(UwCryptoHmacKey* hmac_key) {
+  if (hmac_key == NULL) {
+    return;
+  }
+  HMAC_CTX_cleanup(&hmac_key->context);
+  free(hmac_key);
+}
@@ -26,4 +26,31 @@ bool uw_crypto_hmac_(const uint8_t* key,
                      uint8_t* truncated_digest,
                      size_t truncated_digest_len);
 
+/**
+ * HMAC keyed with one secret. The padded key is hashed once, when the key is
+ * set, and every HMAC computed with it starts from that state.
+ */
+typedef struct UwCryptoHmacKey UwCryptoHmacKey;
+
+/** Create a keyed HMAC, returns NULL on failure. */
+UwCryptoHmacKey* uw_crypto_hmac_key_create_(const uint8_t* key,
+                                            size_t key_len);
+
+/**
+ * Replace the key of hmac_key. Reusing one object for a chain of keys, as a
+ * macaroon chain does, avoids creating one per key.
+ */
+bool uw_crypto_hmac_key_set_(UwCryptoHmacKey* hmac_key,
+                             const uint8_t* key,
+                             size_t key_len);
+
+/** Same as uw_crypto_hmac_() with the key of hmac_key. */
+bool uw_crypto_hmac_with_key_(UwCryptoHmacKey* hmac_key,
+                              const UwCryptoHmacMsg messages[],
+                              size_t num_messages,
+                              uint8_t* truncated_digest,
+                              size_t truncated_digest_len);
+
+void uw_crypto_hmac_key_destroy_(UwCryptoHmacKey* hmac_key);
+
 #endif  // LIBUWEAVE_SRC_CRYPTO_HMAC_H_
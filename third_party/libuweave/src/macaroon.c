@@ -11,13 +11,14 @@
 #include "src/macaroon_caveat_internal.h"
 #include "src/macaroon_encoding.h"
 
-static bool create_mac_tag_(const uint8_t* key,
-                            size_t key_len,
+// Signs the first caveat with root_key and every next one with the previous
+// tag.
+static bool create_mac_tag_(UwCryptoHmacKey* root_key,
                             const UwMacaroonContext* context,
                             const UwMacaroonCaveat* const caveats[],
                             size_t num_caveats,
                             uint8_t mac_tag[UW_MACAROON_MAC_LEN]) {
-  if (key == NULL || key_len == 0 || context == NULL || caveats == NULL ||
+  if (root_key == NULL || context == NULL || caveats == NULL ||
       num_caveats == 0 || mac_tag == NULL) {
     return false;
   }
@@ -30,37 +31,44 @@ static bool create_mac_tag_(const uint8_t* key,
   uint8_t mac_tag_buff[UW_MACAROON_MAC_LEN];
 
   // Compute the first tag by using the key
-  if (!uw_macaroon_caveat_sign_(key, key_len, context, caveats[0], mac_tag_buff,
-                                sizeof(mac_tag_buff))) {
-    return false;
-  }
-
-  // Compute the rest of the tags by using the tag as the key
-  for (size_t i = 1; i < num_caveats; i++) {
-    if (!uw_macaroon_caveat_sign_(mac_tag_buff, sizeof(mac_tag_buff), context,
-                                  caveats[i], mac_tag_buff,
-                                  sizeof(mac_tag_buff))) {
-      return false;
+  bool result = uw_macaroon_caveat_sign_(root_key, context, caveats[0],
+                                         mac_tag_buff, sizeof(mac_tag_buff));
+
+  // Compute the rest of the tags by using the tag as the key. The tags key one
+  // HMAC object in turn.
+  UwCryptoHmacKey* tag_key = NULL;
+  for (size_t i = 1; result && i < num_caveats; i++) {
+    if (tag_key == NULL) {
+      tag_key = uw_crypto_hmac_key_create_(mac_tag_buff, sizeof(mac_tag_buff));
+      result = tag_key != NULL;
+    } else {
+      result =
+          uw_crypto_hmac_key_set_(tag_key, mac_tag_buff, sizeof(mac_tag_buff));
     }
+    result = result && uw_macaroon_caveat_sign_(tag_key, context, caveats[i],
+                                                mac_tag_buff,
+                                                sizeof(mac_tag_buff));
   }
+  uw_crypto_hmac_key_destroy_(tag_key);
 
-  memcpy(mac_tag, mac_tag_buff, UW_MACAROON_MAC_LEN);
-  return true;
+  if (result) {
+    memcpy(mac_tag, mac_tag_buff, UW_MACAROON_MAC_LEN);
+  }
+  return result;
 }
 
-static bool verify_mac_tag_(const uint8_t* root_key,
-                            size_t root_key_len,
+static bool verify_mac_tag_(UwCryptoHmacKey* root_key,
                             const UwMacaroonContext* context,
                             const UwMacaroonCaveat* const caveats[],
                             size_t num_caveats,
                             const uint8_t mac_tag[UW_MACAROON_MAC_LEN]) {
-  if (root_key == NULL || root_key_len == 0 || context == NULL ||
-      caveats == NULL || num_caveats == 0 || mac_tag == 0) {
+  if (root_key == NULL || context == NULL || caveats == NULL ||
+      num_caveats == 0 || mac_tag == 0) {
     return false;
   }
 
   uint8_t computed_mac_tag[UW_MACAROON_MAC_LEN] = {0};
-  if (!create_mac_tag_(root_key, root_key_len, context, caveats, num_caveats,
+  if (!create_mac_tag_(root_key, context, caveats, num_caveats,
                        computed_mac_tag)) {
     return false;
   }
@@ -74,12 +82,29 @@ bool uw_macaroon_create_from_root_key_(UwMacaroon* new_macaroon,
                                        const UwMacaroonContext* context,
                                        const UwMacaroonCaveat* const caveats[],
                                        size_t num_caveats) {
+  if (root_key == NULL || root_key_len == 0) {
+    return false;
+  }
+
+  UwCryptoHmacKey* hmac_key =
+      uw_crypto_hmac_key_create_(root_key, root_key_len);
+  bool result = uw_macaroon_create_from_hmac_key_(
+      new_macaroon, hmac_key, context, caveats, num_caveats);
+  uw_crypto_hmac_key_destroy_(hmac_key);
+  return result;
+}
+
+bool uw_macaroon_create_from_hmac_key_(UwMacaroon* new_macaroon,
+                                       UwCryptoHmacKey* root_key,
+                                       const UwMacaroonContext* context,
+                                       const UwMacaroonCaveat* const caveats[],
+                                       size_t num_caveats) {
   if (new_macaroon == NULL || root_key == NULL || context == NULL ||
-      root_key_len == 0 || caveats == NULL || num_caveats == 0) {
+      caveats == NULL || num_caveats == 0) {
     return false;
   }
 
-  if (!create_mac_tag_(root_key, root_key_len, context, caveats, num_caveats,
+  if (!create_mac_tag_(root_key, context, caveats, num_caveats,
                        new_macaroon->mac_tag)) {
     return false;
   }
@@ -124,9 +149,13 @@ bool uw_macaroon_extend_(const UwMacaroon* old_macaroon,
   new_macaroon->caveats = (const UwMacaroonCaveat* const*)extended_list;
 
   // Compute the new MAC tag
-  return create_mac_tag_(old_macaroon->mac_tag, UW_MACAROON_MAC_LEN, context,
-                         new_macaroon->caveats + old_count, 1,
-                         new_macaroon->mac_tag);
+  UwCryptoHmacKey* hmac_key =
+      uw_crypto_hmac_key_create_(old_macaroon->mac_tag, UW_MACAROON_MAC_LEN);
+  bool result = create_mac_tag_(hmac_key, context,
+                                new_macaroon->caveats + old_count, 1,
+                                new_macaroon->mac_tag);
+  uw_crypto_hmac_key_destroy_(hmac_key);
+  return result;
 }
 
 static void init_validation_result(UwMacaroonValidationResult* result) {
@@ -169,9 +198,29 @@ bool uw_macaroon_validate_(const UwMacaroon* macaroon,
   }
   init_validation_result(result);
 
-  if (root_key == NULL || root_key_len == 0 || macaroon == NULL ||
-      context == NULL || result == NULL ||
-      !verify_mac_tag_(root_key, root_key_len, context, macaroon->caveats,
+  if (root_key == NULL || root_key_len == 0) {
+    return false;
+  }
+
+  UwCryptoHmacKey* hmac_key =
+      uw_crypto_hmac_key_create_(root_key, root_key_len);
+  bool is_valid =
+      uw_macaroon_validate_with_hmac_key_(macaroon, hmac_key, context, result);
+  uw_crypto_hmac_key_destroy_(hmac_key);
+  return is_valid;
+}
+
+bool uw_macaroon_validate_with_hmac_key_(const UwMacaroon* macaroon,
+                                         UwCryptoHmacKey* root_key,
+                                         const UwMacaroonContext* context,
+                                         UwMacaroonValidationResult* result) {
+  if (result == NULL) {
+    return false;
+  }
+  init_validation_result(result);
+
+  if (root_key == NULL || macaroon == NULL || context == NULL ||
+      !verify_mac_tag_(root_key, context, macaroon->caveats,
                        macaroon->num_caveats, macaroon->mac_tag)) {
     return false;
   }
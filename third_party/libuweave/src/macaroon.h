@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <time.h>
 
+#include "src/crypto_hmac.h"
 #include "src/macaroon_caveat.h"
 #include "src/macaroon_context.h"
 
@@ -63,6 +64,16 @@ bool uw_macaroon_create_from_root_key_(UwMacaroon* new_macaroon,
                                        const UwMacaroonCaveat* const caveats[],
                                        size_t num_caveats);
 
+/**
+ * Same as uw_macaroon_create_from_root_key_() with a root key that is already
+ * set up, for the callers signing many macaroons with one key.
+ */
+bool uw_macaroon_create_from_hmac_key_(UwMacaroon* new_macaroon,
+                                       UwCryptoHmacKey* root_key,
+                                       const UwMacaroonContext* context,
+                                       const UwMacaroonCaveat* const caveats[],
+                                       size_t num_caveats);
+
 /**
  * Creates a new macaroon with a new caveat. The buffer must be large enough to
  * hold the count of caveats in the old_macaroon plus one.
@@ -85,6 +96,12 @@ bool uw_macaroon_validate_(const UwMacaroon* macaroon,
                            const UwMacaroonContext* context,
                            UwMacaroonValidationResult* result);
 
+/** Same as uw_macaroon_validate_() with a root key that is already set up. */
+bool uw_macaroon_validate_with_hmac_key_(const UwMacaroon* macaroon,
+                                         UwCryptoHmacKey* root_key,
+                                         const UwMacaroonContext* context,
+                                         UwMacaroonValidationResult* result);
+
 /** Encode a Macaroon to a byte string. */
 bool uw_macaroon_serialize_(const UwMacaroon* macaroon,
                             uint8_t* out,
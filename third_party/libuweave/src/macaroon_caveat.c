@@ -337,14 +337,13 @@ bool uw_macaroon_caveat_get_type_(const UwMacaroonCaveat* caveat,
 
 /* === Some internal functions defined in macaroon_caveat_internal.h === */
 
-bool uw_macaroon_caveat_sign_(const uint8_t* key,
-                              size_t key_len,
+bool uw_macaroon_caveat_sign_(UwCryptoHmacKey* key,
                               const UwMacaroonContext* context,
                               const UwMacaroonCaveat* caveat,
                               uint8_t* mac_tag,
                               size_t mac_tag_size) {
-  if (key == NULL || key_len == 0 || context == NULL || caveat == NULL ||
-      mac_tag == NULL || mac_tag_size == 0) {
+  if (key == NULL || context == NULL || caveat == NULL || mac_tag == NULL ||
+      mac_tag_size == 0) {
     return false;
   }
 
@@ -372,9 +371,9 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
         {caveat->bytes, caveat->num_bytes},
     };
 
-    return uw_crypto_hmac_(key, key_len, messages,
-                           sizeof(messages) / sizeof(messages[0]), mac_tag,
-                           mac_tag_size);
+    return uw_crypto_hmac_with_key_(key, messages,
+                                    sizeof(messages) / sizeof(messages[0]),
+                                    mac_tag, mac_tag_size);
   }
 
   // If there is additional value from the context.
@@ -422,9 +421,9 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
       {additional_value_str, additional_value_str_len},
   };
 
-  return uw_crypto_hmac_(key, key_len, messages,
-                         sizeof(messages) / sizeof(messages[0]), mac_tag,
-                         mac_tag_size);
+  return uw_crypto_hmac_with_key_(key, messages,
+                                  sizeof(messages) / sizeof(messages[0]),
+                                  mac_tag, mac_tag_size);
 }
 
 static bool update_and_check_expiration_time(
@@ -9,11 +9,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "src/crypto_hmac.h"
 #include "src/macaroon.h"
 #include "src/macaroon_caveat.h"
 
-bool uw_macaroon_caveat_sign_(const uint8_t* key,
-                              size_t key_len,
+bool uw_macaroon_caveat_sign_(UwCryptoHmacKey* key,
                               const UwMacaroonContext* context,
                               const UwMacaroonCaveat* caveat,
                               uint8_t* mac_tag,